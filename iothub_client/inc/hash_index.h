@@ -0,0 +1,67 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	hash_index.h
+*	@brief	A string-keyed hash index, used by the transports to look up registered devices (and other items) by id in constant time.
+*/
+
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct HASH_INDEX_TAG* HASH_INDEX_HANDLE;
+
+/**
+* @brief	Creates a new hash index.
+*
+* @param	initial_bucket_count	Number of buckets to start with. If 0, a small default is used. The index doubles its bucket count whenever it holds more items than buckets.
+*
+* @returns	A valid HASH_INDEX_HANDLE if no failures occur, NULL otherwise.
+*/
+MOCKABLE_FUNCTION(, HASH_INDEX_HANDLE, hash_index_create, size_t, initial_bucket_count);
+
+/**
+* @brief	Destroys the hash index and the copies of the keys it holds. The values, and the keys added without a copy, are not touched.
+*/
+MOCKABLE_FUNCTION(, void, hash_index_destroy, HASH_INDEX_HANDLE, index);
+
+/**
+* @brief	Adds @c value to the index under a copy of @c key.
+*
+* @returns	0 if no failures occur, non-zero if the arguments are invalid, @c key is already in the index or memory cannot be allocated.
+*/
+MOCKABLE_FUNCTION(, int, hash_index_add, HASH_INDEX_HANDLE, index, const char*, key, void*, value);
+
+/**
+* @brief	Adds @c value to the index under @c key itself, without copying it. @c key must stay valid and unchanged until it is removed or the index is destroyed.
+*
+* @returns	0 if no failures occur, non-zero if the arguments are invalid, @c key is already in the index or memory cannot be allocated.
+*/
+MOCKABLE_FUNCTION(, int, hash_index_add_without_copy, HASH_INDEX_HANDLE, index, const char*, key, void*, value);
+
+/**
+* @brief	Looks up the value stored under @c key.
+*
+* @returns	The value stored under @c key, or NULL if the arguments are invalid or @c key is not in the index.
+*/
+MOCKABLE_FUNCTION(, void*, hash_index_find, HASH_INDEX_HANDLE, index, const char*, key);
+
+/**
+* @brief	Removes @c key from the index.
+*
+* @returns	0 if @c key was found and removed, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, hash_index_remove, HASH_INDEX_HANDLE, index, const char*, key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*HASH_INDEX_H*/
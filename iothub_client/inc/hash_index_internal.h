@@ -0,0 +1,27 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	hash_index_internal.h
+*	@brief	Internal helpers of the hash index shared with other modules of the client.
+*/
+
+#ifndef HASH_INDEX_INTERNAL_H
+#define HASH_INDEX_INTERNAL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+* @brief	Computes the FNV-1a hash of a NULL terminated @c key, the same hash the index uses to pick a bucket.
+*/
+extern size_t hash_index_get_key_hash(const char* key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*HASH_INDEX_INTERNAL_H*/
@@ -30,10 +30,80 @@ extern "C"
     static const char* OPTION_CBS_REQUEST_TIMEOUT = "cbs_request_timeout";
 
     static const char* OPTION_MIN_POLLING_TIME = "MinimumPollingTime";
+    static const char* OPTION_MAX_POLLING_TIME = "MaximumPollingTime";
     static const char* OPTION_BATCHING = "Batching";
 
     static const char* OPTION_MESSAGE_TIMEOUT = "messageTimeout";
     static const char* OPTION_PRODUCT_INFO = "product_info";
+
+    /*
+    * @brief Time window, in milliseconds, during which reported properties sent with IoTHubClient_LL_SendReportedState are held and JSON-merged
+    *        into a single PATCH as long as they have not been handed to the transport. Each merged report still gets its own callback.
+    *        Value is a pointer to a tickcounter_ms_t. The default value of 0 disables coalescing.
+    */
+    static const char* OPTION_TWIN_REPORTED_COALESCING_MS = "twin_reported_coalescing_ms";
+
+    /*
+    * @brief Keeps a local copy of the desired properties and their $version, patched with every partial update. A complete or partial
+    *        update whose desired $version is not newer than the local one (e.g. the twin fetched again after a reconnect) is not
+    *        delivered to the device twin callback. Value is a pointer to a bool. The default value is false.
+    */
+    static const char* OPTION_TWIN_DESIRED_CACHE = "twin_desired_cache";
+
+    /*
+    * @brief Pauses the delivery of cloud-to-device messages while the application catches up. While paused the transport is unsubscribed
+    *        (AMQP detaches the C2D link, MQTT unsubscribes from the devicebound topic, HTTP stops polling), so the service holds the messages
+    *        instead of the client buffering them. The message callback stays set. Value is a pointer to a bool. The default value is false.
+    */
+    static const char* OPTION_C2D_RECEIVE_PAUSED = "c2d_receive_paused";
+
+    /*
+    * @brief IoTHubClient (convenience layer) only. Number of worker threads that run the device method callbacks, so up to that many methods
+    *        execute in parallel without holding back the other callbacks. Responses are sent as each method completes. Can only be set once.
+    *        Value is a pointer to a size_t. The default value of 0 runs the methods one at a time on the callback dispatching thread.
+    */
+    static const char* OPTION_METHOD_WORKER_COUNT = "method_worker_count";
+
+    /*
+    * @brief MQTT only. When set to true telemetry is published with QoS 0 (at most once): no PUBACK is awaited and no resend is attempted.
+    *        The confirmation callback of each message is invoked with IOTHUB_CLIENT_CONFIRMATION_OK once the message is handed to the socket.
+    *        Meant for high-rate, loss-tolerant data. The default value is false.
+    */
+    static const char* OPTION_TELEMETRY_AT_MOST_ONCE = "telemetry_at_most_once";
+
+    /*
+    * @brief AMQP only. Target size, in bytes, of each batch of telemetry messages sent over the event link. Batches are still capped by the
+    *        maximum message size advertised by the service. Value is a pointer to a size_t. The default value of 0 uses the link maximum only.
+    */
+    static const char* OPTION_EVENT_BATCH_TARGET_SIZE = "event_batch_target_size";
+
+    /*
+    * @brief AMQP only. Maximum time, in milliseconds, a partially filled telemetry batch is held back waiting for more messages before it is sent.
+    *        Value is a pointer to a size_t. The default value of 0 sends whatever is pending on every DoWork.
+    */
+    static const char* OPTION_EVENT_BATCH_MAX_LINGER_MS = "event_batch_max_linger_ms";
+
+    /*
+    * @brief AMQP only. Maximum number of telemetry batches sent and not yet acknowledged by the service. New batches keep being filled, but are not
+    *        sent until one in flight completes. Value is a pointer to a size_t. The default value of 0 does not limit batches in flight.
+    */
+    static const char* OPTION_EVENT_BATCH_MAX_IN_FLIGHT = "event_batch_max_in_flight";
+
+    /*
+    * @brief AMQP only. Incoming and outgoing window, in transfer frames, of the AMQP session shared by all links of the connection. The outgoing window
+    *        bounds how many transfers can be outstanding at once, so raise it on high-latency links. Applied the next time the connection is established.
+    *        Value is a pointer to a size_t. The default value of 0 keeps the transport defaults (UINT_MAX incoming, 100 outgoing).
+    */
+    static const char* OPTION_AMQP_SESSION_INCOMING_WINDOW = "amqp_session_incoming_window";
+    static const char* OPTION_AMQP_SESSION_OUTGOING_WINDOW = "amqp_session_outgoing_window";
+
+    /*
+    * @brief AMQP only. Maximum number of devices multiplexed on the connection that are started (authenticated with a CBS put-token and their links attached) at once.
+    *        The remaining devices wait, without their start timeout running, until one of them completes. Value is a pointer to a size_t.
+    *        The default value of 0 starts all registered devices at once.
+    */
+    static const char* OPTION_AMQP_MAX_CONCURRENT_AUTHENTICATIONS = "amqp_max_concurrent_authentications";
+
     /*
     * @brief Informs the service of what is the maximum period the client will wait for a keep-alive message from the service.
     *        The service must send keep-alives before this timeout is reached, otherwise the client will trigger its re-connection logic.
@@ -53,6 +53,12 @@ typedef struct IOTHUB_MESSAGE_LIST_TAG
     tickcounter_ms_t ms_timesOutAfter; /* a value of "0" means "no timeout", if the IOTHUBCLIENT_LL's handle tickcounter > msTimesOutAfer then the message shall timeout*/
 }IOTHUB_MESSAGE_LIST;
 
+typedef struct IOTHUB_REPORTED_STATE_CALLBACK_INFO_TAG
+{
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reported_state_callback;
+    void* context;
+} IOTHUB_REPORTED_STATE_CALLBACK_INFO;
+
 typedef struct IOTHUB_DEVICE_TWIN_TAG
 {
     uint32_t item_id;
@@ -63,6 +69,9 @@ typedef struct IOTHUB_DEVICE_TWIN_TAG
     DLIST_ENTRY entry;
 	IOTHUB_CLIENT_LL_HANDLE client_handle;
 	IOTHUB_DEVICE_HANDLE device_handle;
+    tickcounter_ms_t create_time;
+    IOTHUB_REPORTED_STATE_CALLBACK_INFO* coalesced_callbacks; /* callbacks of the reports merged into this one, NULL if none */
+    size_t coalesced_count;
 } IOTHUB_DEVICE_TWIN;
 
 union IOTHUB_IDENTITY_INFO_TAG
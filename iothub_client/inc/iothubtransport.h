@@ -5,6 +5,7 @@
 #define IOTHUB_TRANSPORT_H
 
 typedef struct TRANSPORT_HANDLE_DATA_TAG* TRANSPORT_HANDLE;
+typedef struct TRANSPORT_POOL_HANDLE_DATA_TAG* TRANSPORT_POOL_HANDLE;
 
 
 #include "azure_c_shared_utility/lock.h"
@@ -36,6 +37,10 @@ extern "C"
     MOCKABLE_FUNCTION(, bool, IoTHubTransport_SignalEndWorkerThread, TRANSPORT_HANDLE, transportHandle, IOTHUB_CLIENT_HANDLE, clientHandle);
     MOCKABLE_FUNCTION(, void, IoTHubTransport_JoinWorkerThread, TRANSPORT_HANDLE, transportHandle, IOTHUB_CLIENT_HANDLE, clientHandle);
 
+    MOCKABLE_FUNCTION(, TRANSPORT_POOL_HANDLE, IoTHubTransport_CreatePool, IOTHUB_CLIENT_TRANSPORT_PROVIDER, protocol, const char*, iotHubName, const char*, iotHubSuffix, size_t, transportCount);
+    MOCKABLE_FUNCTION(, void, IoTHubTransport_DestroyPool, TRANSPORT_POOL_HANDLE, poolHandle);
+    MOCKABLE_FUNCTION(, TRANSPORT_HANDLE, IoTHubTransport_GetPoolTransport, TRANSPORT_POOL_HANDLE, poolHandle, const char*, deviceId);
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,6 +35,8 @@ typedef struct AMQP_CONNECTION_CONFIG_TAG
 	ON_AMQP_CONNECTION_STATE_CHANGED on_state_changed_callback;
 	const void* on_state_changed_context;
     size_t c2d_keep_alive_freq_secs;
+    size_t session_incoming_window;
+    size_t session_outgoing_window;
 } AMQP_CONNECTION_CONFIG;
 
 typedef struct AMQP_CONNECTION_INSTANCE* AMQP_CONNECTION_HANDLE;
@@ -23,6 +23,9 @@ static const char* DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS = "event_send_timeout_s
 static const char* DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS = "cbs_request_timeout_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS = "sas_token_refresh_time_secs";
 static const char* DEVICE_OPTION_SAS_TOKEN_LIFETIME_SECS = "sas_token_lifetime_secs";
+static const char* DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE = "event_batch_target_size";
+static const char* DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS = "event_batch_max_linger_msecs";
+static const char* DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT = "event_batch_max_in_flight";
 
 #define DEVICE_STATE_VALUES \
     DEVICE_STATE_STOPPED, \
@@ -80,7 +83,7 @@ DEFINE_ENUM(DEVICE_TWIN_UPDATE_TYPE, DEVICE_TWIN_UPDATE_TYPE_STRINGS)
 typedef struct DEVICE_MESSAGE_DISPOSITION_INFO_TAG
 {
     unsigned long message_id;
-    char* source;
+    const char* source;
 } DEVICE_MESSAGE_DISPOSITION_INFO;
 
 typedef void(*ON_DEVICE_STATE_CHANGED)(void* context, DEVICE_STATE previous_state, DEVICE_STATE new_state);
@@ -17,6 +17,9 @@ extern "C"
 
 static const char* MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS = "telemetry_event_send_timeout_secs";
 static const char* MESSENGER_OPTION_SAVED_OPTIONS = "saved_telemetry_messenger_options";
+static const char* MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE = "telemetry_event_batch_target_size";
+static const char* MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS = "telemetry_event_batch_max_linger_msecs";
+static const char* MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT = "telemetry_event_batch_max_in_flight";
 
 typedef struct TELEMETRY_MESSENGER_INSTANCE* TELEMETRY_MESSENGER_HANDLE;
 
@@ -55,7 +58,7 @@ typedef enum TELEMETRY_MESSENGER_STATE_TAG
 typedef struct TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO_TAG
 {
 	delivery_number message_id;
-	char* source;
+	const char* source;
 } TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO;
 
 typedef void(*ON_TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE)(IOTHUB_MESSAGE_LIST* iothub_message_list, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT messenger_event_send_complete_result, void* context);
@@ -0,0 +1,94 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/** @file	iothubtransport_http_common.h
+*	@brief	Helpers shared by the HTTP transport and the async HTTP transport.
+*/
+
+#ifndef IOTHUBTRANSPORT_HTTP_COMMON_H
+#define IOTHUBTRANSPORT_HTTP_COMMON_H
+
+#include <stddef.h>
+#include "azure_c_shared_utility/umock_c_prod.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "iothub_client_private.h"
+#include "iothub_message.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define IOTHUB_APP_PREFIX "iothub-app-"
+
+/*DEFAULT_GETMINIMUMPOLLINGTIME is the minimum time in seconds allowed between 2 consecutive GET issues to the service (GET=fetch messages)*/
+/*the default is 25 minutes*/
+#define DEFAULT_GETMINIMUMPOLLINGTIME ((unsigned int)25*60)
+
+/*DEFAULT_GETMAXIMUMPOLLINGTIME is the maximum time in seconds the polling interval backs off to after consecutive GETs without messages*/
+/*the default (0) disables the back off, and GETs are issued every getMinimumPollingTime*/
+#define DEFAULT_GETMAXIMUMPOLLINGTIME ((unsigned int)0)
+
+/*polling intervals get up to this percentage added at random, so devices sharing a transport do not poll in lockstep*/
+#define POLLING_JITTER_PERCENT 10
+
+/**
+* @brief	Computes how long to wait before the GET that follows one answered without a message.
+*
+* @param	baseInterval	The un-jittered interval of the previous GET (0 before the first one, or after a GET that received a message). It is updated to the new un-jittered interval.
+*
+* @returns	The new interval in seconds, jitter included.
+*/
+MOCKABLE_FUNCTION(, unsigned int, IoTHubTransport_HTTP_Common_GetNextPollingInterval, unsigned int, minimumPollingTime, unsigned int, maximumPollingTime, unsigned int*, baseInterval);
+
+/**
+* @brief	Computes the delay added once to the first polling interval of a device, so devices registered together do not poll in lockstep.
+*
+* @param	deviceIndex	The order in which the device was registered on its transport, starting at 0.
+*
+* @returns	A fraction of @c pollingInterval that is 0 for the first device and spreads the following ones evenly over the interval.
+*/
+MOCKABLE_FUNCTION(, unsigned int, IoTHubTransport_HTTP_Common_GetPollingPhaseOffset, unsigned int, pollingInterval, size_t, deviceIndex);
+
+/*the number of characters IoTHubTransport_HTTP_Common_EncodeBase64 writes for size bytes*/
+#define IOTHUB_BASE64_ENCODED_LENGTH(size) (4 * (((size) + 2) / 3))
+
+/**
+* @brief	Encodes @c size bytes of @c source as padded base64, looking up 2 output characters at a time.
+*
+* @param	destination	Receives IOTHUB_BASE64_ENCODED_LENGTH(size) characters, it is not null terminated.
+*
+* @returns	The number of characters written.
+*/
+MOCKABLE_FUNCTION(, size_t, IoTHubTransport_HTTP_Common_EncodeBase64, char*, destination, const unsigned char*, source, size_t, size);
+
+/**
+* @brief	Builds "iothub-app-" followed by @c key in a buffer owned by the caller, that is only reallocated when it is too small.
+*
+* @returns	The header name, valid until the next call with the same buffer, or NULL if the buffer cannot be grown.
+*/
+MOCKABLE_FUNCTION(, const char*, IoTHubTransport_HTTP_Common_GetPropertyHeaderName, char**, propertyHeaderName, size_t*, propertyHeaderNameSize, const char*, key);
+
+/**
+* @brief	Adds the "User-Agent" header, using the product info option of the client when it is set.
+*/
+MOCKABLE_FUNCTION(, HTTP_HEADERS_RESULT, IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo, IOTHUB_CLIENT_LL_HANDLE, iotHubClientHandle, HTTP_HEADERS_HANDLE, requestHeaders);
+
+/**
+* @brief	Copies the "iothub-app-" headers, message id, correlation id, content type and content encoding of a received message into it.
+*
+* @returns	true if all the headers were copied, false otherwise.
+*/
+MOCKABLE_FUNCTION(, bool, IoTHubTransport_HTTP_Common_SetMessageProperties, IOTHUB_MESSAGE_HANDLE, receivedMessage, HTTP_HEADERS_HANDLE, responseHeaders);
+
+/**
+* @brief	Moves the events of @c source back to the head of @c destination, undoing a send that could not happen.
+*/
+MOCKABLE_FUNCTION(, void, IoTHubTransport_HTTP_Common_ReversePutListBackIn, PDLIST_ENTRY, source, PDLIST_ENTRY, destination);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*IOTHUBTRANSPORT_HTTP_COMMON_H*/
@@ -11,6 +11,7 @@
 #include "azure_c_shared_utility/macro_utils.h"
 #include "azure_c_shared_utility/umock_c_prod.h"
 #include "azure_c_shared_utility/optionhandler.h"
+#include "iothub_client_ll.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -19,6 +20,7 @@ extern "C"
 
 typedef struct MESSAGE_QUEUE_TAG* MESSAGE_QUEUE_HANDLE;
 typedef void* MQ_MESSAGE_HANDLE;
+typedef struct MESSAGE_QUEUE_ITEM_TAG* MQ_ITEM_HANDLE;
 typedef void* USER_DEFINED_REASON;
 
 #define MESSAGE_QUEUE_RESULT_STRINGS  \
@@ -38,8 +40,9 @@ typedef void(*MESSAGE_PROCESSING_COMPLETED_CALLBACK)(MQ_MESSAGE_HANDLE message,
 /**
 * @brief	Callback that MUST be invoked by PROCESS_MESSAGE_CALLBACK (user provided) to signal to MESSAGE_QUEUE that a message has been processed.
 * @remarks  Besides causing MESSAGE_QUEUE to dequeue the message from its internal lists, causes MESSAGE_PROCESSING_COMPLETED_CALLBACK to be triggered.
+*           The message is identified by the @c MQ_ITEM_HANDLE returned by message_queue_add, so completing it does not depend on the number of messages queued.
 */
-typedef void(*PROCESS_MESSAGE_COMPLETED_CALLBACK)(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_QUEUE_RESULT result, USER_DEFINED_REASON reason);
+typedef void(*PROCESS_MESSAGE_COMPLETED_CALLBACK)(MESSAGE_QUEUE_HANDLE message_queue, MQ_ITEM_HANDLE item, MESSAGE_QUEUE_RESULT result, USER_DEFINED_REASON reason);
 
 /**
 * @brief	User-provided callback invoked by MESSAGE_QUEUE when a messages is ready to be processed, getting internally moved from "pending" to "in-progress".
@@ -59,6 +62,15 @@ typedef struct MESSAGE_QUEUE_CONFIG_TAG
 	size_t max_message_enqueued_time_secs;
 	size_t max_message_processing_time_secs;
 	size_t max_retry_count;
+
+	/**
+	* @brief	Backoff applied before re-processing a message completed with MESSAGE_QUEUE_RETRYABLE_ERROR, calculated as by the IoT Hub client retry policies.
+	*
+	* @remarks  The number of retries is still bound by @c max_retry_count. IOTHUB_CLIENT_RETRY_NONE and IOTHUB_CLIENT_RETRY_IMMEDIATE re-process the message with no delay.
+	*/
+	IOTHUB_CLIENT_RETRY_POLICY retry_policy;
+	size_t initial_retry_wait_time_secs;
+	size_t max_retry_jitter_percent;
 } MESSAGE_QUEUE_CONFIG;
 
 /**
@@ -88,9 +100,12 @@ MOCKABLE_FUNCTION(, void, message_queue_destroy, MESSAGE_QUEUE_HANDLE, message_q
 *
 * @param	message A generic message to be queued and then processed (i.e., sent, consolidated, etc).
 *
+* @param	item	Set to the handle of the queued item, to be passed to PROCESS_MESSAGE_COMPLETED_CALLBACK once the message is processed; it cannot be NULL, since the message could not be completed without it.
+*                   The handle remains valid until that callback is invoked for it, even if the message times out or is cancelled meanwhile, or until the queue is destroyed.
+*
 * @returns	Zero if the no errors occur, non-zero otherwise.
 */
-MOCKABLE_FUNCTION(, int, message_queue_add, MESSAGE_QUEUE_HANDLE, message_queue, MQ_MESSAGE_HANDLE, message, MESSAGE_PROCESSING_COMPLETED_CALLBACK, on_message_processing_completed_callback, void*, user_context);
+MOCKABLE_FUNCTION(, int, message_queue_add, MESSAGE_QUEUE_HANDLE, message_queue, MQ_MESSAGE_HANDLE, message, MESSAGE_PROCESSING_COMPLETED_CALLBACK, on_message_processing_completed_callback, void*, user_context, MQ_ITEM_HANDLE*, item);
 
 /**
 * @brief	Causes all messages in-progress to be moved back to the beginning of the pending list.
@@ -166,6 +181,21 @@ MOCKABLE_FUNCTION(, int, message_queue_set_max_message_processing_time_secs, MES
 */
 MOCKABLE_FUNCTION(, int, message_queue_set_max_retry_count, MESSAGE_QUEUE_HANDLE, message_queue, size_t, max_retry_count);
 
+/**
+* @brief	Sets the backoff MESSAGE_QUEUE applies before re-processing a message completed with MESSAGE_QUEUE_RETRYABLE_ERROR.
+*
+* @param	message_queue	A @c MESSAGE_QUEUE_HANDLE obtained using message_queue_create.
+*
+* @param	policy	Retry policy used to calculate the wait before each retry of a message. IOTHUB_CLIENT_RETRY_NONE and IOTHUB_CLIENT_RETRY_IMMEDIATE disable the backoff.
+*
+* @param	initial_wait_time_secs	Base wait time, in seconds, of @c policy.
+*
+* @param	max_jitter_percent	Maximum jitter, from 0 to 100, added to the wait of IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER.
+*
+* @returns	Zero if the no errors occur, non-zero otherwise.
+*/
+MOCKABLE_FUNCTION(, int, message_queue_set_retry_policy, MESSAGE_QUEUE_HANDLE, message_queue, IOTHUB_CLIENT_RETRY_POLICY, policy, size_t, initial_wait_time_secs, size_t, max_jitter_percent);
+
 /**
 * @brief	Retrieves a blob with all the options currently set in the instance of MESSAGE_QUEUE.
 *
@@ -0,0 +1,300 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "hash_index.h"
+#include "hash_index_internal.h"
+
+#define RESULT_OK                   0
+#define DEFAULT_BUCKET_COUNT        16
+
+typedef struct HASH_INDEX_ENTRY_TAG
+{
+    struct HASH_INDEX_ENTRY_TAG* next;
+    size_t hash;
+    void* value;
+    // Points to key_copy, or to the caller's key when it was added without a copy.
+    const char* key;
+    // A copied key is stored right after the entry, in the same allocation.
+    char key_copy[1];
+} HASH_INDEX_ENTRY;
+
+typedef struct HASH_INDEX_TAG
+{
+    HASH_INDEX_ENTRY** buckets;
+    size_t bucket_count;
+    size_t item_count;
+} HASH_INDEX;
+
+static HASH_INDEX_ENTRY** create_buckets(size_t bucket_count)
+{
+    HASH_INDEX_ENTRY** result;
+
+    if (bucket_count > SIZE_MAX / sizeof(HASH_INDEX_ENTRY*))
+    {
+        result = NULL;
+    }
+    else if ((result = (HASH_INDEX_ENTRY**)malloc(bucket_count * sizeof(HASH_INDEX_ENTRY*))) != NULL)
+    {
+        (void)memset(result, 0, bucket_count * sizeof(HASH_INDEX_ENTRY*));
+    }
+
+    return result;
+}
+
+size_t hash_index_get_key_hash(const char* key)
+{
+    // Codes_SRS_HASH_INDEX_09_020: [hash_index_get_key_hash shall return the 32-bit FNV-1a hash of key]
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    while (*key != '\0')
+    {
+        hash ^= (unsigned char)*key;
+        hash *= 16777619u;
+        key++;
+    }
+
+    return (size_t)hash;
+}
+
+static HASH_INDEX_ENTRY** find_entry(HASH_INDEX* index, const char* key, size_t hash)
+{
+    HASH_INDEX_ENTRY** current = &index->buckets[hash % index->bucket_count];
+
+    while (*current != NULL &&
+        ((*current)->hash != hash || strcmp((*current)->key, key) != 0))
+    {
+        current = &(*current)->next;
+    }
+
+    return current;
+}
+
+static void grow_buckets(HASH_INDEX* index)
+{
+    size_t new_bucket_count = index->bucket_count * 2;
+    HASH_INDEX_ENTRY** new_buckets;
+
+    if (new_bucket_count < index->bucket_count ||
+        (new_buckets = create_buckets(new_bucket_count)) == NULL)
+    {
+        // Codes_SRS_HASH_INDEX_09_016: [If the buckets cannot be grown, hash_index_add shall keep the current buckets and still succeed]
+        LogError("Could not grow the hash index to %lu buckets; keeping %lu", (unsigned long)new_bucket_count, (unsigned long)index->bucket_count);
+    }
+    else
+    {
+        size_t i;
+
+        for (i = 0; i < index->bucket_count; i++)
+        {
+            HASH_INDEX_ENTRY* entry = index->buckets[i];
+
+            while (entry != NULL)
+            {
+                HASH_INDEX_ENTRY* next = entry->next;
+                size_t new_position = entry->hash % new_bucket_count;
+
+                entry->next = new_buckets[new_position];
+                new_buckets[new_position] = entry;
+                entry = next;
+            }
+        }
+
+        free(index->buckets);
+        index->buckets = new_buckets;
+        index->bucket_count = new_bucket_count;
+    }
+}
+
+HASH_INDEX_HANDLE hash_index_create(size_t initial_bucket_count)
+{
+    HASH_INDEX* result;
+
+    // Codes_SRS_HASH_INDEX_09_001: [hash_index_create shall allocate memory for the hash index instance]
+    if ((result = (HASH_INDEX*)malloc(sizeof(HASH_INDEX))) == NULL)
+    {
+        // Codes_SRS_HASH_INDEX_09_002: [If malloc fails, hash_index_create shall fail and return NULL]
+        LogError("Failed allocating the hash index");
+    }
+    else
+    {
+        // Codes_SRS_HASH_INDEX_09_003: [If initial_bucket_count is 0, hash_index_create shall use 16 buckets]
+        result->bucket_count = (initial_bucket_count == 0 ? DEFAULT_BUCKET_COUNT : initial_bucket_count);
+        result->item_count = 0;
+
+        // Codes_SRS_HASH_INDEX_09_004: [hash_index_create shall allocate the buckets and set them all to empty]
+        if ((result->buckets = create_buckets(result->bucket_count)) == NULL)
+        {
+            // Codes_SRS_HASH_INDEX_09_005: [If the buckets cannot be allocated, hash_index_create shall free the instance and return NULL]
+            LogError("Failed allocating %lu hash index buckets", (unsigned long)result->bucket_count);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+void hash_index_destroy(HASH_INDEX_HANDLE index)
+{
+    // Codes_SRS_HASH_INDEX_09_006: [If index is NULL, hash_index_destroy shall return]
+    if (index != NULL)
+    {
+        size_t i;
+
+        // Codes_SRS_HASH_INDEX_09_007: [hash_index_destroy shall free every entry, the buckets and the instance]
+        for (i = 0; i < index->bucket_count; i++)
+        {
+            HASH_INDEX_ENTRY* entry = index->buckets[i];
+
+            while (entry != NULL)
+            {
+                HASH_INDEX_ENTRY* next = entry->next;
+                free(entry);
+                entry = next;
+            }
+        }
+
+        free(index->buckets);
+        free(index);
+    }
+}
+
+static int add_entry(HASH_INDEX* index, const char* key, void* value, bool copy_key)
+{
+    int result;
+
+    // Codes_SRS_HASH_INDEX_09_008: [If index or key are NULL, hash_index_add shall fail and return non-zero]
+    // Codes_SRS_HASH_INDEX_09_021: [If index or key are NULL, hash_index_add_without_copy shall fail and return non-zero]
+    if (index == NULL || key == NULL)
+    {
+        LogError("Invalid argument (index=%p, key=%p)", index, key);
+        result = __FAILURE__;
+    }
+    else
+    {
+        size_t hash = hash_index_get_key_hash(key);
+        HASH_INDEX_ENTRY** position = find_entry(index, key, hash);
+
+        if (*position != NULL)
+        {
+            // Codes_SRS_HASH_INDEX_09_009: [If key is already in the index, hash_index_add shall fail and return non-zero]
+            LogError("Key '%s' is already in the hash index", key);
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t key_length = (copy_key ? strlen(key) : 0);
+            HASH_INDEX_ENTRY* entry;
+
+            // Codes_SRS_HASH_INDEX_09_010: [hash_index_add shall allocate a single entry holding a copy of key and value]
+            // Codes_SRS_HASH_INDEX_09_022: [hash_index_add_without_copy shall allocate an entry holding key itself and value, without copying key]
+            if ((entry = (HASH_INDEX_ENTRY*)malloc(sizeof(HASH_INDEX_ENTRY) + key_length)) == NULL)
+            {
+                // Codes_SRS_HASH_INDEX_09_011: [If malloc fails, hash_index_add shall fail and return non-zero]
+                LogError("Failed allocating hash index entry for key '%s'", key);
+                result = __FAILURE__;
+            }
+            else
+            {
+                if (copy_key)
+                {
+                    (void)memcpy(entry->key_copy, key, key_length + 1);
+                    entry->key = entry->key_copy;
+                }
+                else
+                {
+                    entry->key = key;
+                }
+                entry->hash = hash;
+                entry->value = value;
+                entry->next = NULL;
+                *position = entry;
+                index->item_count++;
+
+                // Codes_SRS_HASH_INDEX_09_012: [If the index holds more items than buckets, hash_index_add shall double the number of buckets and redistribute the entries]
+                if (index->item_count > index->bucket_count)
+                {
+                    grow_buckets(index);
+                }
+
+                // Codes_SRS_HASH_INDEX_09_013: [If no failures occur, hash_index_add shall return 0]
+                result = RESULT_OK;
+            }
+        }
+    }
+
+    return result;
+}
+
+int hash_index_add(HASH_INDEX_HANDLE index, const char* key, void* value)
+{
+    return add_entry(index, key, value, true);
+}
+
+int hash_index_add_without_copy(HASH_INDEX_HANDLE index, const char* key, void* value)
+{
+    // Codes_SRS_HASH_INDEX_09_023: [Otherwise hash_index_add_without_copy shall behave as hash_index_add]
+    return add_entry(index, key, value, false);
+}
+
+void* hash_index_find(HASH_INDEX_HANDLE index, const char* key)
+{
+    void* result;
+
+    // Codes_SRS_HASH_INDEX_09_014: [If index or key are NULL, hash_index_find shall return NULL]
+    if (index == NULL || key == NULL)
+    {
+        LogError("Invalid argument (index=%p, key=%p)", index, key);
+        result = NULL;
+    }
+    else
+    {
+        HASH_INDEX_ENTRY* entry = *find_entry(index, key, hash_index_get_key_hash(key));
+
+        // Codes_SRS_HASH_INDEX_09_015: [hash_index_find shall return the value stored under key, or NULL if key is not in the index]
+        result = (entry == NULL ? NULL : entry->value);
+    }
+
+    return result;
+}
+
+int hash_index_remove(HASH_INDEX_HANDLE index, const char* key)
+{
+    int result;
+
+    // Codes_SRS_HASH_INDEX_09_017: [If index or key are NULL, hash_index_remove shall fail and return non-zero]
+    if (index == NULL || key == NULL)
+    {
+        LogError("Invalid argument (index=%p, key=%p)", index, key);
+        result = __FAILURE__;
+    }
+    else
+    {
+        HASH_INDEX_ENTRY** position = find_entry(index, key, hash_index_get_key_hash(key));
+
+        if (*position == NULL)
+        {
+            // Codes_SRS_HASH_INDEX_09_018: [If key is not in the index, hash_index_remove shall fail and return non-zero]
+            result = __FAILURE__;
+        }
+        else
+        {
+            // Codes_SRS_HASH_INDEX_09_019: [hash_index_remove shall unlink and free the entry of key and return 0]
+            HASH_INDEX_ENTRY* entry = *position;
+            *position = entry->next;
+            free(entry);
+            index->item_count--;
+            result = RESULT_OK;
+        }
+    }
+
+    return result;
+}
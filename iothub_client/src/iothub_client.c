@@ -11,6 +11,7 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothub_client.h"
 #include "iothub_client_ll.h"
+#include "iothub_client_options.h"
 #include "iothub_client_private.h"
 #include "iothubtransport.h"
 #include "azure_c_shared_utility/threadapi.h"
@@ -44,6 +45,11 @@ typedef struct IOTHUB_CLIENT_INSTANCE_TAG
     struct IOTHUB_QUEUE_CONTEXT_TAG* connection_status_user_context;
     struct IOTHUB_QUEUE_CONTEXT_TAG* message_user_context;
     struct IOTHUB_QUEUE_CONTEXT_TAG* method_user_context;
+    size_t method_worker_count;
+    THREAD_HANDLE* method_worker_threads;
+    LOCK_HANDLE method_queue_lock;
+    SINGLYLINKEDLIST_HANDLE pending_method_calls; /*list of USER_CALLBACK_INFO* waiting for a method worker*/
+    sig_atomic_t StopMethodWorkers;
 } IOTHUB_CLIENT_INSTANCE;
 
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -101,6 +107,10 @@ typedef struct METHOD_CALLBACK_INFO_TAG
     STRING_HANDLE method_name;
     BUFFER_HANDLE payload;
     METHOD_HANDLE method_id;
+    /*taken under the client lock when the method request is dispatched, so the method workers do not read the callbacks of the client*/
+    IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC device_method_callback;
+    IOTHUB_CLIENT_INBOUND_DEVICE_METHOD_CALLBACK inbound_device_method_callback;
+    IOTHUB_CLIENT_HANDLE iotHubClientHandle;
 } METHOD_CALLBACK_INFO;
 
 typedef struct USER_CALLBACK_INFO_TAG
@@ -398,6 +408,260 @@ static void iothub_ll_device_twin_callback(DEVICE_TWIN_UPDATE_STATE update_state
     }
 }
 
+static void invoke_device_method_callback(USER_CALLBACK_INFO* queued_cb)
+{
+    const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
+    const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
+    size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+
+    if (queued_cb->type == CALLBACK_TYPE_DEVICE_METHOD)
+    {
+        if (queued_cb->iothub_callback.method_cb_info.device_method_callback)
+        {
+            unsigned char* payload_resp = NULL;
+            size_t response_size = 0;
+            int status = queued_cb->iothub_callback.method_cb_info.device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
+
+            if (payload_resp && (response_size > 0) && (queued_cb->iothub_callback.method_cb_info.iotHubClientHandle != NULL))
+            {
+                IOTHUB_CLIENT_HANDLE handle = queued_cb->iothub_callback.method_cb_info.iotHubClientHandle;
+                IOTHUB_CLIENT_RESULT result = IoTHubClient_DeviceMethodResponse(handle, queued_cb->iothub_callback.method_cb_info.method_id, (const unsigned char*)payload_resp, response_size, status);
+                if (result != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubClient_LL_DeviceMethodResponse failed");
+                }
+            }
+
+            if (payload_resp)
+            {
+                free(payload_resp);
+            }
+        }
+    }
+    else
+    {
+        if (queued_cb->iothub_callback.method_cb_info.inbound_device_method_callback)
+        {
+            queued_cb->iothub_callback.method_cb_info.inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
+        }
+    }
+
+    BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
+    STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+}
+
+static int queue_method_call_for_workers(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, const USER_CALLBACK_INFO* queued_cb)
+{
+    int result;
+    USER_CALLBACK_INFO* method_call = (USER_CALLBACK_INFO*)malloc(sizeof(USER_CALLBACK_INFO));
+
+    if (method_call == NULL)
+    {
+        LogError("failed allocating method call for the method workers");
+        result = __FAILURE__;
+    }
+    else
+    {
+        (void)memcpy(method_call, queued_cb, sizeof(USER_CALLBACK_INFO));
+
+        if (Lock(iotHubClientInstance->method_queue_lock) != LOCK_OK)
+        {
+            LogError("failed locking the method queue");
+            free(method_call);
+            result = __FAILURE__;
+        }
+        else
+        {
+            if (singlylinkedlist_add(iotHubClientInstance->pending_method_calls, method_call) == NULL)
+            {
+                LogError("failed queueing method call for the method workers");
+                free(method_call);
+                result = __FAILURE__;
+            }
+            else
+            {
+                result = 0;
+            }
+
+            (void)Unlock(iotHubClientInstance->method_queue_lock);
+        }
+    }
+
+    return result;
+}
+
+static int MethodWorker_Thread(void* threadArgument)
+{
+    IOTHUB_CLIENT_INSTANCE* iotHubClientInstance = (IOTHUB_CLIENT_INSTANCE*)threadArgument;
+
+    while (1)
+    {
+        USER_CALLBACK_INFO* method_call = NULL;
+
+        if (Lock(iotHubClientInstance->method_queue_lock) == LOCK_OK)
+        {
+            if (iotHubClientInstance->StopMethodWorkers)
+            {
+                (void)Unlock(iotHubClientInstance->method_queue_lock);
+                break; /*gets out of the thread*/
+            }
+            else
+            {
+                LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(iotHubClientInstance->pending_method_calls);
+
+                if (list_item != NULL)
+                {
+                    method_call = (USER_CALLBACK_INFO*)singlylinkedlist_item_get_value(list_item);
+                    (void)singlylinkedlist_remove(iotHubClientInstance->pending_method_calls, list_item);
+                }
+
+                (void)Unlock(iotHubClientInstance->method_queue_lock);
+            }
+        }
+
+        if (method_call != NULL)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_09_004: [ Each method worker shall invoke the device method callback of the method requests queued, responding to IOTHUB_CLIENT_DEVICE_METHOD_CALLBACK_ASYNC requests through IoTHubClient_DeviceMethodResponse. ]*/
+            invoke_device_method_callback(method_call);
+            free(method_call);
+        }
+        else
+        {
+            (void)ThreadAPI_Sleep(1);
+        }
+    }
+
+    ThreadAPI_Exit(0);
+    return 0;
+}
+
+/*signals the method workers to end, joins them and releases the method requests still queued, the method queue and its lock*/
+static void end_method_workers(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, THREAD_HANDLE* worker_threads, size_t worker_count)
+{
+    size_t index;
+    LIST_ITEM_HANDLE list_item;
+
+    if (Lock(iotHubClientInstance->method_queue_lock) != LOCK_OK)
+    {
+        LogError("unable to Lock - - will still proceed to try to end the method workers without locking");
+    }
+
+    iotHubClientInstance->StopMethodWorkers = 1;
+
+    if (Unlock(iotHubClientInstance->method_queue_lock) != LOCK_OK)
+    {
+        LogError("unable to Unlock");
+    }
+
+    for (index = 0; index < worker_count; index++)
+    {
+        int res;
+        if (ThreadAPI_Join(worker_threads[index], &res) != THREADAPI_OK)
+        {
+            LogError("ThreadAPI_Join failed");
+        }
+    }
+
+    while ((list_item = singlylinkedlist_get_head_item(iotHubClientInstance->pending_method_calls)) != NULL)
+    {
+        USER_CALLBACK_INFO* method_call = (USER_CALLBACK_INFO*)singlylinkedlist_item_get_value(list_item);
+        STRING_delete(method_call->iothub_callback.method_cb_info.method_name);
+        BUFFER_delete(method_call->iothub_callback.method_cb_info.payload);
+        free(method_call);
+        (void)singlylinkedlist_remove(iotHubClientInstance->pending_method_calls, list_item);
+    }
+
+    singlylinkedlist_destroy(iotHubClientInstance->pending_method_calls);
+    Lock_Deinit(iotHubClientInstance->method_queue_lock);
+    free(worker_threads);
+
+    iotHubClientInstance->pending_method_calls = NULL;
+    iotHubClientInstance->method_queue_lock = NULL;
+}
+
+/*only called by IoTHubClient_Destroy, once the threads dispatching the user callbacks were joined*/
+static void stop_method_workers(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance)
+{
+    if (iotHubClientInstance->method_worker_threads != NULL)
+    {
+        THREAD_HANDLE* worker_threads = iotHubClientInstance->method_worker_threads;
+        size_t worker_count = iotHubClientInstance->method_worker_count;
+
+        iotHubClientInstance->method_worker_threads = NULL;
+        iotHubClientInstance->method_worker_count = 0;
+
+        end_method_workers(iotHubClientInstance, worker_threads, worker_count);
+    }
+}
+
+/*called with the client lock held; the workers are published only once all of them started, so the dispatcher never queues to a pool that is being torn down*/
+static IOTHUB_CLIENT_RESULT start_method_workers(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, size_t worker_count)
+{
+    IOTHUB_CLIENT_RESULT result;
+    THREAD_HANDLE* worker_threads;
+
+    if (iotHubClientInstance->method_worker_threads != NULL)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_09_003: [ If the method workers were already started, IoTHubClient_SetOption shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("the method workers were already started (%zu workers)", iotHubClientInstance->method_worker_count);
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if (worker_count == 0)
+    {
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if ((iotHubClientInstance->method_queue_lock = Lock_Init()) == NULL)
+    {
+        LogError("failed creating the method queue lock");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((iotHubClientInstance->pending_method_calls = singlylinkedlist_create()) == NULL)
+    {
+        LogError("failed creating the method queue");
+        Lock_Deinit(iotHubClientInstance->method_queue_lock);
+        iotHubClientInstance->method_queue_lock = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else if ((worker_threads = (THREAD_HANDLE*)malloc(sizeof(THREAD_HANDLE) * worker_count)) == NULL)
+    {
+        LogError("failed allocating the method worker threads");
+        singlylinkedlist_destroy(iotHubClientInstance->pending_method_calls);
+        iotHubClientInstance->pending_method_calls = NULL;
+        Lock_Deinit(iotHubClientInstance->method_queue_lock);
+        iotHubClientInstance->method_queue_lock = NULL;
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        size_t started_count;
+
+        iotHubClientInstance->StopMethodWorkers = 0;
+
+        for (started_count = 0; started_count < worker_count; started_count++)
+        {
+            if (ThreadAPI_Create(&worker_threads[started_count], MethodWorker_Thread, iotHubClientInstance) != THREADAPI_OK)
+            {
+                LogError("ThreadAPI_Create failed");
+                break;
+            }
+        }
+
+        if (started_count < worker_count)
+        {
+            end_method_workers(iotHubClientInstance, worker_threads, started_count);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            iotHubClientInstance->method_worker_threads = worker_threads;
+            iotHubClientInstance->method_worker_count = worker_count;
+            result = IOTHUB_CLIENT_OK;
+        }
+    }
+
+    return result;
+}
+
 static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance, VECTOR_HANDLE call_backs)
 {
     size_t callbacks_length = VECTOR_size(call_backs);
@@ -458,48 +722,36 @@ static void dispatch_user_callbacks(IOTHUB_CLIENT_INSTANCE* iotHubClientInstance
                     }
                     break;
                 case CALLBACK_TYPE_DEVICE_METHOD:
-                    if (iotHubClientInstance->device_method_callback)
-                    {
-                        const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                        const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                        size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
-
-                        unsigned char* payload_resp = NULL;
-                        size_t response_size = 0;
-                        int status = iotHubClientInstance->device_method_callback(method_name, payload, payload_len, &payload_resp, &response_size, queued_cb->userContextCallback);
-
-                        if (payload_resp && (response_size > 0))
-                        {
-                            IOTHUB_CLIENT_HANDLE handle = iotHubClientInstance->method_user_context->iotHubClientHandle;
-                            IOTHUB_CLIENT_RESULT result = IoTHubClient_DeviceMethodResponse(handle, queued_cb->iothub_callback.method_cb_info.method_id, (const unsigned char*)payload_resp, response_size, status);
-                            if (result != IOTHUB_CLIENT_OK)
-                            {
-                                LogError("IoTHubClient_LL_DeviceMethodResponse failed");
-                            }
-                        }
+                case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
+                {
+                    bool is_queued;
 
-                        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
-                        
-                        if (payload_resp)
-                        {
-                            free(payload_resp);
-                        }
+                    if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
+                    {
+                        LogError("failed locking for dispatch_user_callbacks");
+                        queued_cb->iothub_callback.method_cb_info.device_method_callback = NULL;
+                        queued_cb->iothub_callback.method_cb_info.inbound_device_method_callback = NULL;
+                        queued_cb->iothub_callback.method_cb_info.iotHubClientHandle = NULL;
+                        is_queued = false;
                     }
-                    break;
-                case CALLBACK_TYPE_INBOUD_DEVICE_METHOD:
-                    if (iotHubClientInstance->inbound_device_method_callback)
+                    else
                     {
-                        const char* method_name = STRING_c_str(queued_cb->iothub_callback.method_cb_info.method_name);
-                        const unsigned char* payload = BUFFER_u_char(queued_cb->iothub_callback.method_cb_info.payload);
-                        size_t payload_len = BUFFER_length(queued_cb->iothub_callback.method_cb_info.payload);
+                        queued_cb->iothub_callback.method_cb_info.device_method_callback = iotHubClientInstance->device_method_callback;
+                        queued_cb->iothub_callback.method_cb_info.inbound_device_method_callback = iotHubClientInstance->inbound_device_method_callback;
+                        queued_cb->iothub_callback.method_cb_info.iotHubClientHandle = (iotHubClientInstance->method_user_context == NULL) ? NULL : iotHubClientInstance->method_user_context->iotHubClientHandle;
 
-                        iotHubClientInstance->inbound_device_method_callback(method_name, payload, payload_len, queued_cb->iothub_callback.method_cb_info.method_id, queued_cb->userContextCallback);
+                        /*Codes_SRS_IOTHUBCLIENT_09_002: [ If method workers were started, method requests shall be queued to them instead of being invoked on the thread dispatching the user callbacks. ]*/
+                        is_queued = (iotHubClientInstance->method_worker_threads != NULL) &&
+                            (queue_method_call_for_workers(iotHubClientInstance, queued_cb) == 0);
+                        (void)Unlock(iotHubClientInstance->LockHandle);
+                    }
 
-                        BUFFER_delete(queued_cb->iothub_callback.method_cb_info.payload);
-                        STRING_delete(queued_cb->iothub_callback.method_cb_info.method_name);
+                    if (!is_queued)
+                    {
+                        invoke_device_method_callback(queued_cb);
                     }
                     break;
+                }
                 case CALLBACK_TYPE_MESSAGE:
                     if (iotHubClientInstance->message_callback)
                     {
@@ -778,6 +1030,11 @@ static IOTHUB_CLIENT_INSTANCE* create_iothub_instance(const IOTHUB_CLIENT_CONFIG
                     result->message_callback = NULL;
                     result->message_user_context = NULL;
                     result->method_user_context = NULL;
+                    result->method_worker_count = 0;
+                    result->method_worker_threads = NULL;
+                    result->method_queue_lock = NULL;
+                    result->pending_method_calls = NULL;
+                    result->StopMethodWorkers = 0;
                 }
             }
         }
@@ -897,6 +1154,9 @@ void IoTHubClient_Destroy(IOTHUB_CLIENT_HANDLE iotHubClientHandle)
             }
         }
 
+        /*Codes_SRS_IOTHUBCLIENT_09_005: [ IoTHubClient_Destroy shall signal the method workers (if any) to end, join them and release the method requests still queued. ]*/
+        stop_method_workers(iotHubClientInstance);
+
 
         if (Lock(iotHubClientInstance->LockHandle) != LOCK_OK)
         {
@@ -1398,11 +1658,23 @@ IOTHUB_CLIENT_RESULT IoTHubClient_SetOption(IOTHUB_CLIENT_HANDLE iotHubClientHan
         }
         else
         {
-            /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
-            result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
-            if (result != IOTHUB_CLIENT_OK)
+            if (strcmp(optionName, OPTION_METHOD_WORKER_COUNT) == 0)
             {
-                LogError("IoTHubClient_LL_SetOption failed");
+                /*Codes_SRS_IOTHUBCLIENT_09_001: [ If optionName is OPTION_METHOD_WORKER_COUNT, IoTHubClient_SetOption shall start as many method worker threads as the size_t pointed by value. ]*/
+                result = start_method_workers(iotHubClientInstance, *(const size_t*)value);
+                if (result != IOTHUB_CLIENT_OK)
+                {
+                    LogError("failed starting the method workers");
+                }
+            }
+            else
+            {
+                /*Codes_SRS_IOTHUBCLIENT_02_038: [If optionName doesn't match one of the options handled by this module then IoTHubClient_SetOption shall call IoTHubClient_LL_SetOption passing the same parameters and return what IoTHubClient_LL_SetOption returns.] */
+                result = IoTHubClient_LL_SetOption(iotHubClientInstance->IoTHubClientLLHandle, optionName, value);
+                if (result != IOTHUB_CLIENT_OK)
+                {
+                    LogError("IoTHubClient_LL_SetOption failed");
+                }
             }
 
             (void)Unlock(iotHubClientInstance->LockHandle);
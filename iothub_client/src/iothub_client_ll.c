@@ -11,6 +11,7 @@
 #include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/constbuffer.h"
 #include "azure_c_shared_utility/platform.h"
+#include "parson.h"
 
 #include "iothub_client_authorization.h"
 #include "iothub_client_ll.h"
@@ -86,6 +87,10 @@ typedef struct IOTHUB_CLIENT_LL_HANDLE_DATA_TAG
     bool complete_twin_update_encountered;
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
     STRING_HANDLE product_info;
+    tickcounter_ms_t reported_coalescing_ms; /*0 means reported states are not coalesced*/
+    bool twin_desired_cache_enabled;
+    JSON_Value* twin_desired_snapshot; /*last known desired properties, including $version*/
+    bool c2d_receive_paused; /*when true the transport is kept unsubscribed from C2D messages, even if a message callback is set*/
 }IOTHUB_CLIENT_LL_HANDLE_DATA;
 
 static const char HOSTNAME_TOKEN[] = "HostName";
@@ -95,6 +100,8 @@ static const char X509_TOKEN_ONLY_ACCEPTABLE_VALUE[] = "true";
 static const char DEVICEKEY_TOKEN[] = "SharedAccessKey";
 static const char DEVICESAS_TOKEN[] = "SharedAccessSignature";
 static const char PROTOCOL_GATEWAY_HOST[] = "GatewayHostName";
+static const char TWIN_DESIRED_PROPERTY[] = "desired";
+static const char TWIN_VERSION_PROPERTY[] = "$version";
 
 static void setTransportProtocol(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, TRANSPORT_PROVIDER* protocol)
 {
@@ -121,6 +128,10 @@ static void setTransportProtocol(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, TRANS
 static void device_twin_data_destroy(IOTHUB_DEVICE_TWIN* client_item)
 {
     CONSTBUFFER_Destroy(client_item->report_data_handle);
+    if (client_item->coalesced_callbacks != NULL)
+    {
+        free(client_item->coalesced_callbacks);
+    }
     free(client_item);
 }
 
@@ -480,7 +491,7 @@ static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_LL_HANDLE_DATA* ha
             free(result);
             result = NULL;
         }
-        else if (tickcounter_get_current_ms(handleData->tickCounter, &result->ms_timesOutAfter) != 0)
+        else if (tickcounter_get_current_ms(handleData->tickCounter, &result->create_time) != 0)
         {
             LogError("Failure getting tickcount info");
             CONSTBUFFER_Destroy(result->report_data_handle);
@@ -495,6 +506,8 @@ static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_LL_HANDLE_DATA* ha
             result->reported_state_callback = reportedStateCallback;
             result->client_handle = handleData;
             result->device_handle = handleData->deviceHandle;
+            result->coalesced_callbacks = NULL;
+            result->coalesced_count = 0;
         }
     }
     else
@@ -504,6 +517,192 @@ static IOTHUB_DEVICE_TWIN* dev_twin_data_create(IOTHUB_CLIENT_LL_HANDLE_DATA* ha
     return result;
 }
 
+static JSON_Value* parse_reported_state(const unsigned char* reportedState, size_t size)
+{
+    JSON_Value* result;
+    char* json_string = (char*)malloc(size + 1);
+    if (json_string == NULL)
+    {
+        LogError("Failure allocating reported state string");
+        result = NULL;
+    }
+    else
+    {
+        (void)memcpy(json_string, reportedState, size);
+        json_string[size] = '\0';
+        result = json_parse_string(json_string);
+        free(json_string);
+    }
+    return result;
+}
+
+/*applies the semantics of a twin PATCH: nested objects are merged, any other value replaces the previous one. A null either replaces the previous value or, when remove_nulls is set, deletes it*/
+static int merge_twin_patch(JSON_Object* target, const JSON_Object* patch, bool remove_nulls)
+{
+    int result = 0;
+    size_t count = json_object_get_count(patch);
+    size_t index;
+    for (index = 0; index < count && result == 0; index++)
+    {
+        const char* name = json_object_get_name(patch, index);
+        JSON_Value* patch_value = json_object_get_value(patch, name);
+        JSON_Object* target_object = json_object_get_object(target, name);
+        if (target_object != NULL && json_value_get_type(patch_value) == JSONObject)
+        {
+            result = merge_twin_patch(target_object, json_value_get_object(patch_value), remove_nulls);
+        }
+        else if (remove_nulls && json_value_get_type(patch_value) == JSONNull)
+        {
+            /*the property might not be known locally, nothing to remove then*/
+            (void)json_object_remove(target, name);
+        }
+        else
+        {
+            JSON_Value* value_copy = json_value_deep_copy(patch_value);
+            if (value_copy == NULL)
+            {
+                LogError("Failure copying twin property %s", name);
+                result = __FAILURE__;
+            }
+            else if (json_object_set_value(target, name, value_copy) != JSONSuccess)
+            {
+                LogError("Failure setting twin property %s", name);
+                json_value_free(value_copy);
+                result = __FAILURE__;
+            }
+        }
+    }
+    return result;
+}
+
+/*merges the report into the last IOTHUB_DEVICE_TWIN still waiting in iot_msg_queue, returns 0 if it did*/
+static int coalesce_reported_state(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback)
+{
+    int result;
+    if (DList_IsListEmpty(&(handleData->iot_msg_queue)))
+    {
+        result = __FAILURE__;
+    }
+    else
+    {
+        IOTHUB_DEVICE_TWIN* queued_item = containingRecord(handleData->iot_msg_queue.Blink, IOTHUB_DEVICE_TWIN, entry);
+        const CONSTBUFFER* queued_data = CONSTBUFFER_GetContent(queued_item->report_data_handle);
+        JSON_Value* merged_value;
+        JSON_Value* patch_value;
+        if (queued_data == NULL || (merged_value = parse_reported_state(queued_data->buffer, queued_data->size)) == NULL)
+        {
+            result = __FAILURE__;
+        }
+        else
+        {
+            if ((patch_value = parse_reported_state(reportedState, size)) == NULL)
+            {
+                result = __FAILURE__;
+            }
+            else
+            {
+                JSON_Object* merged_object = json_value_get_object(merged_value);
+                JSON_Object* patch_object = json_value_get_object(patch_value);
+                char* merged_string;
+                IOTHUB_REPORTED_STATE_CALLBACK_INFO* callbacks;
+                if (merged_object == NULL || patch_object == NULL)
+                {
+                    LogError("Reported state is not a JSON object, it cannot be coalesced");
+                    result = __FAILURE__;
+                }
+                else if (merge_twin_patch(merged_object, patch_object, false) != 0)
+                {
+                    LogError("Failure merging reported states");
+                    result = __FAILURE__;
+                }
+                else if ((merged_string = json_serialize_to_string(merged_value)) == NULL)
+                {
+                    LogError("Failure serializing merged reported state");
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    CONSTBUFFER_HANDLE merged_data;
+                    if ((merged_data = CONSTBUFFER_Create((const unsigned char*)merged_string, strlen(merged_string))) == NULL)
+                    {
+                        LogError("Failure allocating merged reported state data");
+                        result = __FAILURE__;
+                    }
+                    else if ((callbacks = (IOTHUB_REPORTED_STATE_CALLBACK_INFO*)realloc(queued_item->coalesced_callbacks, (queued_item->coalesced_count + 1) * sizeof(IOTHUB_REPORTED_STATE_CALLBACK_INFO))) == NULL)
+                    {
+                        LogError("Failure allocating reported state callback information");
+                        CONSTBUFFER_Destroy(merged_data);
+                        result = __FAILURE__;
+                    }
+                    else
+                    {
+                        callbacks[queued_item->coalesced_count].reported_state_callback = reportedStateCallback;
+                        callbacks[queued_item->coalesced_count].context = userContextCallback;
+                        queued_item->coalesced_callbacks = callbacks;
+                        queued_item->coalesced_count++;
+
+                        CONSTBUFFER_Destroy(queued_item->report_data_handle);
+                        queued_item->report_data_handle = merged_data;
+                        result = 0;
+                    }
+                    json_free_serialized_string(merged_string);
+                }
+                json_value_free(patch_value);
+            }
+            json_value_free(merged_value);
+        }
+    }
+    return result;
+}
+
+/*updates the desired properties snapshot, returns false when the update carries a $version the application has already seen*/
+static bool update_twin_desired_snapshot(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, DEVICE_TWIN_UPDATE_STATE update_state, const unsigned char* payLoad, size_t size)
+{
+    bool result = true;
+    JSON_Value* update_value;
+    if (payLoad == NULL || size == 0 || (update_value = parse_reported_state(payLoad, size)) == NULL)
+    {
+        LogError("Failure parsing twin update, desired properties snapshot not updated");
+    }
+    else
+    {
+        JSON_Value* desired_value = (update_state == DEVICE_TWIN_UPDATE_COMPLETE) ? json_object_get_value(json_value_get_object(update_value), TWIN_DESIRED_PROPERTY) : update_value;
+        JSON_Object* desired = json_value_get_object(desired_value);
+        JSON_Object* snapshot = json_value_get_object(handleData->twin_desired_snapshot);
+        double update_version = json_object_get_number(desired, TWIN_VERSION_PROPERTY);
+        if (desired == NULL)
+        {
+            LogError("Twin update does not contain desired properties");
+        }
+        else if (snapshot != NULL && update_version > 0 && update_version <= json_object_get_number(snapshot, TWIN_VERSION_PROPERTY))
+        {
+            result = false;
+        }
+        else if (update_state == DEVICE_TWIN_UPDATE_COMPLETE)
+        {
+            JSON_Value* desired_copy = json_value_deep_copy(desired_value);
+            if (desired_copy == NULL)
+            {
+                LogError("Failure copying desired properties");
+            }
+            else
+            {
+                json_value_free(handleData->twin_desired_snapshot);
+                handleData->twin_desired_snapshot = desired_copy;
+            }
+        }
+        else if (snapshot != NULL && merge_twin_patch(snapshot, desired, true) != 0)
+        {
+            /*a partially merged snapshot cannot be trusted, the next complete update repopulates it*/
+            LogError("Failure merging desired properties patch");
+            json_value_free(handleData->twin_desired_snapshot);
+            handleData->twin_desired_snapshot = NULL;
+        }
+        json_value_free(update_value);
+    }
+    return result;
+}
+
 IOTHUB_CLIENT_LL_HANDLE IoTHubClient_LL_CreateFromDeviceAuth(const char* iothub_uri, const char* device_id, IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol)
 {
     IOTHUB_CLIENT_LL_HANDLE result;
@@ -965,6 +1164,7 @@ void IoTHubClient_LL_Destroy(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         }
 
         /*Codes_SRS_IOTHUBCLIENT_LL_17_011: [IoTHubClient_LL_Destroy  shall free the resources allocated by IoTHubClient (if any).] */
+        json_value_free(handleData->twin_desired_snapshot);
         IoTHubClient_Auth_Destroy(handleData->authorization_module);
         tickcounter_destroy(handleData->tickCounter);
 #ifndef DONT_USE_UPLOADTOBLOB
@@ -1089,7 +1289,11 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_02_019: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
-                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_020: [ While "c2d_receive_paused" is true, IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall only save or clear the callback, without calling the underlying layer's _Subscribe or _Unsubscribe functions. ]*/
+                if (!handleData->c2d_receive_paused)
+                {
+                    handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+                }
                 handleData->messageCallback.type = CALLBACK_TYPE_NONE;
                 handleData->messageCallback.callbackSync = NULL;
                 handleData->messageCallback.callbackAsync = NULL;
@@ -1107,7 +1311,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback(IOTHUB_CLIENT_LL_HANDLE
             }
             else
             {
-                if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
+                if (handleData->c2d_receive_paused || handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_02_017: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback shall call the underlying layer's _Subscribe function.]*/
                     handleData->messageCallback.type = CALLBACK_TYPE_SYNC;
@@ -1160,7 +1364,11 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback_Ex(IOTHUB_CLIENT_LL_HAND
             else
             {
                 /*Codes_SRS_IOTHUBCLIENT_LL_10_023: [If parameter messageCallback is NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */ 
-                handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_020: [ While "c2d_receive_paused" is true, IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall only save or clear the callback, without calling the underlying layer's _Subscribe or _Unsubscribe functions. ]*/
+                if (!handleData->c2d_receive_paused)
+                {
+                    handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+                }
                 handleData->messageCallback.type = CALLBACK_TYPE_NONE;
                 handleData->messageCallback.callbackSync = NULL;
                 handleData->messageCallback.callbackAsync = NULL;
@@ -1178,7 +1386,7 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetMessageCallback_Ex(IOTHUB_CLIENT_LL_HAND
             }
             else
             {
-                if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
+                if (handleData->c2d_receive_paused || handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) == 0)
                 {
                     /*Codes_SRS_IOTHUBCLIENT_LL_10_024: [If parameter messageCallback is non-NULL then IoTHubClient_LL_SetMessageCallback_Ex shall call the underlying layer's _Subscribe function.]*/
                     handleData->messageCallback.type = CALLBACK_TYPE_ASYNC;
@@ -1262,6 +1470,20 @@ void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
         DoTimeouts(handleData);
 
+        tickcounter_ms_t current_ms;
+        bool hold_reported_states = false;
+        if (handleData->reported_coalescing_ms > 0 && !DList_IsListEmpty(&(handleData->iot_msg_queue)))
+        {
+            if (tickcounter_get_current_ms(handleData->tickCounter, &current_ms) != 0)
+            {
+                LogError("unable to get the current ms, reported states are sent without waiting for the coalescing window");
+            }
+            else
+            {
+                hold_reported_states = true;
+            }
+        }
+
         /*Codes_SRS_IOTHUBCLIENT_LL_07_008: [ IoTHubClient_LL_DoWork shall iterate the message queue and execute the underlying transports IoTHubTransport_ProcessItem function for each item. ] */
         DLIST_ENTRY* client_item = handleData->iot_msg_queue.Flink;
         while (client_item != &(handleData->iot_msg_queue)) /*while we are not at the end of the list*/
@@ -1269,6 +1491,11 @@ void IoTHubClient_LL_DoWork(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
             PDLIST_ENTRY next_item = client_item->Flink;
 
             IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
+            if (hold_reported_states && current_ms - queue_data->create_time < handleData->reported_coalescing_ms)
+            {
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_012: [ If "twin_reported_coalescing_ms" is set, IoTHubClient_LL_DoWork shall not process an IOTHUB_DEVICE_TWIN until that many milliseconds have passed since it was queued. ]*/
+                break;
+            }
             IOTHUB_IDENTITY_INFO identity_info;
             identity_info.device_twin = queue_data;
             IOTHUB_PROCESS_ITEM_RESULT process_results =  handleData->IoTHubTransport_ProcessItem(handleData->transportHandle, IOTHUB_TYPE_DEVICE_TWIN, &identity_info);
@@ -1420,8 +1647,13 @@ void IoTHubClient_LL_RetrievePropertyComplete(IOTHUB_CLIENT_LL_HANDLE handle, DE
             }
             if (handleData->complete_twin_update_encountered)
             {
-                /* Codes_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClient_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
-                handleData->deviceTwinCallback(update_state, payLoad, size, handleData->deviceTwinContextCallback);
+                /* Codes_SRS_IOTHUBCLIENT_LL_09_015: [ If "twin_desired_cache" is enabled, IoTHubClient_LL_RetrievePropertyComplete shall keep a copy of the desired properties and apply every DEVICE_TWIN_UPDATE_PARTIAL to it. ] */
+                /* Codes_SRS_IOTHUBCLIENT_LL_09_016: [ If "twin_desired_cache" is enabled and the desired $version of the update is not newer than the one of the copy, IoTHubClient_LL_RetrievePropertyComplete shall not call deviceTwinCallback. ] */
+                if (!handleData->twin_desired_cache_enabled || update_twin_desired_snapshot(handleData, update_state, payLoad, size))
+                {
+                    /* Codes_SRS_IOTHUBCLIENT_LL_07_016: [ If deviceTwinCallback is set and DEVICE_TWIN_UPDATE_COMPLETE has been encountered then IoTHubClient_LL_RetrievePropertyComplete shall call deviceTwinCallback.] */
+                    handleData->deviceTwinCallback(update_state, payLoad, size, handleData->deviceTwinContextCallback);
+                }
             }
         }
     }
@@ -1447,10 +1679,19 @@ void IoTHubClient_LL_ReportedStateComplete(IOTHUB_CLIENT_LL_HANDLE handle, uint3
             IOTHUB_DEVICE_TWIN* queue_data = containingRecord(client_item, IOTHUB_DEVICE_TWIN, entry);
             if (queue_data->item_id == item_id)
             {
+                size_t index;
                 if (queue_data->reported_state_callback != NULL)
                 {
                     queue_data->reported_state_callback(status_code, queue_data->context);
                 }
+                /*Codes_SRS_IOTHUBCLIENT_LL_09_013: [ IoTHubClient_LL_ReportedStateComplete shall invoke the callback of every report that was coalesced into the IOTHUB_DEVICE_TWIN, in the order they were sent. ]*/
+                for (index = 0; index < queue_data->coalesced_count; index++)
+                {
+                    if (queue_data->coalesced_callbacks[index].reported_state_callback != NULL)
+                    {
+                        queue_data->coalesced_callbacks[index].reported_state_callback(status_code, queue_data->coalesced_callbacks[index].context);
+                    }
+                }
                 /*Codes_SRS_IOTHUBCLIENT_LL_07_009: [ IoTHubClient_LL_ReportedStateComplete shall remove the IOTHUB_DEVICE_TWIN item from the ack queue.]*/
                 DList_RemoveEntryList(client_item);
                 device_twin_data_destroy(queue_data);
@@ -1658,6 +1899,38 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_GetLastMessageReceiveTime(IOTHUB_CLIENT_LL_
     return result;
 }
 
+static IOTHUB_CLIENT_RESULT set_c2d_receive_paused(IOTHUB_CLIENT_LL_HANDLE_DATA* handleData, bool paused)
+{
+    IOTHUB_CLIENT_RESULT result;
+
+    if (paused == handleData->c2d_receive_paused || handleData->messageCallback.type == CALLBACK_TYPE_NONE)
+    {
+        /*not subscribed, the flag is honored once a message callback is set*/
+        handleData->c2d_receive_paused = paused;
+        result = IOTHUB_CLIENT_OK;
+    }
+    else if (paused)
+    {
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_018: [ "c2d_receive_paused" - Value is a pointer to a bool. When set to true while a message callback is set, IoTHubClient_LL_SetOption shall call the underlying layer's _Unsubscribe function and keep the message callback. ]*/
+        handleData->IoTHubTransport_Unsubscribe(handleData->deviceHandle);
+        handleData->c2d_receive_paused = true;
+        result = IOTHUB_CLIENT_OK;
+    }
+    /*Codes_SRS_IOTHUBCLIENT_LL_09_019: [ When "c2d_receive_paused" is set back to false while a message callback is set, IoTHubClient_LL_SetOption shall call the underlying layer's _Subscribe function. If it fails, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR and C2D messages shall remain paused. ]*/
+    else if (handleData->IoTHubTransport_Subscribe(handleData->deviceHandle) != 0)
+    {
+        LogError("IoTHubTransport_Subscribe failed, C2D messages remain paused");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        handleData->c2d_receive_paused = false;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
 IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, const char* optionName, const void* value)
 {
 
@@ -1686,6 +1959,27 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SetOption(IOTHUB_CLIENT_LL_HANDLE iotHubCli
             handleData->currentMessageTimeout = *(const tickcounter_ms_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_IOTHUBCLIENT_LL_09_011: [ "twin_reported_coalescing_ms" - reported states sent within value milliseconds of each other shall be merged into a single PATCH. Value is a pointer to a tickcounter_ms_t, 0 disables it. ]*/
+        else if (strcmp(optionName, OPTION_TWIN_REPORTED_COALESCING_MS) == 0)
+        {
+            handleData->reported_coalescing_ms = *(const tickcounter_ms_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_TWIN_DESIRED_CACHE) == 0)
+        {
+            /*Codes_SRS_IOTHUBCLIENT_LL_09_017: [ "twin_desired_cache" - Value is a pointer to a bool. When set to false IoTHubClient_LL_SetOption shall release the desired properties copy. ]*/
+            handleData->twin_desired_cache_enabled = *(const bool*)value;
+            if (!handleData->twin_desired_cache_enabled)
+            {
+                json_value_free(handleData->twin_desired_snapshot);
+                handleData->twin_desired_snapshot = NULL;
+            }
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(optionName, OPTION_C2D_RECEIVE_PAUSED) == 0)
+        {
+            result = set_c2d_receive_paused(handleData, *(const bool*)value);
+        }
         else if (strcmp(optionName, OPTION_PRODUCT_INFO) == 0)
         {
             /*Codes_SRS_IOTHUBCLIENT_LL_10_033: [repeat calls with "product_info" will erase the previously set product information if applicatble. ]*/
@@ -1820,9 +2114,15 @@ IOTHUB_CLIENT_RESULT IoTHubClient_LL_SendReportedState(IOTHUB_CLIENT_LL_HANDLE i
     else
     {
         IOTHUB_CLIENT_LL_HANDLE_DATA* handleData = (IOTHUB_CLIENT_LL_HANDLE_DATA*)iotHubClientHandle;
+        IOTHUB_DEVICE_TWIN* client_data;
+        /* Codes_SRS_IOTHUBCLIENT_LL_09_014: [ If "twin_reported_coalescing_ms" is set and an IOTHUB_DEVICE_TWIN is still waiting to be processed, IoTHubClient_LL_SendReportedState shall JSON-merge reportedState into the last one and return IOTHUB_CLIENT_OK. ] */
+        if (handleData->reported_coalescing_ms > 0 &&
+            coalesce_reported_state(handleData, reportedState, size, reportedStateCallback, userContextCallback) == 0)
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
         /* Codes_SRS_IOTHUBCLIENT_LL_10_014: [IoTHubClient_LL_SendReportedState shall construct and queue the reported a Device_Twin structure for transmition by the underlying transport.] */
-        IOTHUB_DEVICE_TWIN* client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback);
-        if (client_data == NULL)
+        else if ((client_data = dev_twin_data_create(handleData, get_next_item_id(handleData), reportedState, size, reportedStateCallback, userContextCallback)) == NULL)
         {
             /* Codes_SRS_IOTHUBCLIENT_LL_10_015: [If any error is encountered IoTHubClient_LL_SendReportedState shall return IOTHUB_CLIENT_ERROR.] */
             LogError("Failure constructing device twin data");
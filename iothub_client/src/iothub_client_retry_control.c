@@ -194,44 +194,8 @@ static int evaluate_retry_action(RETRY_CONTROL_INSTANCE* retry_control, RETRY_AC
 
 static unsigned int calculate_next_wait_time(RETRY_CONTROL_INSTANCE* retry_control)
 {
-	unsigned int result;
-
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_INTERVAL, `calculate_next_wait_time` shall return `retry_control->initial_wait_time_in_secs`]
-	if (retry_control->policy == IOTHUB_CLIENT_RETRY_INTERVAL)
-	{
-		result = retry_control->initial_wait_time_in_secs;
-	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (`retry_control->retry_count`))]
-	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF)
-	{
-		result = retry_control->initial_wait_time_in_secs * (retry_control->retry_count);
-	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `calculate_next_wait_time` shall return (pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`)]
-	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF)
-	{
-		result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_secs);
-	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `calculate_next_wait_time` shall return ((pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`) * (1 + (`retry_control->max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
-	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER)
-	{
-		double jitter_percent = (retry_control->max_jitter_percent / 100.0) * (rand() / ((double)RAND_MAX));
-
-		result = (unsigned int)(pow(2, retry_control->retry_count - 1) * retry_control->initial_wait_time_in_secs * (1 + jitter_percent));
-	}
-	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `retry_control->policy` is IOTHUB_CLIENT_RETRY_RANDOM, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (rand() / RAND_MAX))]
-	else if (retry_control->policy == IOTHUB_CLIENT_RETRY_RANDOM)
-	{
-		double random_percent = ((double)rand() / (double)RAND_MAX);
-		result = (unsigned int)(retry_control->initial_wait_time_in_secs * random_percent);
-	}
-	else
-	{
-		LogError("Failed to calculate the next wait time (policy %d is not expected)", retry_control->policy);
-
-		result = 0;
-	}
-
-	return result;
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_064: [`calculate_next_wait_time` shall return the result of retry_control_calculate_wait_time() for `retry_control->policy`, `retry_control->initial_wait_time_in_secs`, `retry_control->max_jitter_percent` and `retry_control->retry_count`]
+	return retry_control_calculate_wait_time(retry_control->policy, retry_control->initial_wait_time_in_secs, retry_control->max_jitter_percent, retry_control->retry_count);
 }
 
 
@@ -285,6 +249,53 @@ int is_timeout_reached(time_t start_time, unsigned int timeout_in_secs, bool* is
 	return result;
 }
 
+unsigned int retry_control_calculate_wait_time(IOTHUB_CLIENT_RETRY_POLICY policy, unsigned int initial_wait_time_in_secs, unsigned int max_jitter_percent, unsigned int retry_count)
+{
+	unsigned int result;
+
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_065: [If `policy` is IOTHUB_CLIENT_RETRY_NONE or IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control_calculate_wait_time` shall return 0]
+	if (policy == IOTHUB_CLIENT_RETRY_NONE || policy == IOTHUB_CLIENT_RETRY_IMMEDIATE)
+	{
+		result = 0;
+	}
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `policy` is IOTHUB_CLIENT_RETRY_INTERVAL, `retry_control_calculate_wait_time` shall return `initial_wait_time_in_secs`]
+	else if (policy == IOTHUB_CLIENT_RETRY_INTERVAL)
+	{
+		result = initial_wait_time_in_secs;
+	}
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `policy` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `retry_control_calculate_wait_time` shall return (`initial_wait_time_in_secs` * `retry_count`)]
+	else if (policy == IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF)
+	{
+		result = initial_wait_time_in_secs * retry_count;
+	}
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `retry_control_calculate_wait_time` shall return (pow(2, `retry_count` - 1) * `initial_wait_time_in_secs`)]
+	else if (policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF)
+	{
+		result = (unsigned int)(pow(2, retry_count - 1) * initial_wait_time_in_secs);
+	}
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `retry_control_calculate_wait_time` shall return ((pow(2, `retry_count` - 1) * `initial_wait_time_in_secs`) * (1 + (`max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
+	else if (policy == IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER)
+	{
+		double jitter_percent = (max_jitter_percent / 100.0) * (rand() / ((double)RAND_MAX));
+
+		result = (unsigned int)(pow(2, retry_count - 1) * initial_wait_time_in_secs * (1 + jitter_percent));
+	}
+	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `policy` is IOTHUB_CLIENT_RETRY_RANDOM, `retry_control_calculate_wait_time` shall return (`initial_wait_time_in_secs` * (rand() / RAND_MAX))]
+	else if (policy == IOTHUB_CLIENT_RETRY_RANDOM)
+	{
+		double random_percent = ((double)rand() / (double)RAND_MAX);
+		result = (unsigned int)(initial_wait_time_in_secs * random_percent);
+	}
+	else
+	{
+		LogError("Failed to calculate the next wait time (policy %d is not expected)", policy);
+
+		result = 0;
+	}
+
+	return result;
+}
+
 void retry_control_reset(RETRY_CONTROL_HANDLE retry_control_handle)
 {
 	// Codes_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_034: [If `retry_control_handle` is NULL, `retry_control_reset` shall return]
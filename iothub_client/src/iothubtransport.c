@@ -5,10 +5,12 @@
 #include "azure_c_shared_utility/gballoc.h"
 #include <signal.h>
 #include <stddef.h>
+#include <stdint.h>
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "iothubtransport.h"
 #include "iothub_client.h"
 #include "iothub_client_private.h"
+#include "hash_index_internal.h"
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/lock.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -26,6 +28,12 @@ typedef struct TRANSPORT_HANDLE_DATA_TAG
     IOTHUB_CLIENT_MULTIPLEXED_DO_WORK clientDoWork;
 } TRANSPORT_HANDLE_DATA;
 
+typedef struct TRANSPORT_POOL_HANDLE_DATA_TAG
+{
+    TRANSPORT_HANDLE* transports;
+    size_t transportCount;
+} TRANSPORT_POOL_HANDLE_DATA;
+
 /* Used for Unit test */
 const size_t IoTHubTransport_ThreadTerminationOffset = offsetof(TRANSPORT_HANDLE_DATA, stopThread);
 
@@ -449,3 +457,103 @@ void IoTHubTransport_JoinWorkerThread(TRANSPORT_HANDLE transportHandle, IOTHUB_C
         wait_worker_thread(transportData);
     }
 }
+
+static void destroy_pool_transports(TRANSPORT_POOL_HANDLE_DATA* poolData, size_t transportCount)
+{
+    size_t index;
+
+    for (index = 0; index < transportCount; index++)
+    {
+        IoTHubTransport_Destroy(poolData->transports[index]);
+    }
+}
+
+TRANSPORT_POOL_HANDLE IoTHubTransport_CreatePool(IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol, const char* iotHubName, const char* iotHubSuffix, size_t transportCount)
+{
+    TRANSPORT_POOL_HANDLE_DATA* result;
+
+    if (protocol == NULL || iotHubName == NULL || iotHubSuffix == NULL || transportCount == 0)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_09_001: [ If protocol, iotHubName or iotHubSuffix are NULL, or transportCount is zero, IoTHubTransport_CreatePool shall return NULL. ]*/
+        LogError("Invalid argument, protocol [%p], name [%p], suffix [%p], count [%zu].", protocol, iotHubName, iotHubSuffix, transportCount);
+        result = NULL;
+    }
+    /*Codes_SRS_IOTHUBTRANSPORT_09_002: [ IoTHubTransport_CreatePool shall allocate memory for the pool data and for transportCount transport handles. ]*/
+    else if ((result = (TRANSPORT_POOL_HANDLE_DATA*)malloc(sizeof(TRANSPORT_POOL_HANDLE_DATA))) == NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_09_003: [ If memory allocation fails, IoTHubTransport_CreatePool shall return NULL. ]*/
+        LogError("Transport pool handle was not allocated.");
+    }
+    else if ((result->transports = (TRANSPORT_HANDLE*)malloc(sizeof(TRANSPORT_HANDLE) * transportCount)) == NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_09_003: [ If memory allocation fails, IoTHubTransport_CreatePool shall return NULL. ]*/
+        LogError("Transport pool array was not allocated.");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        size_t index;
+
+        result->transportCount = transportCount;
+
+        /*Codes_SRS_IOTHUBTRANSPORT_09_004: [ IoTHubTransport_CreatePool shall create transportCount transports using IoTHubTransport_Create, each with its own lower layer transport, lock and worker thread. ]*/
+        for (index = 0; index < transportCount; index++)
+        {
+            if ((result->transports[index] = IoTHubTransport_Create(protocol, iotHubName, iotHubSuffix)) == NULL)
+            {
+                break;
+            }
+        }
+
+        if (index < transportCount)
+        {
+            /*Codes_SRS_IOTHUBTRANSPORT_09_005: [ If any transport fails to be created, IoTHubTransport_CreatePool shall destroy the transports already created, free all memory and return NULL. ]*/
+            LogError("Failed creating transport %zu of the pool.", index);
+            destroy_pool_transports(result, index);
+            free(result->transports);
+            free(result);
+            result = NULL;
+        }
+    }
+
+    /*Codes_SRS_IOTHUBTRANSPORT_09_006: [ IoTHubTransport_CreatePool shall return a non-NULL handle on success. ]*/
+    return result;
+}
+
+void IoTHubTransport_DestroyPool(TRANSPORT_POOL_HANDLE poolHandle)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_09_007: [ IoTHubTransport_DestroyPool shall do nothing if poolHandle is NULL. ]*/
+    if (poolHandle != NULL)
+    {
+        TRANSPORT_POOL_HANDLE_DATA* poolData = (TRANSPORT_POOL_HANDLE_DATA*)poolHandle;
+
+        /*Codes_SRS_IOTHUBTRANSPORT_09_008: [ IoTHubTransport_DestroyPool shall destroy each transport using IoTHubTransport_Destroy and free all resources. ]*/
+        destroy_pool_transports(poolData, poolData->transportCount);
+        free(poolData->transports);
+        free(poolData);
+    }
+}
+
+TRANSPORT_HANDLE IoTHubTransport_GetPoolTransport(TRANSPORT_POOL_HANDLE poolHandle, const char* deviceId)
+{
+    TRANSPORT_HANDLE result;
+
+    if (poolHandle == NULL || deviceId == NULL)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_09_009: [ If poolHandle or deviceId are NULL, IoTHubTransport_GetPoolTransport shall return NULL. ]*/
+        LogError("Invalid argument, pool [%p], deviceId [%p].", poolHandle, deviceId);
+        result = NULL;
+    }
+    else
+    {
+        TRANSPORT_POOL_HANDLE_DATA* poolData = (TRANSPORT_POOL_HANDLE_DATA*)poolHandle;
+        /* The hash is stable, so that a given device always lands on the same connection. */
+        size_t hash = hash_index_get_key_hash(deviceId);
+
+        /*Codes_SRS_IOTHUBTRANSPORT_09_010: [ IoTHubTransport_GetPoolTransport shall return the transport selected by a hash of deviceId modulo the number of transports in the pool. ]*/
+        result = poolData->transports[hash % poolData->transportCount];
+    }
+
+    return result;
+}
@@ -16,11 +16,16 @@
 #define DEFAULT_CBS_REQUEST_TIMEOUT_SECS          UINT32_MAX
 #define DEFAULT_SAS_TOKEN_LIFETIME_SECS           3600
 #define DEFAULT_SAS_TOKEN_REFRESH_TIME_SECS       1800
+#define SAS_TOKEN_REFRESH_MAX_JITTER_PERCENT      10
+// The pre-generation lead always exceeds the refresh jitter, so the next SAS token is ready before its refresh is due.
+#define SAS_TOKEN_PREGENERATION_MIN_LEAD_PERCENT  15
+#define SAS_TOKEN_PREGENERATION_MAX_LEAD_PERCENT  25
 
 typedef struct AUTHENTICATION_INSTANCE_TAG 
 {
     const char* device_id;
     STRING_HANDLE iothub_host_fqdn;
+    STRING_HANDLE devices_path;
     
     ON_AUTHENTICATION_STATE_CHANGED_CALLBACK on_state_changed_callback;
     void* on_state_changed_callback_context;
@@ -31,6 +36,10 @@ typedef struct AUTHENTICATION_INSTANCE_TAG
     size_t cbs_request_timeout_secs;
     size_t sas_token_lifetime_secs;
     size_t sas_token_refresh_time_secs;
+    // Fraction of `sas_token_refresh_time_secs` by which the next refresh is anticipated, so devices that authenticated together do not refresh together.
+    double sas_token_refresh_jitter_ratio;
+    // Fraction of `sas_token_refresh_time_secs` ahead of the refresh by which the next SAS token is created.
+    double sas_token_pregeneration_lead_ratio;
 
     AUTHENTICATION_STATE state;
     CBS_HANDLE cbs_handle;
@@ -40,6 +49,9 @@ typedef struct AUTHENTICATION_INSTANCE_TAG
 
     time_t current_sas_token_put_time;
 
+    // Next SAS token for `devices_path`, created in an earlier authentication_do_work() call than the one that puts it to CBS.
+    char* pregenerated_sas_token;
+
     // Auth module used to generating handle authorization
     // with either SAS Token, x509 Certs, and Device SAS Token
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;
@@ -124,7 +136,7 @@ static int verify_cbs_put_token_timeout(AUTHENTICATION_INSTANCE* instance, bool*
     return result;
 }
 
-static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, bool* is_timed_out)
+static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, bool* is_timed_out, bool* is_pregeneration_due)
 {
     int result;
 
@@ -142,14 +154,15 @@ static int verify_sas_token_refresh_timeout(AUTHENTICATION_INSTANCE* instance, b
             result = __FAILURE__;
             LogError("Failed verifying if SAS token refresh timed out (get_time failed)");
         }
-        else if ((uint32_t)get_difftime(current_time, instance->current_sas_token_put_time) >= instance->sas_token_refresh_time_secs)
-        {
-            *is_timed_out = true;
-            result = RESULT_OK;
-        }
         else
         {
-            *is_timed_out = false;
+            uint32_t seconds_since_put = (uint32_t)get_difftime(current_time, instance->current_sas_token_put_time);
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs` minus the refresh jitter]
+            *is_timed_out = (seconds_since_put >=
+                instance->sas_token_refresh_time_secs - (size_t)(instance->sas_token_refresh_time_secs * instance->sas_token_refresh_jitter_ratio));
+            *is_pregeneration_due = (seconds_since_put >=
+                instance->sas_token_refresh_time_secs - (size_t)(instance->sas_token_refresh_time_secs * instance->sas_token_pregeneration_lead_ratio));
             result = RESULT_OK;
         }
     }
@@ -241,120 +254,124 @@ static int put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance, STRING_HANDLE
 
         instance->current_sas_token_put_time = current_time; // If it failed, fear not. `current_sas_token_put_time` shall be checked for INDEFINITE_TIME wherever it is used.
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_131: [If cbs_put_token_async() succeeds, authentication_do_work() shall randomly pick the refresh jitter of the new SAS token, between 0 and 10% of `instance->sas_token_refresh_time_secs`]
+        instance->sas_token_refresh_jitter_ratio = (SAS_TOKEN_REFRESH_MAX_JITTER_PERCENT / 100.0) * (rand() / ((double)RAND_MAX));
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_132: [If cbs_put_token_async() succeeds, authentication_do_work() shall randomly pick the pre-generation lead of the next SAS token, between 15% and 25% of `instance->sas_token_refresh_time_secs`]
+        instance->sas_token_pregeneration_lead_ratio = (SAS_TOKEN_PREGENERATION_MIN_LEAD_PERCENT +
+            (SAS_TOKEN_PREGENERATION_MAX_LEAD_PERCENT - SAS_TOKEN_PREGENERATION_MIN_LEAD_PERCENT) * (rand() / ((double)RAND_MAX))) / 100.0;
+
         result = RESULT_OK;
     }
 
     return result;
 }
 
-static int create_and_put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance)
+static int create_SAS_token(AUTHENTICATION_INSTANCE* instance, char** sas_token_out)
 {
     int result;
     char* sas_token;
-    STRING_HANDLE devices_path;
 
-    if ((devices_path = create_devices_path(instance->iothub_host_fqdn, instance->device_id)) == NULL)
+    /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_07_001: [ authentication_do_work() shall determine what credential type is used SAS_TOKEN or DEVICE_KEY by calling IoTHubClient_Auth_Get_Credential_Type ] */
+    IOTHUB_CREDENTIAL_TYPE cred_type = IoTHubClient_Auth_Get_Credential_Type(instance->authorization_module);
+    if (cred_type == IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY || cred_type == IOTHUB_CREDENTIAL_TYPE_DEVICE_AUTH)
     {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_054: [If `devices_path` failed to be created, authentication_do_work() shall fail and return]
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_072: [If `devices_path` failed to be created, authentication_do_work() shall fail and return]
-        result = __FAILURE__;
-        sas_token = NULL;
-        LogError("Failed creating a SAS token (create_devices_path() failed)");
-    }
-    else
-    {
-        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_07_001: [ authentication_do_work() shall determine what credential type is used SAS_TOKEN or DEVICE_KEY by calling IoTHubClient_Auth_Get_Credential_Type ] */
-        IOTHUB_CREDENTIAL_TYPE cred_type = IoTHubClient_Auth_Get_Credential_Type(instance->authorization_module);
-        if (cred_type == IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY || cred_type == IOTHUB_CREDENTIAL_TYPE_DEVICE_AUTH)
+        double seconds_since_epoch;
+        if (get_seconds_since_epoch(&seconds_since_epoch) != RESULT_OK)
         {
-            double seconds_since_epoch;
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_053: [A STRING_HANDLE, referred to as `devices_path`, shall be created from the following parts: iothub_host_fqdn + "/devices/" + device_id]
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_071: [A STRING_HANDLE, referred to as `devices_path`, shall be created from the following parts: iothub_host_fqdn + "/devices/" + device_id]
-            if (get_seconds_since_epoch(&seconds_since_epoch) != RESULT_OK)
-            {
-                result = __FAILURE__;
-                sas_token = NULL;
-                LogError("Failed creating a SAS token (get_seconds_since_epoch() failed)");
-            }
-            else
-            {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_052: [The SAS token expiration time shall be calculated adding `instance->sas_token_lifetime_secs` to the current number of seconds since epoch time UTC]
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_070: [The SAS token expiration time shall be calculated adding `instance->sas_token_lifetime_secs` to the current number of seconds since epoch time UTC]
-                size_t sas_token_expiration_time_secs = (size_t)seconds_since_epoch + instance->sas_token_lifetime_secs;
-
-                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_049: [authentication_do_work() shall create a SAS token using IoTHubClient_Auth_Get_SasToken, unless it has failed previously] */
-                sas_token = IoTHubClient_Auth_Get_SasToken(instance->authorization_module, STRING_c_str(devices_path), sas_token_expiration_time_secs);
-                if (sas_token == NULL)
-                {
-                    LogError("failure getting sas token.");
-                    result = __FAILURE__;
-                }
-                else
-                {
-                    result = RESULT_OK;
-                }
-            }
+            result = __FAILURE__;
+            sas_token = NULL;
+            LogError("Failed creating a SAS token (get_seconds_since_epoch() failed)");
         }
-        else if (cred_type == IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN)
+        else
         {
-            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_07_002: [ If credential Type is SAS_TOKEN authentication_do_work() shall validate the sas_token, and fail if it's not valid. ] */
-            SAS_TOKEN_STATUS token_status = IoTHubClient_Auth_Is_SasToken_Valid(instance->authorization_module);
-            if (token_status == SAS_TOKEN_STATUS_INVALID)
-            {
-                LogError("sas token is invalid.");
-                sas_token = NULL;
-                result = __FAILURE__;
-            }
-            else if (token_status == SAS_TOKEN_STATUS_FAILED)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_052: [The SAS token expiration time shall be calculated adding `instance->sas_token_lifetime_secs` to the current number of seconds since epoch time UTC]
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_070: [The SAS token expiration time shall be calculated adding `instance->sas_token_lifetime_secs` to the current number of seconds since epoch time UTC]
+            size_t sas_token_expiration_time_secs = (size_t)seconds_since_epoch + instance->sas_token_lifetime_secs;
+
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_049: [authentication_do_work() shall create a SAS token using IoTHubClient_Auth_Get_SasToken, unless it has failed previously] */
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_053: [The SAS token shall be created for `instance->devices_path`]
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_071: [The SAS token shall be created for `instance->devices_path`]
+            sas_token = IoTHubClient_Auth_Get_SasToken(instance->authorization_module, STRING_c_str(instance->devices_path), sas_token_expiration_time_secs);
+            if (sas_token == NULL)
             {
-                LogError("testing Sas Token failed.");
-                sas_token = NULL;
+                LogError("failure getting sas token.");
                 result = __FAILURE__;
             }
             else
             {
-                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_049: [authentication_do_work() shall create a SAS token using IoTHubClient_Auth_Get_SasToken, unless it has failed previously] */
-                sas_token = IoTHubClient_Auth_Get_SasToken(instance->authorization_module, NULL, 0);
-                if (sas_token == NULL)
-                {
-                    LogError("failure getting sas Token.");
-                    result = __FAILURE__;
-                }
-                else
-                {
-                    result = RESULT_OK;
-                }
+                result = RESULT_OK;
             }
         }
-        else if (cred_type == IOTHUB_CREDENTIAL_TYPE_X509 || cred_type == IOTHUB_CREDENTIAL_TYPE_X509_ECC)
+    }
+    else if (cred_type == IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN)
+    {
+        /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_07_002: [ If credential Type is SAS_TOKEN authentication_do_work() shall validate the sas_token, and fail if it's not valid. ] */
+        SAS_TOKEN_STATUS token_status = IoTHubClient_Auth_Is_SasToken_Valid(instance->authorization_module);
+        if (token_status == SAS_TOKEN_STATUS_INVALID)
         {
+            LogError("sas token is invalid.");
             sas_token = NULL;
-            result = RESULT_OK;
+            result = __FAILURE__;
         }
-        else
+        else if (token_status == SAS_TOKEN_STATUS_FAILED)
         {
-            LogError("failure unknown credential type found.");
+            LogError("testing Sas Token failed.");
             sas_token = NULL;
             result = __FAILURE__;
         }
-
-
-        if (sas_token != NULL)
+        else
         {
-            if (put_SAS_token_to_cbs(instance, devices_path, sas_token) != RESULT_OK)
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_049: [authentication_do_work() shall create a SAS token using IoTHubClient_Auth_Get_SasToken, unless it has failed previously] */
+            sas_token = IoTHubClient_Auth_Get_SasToken(instance->authorization_module, NULL, 0);
+            if (sas_token == NULL)
             {
+                LogError("failure getting sas Token.");
                 result = __FAILURE__;
-                LogError("Failed putting SAS token to CBS");
             }
             else
             {
                 result = RESULT_OK;
             }
-            free(sas_token);
         }
+    }
+    else if (cred_type == IOTHUB_CREDENTIAL_TYPE_X509 || cred_type == IOTHUB_CREDENTIAL_TYPE_X509_ECC)
+    {
+        sas_token = NULL;
+        result = RESULT_OK;
+    }
+    else
+    {
+        LogError("failure unknown credential type found.");
+        sas_token = NULL;
+        result = __FAILURE__;
+    }
+
+    *sas_token_out = sas_token;
+
+    return result;
+}
+
+static int create_and_put_SAS_token_to_cbs(AUTHENTICATION_INSTANCE* instance)
+{
+    int result;
+    char* sas_token;
+
+    result = create_SAS_token(instance, &sas_token);
 
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_081: [authentication_do_work() shall free the memory it allocated for `devices_path`, `sasTokenKeyName` and SAS token]
-        STRING_delete(devices_path);
+    if (sas_token != NULL)
+    {
+        if (put_SAS_token_to_cbs(instance, instance->devices_path, sas_token) != RESULT_OK)
+        {
+            result = __FAILURE__;
+            LogError("Failed putting SAS token to CBS");
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_081: [authentication_do_work() shall free the memory it allocated for the SAS token]
+        free(sas_token);
     }
     return result;
 }
@@ -480,6 +497,13 @@ int authentication_stop(AUTHENTICATION_HANDLE authentication_handle)
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_033: [`instance->cbs_handle` shall be set to NULL]
             instance->cbs_handle = NULL;
 
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_136: [authentication_stop() shall free the pre-generated SAS token, if any]
+            if (instance->pregenerated_sas_token != NULL)
+            {
+                free(instance->pregenerated_sas_token);
+                instance->pregenerated_sas_token = NULL;
+            }
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_034: [`instance->state` shall be set to AUTHENTICATION_STATE_STOPPED and `instance->on_state_changed_callback` invoked]
             update_state(instance, AUTHENTICATION_STATE_STOPPED);
 
@@ -511,6 +535,9 @@ void authentication_destroy(AUTHENTICATION_HANDLE authentication_handle)
         if (instance->iothub_host_fqdn != NULL)
             STRING_delete(instance->iothub_host_fqdn);
 
+        if (instance->devices_path != NULL)
+            STRING_delete(instance->devices_path);
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_108: [authentication_destroy() shall destroy all resouces used by this module]
         free(instance);
     }
@@ -573,6 +600,13 @@ AUTHENTICATION_HANDLE authentication_create(const AUTHENTICATION_CONFIG* config)
                 result = NULL;
                 LogError("authentication_create failed (config->iothub_host_fqdn could not be copied; STRING_construct failed)");
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_129: [authentication_create() shall save into `instance->devices_path` a STRING_HANDLE created from the following parts: iothub_host_fqdn + "/devices/" + device_id]
+            else if ((instance->devices_path = create_devices_path(instance->iothub_host_fqdn, instance->device_id)) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_130: [If `instance->devices_path` fails to be created, authentication_create() shall fail and return NULL]
+                result = NULL;
+                LogError("authentication_create failed (could not create the devices path)");
+            }
             else
             {
                 instance->state = AUTHENTICATION_STATE_STOPPED;
@@ -655,20 +689,37 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
             if (IoTHubClient_Auth_Get_Credential_Type(instance->authorization_module) == IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_039: [If `instance->state` is AUTHENTICATION_STATE_STARTED and device keys were used, authentication_do_work() shall only verify the SAS token refresh time]
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs`]
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs` minus the refresh jitter]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_066: [If SAS token does not need to be refreshed, authentication_do_work() shall return]
                 bool is_timed_out;
-                if (verify_sas_token_refresh_timeout(instance, &is_timed_out) == RESULT_OK && is_timed_out)
+                bool is_pregeneration_due;
+                if (verify_sas_token_refresh_timeout(instance, &is_timed_out, &is_pregeneration_due) != RESULT_OK)
+                {
+                    // Nothing to be done; the refresh time is verified again on the next call.
+                }
+                else if (is_timed_out)
                 {
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_119: [authentication_do_work() shall set `instance->is_sas_token_refresh_in_progress` to TRUE]
                     instance->is_sas_token_refresh_in_progress = true;
 
+                    if (instance->pregenerated_sas_token != NULL)
+                    {
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_134: [If the SAS token needs to be refreshed and one was pre-generated, authentication_do_work() shall put the pre-generated SAS token to CBS instead of creating a new one]
+                        if (put_SAS_token_to_cbs(instance, instance->devices_path, instance->pregenerated_sas_token) != RESULT_OK)
+                        {
+                            LogError("Failed refreshing SAS token for device '%s' (could not put the pre-generated SAS token)", instance->device_id);
+                        }
+
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_081: [authentication_do_work() shall free the memory it allocated for the SAS token]
+                        free(instance->pregenerated_sas_token);
+                        instance->pregenerated_sas_token = NULL;
+                    }
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_067: [authentication_do_work() shall create a SAS token using `instance->device_primary_key`, unless it has failed previously]
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_069: [If using `instance->device_primary_key` has failed previously, a SAS token shall be created using `instance->device_secondary_key`]
                     // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_068: [If using `instance->device_primary_key` has failed previously and `instance->device_secondary_key` is not provided,  authentication_do_work() shall fail and return]
-                    if (create_and_put_SAS_token_to_cbs(instance) != RESULT_OK)
+                    else if (create_and_put_SAS_token_to_cbs(instance) != RESULT_OK)
                     {
-                        LogError("Failed refreshing SAS token '%'", instance->device_id);
+                        LogError("Failed refreshing SAS token '%s'", instance->device_id);
                     }
 
                     if (!instance->is_cbs_put_token_in_progress)
@@ -683,6 +734,15 @@ void authentication_do_work(AUTHENTICATION_HANDLE authentication_handle)
                         notify_error(instance, AUTHENTICATION_ERROR_SAS_REFRESH_FAILED);
                     }
                 }
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_133: [If the SAS token does not need to be refreshed yet, but the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs` minus the pre-generation lead, authentication_do_work() shall create the next SAS token and keep it for `instance->devices_path`, unless one was already created]
+                else if (is_pregeneration_due && instance->pregenerated_sas_token == NULL)
+                {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_135: [If the next SAS token fails to be pre-generated, authentication_do_work() shall create it when the refresh is due]
+                    if (create_SAS_token(instance, &instance->pregenerated_sas_token) != RESULT_OK)
+                    {
+                        LogError("Failed pre-generating the next SAS token for device '%s'; it will be created when the refresh is due", instance->device_id);
+                    }
+                }
             }
         }
         else if (instance->state == AUTHENTICATION_STATE_STARTING)
@@ -33,6 +33,7 @@
 #include "iothubtransportamqp_methods.h"
 #endif
 #include "iothub_client_retry_control.h"
+#include "hash_index.h"
 #include "iothubtransport_amqp_common.h"
 #include "iothubtransport_amqp_connection.h"
 #include "iothubtransport_amqp_device.h"
@@ -81,11 +82,18 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     AMQP_CONNECTION_STATE amqp_connection_state;                        // Current state of the amqp_connection.
     AMQP_TRANSPORT_AUTHENTICATION_MODE preferred_authentication_mode;   // Used to avoid registered devices using different authentication modes.
     SINGLYLINKEDLIST_HANDLE registered_devices;                         // List of devices currently registered in this transport.
+    HASH_INDEX_HANDLE registered_devices_index;                         // Items of registered_devices, indexed by device id.
     bool is_trace_on;                                                   // Turns logging on and off.
     OPTIONHANDLER_HANDLE saved_tls_options;                             // Here are the options from the xio layer if any is saved.
     AMQP_TRANSPORT_STATE state;                                         // Current state of the transport.
     RETRY_CONTROL_HANDLE connection_retry_control;                      // Controls when the re-connection attempt should occur.
+    IOTHUB_CLIENT_RETRY_POLICY option_retry_policy;                     // Retry policy applied to the connection and to each registered device.
+    size_t option_retry_timeout_limit_in_secs;                          // Maximum time the retry policy keeps retrying (0 for no limit).
     size_t c2d_keep_alive_freq_secs;                                    // Service to device keep alive frequency
+    size_t session_incoming_window;                                     // AMQP session incoming window (0 for the connection default).
+    size_t session_outgoing_window;                                     // AMQP session outgoing window (0 for the connection default).
+    size_t max_concurrent_authentications;                              // Maximum number of registered devices starting (authenticating) at once (0 for no limit).
+    size_t authenticating_devices_count;                                // Number of registered devices currently in DEVICE_STATE_STARTING.
 
     char* http_proxy_hostname;
     int http_proxy_port;
@@ -96,6 +104,9 @@ typedef struct AMQP_TRANSPORT_INSTANCE_TAG
     size_t option_sas_token_refresh_time_secs;                          // Device-specific option.
     size_t option_cbs_request_timeout_secs;                             // Device-specific option.
     size_t option_send_event_timeout_secs;                              // Device-specific option.
+    size_t option_event_batch_target_size;                              // Device-specific option.
+    size_t option_event_batch_max_linger_msecs;                         // Device-specific option.
+    size_t option_event_batch_max_in_flight;                            // Device-specific option.
 
                                                                         // Auth module used to generating handle authorization
     IOTHUB_AUTHORIZATION_HANDLE authorization_module;                   // with either SAS Token, x509 Certs, and Device SAS Token
@@ -113,6 +124,9 @@ typedef struct AMQP_TRANSPORT_DEVICE_INSTANCE_TAG
     size_t number_of_send_event_complete_failures;                      // Number of times on_event_send_complete was called in row with an error.
     time_t time_of_last_state_change;                                   // Time the device_handle last changed state; used to track timeouts of device_start_async and device_stop.
     unsigned int max_state_change_timeout_secs;                         // Maximum number of seconds allowed for device_handle to complete start and stop state changes.
+    RETRY_CONTROL_HANDLE retry_control;                                 // Controls when the device is restarted after it has failed on its own (i.e., without a connection retry).
+    bool is_waiting_for_restart;                                        // Indicates the device was stopped after failing, and its restart is subject to retry_control.
+    bool is_retry_expired;                                              // Indicates retry_control gave up restarting the device.
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     // the methods portion
     IOTHUBTRANSPORT_AMQP_METHODS_HANDLE methods_handle;                 // Handle to instance of module that deals with device methods for AMQP.
@@ -187,6 +201,10 @@ static void update_state(AMQP_TRANSPORT_INSTANCE* transport_instance, AMQP_TRANS
 static void reset_retry_control(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
 {
     retry_control_reset(registered_device->transport_instance->connection_retry_control);
+    retry_control_reset(registered_device->retry_control);
+
+    registered_device->is_waiting_for_restart = false;
+    registered_device->is_retry_expired = false;
 }
 
 
@@ -210,6 +228,11 @@ static void internal_destroy_amqp_device_instance(AMQP_TRANSPORT_DEVICE_INSTANCE
         STRING_delete(trdev_inst->device_id);
     }
 
+    if (trdev_inst->retry_control != NULL)
+    {
+        retry_control_destroy(trdev_inst->retry_control);
+    }
+
     free(trdev_inst);
 }
 
@@ -232,6 +255,22 @@ static DEVICE_AUTH_MODE get_authentication_mode(const IOTHUB_DEVICE_CONFIG* devi
     return result;
 }
 
+// @brief
+//     Saves the new state of the registered device, keeping count of the devices that are starting.
+static void set_device_state(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device, DEVICE_STATE new_state)
+{
+    if (registered_device->device_state == DEVICE_STATE_STARTING && new_state != DEVICE_STATE_STARTING)
+    {
+        registered_device->transport_instance->authenticating_devices_count--;
+    }
+    else if (registered_device->device_state != DEVICE_STATE_STARTING && new_state == DEVICE_STATE_STARTING)
+    {
+        registered_device->transport_instance->authenticating_devices_count++;
+    }
+
+    registered_device->device_state = new_state;
+}
+
 // @brief
 //     Saves the new state, if it is different than the previous one.
 static void on_device_state_changed_callback(void* context, DEVICE_STATE previous_state, DEVICE_STATE new_state)
@@ -241,13 +280,14 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
     {
         AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)context;
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_062: [If `new_state` shall be saved into the `registered_device` instance]
-        registered_device->device_state = new_state;
+        set_device_state(registered_device, new_state);
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_063: [If `registered_device->time_of_last_state_change` shall be set using get_time()]
         registered_device->time_of_last_state_change = get_time(NULL);
 
         if (new_state == DEVICE_STATE_STARTED)
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_127: [If `new_state` is DEVICE_STATE_STARTED, retry_control_reset() shall be invoked passing `instance->connection_retry_control`]
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_166: [If `new_state` is DEVICE_STATE_STARTED, retry_control_reset() shall be invoked passing `registered_device->retry_control`]
             reset_retry_control(registered_device);
 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_120: [If `new_state` is DEVICE_STATE_STARTED, IoTHubClient_LL_ConnectionStatusCallBack shall be invoked with IOTHUB_CLIENT_CONNECTION_AUTHENTICATED and IOTHUB_CLIENT_CONNECTION_OK]
@@ -271,41 +311,12 @@ static void on_device_state_changed_callback(void* context, DEVICE_STATE previou
     }
 }
 
-// @brief    Auxiliary function to be used to find a device in the registered_devices list.
-// @returns  true if the device ids match, false otherwise.
-static bool find_device_by_id_callback(LIST_ITEM_HANDLE list_item, const void* match_context)
-{
-    bool result;
-
-    if (match_context == NULL)
-    {
-        result = false;
-    }
-    else
-    {
-        AMQP_TRANSPORT_DEVICE_INSTANCE* device_instance = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
-
-        if (device_instance == NULL || 
-            device_instance->device_id == NULL || 
-            STRING_c_str(device_instance->device_id) != match_context)
-        {
-            result = false;
-        }
-        else
-        {
-            result = true;
-        }
-    }
-
-    return result;
-}
-
 // @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
 // @remarks     Returns the correspoding LIST_ITEM_HANDLE in registered_devices, if found.
 // @returns     true if the device is already in the list, false otherwise.
-static bool is_device_registered_ex(SINGLYLINKEDLIST_HANDLE registered_devices, const char* device_id, LIST_ITEM_HANDLE *list_item)
+static bool is_device_registered_ex(AMQP_TRANSPORT_INSTANCE* transport_instance, const char* device_id, LIST_ITEM_HANDLE *list_item)
 {
-    return ((*list_item = singlylinkedlist_find(registered_devices, find_device_by_id_callback, device_id)) != NULL ? 1 : 0);
+    return ((*list_item = (LIST_ITEM_HANDLE)hash_index_find(transport_instance->registered_devices_index, device_id)) != NULL ? 1 : 0);
 }
 
 // @brief       Verifies if a device is already registered within the transport that owns the list of registered devices.
@@ -314,7 +325,7 @@ static bool is_device_registered(AMQP_TRANSPORT_DEVICE_INSTANCE* amqp_device_ins
 {
     LIST_ITEM_HANDLE list_item;
     const char* device_id = STRING_c_str(amqp_device_instance->device_id);
-    return is_device_registered_ex(amqp_device_instance->transport_instance->registered_devices, device_id, &list_item);
+    return is_device_registered_ex(amqp_device_instance->transport_instance, device_id, &list_item);
 }
 
 static size_t get_number_of_registered_devices(AMQP_TRANSPORT_INSTANCE* transport)
@@ -766,6 +777,9 @@ static int establish_amqp_connection(AMQP_TRANSPORT_INSTANCE* transport_instance
         amqp_connection_config.on_state_changed_context = transport_instance;
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_12_003: [AMQP connection will be configured using the `c2d_keep_alive_freq_secs` value from SetOption ]
         amqp_connection_config.c2d_keep_alive_freq_secs = transport_instance->c2d_keep_alive_freq_secs;
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_154: [`instance->session_incoming_window` and `instance->session_outgoing_window` shall be set into AMQP_CONNECTION_CONFIG]
+        amqp_connection_config.session_incoming_window = transport_instance->session_incoming_window;
+        amqp_connection_config.session_outgoing_window = transport_instance->session_outgoing_window;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_027: [If `transport->preferred_authentication_method` is CBS, AMQP_CONNECTION_CONFIG shall be set with `create_sasl_io` = true and `create_cbs_connection` = true]
         if (transport_instance->preferred_authentication_mode == AMQP_TRANSPORT_AUTHENTICATION_MODE_CBS)
@@ -830,6 +844,40 @@ static void prepare_device_for_connection_retry(AMQP_TRANSPORT_DEVICE_INSTANCE*
     registered_device->number_of_send_event_complete_failures = 0;
 }
 
+static bool has_device_failed(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    return (registered_device->number_of_previous_failures >= MAX_NUMBER_OF_DEVICE_FAILURES ||
+        registered_device->number_of_send_event_complete_failures >= MAX_NUMBER_OF_DEVICE_FAILURES);
+}
+
+// @brief
+//     Stops the registered devices that have failed, so they are started again (re-authenticated and with their links re-attached) on the next DoWork.
+//     The other registered devices and the amqp_connection are not affected.
+static void reset_failed_devices(AMQP_TRANSPORT_INSTANCE* transport_instance)
+{
+    LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(transport_instance->registered_devices);
+
+    while (list_item != NULL)
+    {
+        AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
+
+        if (registered_device == NULL)
+        {
+            LogError("Failed resetting device (singlylinkedlist_item_get_value failed)");
+        }
+        else if (has_device_failed(registered_device))
+        {
+            LogError("Device '%s' will be restarted; the other devices and the connection are not affected.", STRING_c_str(registered_device->device_id));
+
+            prepare_device_for_connection_retry(registered_device);
+
+            registered_device->is_waiting_for_restart = true;
+        }
+
+        list_item = singlylinkedlist_get_next_item(list_item);
+    }
+}
+
 static void prepare_for_connection_retry(AMQP_TRANSPORT_INSTANCE* transport_instance)
 {
     LogInfo("Preparing transport for re-connection");
@@ -1019,6 +1067,50 @@ static int send_pending_events(AMQP_TRANSPORT_DEVICE_INSTANCE* device_state)
     return result;
 }
 
+// @brief
+//     Verifies, using the device's own retry control, if a device stopped after failing can be started on this DoWork.
+//     Reports IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED for the device once its retry policy gives up.
+static bool can_restart_device(AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device)
+{
+    bool result;
+
+    if (!registered_device->is_waiting_for_restart)
+    {
+        result = true;
+    }
+    else if (registered_device->is_retry_expired)
+    {
+        result = false;
+    }
+    else
+    {
+        RETRY_ACTION retry_action;
+
+        if (retry_control_should_retry(registered_device->retry_control, &retry_action) != RESULT_OK)
+        {
+            LogError("Failed verifying if device '%s' should be restarted (retry_control_should_retry failed); restarting it now", STRING_c_str(registered_device->device_id));
+            retry_action = RETRY_ACTION_RETRY_NOW;
+        }
+
+        if (retry_action == RETRY_ACTION_STOP_RETRYING)
+        {
+            LogError("Device '%s' will not be restarted (retry policy expired)", STRING_c_str(registered_device->device_id));
+
+            registered_device->is_retry_expired = true;
+
+            IoTHubClient_LL_ConnectionStatusCallBack(registered_device->iothub_client_handle, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED);
+
+            result = false;
+        }
+        else
+        {
+            result = (retry_action == RETRY_ACTION_RETRY_NOW);
+        }
+    }
+
+    return result;
+}
+
 // @brief
 //     Auxiliary function for the public DoWork API, performing DoWork activities (authenticate, messaging) for a specific device.
 // @requires
@@ -1037,8 +1129,20 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
             SESSION_HANDLE session_handle;
             CBS_HANDLE cbs_handle = NULL;
 
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_161: [If `instance->max_concurrent_authentications` is not zero and as many registered devices are in DEVICE_STATE_STARTING, the device shall not be started on this DoWork]
+            if (registered_device->transport_instance->max_concurrent_authentications != 0 &&
+                registered_device->transport_instance->authenticating_devices_count >= registered_device->transport_instance->max_concurrent_authentications)
+            {
+                result = RESULT_OK;
+            }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_167: [If the device was stopped by the transport after failing, it shall be started only if retry_control_should_retry() on `registered_device->retry_control` returns RETRY_ACTION_RETRY_NOW, or if it fails]
+            else if (!can_restart_device(registered_device))
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_168: [If retry_control_should_retry() returns RETRY_ACTION_STOP_RETRYING, IoTHubClient_LL_ConnectionStatusCallBack shall be invoked once for the device with IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED and IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED, and the device shall not be restarted]
+                result = RESULT_OK;
+            }
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_039: [amqp_connection_get_session_handle() shall be invoked on `instance->connection`]
-            if (amqp_connection_get_session_handle(registered_device->transport_instance->amqp_connection, &session_handle) != RESULT_OK)
+            else if (amqp_connection_get_session_handle(registered_device->transport_instance->amqp_connection, &session_handle) != RESULT_OK)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_040: [If amqp_connection_get_session_handle() fails, IoTHubTransport_AMQP_Common_DoWork shall fail and return]
                 LogError("Failed performing DoWork for device '%s' (failed to get the amqp_connection session_handle)", STRING_c_str(registered_device->device_id));
@@ -1072,14 +1176,14 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
             if (is_timeout_reached(registered_device->time_of_last_state_change, registered_device->max_state_change_timeout_secs, &is_timed_out) != RESULT_OK)
             {
                 LogError("Failed performing DoWork for device '%s' (failed tracking timeout of device %d state)", STRING_c_str(registered_device->device_id), registered_device->device_state);
-                registered_device->device_state = DEVICE_STATE_ERROR_AUTH; // if time could not be calculated, the worst must be assumed.
+                set_device_state(registered_device, DEVICE_STATE_ERROR_AUTH); // if time could not be calculated, the worst must be assumed.
                 result = __FAILURE__;
             }
             else if (is_timed_out)
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_044: [If the device times out in state DEVICE_STATE_STARTING or DEVICE_STATE_STOPPING, the registered device shall be marked with failure]
                 LogError("Failed performing DoWork for device '%s' (device failed to start or stop within expected timeout)", STRING_c_str(registered_device->device_id));
-                registered_device->device_state = DEVICE_STATE_ERROR_AUTH; // this will cause device to be stopped bellow on the next call to this function.
+                set_device_state(registered_device, DEVICE_STATE_ERROR_AUTH); // this will cause device to be stopped bellow on the next call to this function.
                 result = __FAILURE__;
             }
             else
@@ -1094,7 +1198,7 @@ static int IoTHubTransport_AMQP_Common_Device_DoWork(AMQP_TRANSPORT_DEVICE_INSTA
 
             registered_device->number_of_previous_failures++;
 
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_046: [If the device has failed for MAX_NUMBER_OF_DEVICE_FAILURES in a row, it shall trigger a connection retry on the transport]
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_046: [If the device has failed for MAX_NUMBER_OF_DEVICE_FAILURES in a row, it shall be reported as failed to the transport]
             if (registered_device->number_of_previous_failures >= MAX_NUMBER_OF_DEVICE_FAILURES)
             {
                 result = __FAILURE__;
@@ -1162,6 +1266,30 @@ static int replicate_device_options_to(AMQP_TRANSPORT_DEVICE_INSTANCE* dev_insta
         LogError("Failed to apply option DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
         result = __FAILURE__;
     }
+    else if (device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE,
+        &dev_instance->transport_instance->option_event_batch_target_size) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    else if (device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS,
+        &dev_instance->transport_instance->option_event_batch_max_linger_msecs) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
+    else if (device_set_option(
+        dev_instance->device_handle,
+        DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT,
+        &dev_instance->transport_instance->option_event_batch_max_in_flight) != RESULT_OK)
+    {
+        LogError("Failed to apply option DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT to device '%s' (device_set_option failed)", STRING_c_str(dev_instance->device_id));
+        result = __FAILURE__;
+    }
     else if (auth_mode == DEVICE_AUTH_MODE_CBS)
     {
         if (device_set_option(
@@ -1223,6 +1351,18 @@ static const char* get_device_option_name_from(const char* iothubclient_option_n
     {
         device_option_name = DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS;
     }
+    else if (strcmp(OPTION_EVENT_BATCH_TARGET_SIZE, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE;
+    }
+    else if (strcmp(OPTION_EVENT_BATCH_MAX_LINGER_MS, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS;
+    }
+    else if (strcmp(OPTION_EVENT_BATCH_MAX_IN_FLIGHT, iothubclient_option_name) == 0)
+    {
+        device_option_name = DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT;
+    }
     else
     {
         device_option_name = NULL;
@@ -1297,6 +1437,11 @@ static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
             singlylinkedlist_destroy(instance->registered_devices);
         }
 
+        if (instance->registered_devices_index != NULL)
+        {
+            hash_index_destroy(instance->registered_devices_index);
+        }
+
         if (instance->amqp_connection != NULL)
         {
             amqp_connection_destroy(instance->amqp_connection);
@@ -1315,37 +1460,6 @@ static void internal_destroy_instance(AMQP_TRANSPORT_INSTANCE* instance)
     }
 }
 
-// ---------- SendMessageDisposition helpers ---------- //
-
-static DEVICE_MESSAGE_DISPOSITION_INFO* create_device_message_disposition_info_from(MESSAGE_CALLBACK_INFO* message_data)
-{
-    DEVICE_MESSAGE_DISPOSITION_INFO* result;
-
-    if ((result = (DEVICE_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO))) == NULL)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (malloc failed)");
-    }
-    else if (mallocAndStrcpy_s(&result->source, message_data->transportContext->link_name) != RESULT_OK)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
-        free(result);
-        result = NULL;
-    }
-    else
-    {
-        result->message_id = message_data->transportContext->message_id;
-    }
-
-    return result;
-}
-
-static void destroy_device_message_disposition_info(DEVICE_MESSAGE_DISPOSITION_INFO* device_message_disposition_info)
-{
-    free(device_message_disposition_info->source);
-    free(device_message_disposition_info);
-}
-
-
 // ---------- API functions ---------- //
 
 TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CONFIG* config, AMQP_GET_IO_TRANSPORT get_io_transport)
@@ -1384,6 +1498,9 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
             instance->state = AMQP_TRANSPORT_STATE_NOT_CONNECTED;
             instance->authorization_module = config->auth_module_handle;
 
+            instance->option_retry_policy = DEFAULT_RETRY_POLICY;
+            instance->option_retry_timeout_limit_in_secs = DEFAULT_MAX_RETRY_TIME_IN_SECS;
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_124: [`instance->connection_retry_control` shall be set using retry_control_create(), passing defaults EXPONENTIAL_BACKOFF_WITH_JITTER and 0]
             if ((instance->connection_retry_control = retry_control_create(DEFAULT_RETRY_POLICY, DEFAULT_MAX_RETRY_TIME_IN_SECS)) == NULL)
             {
@@ -1406,6 +1523,13 @@ TRANSPORT_LL_HANDLE IoTHubTransport_AMQP_Common_Create(const IOTHUBTRANSPORT_CON
                 LogError("Failed to initialize the internal list of registered devices (singlylinkedlist_create failed)");
                 result = NULL;
             }
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_156: [`instance->registered_devices_index` shall be set using hash_index_create()]
+            else if ((instance->registered_devices_index = hash_index_create(0)) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_157: [If hash_index_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
+                LogError("Failed to initialize the internal index of registered devices (hash_index_create failed)");
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_010: [`get_io_transport` shall be saved on `instance->underlying_io_transport_provider`]
@@ -1538,6 +1662,9 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_020: [If the amqp_connection is OPENED, the transport shall iterate through each registered device and perform a device-specific do_work on each]
             else if (transport_instance->amqp_connection_state == AMQP_CONNECTION_STATE_OPENED)
             {
+                size_t number_of_devices = 0;
+                size_t number_of_failed_devices = 0;
+
                 while (list_item != NULL)
                 {
                     AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device;
@@ -1546,25 +1673,44 @@ void IoTHubTransport_AMQP_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                     {
                         LogError("Transport had an unexpected failure during DoWork (failed to fetch a registered_devices list item value)");
                     }
-                    else if (registered_device->number_of_send_event_complete_failures >= MAX_NUMBER_OF_DEVICE_FAILURES)
+                    else
                     {
-                        LogError("Device '%s' reported a critical failure (events completed sending with failures); connection retry will be triggered.", STRING_c_str(registered_device->device_id));
+                        number_of_devices++;
 
-                        update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
-                    }
-                    else if (IoTHubTransport_AMQP_Common_Device_DoWork(registered_device) != RESULT_OK)
-                    {
-                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_021: [If DoWork fails for the registered device for more than MAX_NUMBER_OF_DEVICE_FAILURES, connection retry shall be triggered]
-                        if (registered_device->number_of_previous_failures >= MAX_NUMBER_OF_DEVICE_FAILURES)
+                        if (registered_device->number_of_send_event_complete_failures >= MAX_NUMBER_OF_DEVICE_FAILURES)
                         {
-                            LogError("Device '%s' reported a critical failure; connection retry will be triggered.", STRING_c_str(registered_device->device_id));
-
-                            update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
+                            LogError("Device '%s' reported a critical failure (events completed sending with failures).", STRING_c_str(registered_device->device_id));
+                            number_of_failed_devices++;
+                        }
+                        else if (IoTHubTransport_AMQP_Common_Device_DoWork(registered_device) != RESULT_OK)
+                        {
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_021: [If DoWork fails for the registered device for more than MAX_NUMBER_OF_DEVICE_FAILURES, the device shall be considered failed]
+                            if (registered_device->number_of_previous_failures >= MAX_NUMBER_OF_DEVICE_FAILURES)
+                            {
+                                LogError("Device '%s' reported a critical failure.", STRING_c_str(registered_device->device_id));
+                                number_of_failed_devices++;
+                            }
                         }
                     }
 
                     list_item = singlylinkedlist_get_next_item(list_item);
                 }
+
+                if (number_of_failed_devices > 0)
+                {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_164: [If all the registered devices have failed, connection retry shall be triggered]
+                    if (number_of_failed_devices == number_of_devices)
+                    {
+                        LogError("All devices registered on the transport reported critical failures; connection retry will be triggered.");
+
+                        update_state(transport_instance, AMQP_TRANSPORT_STATE_RECONNECTION_REQUIRED);
+                    }
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_165: [Otherwise, each failed device shall be stopped using device_stop() and have its failure counters reset, without affecting the other registered devices or the connection]
+                    else
+                    {
+                        reset_failed_devices(transport_instance);
+                    }
+                }
             }
         }
 
@@ -1900,6 +2046,21 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             is_device_specific_option = true;
             transport_instance->option_send_event_timeout_secs = *(size_t*)value;
         }
+        else if (strcmp(OPTION_EVENT_BATCH_TARGET_SIZE, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_event_batch_target_size = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_EVENT_BATCH_MAX_LINGER_MS, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_event_batch_max_linger_msecs = *(size_t*)value;
+        }
+        else if (strcmp(OPTION_EVENT_BATCH_MAX_IN_FLIGHT, option) == 0)
+        {
+            is_device_specific_option = true;
+            transport_instance->option_event_batch_max_in_flight = *(size_t*)value;
+        }
         else
         {
             is_device_specific_option = false;
@@ -1923,6 +2084,23 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SetOption(TRANSPORT_LL_HANDLE h
             transport_instance->c2d_keep_alive_freq_secs = *(size_t*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_155: [If `option` is `amqp_session_incoming_window` or `amqp_session_outgoing_window`, `value` shall be saved and used when the AMQP connection is next established]
+        else if (strcmp(OPTION_AMQP_SESSION_INCOMING_WINDOW, option) == 0)
+        {
+            transport_instance->session_incoming_window = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_AMQP_SESSION_OUTGOING_WINDOW, option) == 0)
+        {
+            transport_instance->session_outgoing_window = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_162: [If `option` is `amqp_max_concurrent_authentications`, `value` shall be saved into `instance->max_concurrent_authentications`]
+        else if (strcmp(OPTION_AMQP_MAX_CONCURRENT_AUTHENTICATIONS, option) == 0)
+        {
+            transport_instance->max_concurrent_authentications = *(size_t*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_104: [If `option` is `logtrace`, `value` shall be saved and applied to `instance->connection` using amqp_connection_set_logging()]
         else if (strcmp(OPTION_LOG_TRACE, option) == 0)
         {
@@ -2096,7 +2274,7 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
         AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
 
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_064: [If the device is already registered, IoTHubTransport_AMQP_Common_Register shall fail and return NULL.]
-        if (is_device_registered_ex(transport_instance->registered_devices, device->deviceId, &list_item))
+        if (is_device_registered_ex(transport_instance, device->deviceId, &list_item))
         {
             LogError("IoTHubTransport_AMQP_Common_Register failed (device '%s' already registered on this transport instance)", device->deviceId);
             result = NULL;
@@ -2151,6 +2329,13 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                     LogError("Transport failed to register device '%s' (failed to copy the deviceId)", device->deviceId);
                     result = NULL;
                 }
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_169: [`amqp_device_instance->retry_control` shall be set using retry_control_create(), passing the retry policy and timeout currently set on the transport]
+                else if ((amqp_device_instance->retry_control = retry_control_create(transport_instance->option_retry_policy, (unsigned int)transport_instance->option_retry_timeout_limit_in_secs)) == NULL)
+                {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_170: [If retry_control_create() fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
+                    LogError("Transport failed to register device '%s' (failed to create the device retry control)", device->deviceId);
+                    result = NULL;
+                }
                 else
                 {
                     DEVICE_CONFIG device_config;
@@ -2192,12 +2377,20 @@ IOTHUB_DEVICE_HANDLE IoTHubTransport_AMQP_Common_Register(TRANSPORT_LL_HANDLE ha
                                 result = NULL;
                             }
                             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
-                            else if (singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance) == NULL)
+                            else if ((list_item = singlylinkedlist_add(transport_instance->registered_devices, amqp_device_instance)) == NULL)
                             {
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_075: [If it fails to add `amqp_device_instance`, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
                                 LogError("Transport failed to register device '%s' (singlylinkedlist_add failed)", device->deviceId);
                                 result = NULL;
                             }
+                            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_158: [IoTHubTransport_AMQP_Common_Register shall index the new `instance->registered_devices` item by device id using hash_index_add()]
+                            else if (hash_index_add(transport_instance->registered_devices_index, device->deviceId, list_item) != RESULT_OK)
+                            {
+                                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_159: [If hash_index_add() fails, IoTHubTransport_AMQP_Common_Register shall remove `amqp_device_instance` from `instance->registered_devices`, fail and return NULL]
+                                LogError("Transport failed to register device '%s' (hash_index_add failed)", device->deviceId);
+                                (void)singlylinkedlist_remove(transport_instance->registered_devices, list_item);
+                                result = NULL;
+                            }
                             else
                             {
                                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
@@ -2256,7 +2449,7 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
             LogError("Failed to unregister device '%s' (deviceHandle does not have a transport state associated to).", device_id);
         }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_081: [If the device is not registered with this transport, IoTHubTransport_AMQP_Common_Unregister shall return]
-        else if (!is_device_registered_ex(registered_device->transport_instance->registered_devices, device_id, &list_item))
+        else if (!is_device_registered_ex(registered_device->transport_instance, device_id, &list_item))
         {
             LogError("Failed to unregister device '%s' (device is not registered within this transport).", device_id);
         }
@@ -2269,6 +2462,12 @@ void IoTHubTransport_AMQP_Common_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
             }
             else
             {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_160: [IoTHubTransport_AMQP_Common_Unregister shall remove the device id from `instance->registered_devices_index` using hash_index_remove()]
+                (void)hash_index_remove(registered_device->transport_instance->registered_devices_index, device_id);
+
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_163: [If the device is in DEVICE_STATE_STARTING, IoTHubTransport_AMQP_Common_Unregister shall release its place among the devices authenticating]
+                set_device_state(registered_device, DEVICE_STATE_STOPPED);
+
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_012: [IoTHubTransport_AMQP_Common_Unregister shall destroy the C2D methods handler by calling iothubtransportamqp_methods_destroy]
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_083: [IoTHubTransport_AMQP_Common_Unregister shall free all the memory allocated for the `device_instance`]
                 internal_destroy_amqp_device_instance(registered_device);
@@ -2318,14 +2517,46 @@ int IoTHubTransport_AMQP_Common_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHU
             AMQP_TRANSPORT_INSTANCE* transport_instance = (AMQP_TRANSPORT_INSTANCE*)handle;
             RETRY_CONTROL_HANDLE previous_retry_control = transport_instance->connection_retry_control;
 
+            LIST_ITEM_HANDLE list_item;
+
             transport_instance->connection_retry_control = new_retry_control;
+            transport_instance->option_retry_policy = retryPolicy;
+            transport_instance->option_retry_timeout_limit_in_secs = retryTimeoutLimitInSeconds;
 
             retry_control_destroy(previous_retry_control);
 
-            LogInfo("Retry policy set (%d, timeout = %d)", retryPolicy, retryTimeoutLimitInSeconds);
-
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_128: [If no errors occur, `IoTHubTransport_AMQP_Common_SetRetryPolicy` shall return zero.]
             result = RESULT_OK;
+
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_171: [`registered_device->retry_control` of each registered device shall be replaced using retry_control_create(), passing `retryPolicy` and `retryTimeoutLimitInSeconds`.]
+            list_item = singlylinkedlist_get_head_item(transport_instance->registered_devices);
+
+            while (list_item != NULL)
+            {
+                AMQP_TRANSPORT_DEVICE_INSTANCE* registered_device = (AMQP_TRANSPORT_DEVICE_INSTANCE*)singlylinkedlist_item_get_value(list_item);
+
+                if (registered_device == NULL)
+                {
+                    LogError("Cannot set retry policy on device (singlylinkedlist_item_get_value failed)");
+                    result = __FAILURE__;
+                }
+                else if ((new_retry_control = retry_control_create(retryPolicy, (unsigned int)retryTimeoutLimitInSeconds)) == NULL)
+                {
+                    // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_172: [If retry_control_create() fails for a registered device, the device shall keep its previous retry control and `IoTHubTransport_AMQP_Common_SetRetryPolicy` shall return non-zero.]
+                    LogError("Cannot set retry policy on device '%s' (retry_control_create failed)", STRING_c_str(registered_device->device_id));
+                    result = __FAILURE__;
+                }
+                else
+                {
+                    retry_control_destroy(registered_device->retry_control);
+                    registered_device->retry_control = new_retry_control;
+                    registered_device->is_retry_expired = false;
+                }
+
+                list_item = singlylinkedlist_get_next_item(list_item);
+            }
+
+            LogInfo("Retry policy set (%d, timeout = %d)", retryPolicy, retryTimeoutLimitInSeconds);
         }
     }
 
@@ -2371,34 +2602,25 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_AMQP_Common_SendMessageDisposition(MESSAGE_
         }
         else
         {
-            DEVICE_MESSAGE_DISPOSITION_INFO* device_message_disposition_info;
+            DEVICE_MESSAGE_DISPOSITION_INFO device_message_disposition_info;
 
             /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_004: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall convert the given IOTHUBMESSAGE_DISPOSITION_RESULT to the equivalent AMQP_VALUE and will return the result of calling messagereceiver_send_message_disposition. ] */
             DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result = get_device_disposition_result_from(disposition);
 
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_112: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `link_name` and `message_id` contained in `message_data`]  
-            if ((device_message_disposition_info = create_device_message_disposition_info_from(message_data)) == NULL)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_112: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be populated with the `link_name` and `message_id` contained in `message_data`, without copying `link_name`]  
+            device_message_disposition_info.message_id = message_data->transportContext->message_id;
+            device_message_disposition_info.source = message_data->transportContext->link_name;
+
+            /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_003: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR if the POST message fails, otherwise return IOTHUB_CLIENT_OK.] */
+            if (device_send_message_disposition(message_data->transportContext->device_state->device_handle, &device_message_disposition_info, device_disposition_result) != RESULT_OK)
             {
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_113: [If the DEVICE_MESSAGE_DISPOSITION_INFO fails to be created, `IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall fail and return IOTHUB_CLIENT_ERROR]
-                LogError("Device '%s' failed sending message disposition (failed creating DEVICE_MESSAGE_DISPOSITION_RESULT)", STRING_c_str(message_data->transportContext->device_state->device_id));
+                LogError("Device '%s' failed sending message disposition (device_send_message_disposition failed)", STRING_c_str(message_data->transportContext->device_state->device_id));
                 result = IOTHUB_CLIENT_ERROR;
             }
             else
             {
-                /* Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_003: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR if the POST message fails, otherwise return IOTHUB_CLIENT_OK.] */
-                if (device_send_message_disposition(message_data->transportContext->device_state->device_handle, device_message_disposition_info, device_disposition_result) != RESULT_OK)
-                {
-                    LogError("Device '%s' failed sending message disposition (device_send_message_disposition failed)", STRING_c_str(message_data->transportContext->device_state->device_id));
-                    result = IOTHUB_CLIENT_ERROR;
-                }
-                else
-                {
-                    IoTHubMessage_Destroy(message_data->messageHandle);
-                    result = IOTHUB_CLIENT_OK;
-                }
-
-                // Codes_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_114: [`IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall destroy the DEVICE_MESSAGE_DISPOSITION_INFO instance]  
-                destroy_device_message_disposition_info(device_message_disposition_info);
+                IoTHubMessage_Destroy(message_data->messageHandle);
+                result = IOTHUB_CLIENT_OK;
             }
         }
 
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <limits.h>
+#include <stdint.h>
 #include "iothubtransport_amqp_connection.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/gballoc.h"
@@ -34,6 +35,8 @@ typedef struct AMQP_CONNECTION_INSTANCE_TAG
     ON_AMQP_CONNECTION_STATE_CHANGED on_state_changed_callback;
     const void* on_state_changed_context;
     uint32_t c2d_keep_alive_freq_secs;
+    uint32_t session_incoming_window;
+    uint32_t session_outgoing_window;
 } AMQP_CONNECTION_INSTANCE;
 
 
@@ -219,6 +222,28 @@ static int create_connection_handle(AMQP_CONNECTION_INSTANCE* instance)
     return result;
 }
 
+static uint32_t get_session_window_size(size_t configured_size, uint32_t default_size)
+{
+    uint32_t result;
+
+    if (configured_size == 0)
+    {
+        result = default_size;
+    }
+#if SIZE_MAX > UINT32_MAX
+    else if (configured_size > UINT32_MAX)
+    {
+        result = UINT32_MAX;
+    }
+#endif
+    else
+    {
+        result = (uint32_t)configured_size;
+    }
+
+    return result;
+}
+
 static int create_session_handle(AMQP_CONNECTION_INSTANCE* instance)
 {
     int result;
@@ -232,14 +257,14 @@ static int create_session_handle(AMQP_CONNECTION_INSTANCE* instance)
     }
     else
     {
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_026: [The `instance->session_handle` incoming window size shall be set as UINT_MAX using session_set_incoming_window()]
-        if (session_set_incoming_window(instance->session_handle, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE) != 0)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_026: [The `instance->session_handle` incoming window size shall be set as `instance->session_incoming_window` using session_set_incoming_window()]
+        if (session_set_incoming_window(instance->session_handle, instance->session_incoming_window) != 0)
         {
             LogError("Failed to set the AMQP session incoming window size.");
         }
 
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_027: [The `instance->session_handle` outgoing window size shall be set as 100 using session_set_outgoing_window()]
-        if (session_set_outgoing_window(instance->session_handle, DEFAULT_OUTGOING_WINDOW_SIZE) != 0)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_027: [The `instance->session_handle` outgoing window size shall be set as `instance->session_outgoing_window` using session_set_outgoing_window()]
+        if (session_set_outgoing_window(instance->session_handle, instance->session_outgoing_window) != 0)
         {
             LogError("Failed to set the AMQP session outgoing window size.");
         }
@@ -384,6 +409,11 @@ AMQP_CONNECTION_HANDLE amqp_connection_create(AMQP_CONNECTION_CONFIG* config)
 
                 instance->c2d_keep_alive_freq_secs = (uint32_t)config->c2d_keep_alive_freq_secs;
 
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_075: [`config->session_incoming_window` shall be saved on `instance->session_incoming_window`, or UINT_MAX if zero]
+                instance->session_incoming_window = get_session_window_size(config->session_incoming_window, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE);
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_076: [`config->session_outgoing_window` shall be saved on `instance->session_outgoing_window`, or 100 if zero]
+                instance->session_outgoing_window = get_session_window_size(config->session_outgoing_window, DEFAULT_OUTGOING_WINDOW_SIZE);
+
                 instance->current_state = AMQP_CONNECTION_STATE_CLOSED;
 
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_011: [If `config->create_sasl_io` is true or `config->create_cbs_connection` is true, amqp_connection_create() shall create SASL I/O]
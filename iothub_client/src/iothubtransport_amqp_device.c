@@ -320,62 +320,6 @@ static void on_twin_messenger_state_changed_callback(void* context, TWIN_MESSENG
 
 //---------- Message Dispostion ----------//
 
-static DEVICE_MESSAGE_DISPOSITION_INFO* create_device_message_disposition_info_from(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info)
-{
-    DEVICE_MESSAGE_DISPOSITION_INFO* device_disposition_info;
-
-    if ((device_disposition_info = (DEVICE_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO))) == NULL)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (malloc failed)");
-    }
-    else if (mallocAndStrcpy_s(&device_disposition_info->source, messenger_disposition_info->source) != RESULT_OK)
-    {
-        LogError("Failed creating DEVICE_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
-        free(device_disposition_info);
-        device_disposition_info = NULL;
-    }
-    else
-    {
-        device_disposition_info->message_id = messenger_disposition_info->message_id;
-    }
-
-    return device_disposition_info;
-}
-
-static void destroy_device_disposition_info(DEVICE_MESSAGE_DISPOSITION_INFO* disposition_info)
-{
-    free(disposition_info->source);
-    free(disposition_info);
-}
-
-static TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* create_messenger_disposition_info(DEVICE_MESSAGE_DISPOSITION_INFO* device_disposition_info)
-{
-    TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info;
-
-    if ((messenger_disposition_info = (TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO))) == NULL)
-    {
-        LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (malloc failed)");
-    }
-    else if (mallocAndStrcpy_s(&messenger_disposition_info->source, device_disposition_info->source) != RESULT_OK)
-    {
-        LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (mallocAndStrcpy_s failed)");
-        free(messenger_disposition_info);
-        messenger_disposition_info = NULL;
-    }
-    else
-    {
-        messenger_disposition_info->message_id = device_disposition_info->message_id;
-    }
-
-    return messenger_disposition_info;
-}
-
-static void destroy_messenger_disposition_info(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info)
-{
-    free(messenger_disposition_info->source);
-    free(messenger_disposition_info);
-}
-
 static TELEMETRY_MESSENGER_DISPOSITION_RESULT get_messenger_message_disposition_result_from(DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result)
 {
     TELEMETRY_MESSENGER_DISPOSITION_RESULT messenger_disposition_result;
@@ -424,28 +368,20 @@ static TELEMETRY_MESSENGER_DISPOSITION_RESULT on_messenger_message_received_call
         }
         else
         {
-            DEVICE_MESSAGE_DISPOSITION_INFO* device_message_disposition_info;
+            DEVICE_MESSAGE_DISPOSITION_INFO device_message_disposition_info;
+            DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result;
 
-            // Codes_SRS_DEVICE_09_119: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created containing a copy of `disposition_info->source` and `disposition_info->message_id`]
-            if ((device_message_disposition_info = create_device_message_disposition_info_from(disposition_info)) == NULL)
-            {
-                // Codes_SRS_DEVICE_09_120: [If the DEVICE_MESSAGE_DISPOSITION_INFO instance fails to be created, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-                LogError("Device '%s' failed receiving incoming C2D message (failed creating DEVICE_MESSAGE_DISPOSITION_INFO)", device_instance->config->device_id);
-                msgr_disposition_result = TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED;
-            }
-            else
-            {
-                // Codes_SRS_DEVICE_09_071: [The user callback shall be invoked, passing the context it provided]
-                DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result = device_instance->on_message_received_callback(iothub_message_handle, device_message_disposition_info, device_instance->on_message_received_context);
+            // Codes_SRS_DEVICE_09_119: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be populated with `disposition_info->source` and `disposition_info->message_id`, without copying `source`]
+            device_message_disposition_info.message_id = disposition_info->message_id;
+            device_message_disposition_info.source = disposition_info->source;
 
-                // Codes_SRS_DEVICE_09_072: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED]
-                // Codes_SRS_DEVICE_09_073: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_REJECTED]
-                // Codes_SRS_DEVICE_09_074: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-                msgr_disposition_result = get_messenger_message_disposition_result_from(device_disposition_result);
+            // Codes_SRS_DEVICE_09_071: [The user callback shall be invoked, passing the context it provided]
+            device_disposition_result = device_instance->on_message_received_callback(iothub_message_handle, &device_message_disposition_info, device_instance->on_message_received_context);
 
-                // Codes_SRS_DEVICE_09_121: [on_messenger_message_received_callback shall release the memory allocated for DEVICE_MESSAGE_DISPOSITION_INFO]
-                destroy_device_disposition_info(device_message_disposition_info);
-            }
+            // Codes_SRS_DEVICE_09_072: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED]
+            // Codes_SRS_DEVICE_09_073: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_REJECTED]
+            // Codes_SRS_DEVICE_09_074: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
+            msgr_disposition_result = get_messenger_message_disposition_result_from(device_disposition_result);
         }
     }
 
@@ -616,6 +552,38 @@ static int create_twin_messenger(DEVICE_INSTANCE* instance)
 
 // ---------- Set/Retrieve Options Helpers ----------//
 
+// @brief
+//     Translates the device options that apply to the telemetry messenger into the names supported by iothubtransport_amqp_telemetry_messenger.
+// @returns
+//     The messenger option name, or NULL if `device_option_name` does not refer to the telemetry messenger.
+static const char* get_telemetry_messenger_option_name_from(const char* device_option_name)
+{
+    const char* messenger_option_name;
+
+    if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, device_option_name) == 0)
+    {
+        messenger_option_name = MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS;
+    }
+    else if (strcmp(DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE, device_option_name) == 0)
+    {
+        messenger_option_name = MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE;
+    }
+    else if (strcmp(DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, device_option_name) == 0)
+    {
+        messenger_option_name = MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS;
+    }
+    else if (strcmp(DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, device_option_name) == 0)
+    {
+        messenger_option_name = MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT;
+    }
+    else
+    {
+        messenger_option_name = NULL;
+    }
+
+    return messenger_option_name;
+}
+
 static void* device_clone_option(const char* name, const void* value)
 {
     void* result;
@@ -1307,34 +1275,25 @@ int device_send_message_disposition(DEVICE_HANDLE device_handle, DEVICE_MESSAGE_
     else
     {
         DEVICE_INSTANCE* device = (DEVICE_INSTANCE*)device_handle;
-        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* messenger_disposition_info;
+        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO messenger_disposition_info;
+        TELEMETRY_MESSENGER_DISPOSITION_RESULT messenger_disposition_result;
+
+        // Codes_SRS_DEVICE_09_113: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be populated with the `source` and `message_id` contained in `disposition_info`, without copying `source`]  
+        messenger_disposition_info.message_id = (delivery_number)disposition_info->message_id;
+        messenger_disposition_info.source = disposition_info->source;
+        messenger_disposition_result = get_messenger_message_disposition_result_from(disposition_result);
 
-        // Codes_SRS_DEVICE_09_113: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `source` and `message_id` contained in `disposition_info`]  
-        if ((messenger_disposition_info = create_messenger_disposition_info(disposition_info)) == NULL)
+        // Codes_SRS_DEVICE_09_115: [`telemetry_messenger_send_message_disposition()` shall be invoked passing the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance and the corresponding TELEMETRY_MESSENGER_DISPOSITION_RESULT]  
+        if (telemetry_messenger_send_message_disposition(device->messenger_handle, &messenger_disposition_info, messenger_disposition_result) != RESULT_OK)
         {
-            // Codes_SRS_DEVICE_09_114: [If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO fails to be created, device_send_message_disposition() shall fail and return __FAILURE__]  
-            LogError("Failed sending message disposition (failed to create TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)");
+            // Codes_SRS_DEVICE_09_116: [If `telemetry_messenger_send_message_disposition()` fails, device_send_message_disposition() shall fail and return __FAILURE__]  
+            LogError("Failed sending message disposition (telemetry_messenger_send_message_disposition failed)");
             result = __FAILURE__;
         }
         else
         {
-            TELEMETRY_MESSENGER_DISPOSITION_RESULT messenger_disposition_result = get_messenger_message_disposition_result_from(disposition_result);
-
-            // Codes_SRS_DEVICE_09_115: [`telemetry_messenger_send_message_disposition()` shall be invoked passing the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance and the corresponding TELEMETRY_MESSENGER_DISPOSITION_RESULT]  
-            if (telemetry_messenger_send_message_disposition(device->messenger_handle, messenger_disposition_info, messenger_disposition_result) != RESULT_OK)
-            {
-                // Codes_SRS_DEVICE_09_116: [If `telemetry_messenger_send_message_disposition()` fails, device_send_message_disposition() shall fail and return __FAILURE__]  
-                LogError("Failed sending message disposition (telemetry_messenger_send_message_disposition failed)");
-                result = __FAILURE__;
-            }
-            else
-            {
-                // Codes_SRS_DEVICE_09_118: [If no failures occurr, device_send_message_disposition() shall return 0]  
-                result = RESULT_OK;
-            }
-
-            // Codes_SRS_DEVICE_09_117: [device_send_message_disposition() shall destroy the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance]  
-            destroy_messenger_disposition_info(messenger_disposition_info);
+            // Codes_SRS_DEVICE_09_118: [If no failures occurr, device_send_message_disposition() shall return 0]  
+            result = RESULT_OK;
         }
     }
 
@@ -1377,6 +1336,7 @@ int device_set_option(DEVICE_HANDLE handle, const char* name, void* value)
     else
     {
         DEVICE_INSTANCE* instance = (DEVICE_INSTANCE*)handle;
+        const char* messenger_option_name;
 
         if (strcmp(DEVICE_OPTION_CBS_REQUEST_TIMEOUT_SECS, name) == 0 ||
             strcmp(DEVICE_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, name) == 0 ||
@@ -1400,10 +1360,11 @@ int device_set_option(DEVICE_HANDLE handle, const char* name, void* value)
                 result = RESULT_OK;
             }
         }
-        else if (strcmp(DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0)
+        else if ((messenger_option_name = get_telemetry_messenger_option_name_from(name)) != NULL)
         {
             // Codes_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to telemetry_messenger_set_option]
-            if (telemetry_messenger_set_option(instance->messenger_handle, MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, value) != RESULT_OK)
+            // Codes_SRS_DEVICE_09_152: [`name` shall be translated to the corresponding MESSENGER_OPTION_* name before being passed to telemetry_messenger_set_option]
+            if (telemetry_messenger_set_option(instance->messenger_handle, messenger_option_name, value) != RESULT_OK)
             {
                 // Codes_SRS_DEVICE_09_087: [If telemetry_messenger_set_option fails, device_set_option shall return a non-zero result]
                 LogError("failed setting option for device '%s' (failed setting messenger option '%s')", instance->config->device_id, name);
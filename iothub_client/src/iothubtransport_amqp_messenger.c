@@ -35,6 +35,8 @@ DEFINE_ENUM_STRINGS(AMQP_MESSENGER_STATE, AMQP_MESSENGER_STATE_VALUES);
 #define MESSAGE_RECEIVER_MAX_LINK_SIZE                  65536
 #define DEFAULT_EVENT_SEND_RETRY_LIMIT                  0
 #define DEFAULT_EVENT_SEND_TIMEOUT_SECS                 600
+#define DEFAULT_EVENT_SEND_RETRY_INITIAL_WAIT_SECS      1
+#define DEFAULT_EVENT_SEND_RETRY_MAX_JITTER_PERCENT     50
 #define DEFAULT_MAX_SEND_ERROR_COUNT                    10
 #define MAX_MESSAGE_SENDER_STATE_CHANGE_TIMEOUT_SECS    300
 #define MAX_MESSAGE_RECEIVER_STATE_CHANGE_TIMEOUT_SECS  300
@@ -76,6 +78,8 @@ typedef struct MESSAGE_SEND_CONTEXT_TAG
 {
 	MESSAGE_HANDLE message;
 	bool is_destroyed;
+	bool is_in_flight;
+	bool is_abandoned;
 
 	AMQP_MESSENGER_INSTANCE* messenger;
 
@@ -83,6 +87,7 @@ typedef struct MESSAGE_SEND_CONTEXT_TAG
 	void* user_context;
 
 	PROCESS_MESSAGE_COMPLETED_CALLBACK on_process_message_completed_callback;
+	MQ_ITEM_HANDLE mq_item;
 } MESSAGE_SEND_CONTEXT;
 
 
@@ -869,6 +874,9 @@ static void on_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_re
 	{
 		MESSAGE_QUEUE_RESULT mq_result;
 		MESSAGE_SEND_CONTEXT* msg_ctx = (MESSAGE_SEND_CONTEXT*)context;
+		bool is_abandoned = msg_ctx->is_abandoned;
+
+		msg_ctx->is_in_flight = false;
 
 		if (send_result == MESSAGE_SEND_OK)
 		{
@@ -881,7 +889,13 @@ static void on_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_re
 			mq_result = MESSAGE_QUEUE_ERROR;
 		}
 
-		msg_ctx->on_process_message_completed_callback(msg_ctx->messenger->send_queue, (MQ_MESSAGE_HANDLE)msg_ctx->message, mq_result, NULL);
+		msg_ctx->on_process_message_completed_callback(msg_ctx->messenger->send_queue, msg_ctx->mq_item, mq_result, NULL);
+
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_141: [If `context` was abandoned by `instance->send_queue` while in flight, it shall be destroyed]
+		if (is_abandoned)
+		{
+			destroy_message_send_context(msg_ctx);
+		}
 	}
 }
 
@@ -896,13 +910,15 @@ static void on_process_message_callback(MESSAGE_QUEUE_HANDLE message_queue, MQ_M
 	{
 		MESSAGE_SEND_CONTEXT* message_context = (MESSAGE_SEND_CONTEXT*)context;
 		message_context->on_process_message_completed_callback = on_process_message_completed_callback;
+		message_context->is_in_flight = true;
 
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_118: [The MESSAGE_HANDLE shall be submitted for sending using messagesender_send(), passing `on_send_complete_callback`]
 		if (messagesender_send(message_context->messenger->message_sender, (MESSAGE_HANDLE)message, on_send_complete_callback, context) != 0)
 		{
 			// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_119: [If messagesender_send() fails, `on_process_message_completed_callback` shall be invoked with result MESSAGE_QUEUE_ERROR]  
 			LogError("Failed sending AMQP message");
-			on_process_message_completed_callback(message_queue, message, MESSAGE_QUEUE_ERROR, NULL);
+			message_context->is_in_flight = false;
+			on_process_message_completed_callback(message_queue, message_context->mq_item, MESSAGE_QUEUE_ERROR, NULL);
 		}
 
 		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_120: [The MESSAGE_HANDLE shall be destroyed using message_destroy() and marked as destroyed in the context provided]  
@@ -974,8 +990,16 @@ static void on_message_processing_completed_callback(MQ_MESSAGE_HANDLE message,
 			message_destroy((MESSAGE_HANDLE)message);
 		}
 
-		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_028: [`send_ctx` shall be destroyed]
-		destroy_message_send_context(msg_ctx);
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_140: [If `send_ctx` is still in flight (i.e., `on_send_complete_callback` has not been invoked for it yet), it shall be marked as abandoned instead of destroyed]
+		if (msg_ctx->is_in_flight)
+		{
+			msg_ctx->is_abandoned = true;
+		}
+		// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_028: [Otherwise `send_ctx` shall be destroyed]
+		else
+		{
+			destroy_message_send_context(msg_ctx);
+		}
 	}
 }
 
@@ -1187,8 +1211,8 @@ int amqp_messenger_send_async(AMQP_MESSENGER_HANDLE messenger_handle, MESSAGE_HA
 				message_context->on_send_complete_callback = on_user_defined_send_complete_callback;
 				message_context->user_context = user_context;
 
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_016: [`send_ctx` shall be added to `instance->send_queue` using message_queue_add(), passing `on_message_processing_completed_callback`]  
-				if (message_queue_add(instance->send_queue, (MQ_MESSAGE_HANDLE)cloned_message, on_message_processing_completed_callback, (void*)message_context) != RESULT_OK)
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_016: [`send_ctx` shall be added to `instance->send_queue` using message_queue_add(), passing `on_message_processing_completed_callback` and `send_ctx->mq_item` to receive the queue item handle]  
+				if (message_queue_add(instance->send_queue, (MQ_MESSAGE_HANDLE)cloned_message, on_message_processing_completed_callback, (void*)message_context, &message_context->mq_item) != RESULT_OK)
 				{
 					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_017: [If message_queue_add() fails, amqp_messenger_send_async() shall fail and return a non-zero value]
 					LogError("Failed adding message to send queue");
@@ -1543,9 +1567,12 @@ AMQP_MESSENGER_HANDLE amqp_messenger_create(const AMQP_MESSENGER_CONFIG* messeng
 				mq_config.max_retry_count = DEFAULT_EVENT_SEND_RETRY_LIMIT;
 				mq_config.max_message_enqueued_time_secs = DEFAULT_EVENT_SEND_TIMEOUT_SECS;
 				mq_config.max_message_processing_time_secs = 0;
+				mq_config.retry_policy = IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER;
+				mq_config.initial_retry_wait_time_secs = DEFAULT_EVENT_SEND_RETRY_INITIAL_WAIT_SECS;
+				mq_config.max_retry_jitter_percent = DEFAULT_EVENT_SEND_RETRY_MAX_JITTER_PERCENT;
 				mq_config.on_process_message_callback = on_process_message_callback;
 
-				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_007: [`instance->send_queue` shall be set using message_queue_create(), passing `on_process_message_callback`]  
+				// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_007: [`instance->send_queue` shall be set using message_queue_create(), passing `on_process_message_callback` and an exponential backoff with jitter for retries]  
 				if ((instance->send_queue = message_queue_create(&mq_config)) == NULL)
 				{
 					// Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_008: [If message_queue_create() fails, amqp_messenger_create() shall fail and return NULL]  
@@ -7,6 +7,7 @@
 #include "azure_c_shared_utility/crt_abstractions.h"
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h" 
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/singlylinkedlist.h"
@@ -37,6 +38,14 @@
 #define STRING_NULL_TERMINATOR                          '\0'
 
 #define AMQP_BATCHING_FORMAT_CODE 0x80013700
+
+typedef struct SEND_PENDING_EVENTS_STATE_TAG
+{
+    struct MESSENGER_SEND_EVENT_TASK_TAG* task;
+    MESSAGE_HANDLE message_batch_container;
+    uint64_t bytes_pending;
+    tickcounter_ms_t creation_time;
+} SEND_PENDING_EVENTS_STATE;
  
 typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
 {
@@ -69,6 +78,14 @@ typedef struct TELEMETRY_MESSENGER_INSTANCE_TAG
     size_t event_send_timeout_secs;
     time_t last_message_sender_state_change_time;
     time_t last_message_receiver_state_change_time;
+
+    size_t event_batch_target_size;                 // 0 means batches are only limited by the link's max message size.
+    size_t event_batch_max_linger_msecs;            // 0 means a partially filled batch is sent on the same do_work.
+    size_t event_batch_max_in_flight;               // 0 means no limit.
+    size_t number_of_batches_in_flight;             // Batches handed to uAMQP that did not complete or time out yet.
+    uint64_t max_batch_size;                        // Cached on the first send after the sender link attaches; 0 until then.
+    TICK_COUNTER_HANDLE tick_counter;               // Only created when event_batch_max_linger_msecs is set.
+    SEND_PENDING_EVENTS_STATE held_batch;           // Batch kept across do_work calls while it lingers or the in-flight cap is reached.
 } TELEMETRY_MESSENGER_INSTANCE;
 
 // MESSENGER_SEND_EVENT_CALLER_INFORMATION corresponds to a message sent from the API, including
@@ -88,6 +105,7 @@ typedef struct MESSENGER_SEND_EVENT_TASK_TAG
     time_t send_time;
     TELEMETRY_MESSENGER_INSTANCE *messenger;
     bool is_timed_out;
+    bool is_in_flight;                      // Counted in messenger->number_of_batches_in_flight
 } MESSENGER_SEND_EVENT_TASK;
 
 
@@ -354,6 +372,9 @@ static void destroy_event_sender(TELEMETRY_MESSENGER_INSTANCE* instance)
         link_destroy(instance->sender_link);
         instance->sender_link = NULL;
     }
+
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_190: [The cached maximum batch size shall be reset, so it is queried again once a new sender link is attached]
+    instance->max_batch_size = 0;
 }
 
 static void on_event_sender_state_changed_callback(void* context, MESSAGE_SENDER_STATE new_state, MESSAGE_SENDER_STATE previous_state)
@@ -542,57 +563,33 @@ static void on_message_receiver_state_changed_callback(const void* context, MESS
     }
 }
 
-static TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* create_message_disposition_info(TELEMETRY_MESSENGER_INSTANCE* messenger)
+static int get_message_disposition_info(TELEMETRY_MESSENGER_INSTANCE* messenger, TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* disposition_info)
 {
-    TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* result;
+    int result;
+    delivery_number message_id;
+    const char* link_name;
 
-    if ((result = (TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO*)malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO))) == NULL)
+    if (messagereceiver_get_received_message_id(messenger->message_receiver, &message_id) != RESULT_OK)
     {
-        LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (malloc failed)");
-        result = NULL;
+        LogError("Failed getting TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (messagereceiver_get_received_message_id failed)");
+        result = __FAILURE__;
+    }
+    else if (messagereceiver_get_link_name(messenger->message_receiver, &link_name) != RESULT_OK)
+    {
+        LogError("Failed getting TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO (messagereceiver_get_link_name failed)");
+        result = __FAILURE__;
     }
     else
     {
-        delivery_number message_id;
-
-        if (messagereceiver_get_received_message_id(messenger->message_receiver, &message_id) != RESULT_OK)
-        {
-            LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_received_message_id failed)");
-            free(result);
-            result = NULL;
-        }
-        else
-        {
-            const char* link_name;
-
-            if (messagereceiver_get_link_name(messenger->message_receiver, &link_name) != RESULT_OK)
-            {
-                LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (messagereceiver_get_link_name failed)");
-                free(result);
-                result = NULL;
-            }
-            else if (mallocAndStrcpy_s(&result->source, link_name) != RESULT_OK)
-            {
-                LogError("Failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO container (failed copying link name)");
-                free(result);
-                result = NULL;
-            }
-            else
-            {
-                result->message_id = message_id;
-            }
-        }
+        // The link name is owned by the receiver link and outlives the on_message_received_callback call, so it is not copied.
+        disposition_info->message_id = message_id;
+        disposition_info->source = link_name;
+        result = RESULT_OK;
     }
 
     return result;
 }
 
-static void destroy_message_disposition_info(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* disposition_info)
-{
-    free(disposition_info->source);
-    free(disposition_info);
-}
-
 static AMQP_VALUE create_uamqp_disposition_result_from(TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result)
 {
     AMQP_VALUE uamqp_disposition_result;
@@ -639,22 +636,19 @@ static AMQP_VALUE on_message_received_internal_callback(const void* context, MES
     else
     {
         TELEMETRY_MESSENGER_INSTANCE* instance = (TELEMETRY_MESSENGER_INSTANCE*)context;
-        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* message_disposition_info;
+        TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO message_disposition_info;
 
-        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created containing the source link name and message delivery ID]
-        if ((message_disposition_info = create_message_disposition_info(instance)) == NULL)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be populated with the source link name and message delivery ID, without copying the link name]
+        if (get_message_disposition_info(instance, &message_disposition_info) != RESULT_OK)
         {
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_187: [**If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance fails to be created, on_message_received_internal_callback shall return messaging_delivery_released()]
-            LogError("on_message_received_internal_callback failed (failed creating TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO).");
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_187: [If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance fails to be populated, on_message_received_internal_callback shall return messaging_delivery_released()]
+            LogError("on_message_received_internal_callback failed (failed getting TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO).");
             result = messaging_delivery_released();
         }
         else
         {
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_123: [`instance->on_message_received_callback` shall be invoked passing the IOTHUB_MESSAGE_HANDLE and TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance]
-            TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result = instance->on_message_received_callback(iothub_message, message_disposition_info, instance->on_message_received_context);
-
-            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_188: [The memory allocated for the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be released]
-            destroy_message_disposition_info(message_disposition_info);
+            TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result = instance->on_message_received_callback(iothub_message, &message_disposition_info, instance->on_message_received_context);
 
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_125: [If `instance->on_message_received_callback` returns TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED, on_message_received_internal_callback shall return the result of messaging_delivery_accepted()]
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_126: [If `instance->on_message_received_callback` returns TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED, on_message_received_internal_callback shall return the result of messaging_delivery_released()]
@@ -1024,12 +1018,28 @@ static void invoke_callback(const void* item, const void* action_context, bool*
     *continue_processing = true;
 }
 
+static void remove_task_from_batches_in_flight(MESSENGER_SEND_EVENT_TASK* task)
+{
+    if (task->is_in_flight)
+    {
+        task->is_in_flight = false;
+
+        if (task->messenger->number_of_batches_in_flight > 0)
+        {
+            task->messenger->number_of_batches_in_flight--;
+        }
+    }
+}
+
 static void internal_on_event_send_complete_callback(void* context, MESSAGE_SEND_RESULT send_result)
 { 
     if (context != NULL)
     {
         MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)context;
 
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_204: [A batch shall no longer be counted as in flight once its send completes or times out]
+        remove_task_from_batches_in_flight(task);
+
         if (task->messenger->message_sender_current_state != MESSAGE_SENDER_STATE_ERROR)
         {
             if (task->is_timed_out == false)
@@ -1086,14 +1096,6 @@ static MESSENGER_SEND_EVENT_CALLER_INFORMATION* get_next_caller_message_to_send(
     return caller_info;
 }
 
-typedef struct SEND_PENDING_EVENTS_STATE_TAG
-{
-    MESSENGER_SEND_EVENT_TASK* task;
-    MESSAGE_HANDLE message_batch_container;
-    uint64_t bytes_pending;
-} SEND_PENDING_EVENTS_STATE;
-
-
 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_191: [Creates an AMQP message, sets it to be batch mode, and creates an associated task for its callbacks.  Errors cause the send events loop to break.]          
 static int create_send_pending_events_state(TELEMETRY_MESSENGER_INSTANCE* instance, SEND_PENDING_EVENTS_STATE *send_pending_events_state)
 {
@@ -1117,6 +1119,13 @@ static int create_send_pending_events_state(TELEMETRY_MESSENGER_INSTANCE* instan
     }
     else
     {
+        if (instance->event_batch_max_linger_msecs > 0 &&
+            tickcounter_get_current_ms(instance->tick_counter, &send_pending_events_state->creation_time) != 0)
+        {
+            LogError("Failed getting the batch creation time; batch will not linger (tickcounter_get_current_ms failed)");
+            send_pending_events_state->creation_time = 0;
+        }
+
         result = RESULT_OK;
     }
 
@@ -1133,9 +1142,14 @@ static int send_batched_message_and_reset_state(TELEMETRY_MESSENGER_INSTANCE* in
 {
     int result;
 
+    // Counted before sending, since uAMQP may complete the send from within messagesender_send
+    send_pending_events_state->task->is_in_flight = true;
+    instance->number_of_batches_in_flight++;
+
     if (messagesender_send(instance->message_sender, send_pending_events_state->message_batch_container, internal_on_event_send_complete_callback, send_pending_events_state->task) != 0)
     {
         LogError("messagesender_send failed");
+        remove_task_from_batches_in_flight(send_pending_events_state->task);
         result = __FAILURE__;
     }
     else
@@ -1169,12 +1183,56 @@ static int get_max_message_size_for_batching(TELEMETRY_MESSENGER_INSTANCE* insta
     else
     {
         *max_messagesize -= AMQP_BATCHING_RESERVE_SIZE;
+
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_191: [If `instance->event_batch_target_size` is set and smaller than the link limit, it shall be used as the maximum batch size instead]
+        if (instance->event_batch_target_size > 0 && instance->event_batch_target_size < *max_messagesize)
+        {
+            *max_messagesize = instance->event_batch_target_size;
+        }
+
         result = 0;
     }
 
     return result;
 }
 
+static bool is_max_batches_in_flight_reached(TELEMETRY_MESSENGER_INSTANCE* instance)
+{
+    return (instance->event_batch_max_in_flight > 0 && instance->number_of_batches_in_flight >= instance->event_batch_max_in_flight);
+}
+
+// @brief
+//     Decides if a partially filled batch shall be sent now or held for the next do_work.
+static bool should_hold_batch(TELEMETRY_MESSENGER_INSTANCE* instance, SEND_PENDING_EVENTS_STATE* send_pending_events_state)
+{
+    bool result;
+
+    if (is_max_batches_in_flight_reached(instance))
+    {
+        result = true;
+    }
+    else if (instance->event_batch_max_linger_msecs == 0)
+    {
+        result = false;
+    }
+    else
+    {
+        tickcounter_ms_t current_time;
+
+        if (tickcounter_get_current_ms(instance->tick_counter, &current_time) != 0)
+        {
+            LogError("Failed getting the current time; batch will be sent without lingering (tickcounter_get_current_ms failed)");
+            result = false;
+        }
+        else
+        {
+            result = ((current_time - send_pending_events_state->creation_time) < instance->event_batch_max_linger_msecs);
+        }
+    }
+
+    return result;
+}
+
 static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
 {
     int result = RESULT_OK;
@@ -1182,16 +1240,19 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
     MESSENGER_SEND_EVENT_CALLER_INFORMATION* caller_info;
     BINARY_DATA body_binary_data;
 
-    SEND_PENDING_EVENTS_STATE send_pending_events_state;
-    memset(&send_pending_events_state, 0, sizeof(send_pending_events_state));
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_192: [A batch held by a previous call shall be resumed, so pending messages are appended to it]
+    SEND_PENDING_EVENTS_STATE send_pending_events_state = instance->held_batch;
+    memset(&instance->held_batch, 0, sizeof(instance->held_batch));
     memset(&body_binary_data, 0, sizeof(body_binary_data));
 
-    uint64_t max_messagesize = 0;
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_202: [The maximum batch size shall be queried from the sender link only once per link attach]
+    uint64_t max_messagesize = instance->max_batch_size;
 
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_192: [Enumerate through all messages waiting to send, building up AMQP message to send and sending when size will be greater than link max size.]
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_198: [While processing pending messages, errors shall result in user callback being invoked.]    
     // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_31_199: [Errors specific to a message (e.g. failure to encode) are NOT fatal but we'll keep processing.  More general errors (e.g. out of memory) will stop processing.]
-    while ((caller_info = get_next_caller_message_to_send(instance)) != NULL)
+    // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_193: [If `instance->event_batch_max_in_flight` batches are already in flight, no more messages shall be taken from `instance->wait_to_send_list`]
+    while (!is_max_batches_in_flight_reached(instance) && (caller_info = get_next_caller_message_to_send(instance)) != NULL)
     {
         if (body_binary_data.bytes != NULL)
         {
@@ -1205,6 +1266,7 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
             LogError("get_max_message_size_for_batching failed");
             invoke_callback_on_error(caller_info, TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_FAIL_SENDING);
             free(caller_info);
+            max_messagesize = 0;
             result = __FAILURE__;
             break;
         }
@@ -1277,9 +1339,17 @@ static int send_pending_events(TELEMETRY_MESSENGER_INSTANCE* instance)
         send_pending_events_state.bytes_pending += body_binary_data.length;
     }
 
+    instance->max_batch_size = max_messagesize;
+
     if ((result == 0) && (send_pending_events_state.bytes_pending != 0))
     {
-        if (send_batched_message_and_reset_state(instance, &send_pending_events_state) != RESULT_OK)
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_194: [If the last batch was created less than `instance->event_batch_max_linger_msecs` ago, or `instance->event_batch_max_in_flight` batches are in flight, it shall be held for the next call instead of sent]
+        if (should_hold_batch(instance, &send_pending_events_state))
+        {
+            instance->held_batch = send_pending_events_state;
+            memset(&send_pending_events_state, 0, sizeof(send_pending_events_state));
+        }
+        else if (send_batched_message_and_reset_state(instance, &send_pending_events_state) != RESULT_OK)
         {
             LogError("send_batched_message_and_reset_state failed");
             result = __FAILURE__;
@@ -1325,7 +1395,8 @@ static int process_event_send_timeouts(TELEMETRY_MESSENGER_INSTANCE* instance)
         {
             MESSENGER_SEND_EVENT_TASK* task = (MESSENGER_SEND_EVENT_TASK*)singlylinkedlist_item_get_value(list_item);
 
-            if (task->is_timed_out == false)
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_195: [The batch held for lingering shall not be checked for timeout, since it has not been sent yet]
+            if (task->is_timed_out == false && task != instance->held_batch.task)
             {
                 int is_timed_out;
 
@@ -1334,6 +1405,8 @@ static int process_event_send_timeouts(TELEMETRY_MESSENGER_INSTANCE* instance)
                     if (is_timed_out)
                     {
                         task->is_timed_out = true;
+                        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_204: [A batch shall no longer be counted as in flight once its send completes or times out]
+                        remove_task_from_batches_in_flight(task);
                         singlylinkedlist_foreach(task->callback_list, invoke_callback, (void*)TELEMETRY_MESSENGER_EVENT_SEND_COMPLETE_RESULT_ERROR_TIMEOUT);
                     }
                 }
@@ -1392,6 +1465,9 @@ static void* telemetry_messenger_clone_option(const char* name, const void* valu
     else
     {
         if (strcmp(MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, name) == 0 ||
+            strcmp(MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, name) == 0 ||
+            strcmp(MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, name) == 0 ||
+            strcmp(MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, name) == 0 ||
             strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
             result = (void*)value;
@@ -1741,6 +1817,13 @@ int telemetry_messenger_stop(TELEMETRY_MESSENGER_HANDLE messenger_handle)
 
             remove_timed_out_events(instance);
 
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_196: [A batch held for lingering shall be destroyed; its events are moved back to `instance->wait_to_send_list` along with the other events in progress]
+            if (instance->held_batch.message_batch_container != NULL)
+            {
+                message_destroy(instance->held_batch.message_batch_container);
+                memset(&instance->held_batch, 0, sizeof(instance->held_batch));
+            }
+
             // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_162: [telemetry_messenger_stop() shall move all items from `instance->in_progress_list` to the beginning of `instance->wait_to_send_list`]
             if (move_events_to_wait_to_send_list(instance) != RESULT_OK)
             {
@@ -1753,6 +1836,9 @@ int telemetry_messenger_stop(TELEMETRY_MESSENGER_HANDLE messenger_handle)
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_164: [If all items get successfuly moved back to `instance->wait_to_send_list`, `instance->state` shall be set to TELEMETRY_MESSENGER_STATE_STOPPED, and `instance->on_state_changed_callback` invoked]
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_203: [Once the events in progress are moved back to `instance->wait_to_send_list`, no batches shall be counted as in flight]
+                instance->number_of_batches_in_flight = 0;
+
                 update_messenger_state(instance, TELEMETRY_MESSENGER_STATE_STOPPED);
                 result = RESULT_OK;
             }
@@ -1959,6 +2045,11 @@ void telemetry_messenger_destroy(TELEMETRY_MESSENGER_HANDLE messenger_handle)
 
         STRING_delete(instance->product_info);
 
+        if (instance->tick_counter != NULL)
+        {
+            tickcounter_destroy(instance->tick_counter);
+        }
+
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_114: [telemetry_messenger_destroy() shall destroy `instance` with free()]
         (void)free(instance);
     }
@@ -2086,6 +2177,36 @@ int telemetry_messenger_set_option(TELEMETRY_MESSENGER_HANDLE messenger_handle,
             instance->event_send_timeout_secs = *((size_t*)value);
             result = RESULT_OK;
         }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_197: [If name matches MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, `value` shall be saved on `instance->event_batch_target_size` and the cached maximum batch size reset]
+        else if (strcmp(MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, name) == 0)
+        {
+            instance->event_batch_target_size = *((size_t*)value);
+            instance->max_batch_size = 0;
+            result = RESULT_OK;
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_198: [If name matches MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, `value` shall be saved on `instance->event_batch_max_linger_msecs`]
+        else if (strcmp(MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, name) == 0)
+        {
+            // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_199: [If `value` is not zero and `instance->tick_counter` is NULL, it shall be created using tickcounter_create()]
+            if (*((size_t*)value) > 0 && instance->tick_counter == NULL &&
+                (instance->tick_counter = tickcounter_create()) == NULL)
+            {
+                // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_200: [If tickcounter_create() fails, telemetry_messenger_set_option shall fail and return a non-zero value]
+                LogError("telemetry_messenger_set_option failed (tickcounter_create failed)");
+                result = __FAILURE__;
+            }
+            else
+            {
+                instance->event_batch_max_linger_msecs = *((size_t*)value);
+                result = RESULT_OK;
+            }
+        }
+        // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_201: [If name matches MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, `value` shall be saved on `instance->event_batch_max_in_flight`]
+        else if (strcmp(MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, name) == 0)
+        {
+            instance->event_batch_max_in_flight = *((size_t*)value);
+            result = RESULT_OK;
+        }
         // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
         else if (strcmp(MESSENGER_OPTION_SAVED_OPTIONS, name) == 0)
         {
@@ -2144,6 +2265,21 @@ OPTIONHANDLER_HANDLE telemetry_messenger_retrieve_options(TELEMETRY_MESSENGER_HA
                 LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS);
                 result = NULL;
             }
+            else if (OptionHandler_AddOption(options, MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, (void*)&instance->event_batch_target_size) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE);
+                result = NULL;
+            }
+            else if (OptionHandler_AddOption(options, MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, (void*)&instance->event_batch_max_linger_msecs) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS);
+                result = NULL;
+            }
+            else if (OptionHandler_AddOption(options, MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, (void*)&instance->event_batch_max_in_flight) != OPTIONHANDLER_OK)
+            {
+                LogError("Failed to retrieve options from messenger instance (OptionHandler_Create failed for option '%s')", MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT);
+                result = NULL;
+            }
             else
             {
                 // Codes_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_179: [If no failures occur, telemetry_messenger_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
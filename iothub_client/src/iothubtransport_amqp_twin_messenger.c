@@ -13,6 +13,7 @@
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_uamqp_c/messaging.h"
 #include "iothub_client_private.h"
+#include "hash_index.h"
 #include "iothubtransport_amqp_messenger.h"
 #include "iothubtransport_amqp_twin_messenger.h"
 
@@ -43,6 +44,9 @@ DEFINE_ENUM_STRINGS(TWIN_UPDATE_TYPE, TWIN_UPDATE_TYPE_VALUES);
 #define TWIN_CORRELATION_ID_PROPERTY_NAME				"com.microsoft:channel-correlation-id"
 #define TWIN_API_VERSION_PROPERTY_NAME					"com.microsoft:api-version"
 #define TWIN_CORRELATION_ID_PROPERTY_FORMAT				"twin:%s"
+#define TWIN_CORRELATION_ID_PREFIX_LENGTH				8
+#define TWIN_OPERATION_CORRELATION_ID_FORMAT			"%s:%lx"
+#define TWIN_OPERATION_CORRELATION_ID_MAX_LENGTH		(TWIN_CORRELATION_ID_PREFIX_LENGTH + 1 + sizeof(unsigned long) * 2 + 1)
 #define TWIN_API_VERSION_NUMBER							"2016-11-14"
 
 #define DEFAULT_MAX_TWIN_SUBSCRIPTION_ERROR_COUNT		3
@@ -88,6 +92,9 @@ typedef struct TWIN_MESSENGER_INSTANCE_TAG
 
 	SINGLYLINKEDLIST_HANDLE pending_patches;
 	SINGLYLINKEDLIST_HANDLE operations;
+	HASH_INDEX_HANDLE operations_index;
+	char correlation_id_prefix[TWIN_CORRELATION_ID_PREFIX_LENGTH + 1];
+	unsigned long correlation_id_counter;
 	
 	TWIN_MESSENGER_STATE_CHANGED_CALLBACK on_state_changed_callback;
 	void* on_state_changed_context;
@@ -114,7 +121,8 @@ typedef struct TWIN_OPERATION_CONTEXT_TAG
 {
 	TWIN_OPERATION_TYPE type;
 	TWIN_MESSENGER_INSTANCE* msgr;
-	char* correlation_id;
+	char correlation_id[TWIN_OPERATION_CORRELATION_ID_MAX_LENGTH];
+	LIST_ITEM_HANDLE list_item;
 	TWIN_MESSENGER_REPORT_STATE_COMPLETE_CALLBACK on_report_state_complete_callback;
 	const void* on_report_state_complete_context;
 	time_t time_sent;
@@ -338,7 +346,7 @@ static char* generate_unique_id()
 	return result;
 }
 
-static char* generate_twin_correlation_id()
+static char* generate_twin_correlation_id(TWIN_MESSENGER_INSTANCE* twin_msgr)
 {
 	char* result;
 	char* unique_id;
@@ -358,6 +366,9 @@ static char* generate_twin_correlation_id()
 		else
 		{
 			(void)sprintf(result, TWIN_CORRELATION_ID_PROPERTY_FORMAT, unique_id);
+
+			// The operations requested over this link are correlated by a short prefix of the link's own id plus a counter.
+			(void)memcpy(twin_msgr->correlation_id_prefix, unique_id, TWIN_CORRELATION_ID_PREFIX_LENGTH);
 		}
 
 		free(unique_id);
@@ -378,28 +389,16 @@ static TWIN_OPERATION_CONTEXT* create_twin_operation_context(TWIN_MESSENGER_INST
 	{
 		memset(result, 0, sizeof(TWIN_OPERATION_CONTEXT));
 
-		if ((result->correlation_id = generate_unique_id()) == NULL)
-		{
-			LogError("Failed setting context correlation-id (%s, %s)", ENUM_TO_STRING(TWIN_OPERATION_TYPE, type), twin_msgr->device_id);
-			free(result);
-			result = NULL;
-		}
-		else
-		{
-			result->type = type;
-			result->msgr = twin_msgr;
-		}
+		twin_msgr->correlation_id_counter++;
+		(void)sprintf(result->correlation_id, TWIN_OPERATION_CORRELATION_ID_FORMAT, twin_msgr->correlation_id_prefix, twin_msgr->correlation_id_counter);
+
+		result->type = type;
+		result->msgr = twin_msgr;
 	}
 
 	return result;
 }
 
-static bool find_twin_operation_by_correlation_id(LIST_ITEM_HANDLE list_item, const void* match_context)
-{
-	TWIN_OPERATION_CONTEXT* twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item);
-	return (strcmp(twin_op_ctx->correlation_id, (const char*)match_context) == 0);
-}
-
 static bool find_twin_operation_by_type(LIST_ITEM_HANDLE list_item, const void* match_context)
 {
 	TWIN_OPERATION_CONTEXT* twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item);
@@ -408,7 +407,6 @@ static bool find_twin_operation_by_type(LIST_ITEM_HANDLE list_item, const void*
 
 static void destroy_twin_operation_context(TWIN_OPERATION_CONTEXT* op_ctx)
 {
-	free(op_ctx->correlation_id);
 	free(op_ctx);
 }
 
@@ -416,11 +414,20 @@ static int add_twin_operation_context_to_queue(TWIN_OPERATION_CONTEXT* twin_op_c
 {
 	int result;
 
-	if (singlylinkedlist_add(twin_op_ctx->msgr->operations, (const void*)twin_op_ctx) == NULL)
+	if ((twin_op_ctx->list_item = singlylinkedlist_add(twin_op_ctx->msgr->operations, (const void*)twin_op_ctx)) == NULL)
 	{
 		LogError("Failed adding TWIN operation context to queue (%s, %s)", ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
 		result = __FAILURE__;
 	}
+	// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_109: [Each TWIN operation queued into `twin_msgr->operations` shall be indexed by its correlation-id using hash_index_add_without_copy(), so the index refers to the correlation-id buffer of the operation context instead of copying it]
+	else if (hash_index_add_without_copy(twin_op_ctx->msgr->operations_index, twin_op_ctx->correlation_id, (void*)twin_op_ctx) != RESULT_OK)
+	{
+		// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_110: [If hash_index_add_without_copy() fails, the TWIN operation shall be removed from `twin_msgr->operations` and the request shall fail]
+		LogError("Failed indexing TWIN operation context (%s, %s)", ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
+		(void)singlylinkedlist_remove(twin_op_ctx->msgr->operations, twin_op_ctx->list_item);
+		twin_op_ctx->list_item = NULL;
+		result = __FAILURE__;
+	}
 	else
 	{
 		result = RESULT_OK;
@@ -432,13 +439,12 @@ static int add_twin_operation_context_to_queue(TWIN_OPERATION_CONTEXT* twin_op_c
 static int remove_twin_operation_context_from_queue(TWIN_OPERATION_CONTEXT* twin_op_ctx)
 {
 	int result;
-	LIST_ITEM_HANDLE list_item;
 
-	if ((list_item = singlylinkedlist_find(twin_op_ctx->msgr->operations, find_twin_operation_by_correlation_id, (const void*)twin_op_ctx->correlation_id)) == NULL)
+	if (twin_op_ctx->list_item == NULL)
 	{
 		result = RESULT_OK;
 	}
-	else if (singlylinkedlist_remove(twin_op_ctx->msgr->operations, list_item) != 0)
+	else if (singlylinkedlist_remove(twin_op_ctx->msgr->operations, twin_op_ctx->list_item) != 0)
 	{
 		LogError("Failed removing TWIN operation context from queue (%s, %s, %s)", 
 			twin_op_ctx->msgr->device_id, ENUM_TO_STRING(TWIN_OPERATION_TYPE, twin_op_ctx->type), twin_op_ctx->correlation_id);
@@ -446,6 +452,8 @@ static int remove_twin_operation_context_from_queue(TWIN_OPERATION_CONTEXT* twin
 	}
 	else
 	{
+		twin_op_ctx->list_item = NULL;
+		(void)hash_index_remove(twin_op_ctx->msgr->operations_index, twin_op_ctx->correlation_id);
 		result = RESULT_OK;
 	}
 
@@ -649,7 +657,7 @@ static MAP_HANDLE create_link_attach_properties(TWIN_MESSENGER_INSTANCE* twin_ms
 	{
 		char* correlation_id;
 
-		if ((correlation_id = generate_twin_correlation_id()) == NULL)
+		if ((correlation_id = generate_twin_correlation_id(twin_msgr)) == NULL)
 		{
 			LogError("Failed adding AMQP link property ");
 			destroy_link_attach_properties(result);
@@ -710,7 +718,7 @@ static const char* get_twin_operation_name(TWIN_OPERATION_TYPE op_type)
 	return result;
 }
 
-static MESSAGE_HANDLE create_amqp_message_for_twin_operation(TWIN_OPERATION_TYPE op_type, char* correlation_id, CONSTBUFFER_HANDLE data)
+static MESSAGE_HANDLE create_amqp_message_for_twin_operation(TWIN_OPERATION_TYPE op_type, const char* correlation_id, CONSTBUFFER_HANDLE data)
 {
 	MESSAGE_HANDLE result;
 	const char* twin_op_name;
@@ -1037,6 +1045,9 @@ static bool remove_expired_twin_operation_request(const void* item, const void*
 			result = true;
 			*continue_processing = true;
 
+			// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_111: [Timed-out items of `twin_msgr->operations` shall be removed from `twin_msgr->operations_index` using hash_index_remove()]
+			(void)hash_index_remove(twin_msgr->operations_index, twin_op_ctx->correlation_id);
+
 			if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PATCH)
 			{
 				// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_081: [If a timed-out item is a reported property PATCH, `on_report_state_complete_callback` shall be invoked with RESULT_ERROR and REASON_TIMEOUT]  
@@ -1319,6 +1330,11 @@ static void internal_twin_messenger_destroy(TWIN_MESSENGER_INSTANCE* twin_msgr)
 		singlylinkedlist_destroy(twin_msgr->operations);
 	}
 
+	if (twin_msgr->operations_index != NULL)
+	{
+		hash_index_destroy(twin_msgr->operations_index);
+	}
+
 	// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_102: [twin_messenger_destroy() shall release all memory allocated for and within `twin_msgr`]  
 	if (twin_msgr->client_version != NULL)
 	{
@@ -1380,156 +1396,147 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
 			{
 				// It is supposed to be a request sent previously (reported properties PATCH, GET, PUT or DELETE).
 
-				LIST_ITEM_HANDLE list_item;
-				if ((list_item = singlylinkedlist_find(twin_msgr->operations, find_twin_operation_by_correlation_id, (const void*)correlation_id)) == NULL)
+				TWIN_OPERATION_CONTEXT* twin_op_ctx;
+
+				// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_112: [The TWIN request corresponding to `message` shall be looked up by correlation-id in `twin_msgr->operations_index` using hash_index_find()]
+				if ((twin_op_ctx = (TWIN_OPERATION_CONTEXT*)hash_index_find(twin_msgr->operations_index, correlation_id)) == NULL)
 				{
 					LogError("Could not find context of TWIN incoming message (%s, %s)", twin_msgr->device_id, correlation_id);
 				}
 				else
 				{
-					TWIN_OPERATION_CONTEXT* twin_op_ctx;
+					if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PATCH)
+					{							
+						if (!has_status_code)
+						{
+							// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_086: [If `message` is a failed response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_ERROR and the status_code zero]  
+							LogError("Received an incoming TWIN message for a PATCH operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
 
-					if ((twin_op_ctx = (TWIN_OPERATION_CONTEXT*)singlylinkedlist_item_get_value(list_item)) == NULL)
-					{
-						LogError("Could not get context for incoming TWIN message (%s, %s)", twin_msgr->device_id, correlation_id);
-					}
-					else
-					{	
-						if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PATCH)
-						{							
-							if (!has_status_code)
+							disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
+							
+							if (twin_op_ctx->on_report_state_complete_callback != NULL)
 							{
-								// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_086: [If `message` is a failed response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_ERROR and the status_code zero]  
-								LogError("Received an incoming TWIN message for a PATCH operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
-
-								disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
-								
-								if (twin_op_ctx->on_report_state_complete_callback != NULL)
-								{
-									twin_op_ctx->on_report_state_complete_callback(TWIN_REPORT_STATE_RESULT_ERROR, TWIN_REPORT_STATE_REASON_INVALID_RESPONSE, 0, twin_op_ctx->on_report_state_complete_context);
-								}
+								twin_op_ctx->on_report_state_complete_callback(TWIN_REPORT_STATE_RESULT_ERROR, TWIN_REPORT_STATE_REASON_INVALID_RESPONSE, 0, twin_op_ctx->on_report_state_complete_context);
 							}
-							else
+						}
+						else
+						{
+							// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_085: [If `message` is a success response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_SUCCESS and the status_code received]  
+							if (twin_op_ctx->on_report_state_complete_callback != NULL)
 							{
-								// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_085: [If `message` is a success response for a PATCH request, the `on_report_state_complete_callback` shall be invoked if provided passing RESULT_SUCCESS and the status_code received]  
-								if (twin_op_ctx->on_report_state_complete_callback != NULL)
-								{
-									twin_op_ctx->on_report_state_complete_callback(TWIN_REPORT_STATE_RESULT_SUCCESS, TWIN_REPORT_STATE_REASON_NONE, status_code, twin_op_ctx->on_report_state_complete_context);
-								}
+								twin_op_ctx->on_report_state_complete_callback(TWIN_REPORT_STATE_RESULT_SUCCESS, TWIN_REPORT_STATE_REASON_NONE, status_code, twin_op_ctx->on_report_state_complete_context);
 							}
 						}
-						else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_GET)
+					}
+					else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_GET)
+					{
+						if (!has_twin_report)
 						{
-							if (!has_twin_report)
-							{
-								// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_089: [If `message` is a failed response for a GET request, the TWIN messenger shall attempt to send another GET request]  
-								LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
+							// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_089: [If `message` is a failed response for a GET request, the TWIN messenger shall attempt to send another GET request]  
+							LogError("Received an incoming TWIN message for a GET operation, but with no report (%s, %s)", twin_msgr->device_id, correlation_id);
 
-								disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
+							disposition_result = AMQP_MESSENGER_DISPOSITION_RESULT_REJECTED;
 
-								if (twin_op_ctx->msgr->on_message_received_callback != NULL)
-								{
-									twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->msgr->on_message_received_context);
-								}
+							if (twin_op_ctx->msgr->on_message_received_callback != NULL)
+							{
+								twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, NULL, 0, twin_op_ctx->msgr->on_message_received_context);
+							}
 
-								if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
-								{
-									twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_GET_COMPLETE_PROPERTIES;
-									twin_msgr->subscription_error_count++;
-								}
+							if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
+							{
+								twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_GET_COMPLETE_PROPERTIES;
+								twin_msgr->subscription_error_count++;
 							}
-							else
+						}
+						else
+						{
+							// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_087: [If `message` is a success response for a GET request, `on_message_received_callback` shall be invoked with TWIN_UPDATE_TYPE_COMPLETE and the message body received]  
+							if (twin_op_ctx->msgr->on_message_received_callback != NULL)
 							{
-								// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_087: [If `message` is a success response for a GET request, `on_message_received_callback` shall be invoked with TWIN_UPDATE_TYPE_COMPLETE and the message body received]  
-								if (twin_op_ctx->msgr->on_message_received_callback != NULL)
-								{
-									twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, (const char*)twin_report.bytes, twin_report.length, twin_op_ctx->msgr->on_message_received_context);
-								}
+								twin_op_ctx->msgr->on_message_received_callback(TWIN_UPDATE_TYPE_COMPLETE, (const char*)twin_report.bytes, twin_report.length, twin_op_ctx->msgr->on_message_received_context);
+							}
 
-								// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_088: [If `message` is a success response for a GET request, the TWIN messenger shall trigger the subscription for partial updates]  
-								if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
-								{
-									twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
-									twin_msgr->subscription_error_count = 0;
-								}
+							// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_088: [If `message` is a success response for a GET request, the TWIN messenger shall trigger the subscription for partial updates]  
+							if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_GETTING_COMPLETE_PROPERTIES)
+							{
+								twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
+								twin_msgr->subscription_error_count = 0;
 							}
 						}
-						else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PUT)
+					}
+					else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_PUT)
+					{
+						if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBED)
 						{
-							if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBED)
+							bool subscription_succeeded = true;
+
+							if (!has_status_code)
 							{
-								bool subscription_succeeded = true;
+								LogError("Received an incoming TWIN message for a PUT operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+								
+								subscription_succeeded = false;
+							}
+							else if (status_code < 200 || status_code >= 300)
+							{
+								LogError("Received status code %d for TWIN subscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
+								
+								subscription_succeeded = false;
+							}
 
-								if (!has_status_code)
-								{
-									LogError("Received an incoming TWIN message for a PUT operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
-									
-									subscription_succeeded = false;
-								}
-								else if (status_code < 200 || status_code >= 300)
+							if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBING)
+							{
+								if (subscription_succeeded)
 								{
-									LogError("Received status code %d for TWIN subscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
-									
-									subscription_succeeded = false;
+									twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBED;
+									twin_msgr->subscription_error_count = 0;
 								}
-
-								if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_SUBSCRIBING)
+								else
 								{
-									if (subscription_succeeded)
-									{
-										twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBED;
-										twin_msgr->subscription_error_count = 0;
-									}
-									else
-									{
-										// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_090: [If `message` is a failed response for a PUT request, the TWIN messenger shall attempt to send another PUT request]  
-										twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
-										twin_msgr->subscription_error_count++;
-									}
+									// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_090: [If `message` is a failed response for a PUT request, the TWIN messenger shall attempt to send another PUT request]  
+									twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_SUBSCRIBE_FOR_UPDATES;
+									twin_msgr->subscription_error_count++;
 								}
 							}
 						}
-						else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_DELETE)
+					}
+					else if (twin_op_ctx->type == TWIN_OPERATION_TYPE_DELETE)
+					{
+						if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED)
 						{
-							if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED)
+							bool unsubscription_succeeded = true;
+
+							if (!has_status_code)
+							{
+								LogError("Received an incoming TWIN message for a DELETE operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
+								
+								unsubscription_succeeded = false;
+							}
+							else if (status_code < 200 || status_code >= 300)
 							{
-								bool unsubscription_succeeded = true;
+								LogError("Received status code %d for TWIN unsubscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
+								
+								unsubscription_succeeded = false;
+							}
 
-								if (!has_status_code)
-								{
-									LogError("Received an incoming TWIN message for a DELETE operation, but with no status code (%s, %s)", twin_msgr->device_id, correlation_id);
-									
-									unsubscription_succeeded = false;
-								}
-								else if (status_code < 200 || status_code >= 300)
+							if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBING)
+							{
+								if (unsubscription_succeeded)
 								{
-									LogError("Received status code %d for TWIN unsubscription request (%s, %s)", status_code, twin_msgr->device_id, correlation_id);
-									
-									unsubscription_succeeded = false;
+									twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED;
+									twin_msgr->subscription_error_count = 0;
 								}
-
-								if (twin_msgr->subscription_state == TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBING)
+								else
 								{
-									if (unsubscription_succeeded)
-									{
-										twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_NOT_SUBSCRIBED;
-										twin_msgr->subscription_error_count = 0;
-									}
-									else
-									{
-										// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_091: [If `message` is a failed response for a DELETE request, the TWIN messenger shall attempt to send another DELETE request]  
-										twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBE;
-										twin_msgr->subscription_error_count++;
-									}
+									// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_091: [If `message` is a failed response for a DELETE request, the TWIN messenger shall attempt to send another DELETE request]  
+									twin_msgr->subscription_state = TWIN_SUBSCRIPTION_STATE_UNSUBSCRIBE;
+									twin_msgr->subscription_error_count++;
 								}
 							}
 						}
-
-						destroy_twin_operation_context(twin_op_ctx);
 					}
 
 					// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_092: [The corresponding TWIN request shall be removed from `twin_msgr->operations` and destroyed]  
-					if (singlylinkedlist_remove(twin_msgr->operations, list_item) != 0)
+					if (remove_twin_operation_context_from_queue(twin_op_ctx) != RESULT_OK)
 					{
 						// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_093: [The corresponding TWIN request failed to be removed from `twin_msgr->operations`, `twin_msgr->state` shall be set to TWIN_MESSENGER_STATE_ERROR and informed to the user]  
 						LogError("Failed removing context for incoming TWIN message (%s, %s, %s)",
@@ -1537,6 +1544,10 @@ static AMQP_MESSENGER_DISPOSITION_RESULT on_amqp_message_received_callback(MESSA
 						
 						update_state(twin_msgr, TWIN_MESSENGER_STATE_ERROR);
 					}
+					else
+					{
+						destroy_twin_operation_context(twin_op_ctx);
+					}
 				}
 
 				free(correlation_id);
@@ -1744,6 +1755,14 @@ TWIN_MESSENGER_HANDLE twin_messenger_create(const TWIN_MESSENGER_CONFIG* messeng
 				internal_twin_messenger_destroy(twin_msgr);
 				twin_msgr = NULL;
 			}
+			// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_113: [`twin_msgr->operations_index` shall be set using hash_index_create()]
+			else if ((twin_msgr->operations_index = hash_index_create(0)) == NULL)
+			{
+				// Codes_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_114: [If hash_index_create() fails, twin_messenger_create() shall fail and return NULL]
+				LogError("Failed creating index for operations (%s)", messenger_config->device_id);
+				internal_twin_messenger_destroy(twin_msgr);
+				twin_msgr = NULL;
+			}
 			else if ((link_attach_properties = create_link_attach_properties(twin_msgr)) == NULL)
 			{
 				LogError("Failed creating link attach properties (%s)", messenger_config->device_id);
@@ -0,0 +1,277 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_version.h"
+#include "iothubtransport_http_common.h"
+
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+
+static const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
+static const char* IOTHUB_CORRELATION_ID = "iothub-correlationid";
+static const char* IOTHUB_CONTENT_TYPE_C2D = "ContentType";
+static const char* IOTHUB_CONTENT_ENCODING_C2D = "ContentEncoding";
+
+#define LITERAL_LENGTH(literal) (sizeof(literal) - 1)
+
+/*golden ratio conjugate, consecutive multiples of it modulo 1 spread any number of devices evenly over an interval*/
+#define POLLING_PHASE_STEP 0.6180339887498949
+
+static const char base64Characters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*all the 4096 pairs of base64 characters, so 12 bits of input are encoded with a single lookup*/
+#define BASE64_PAIRS_ROW(first) \
+    { first, 'A' }, { first, 'B' }, { first, 'C' }, { first, 'D' }, { first, 'E' }, { first, 'F' }, { first, 'G' }, { first, 'H' }, { first, 'I' }, { first, 'J' }, { first, 'K' }, { first, 'L' }, { first, 'M' }, { first, 'N' }, { first, 'O' }, { first, 'P' }, \
+    { first, 'Q' }, { first, 'R' }, { first, 'S' }, { first, 'T' }, { first, 'U' }, { first, 'V' }, { first, 'W' }, { first, 'X' }, { first, 'Y' }, { first, 'Z' }, { first, 'a' }, { first, 'b' }, { first, 'c' }, { first, 'd' }, { first, 'e' }, { first, 'f' }, \
+    { first, 'g' }, { first, 'h' }, { first, 'i' }, { first, 'j' }, { first, 'k' }, { first, 'l' }, { first, 'm' }, { first, 'n' }, { first, 'o' }, { first, 'p' }, { first, 'q' }, { first, 'r' }, { first, 's' }, { first, 't' }, { first, 'u' }, { first, 'v' }, \
+    { first, 'w' }, { first, 'x' }, { first, 'y' }, { first, 'z' }, { first, '0' }, { first, '1' }, { first, '2' }, { first, '3' }, { first, '4' }, { first, '5' }, { first, '6' }, { first, '7' }, { first, '8' }, { first, '9' }, { first, '+' }, { first, '/' },
+static const char base64Pairs[4096][2] =
+{
+    BASE64_PAIRS_ROW('A') BASE64_PAIRS_ROW('B') BASE64_PAIRS_ROW('C') BASE64_PAIRS_ROW('D') BASE64_PAIRS_ROW('E') BASE64_PAIRS_ROW('F') BASE64_PAIRS_ROW('G') BASE64_PAIRS_ROW('H')
+    BASE64_PAIRS_ROW('I') BASE64_PAIRS_ROW('J') BASE64_PAIRS_ROW('K') BASE64_PAIRS_ROW('L') BASE64_PAIRS_ROW('M') BASE64_PAIRS_ROW('N') BASE64_PAIRS_ROW('O') BASE64_PAIRS_ROW('P')
+    BASE64_PAIRS_ROW('Q') BASE64_PAIRS_ROW('R') BASE64_PAIRS_ROW('S') BASE64_PAIRS_ROW('T') BASE64_PAIRS_ROW('U') BASE64_PAIRS_ROW('V') BASE64_PAIRS_ROW('W') BASE64_PAIRS_ROW('X')
+    BASE64_PAIRS_ROW('Y') BASE64_PAIRS_ROW('Z') BASE64_PAIRS_ROW('a') BASE64_PAIRS_ROW('b') BASE64_PAIRS_ROW('c') BASE64_PAIRS_ROW('d') BASE64_PAIRS_ROW('e') BASE64_PAIRS_ROW('f')
+    BASE64_PAIRS_ROW('g') BASE64_PAIRS_ROW('h') BASE64_PAIRS_ROW('i') BASE64_PAIRS_ROW('j') BASE64_PAIRS_ROW('k') BASE64_PAIRS_ROW('l') BASE64_PAIRS_ROW('m') BASE64_PAIRS_ROW('n')
+    BASE64_PAIRS_ROW('o') BASE64_PAIRS_ROW('p') BASE64_PAIRS_ROW('q') BASE64_PAIRS_ROW('r') BASE64_PAIRS_ROW('s') BASE64_PAIRS_ROW('t') BASE64_PAIRS_ROW('u') BASE64_PAIRS_ROW('v')
+    BASE64_PAIRS_ROW('w') BASE64_PAIRS_ROW('x') BASE64_PAIRS_ROW('y') BASE64_PAIRS_ROW('z') BASE64_PAIRS_ROW('0') BASE64_PAIRS_ROW('1') BASE64_PAIRS_ROW('2') BASE64_PAIRS_ROW('3')
+    BASE64_PAIRS_ROW('4') BASE64_PAIRS_ROW('5') BASE64_PAIRS_ROW('6') BASE64_PAIRS_ROW('7') BASE64_PAIRS_ROW('8') BASE64_PAIRS_ROW('9') BASE64_PAIRS_ROW('+') BASE64_PAIRS_ROW('/')
+};
+
+unsigned int IoTHubTransport_HTTP_Common_GetNextPollingInterval(unsigned int minimumPollingTime, unsigned int maximumPollingTime, unsigned int* baseInterval)
+{
+    unsigned int result;
+
+    if (maximumPollingTime <= minimumPollingTime)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_001: [ If maximumPollingTime is not greater than minimumPollingTime, IoTHubTransport_HTTP_Common_GetNextPollingInterval shall set baseInterval to minimumPollingTime and return it, without jitter. ]*/
+        *baseInterval = minimumPollingTime;
+        result = minimumPollingTime;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_002: [ Otherwise IoTHubTransport_HTTP_Common_GetNextPollingInterval shall double baseInterval, starting at minimumPollingTime and capped at maximumPollingTime. ]*/
+        if (*baseInterval >= maximumPollingTime / 2)
+        {
+            *baseInterval = maximumPollingTime;
+        }
+        else if (*baseInterval * 2 > minimumPollingTime)
+        {
+            *baseInterval = *baseInterval * 2;
+        }
+        else
+        {
+            *baseInterval = minimumPollingTime;
+        }
+
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_003: [ IoTHubTransport_HTTP_Common_GetNextPollingInterval shall return baseInterval plus up to 10% of it chosen at random, but not more than maximumPollingTime. ]*/
+        result = *baseInterval + (unsigned int)((*baseInterval / 100.0) * POLLING_JITTER_PERCENT * (rand() / ((double)RAND_MAX)));
+        if (result > maximumPollingTime)
+        {
+            result = maximumPollingTime;
+        }
+    }
+
+    return result;
+}
+
+unsigned int IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(unsigned int pollingInterval, size_t deviceIndex)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_014: [ IoTHubTransport_HTTP_Common_GetPollingPhaseOffset shall return pollingInterval times the fractional part of deviceIndex times the golden ratio conjugate, which is 0 for deviceIndex 0. ]*/
+    double phase = deviceIndex * POLLING_PHASE_STEP;
+    phase -= (double)(unsigned long long)phase;
+
+    return (unsigned int)(pollingInterval * phase);
+}
+
+size_t IoTHubTransport_HTTP_Common_EncodeBase64(char* destination, const unsigned char* source, size_t size)
+{
+    char* destinationBegin = destination;
+    size_t i;
+
+    /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_015: [ IoTHubTransport_HTTP_Common_EncodeBase64 shall write the base64 encoding of the size bytes of source, padded with '=', to destination, without a null terminator. ]*/
+    /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_016: [ Every 3 bytes of source shall be encoded with 2 lookups of 2 characters each. ]*/
+    for (i = 0; i + 2 < size; i += 3)
+    {
+        uint32_t triplet = ((uint32_t)source[i] << 16) | ((uint32_t)source[i + 1] << 8) | source[i + 2];
+        (void)memcpy(destination, base64Pairs[triplet >> 12], 2);
+        (void)memcpy(destination + 2, base64Pairs[triplet & 0xFFF], 2);
+        destination += 4;
+    }
+
+    if (i + 1 == size)
+    {
+        destination[0] = base64Characters[source[i] >> 2];
+        destination[1] = base64Characters[(source[i] & 0x03) << 4];
+        destination[2] = '=';
+        destination[3] = '=';
+        destination += 4;
+    }
+    else if (i + 2 == size)
+    {
+        destination[0] = base64Characters[source[i] >> 2];
+        destination[1] = base64Characters[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        destination[2] = base64Characters[(source[i + 1] & 0x0F) << 2];
+        destination[3] = '=';
+        destination += 4;
+    }
+
+    /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_017: [ IoTHubTransport_HTTP_Common_EncodeBase64 shall return the number of characters written, IOTHUB_BASE64_ENCODED_LENGTH(size). ]*/
+    return (size_t)(destination - destinationBegin);
+}
+
+const char* IoTHubTransport_HTTP_Common_GetPropertyHeaderName(char** propertyHeaderName, size_t* propertyHeaderNameSize, const char* key)
+{
+    const char* result;
+    size_t keyLength = strlen(key);
+    size_t neededSize = LITERAL_LENGTH(IOTHUB_APP_PREFIX) + keyLength + 1;
+
+    if (neededSize > *propertyHeaderNameSize)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_004: [ If the buffer is too small for "iothub-app-" followed by key, IoTHubTransport_HTTP_Common_GetPropertyHeaderName shall realloc it and write "iothub-app-" at its beginning. ]*/
+        char* newPropertyHeaderName = (char*)realloc(*propertyHeaderName, neededSize);
+        if (newPropertyHeaderName == NULL)
+        {
+            LogError("unable to realloc the property header name");
+        }
+        else
+        {
+            (void)memcpy(newPropertyHeaderName, IOTHUB_APP_PREFIX, LITERAL_LENGTH(IOTHUB_APP_PREFIX));
+            *propertyHeaderName = newPropertyHeaderName;
+            *propertyHeaderNameSize = neededSize;
+        }
+    }
+
+    if (neededSize > *propertyHeaderNameSize)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_005: [ If realloc fails, IoTHubTransport_HTTP_Common_GetPropertyHeaderName shall return NULL and leave the buffer untouched. ]*/
+        result = NULL;
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_006: [ IoTHubTransport_HTTP_Common_GetPropertyHeaderName shall copy key after "iothub-app-" and return the buffer. ]*/
+        (void)memcpy(*propertyHeaderName + LITERAL_LENGTH(IOTHUB_APP_PREFIX), key, keyLength + 1);
+        result = *propertyHeaderName;
+    }
+
+    return result;
+}
+
+HTTP_HEADERS_RESULT IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, HTTP_HEADERS_HANDLE requestHeaders)
+{
+    void* product_info;
+    HTTP_HEADERS_RESULT result;
+    if ((IoTHubClient_LL_GetOption(iotHubClientHandle, OPTION_PRODUCT_INFO, &product_info) == IOTHUB_CLIENT_ERROR) || (product_info == NULL))
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_007: [ If the product info option of the client cannot be read or is not set, the "User-Agent" header shall be the SDK name and version. ]*/
+        result = HTTPHeaders_AddHeaderNameValuePair(requestHeaders, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION);
+    }
+    else
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_008: [ Otherwise the "User-Agent" header shall be the product info. ]*/
+        result = HTTPHeaders_AddHeaderNameValuePair(requestHeaders, "User-Agent", STRING_c_str((STRING_HANDLE)product_info));
+    }
+    return result;
+}
+
+/*copies the value of an HTTP header of the form "name: value" into the message, by calling setValue*/
+static bool setHeaderValue(IOTHUB_MESSAGE_HANDLE receivedMessage, char* completeHeader, IOTHUB_MESSAGE_RESULT(*setValue)(IOTHUB_MESSAGE_HANDLE, const char*))
+{
+    bool result;
+    /*there's a guaranteed ':' in the completeHeader, by HTTP_HEADERS module*/
+    char* whereIsColon = strchr(completeHeader, ':');
+    if (whereIsColon == NULL)
+    {
+        result = true;
+    }
+    else
+    {
+        *whereIsColon = '\0'; /*cut it down*/
+        if (setValue(receivedMessage, whereIsColon + 2) != IOTHUB_MESSAGE_OK) /*whereIsColon+1 is a space because HTTPEHADERS outputs a ": " between name and value*/
+        {
+            LogError("unable to set the value of HTTP header %s in the message", completeHeader);
+            result = false;
+        }
+        else
+        {
+            result = true;
+        }
+    }
+    return result;
+}
+
+bool IoTHubTransport_HTTP_Common_SetMessageProperties(IOTHUB_MESSAGE_HANDLE receivedMessage, HTTP_HEADERS_HANDLE responseHeaders)
+{
+    bool result;
+    size_t nHeaders;
+
+    if (HTTPHeaders_GetHeaderCount(responseHeaders, &nHeaders) != HTTP_HEADERS_OK)
+    {
+        /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_009: [ If the count of headers cannot be read, IoTHubTransport_HTTP_Common_SetMessageProperties shall fail and return false. ]*/
+        LogError("unable to get the count of HTTP headers");
+        result = false;
+    }
+    else
+    {
+        size_t i;
+        MAP_HANDLE properties = (nHeaders > 0) ? IoTHubMessage_Properties(receivedMessage) : NULL;
+        result = true;
+
+        for (i = 0; (i < nHeaders) && result; i++)
+        {
+            char* completeHeader;
+            if (HTTPHeaders_GetHeader(responseHeaders, i, &completeHeader) != HTTP_HEADERS_OK)
+            {
+                /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_010: [ If any header cannot be read or copied, IoTHubTransport_HTTP_Common_SetMessageProperties shall stop and return false. ]*/
+                result = false;
+            }
+            else
+            {
+                if (strncmp(IOTHUB_APP_PREFIX, completeHeader, LITERAL_LENGTH(IOTHUB_APP_PREFIX)) == 0)
+                {
+                    /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_011: [ Every header of the form iothub-app-name: somecontent shall be added to the message properties as {name, somecontent}. ]*/
+                    /*there's a guaranteed ':' in the completeHeader, by HTTP_HEADERS module*/
+                    char* whereIsColon = strchr(completeHeader, ':');
+                    if (whereIsColon != NULL)
+                    {
+                        *whereIsColon = '\0'; /*cut it down*/
+                        result = (Map_AddOrUpdate(properties, completeHeader + LITERAL_LENGTH(IOTHUB_APP_PREFIX), whereIsColon + 2) == MAP_OK); /*whereIsColon+1 is a space because HTTPEHADERS outputs a ": " between name and value*/
+                    }
+                }
+                /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_012: [ The values of the "iothub-messageid", "iothub-correlationid", "ContentType" and "ContentEncoding" headers shall be set as the message id, correlation id, content type and content encoding of the message. ]*/
+                else if (strncmp(IOTHUB_MESSAGE_ID, completeHeader, strlen(IOTHUB_MESSAGE_ID)) == 0)
+                {
+                    result = setHeaderValue(receivedMessage, completeHeader, IoTHubMessage_SetMessageId);
+                }
+                else if (strncmp(IOTHUB_CORRELATION_ID, completeHeader, strlen(IOTHUB_CORRELATION_ID)) == 0)
+                {
+                    result = setHeaderValue(receivedMessage, completeHeader, IoTHubMessage_SetCorrelationId);
+                }
+                else if (strncmp(IOTHUB_CONTENT_TYPE_C2D, completeHeader, strlen(IOTHUB_CONTENT_TYPE_C2D)) == 0)
+                {
+                    result = setHeaderValue(receivedMessage, completeHeader, IoTHubMessage_SetContentTypeSystemProperty);
+                }
+                else if (strncmp(IOTHUB_CONTENT_ENCODING_C2D, completeHeader, strlen(IOTHUB_CONTENT_ENCODING_C2D)) == 0)
+                {
+                    result = setHeaderValue(receivedMessage, completeHeader, IoTHubMessage_SetContentEncodingSystemProperty);
+                }
+                free(completeHeader);
+            }
+        }
+    }
+
+    return result;
+}
+
+void IoTHubTransport_HTTP_Common_ReversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
+{
+    /*Codes_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_013: [ IoTHubTransport_HTTP_Common_ReversePutListBackIn shall move the entries of source, in order, to the head of destination and leave source empty. ]*/
+    DList_AppendTailList(destination->Flink, source);
+    DList_RemoveEntryList(source);
+    DList_InitializeListHead(source);
+}
@@ -51,6 +51,14 @@
 #define DEFAULT_RETRY_POLICY                IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER
 #define DEFAULT_RETRY_TIMEOUT_IN_SECONDS    0
 
+// mqttmessage_create_in_place is only available in newer azure-umqtt-c revisions; the build
+// defines USE_MQTTMESSAGE_CREATE_IN_PLACE when the umqtt headers in use declare it.
+#ifdef USE_MQTTMESSAGE_CREATE_IN_PLACE
+#define MQTTMESSAGE_CREATE                  mqttmessage_create_in_place
+#else
+#define MQTTMESSAGE_CREATE                  mqttmessage_create
+#endif
+
 static const char TOPIC_DEVICE_TWIN_PREFIX[] = "$iothub/twin";
 static const char TOPIC_DEVICE_METHOD_PREFIX[] = "$iothub/methods";
 
@@ -85,6 +93,9 @@ static const char* CONTENT_ENCODING_PROPERTY = "ce";
 #define SUBSCRIBE_DEVICE_METHOD_TOPIC           0x0010
 #define SUBSCRIBE_TOPIC_COUNT                   4
 
+// Large enough for the twin topics and for a method response topic carrying any request id generated by the service
+#define PUBLISH_TOPIC_BUFFER_SIZE               128
+
 DEFINE_ENUM_STRINGS(MQTT_CLIENT_EVENT_ERROR, MQTT_CLIENT_EVENT_ERROR_VALUES)
 
 typedef struct SYSTEM_PROPERTY_INFO_TAG
@@ -177,6 +188,7 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     tickcounter_ms_t connectTick;
     bool log_trace;
     bool raw_trace;
+    bool telemetry_at_most_once;
     TICK_COUNTER_HANDLE msgTickCounter;
     OPTIONHANDLER_HANDLE saved_tls_options;		// Here are the options from the xio layer if any is saved.
 
@@ -190,6 +202,9 @@ typedef struct MQTTTRANSPORT_HANDLE_DATA_TAG
     // Telemetry specific
     DLIST_ENTRY telemetry_waitingForAck;
 
+    // Device method requests that have not been responded to yet
+    DLIST_ENTRY pending_method_requests;
+
     // Controls frequency of reconnection logic.
     RETRY_CONTROL_HANDLE retry_control_handle;
 
@@ -228,7 +243,12 @@ typedef struct MQTT_MESSAGE_DETAILS_LIST_TAG
 
 typedef struct DEVICE_METHOD_INFO_TAG
 {
-    STRING_HANDLE request_id;
+    // Points right past the method name, both are stored in the same allocation as this structure
+    const char* request_id;
+    // Set while IoTHubClient_LL_DeviceMethodComplete runs, a response sent from within it only marks the request as responded
+    bool in_method_callback;
+    bool responded;
+    DLIST_ENTRY entry;
 } DEVICE_METHOD_INFO;
 
 static void free_proxy_data(MQTTTRANSPORT_HANDLE_DATA* mqtt_transport_instance)
@@ -333,64 +353,40 @@ static const char* retrieve_mqtt_return_codes(CONNECT_RETURN_CODE rtn_code)
     }
 }
 
-static int retrieve_device_method_rid_info(const char* resp_topic, STRING_HANDLE method_name, STRING_HANDLE request_id)
+static int retrieve_device_method_rid_info(const char* resp_topic, const char** method_name, size_t* method_name_length, const char** request_id, size_t* request_id_length)
 {
     int result;
-    STRING_TOKENIZER_HANDLE token_handle = STRING_TOKENIZER_create_from_char(resp_topic);
-    if (token_handle == NULL)
+    // Topic format: $iothub/methods/POST/<method name>/?$rid=<request id>
+    const char* name_begin = resp_topic;
+    size_t token_index;
+    for (token_index = 0; token_index < 3 && name_begin != NULL; token_index++)
     {
-        LogError("Failed creating token from device twin topic.");
+        name_begin = strchr(name_begin, '/');
+        if (name_begin != NULL)
+        {
+            name_begin++;
+        }
+    }
+
+    const char* name_end = (name_begin == NULL) ? NULL : strchr(name_begin, '/');
+    size_t property_length = strlen(REQUEST_ID_PROPERTY);
+    if (name_end == NULL || name_end == name_begin)
+    {
+        LogError("Failed locating the method name in device method topic.");
+        result = __FAILURE__;
+    }
+    else if (strncmp(name_end + 1, REQUEST_ID_PROPERTY, property_length) != 0)
+    {
+        LogError("Failed locating the request id in device method topic.");
         result = __FAILURE__;
     }
     else
     {
-        STRING_HANDLE token_value;
-        if ((token_value = STRING_new()) == NULL)
-        {
-            LogError("Failed allocating new string .");
-            result = __FAILURE__;
-        }
-        else
-        {
-            size_t token_index = 0;
-            size_t request_id_length = strlen(REQUEST_ID_PROPERTY);
-            result = __FAILURE__;
-            while (STRING_TOKENIZER_get_next_token(token_handle, token_value, "/") == 0)
-            {
-                if (token_index == 3)
-                {
-                    if (STRING_concat_with_STRING(method_name, token_value) != 0)
-                    {
-                        LogError("Failed STRING_concat_with_STRING.");
-                        result = __FAILURE__;
-                        break;
-                    }
-                }
-                else if (token_index == 4)
-                {
-                    if (STRING_length(token_value) >= request_id_length)
-                    {
-                        const char* request_id_value = STRING_c_str(token_value);
-                        if (memcmp(request_id_value, REQUEST_ID_PROPERTY, request_id_length) == 0)
-                        {
-                            if (STRING_concat(request_id, request_id_value+request_id_length) != 0)
-                            {
-                                LogError("Failed STRING_concat failed.");
-                                result = __FAILURE__;
-                            }
-                            else
-                            {
-                                result = 0;
-                            }
-                            break;
-                        }
-                    }
-                }
-                token_index++;
-            }
-            STRING_delete(token_value);
-        }
-        STRING_TOKENIZER_destroy(token_handle);
+        *method_name = name_begin;
+        *method_name_length = name_end - name_begin;
+        *request_id = name_end + 1 + property_length;
+        *request_id_length = strcspn(*request_id, "/");
+        result = 0;
     }
     return result;
 }
@@ -642,10 +638,11 @@ static STRING_HANDLE addPropertiesTouMqttMessage(IOTHUB_MESSAGE_HANDLE iothub_me
     return result;
 }
 
-static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
+// mqttMsgEntry is only given for DELIVER_AT_LEAST_ONCE publishes, which are tracked until PUBACK.
+static int publish_mqtt_telemetry_msg_with_qos(PMQTTTRANSPORT_HANDLE_DATA transport_data, IOTHUB_MESSAGE_HANDLE iothub_message_handle, QOS_VALUE qos_value, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
 {
     int result;
-    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(mqttMsgEntry->iotHubMessageEntry->messageHandle, STRING_c_str(transport_data->topic_MqttEvent));
+    STRING_HANDLE msgTopic = addPropertiesTouMqttMessage(iothub_message_handle, STRING_c_str(transport_data->topic_MqttEvent));
     if (msgTopic == NULL)
     {
         LogError("Failed adding properties to mqtt message");
@@ -653,7 +650,11 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqttMsg = mqttmessage_create(mqttMsgEntry->packet_id, STRING_c_str(msgTopic), DELIVER_AT_LEAST_ONCE, payload, len);
+        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_015: [ If telemetry is sent at most once `IoTHubTransport_MQTT_Common_DoWork` shall publish it with QOS DELIVER_AT_MOST_ONCE ]
+        // Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_017: [ `IoTHubTransport_MQTT_Common_DoWork` shall create the MQTT_MESSAGE_HANDLE with mqttmessage_create_in_place so the message payload is referenced instead of copied, falling back to mqttmessage_create when the azure-umqtt-c in use does not provide it ]
+        // mqtt_client_publish serializes the payload straight into the packet sent to the xio, so the
+        // IOTHUB_MESSAGE_HANDLE buffer only has to outlive mqttMsg, which is destroyed right after the publish.
+        MQTT_MESSAGE_HANDLE mqttMsg = MQTTMESSAGE_CREATE((mqttMsgEntry == NULL) ? 0 : mqttMsgEntry->packet_id, STRING_c_str(msgTopic), qos_value, payload, len);
         if (mqttMsg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -661,7 +662,7 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
         }
         else
         {
-            if (tickcounter_get_current_ms(transport_data->msgTickCounter, &mqttMsgEntry->msgPublishTime) != 0)
+            if (mqttMsgEntry != NULL && tickcounter_get_current_ms(transport_data->msgTickCounter, &mqttMsgEntry->msgPublishTime) != 0)
             {
                 LogError("Failed retrieving tickcounter info");
                 result = __FAILURE__;
@@ -675,7 +676,10 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
                 }
                 else
                 {
-                    mqttMsgEntry->retryCount++;
+                    if (mqttMsgEntry != NULL)
+                    {
+                        mqttMsgEntry->retryCount++;
+                    }
                     result = 0;
                 }
             }
@@ -686,20 +690,36 @@ static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data,
     return result;
 }
 
-static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_data, int status_code, STRING_HANDLE request_id, const unsigned char* response, size_t response_size)
+static int publish_mqtt_telemetry_msg(PMQTTTRANSPORT_HANDLE_DATA transport_data, MQTT_MESSAGE_DETAILS_LIST* mqttMsgEntry, const unsigned char* payload, size_t len)
+{
+    return publish_mqtt_telemetry_msg_with_qos(transport_data, mqttMsgEntry->iotHubMessageEntry->messageHandle, DELIVER_AT_LEAST_ONCE, mqttMsgEntry, payload, len);
+}
+
+static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_data, int status_code, const char* request_id, const unsigned char* response, size_t response_size)
 {
     int result;
     uint16_t packet_id = get_next_packet_id(transport_data);
 
-    STRING_HANDLE msg_topic = STRING_construct_sprintf(DEVICE_METHOD_RESPONSE_TOPIC, status_code, STRING_c_str(request_id) );
-    if (msg_topic == NULL)
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_018: [ The device method response topic shall be rendered into a stack buffer, and only be allocated if the request id does not fit in it. ] */
+    char topic_buffer[PUBLISH_TOPIC_BUFFER_SIZE];
+    char* msg_topic = topic_buffer;
+    int topic_length = snprintf(topic_buffer, sizeof(topic_buffer), DEVICE_METHOD_RESPONSE_TOPIC, status_code, request_id);
+    if (topic_length > 0 && (size_t)topic_length >= sizeof(topic_buffer))
+    {
+        if ((msg_topic = (char*)malloc(topic_length + 1)) != NULL)
+        {
+            (void)snprintf(msg_topic, topic_length + 1, DEVICE_METHOD_RESPONSE_TOPIC, status_code, request_id);
+        }
+    }
+
+    if (topic_length <= 0 || msg_topic == NULL)
     {
         LogError("Failed constructing message topic.");
         result = __FAILURE__;
     }
     else
     {
-        MQTT_MESSAGE_HANDLE mqtt_get_msg = mqttmessage_create(packet_id, STRING_c_str(msg_topic), DELIVER_AT_MOST_ONCE, response, response_size);
+        MQTT_MESSAGE_HANDLE mqtt_get_msg = MQTTMESSAGE_CREATE(packet_id, msg_topic, DELIVER_AT_MOST_ONCE, response, response_size);
         if (mqtt_get_msg == NULL)
         {
             LogError("Failed constructing mqtt message.");
@@ -718,7 +738,10 @@ static int publish_device_method_message(MQTTTRANSPORT_HANDLE_DATA* transport_da
             }
             mqttmessage_destroy(mqtt_get_msg);
         }
-        STRING_delete(msg_topic);
+        if (msg_topic != topic_buffer)
+        {
+            free(msg_topic);
+        }
     }
     return result;
 }
@@ -741,8 +764,9 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
         mqtt_info->msgPublishTime = 0;
         mqtt_info->iothub_type = IOTHUB_TYPE_DEVICE_TWIN;
         mqtt_info->device_twin_data = NULL;
-        STRING_HANDLE msg_topic = STRING_construct_sprintf(GET_PROPERTIES_TOPIC, mqtt_info->packet_id);
-        if (msg_topic == NULL)
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_019: [ The twin get and reported properties topics shall be rendered into a stack buffer. ] */
+        char msg_topic[PUBLISH_TOPIC_BUFFER_SIZE];
+        if (snprintf(msg_topic, sizeof(msg_topic), GET_PROPERTIES_TOPIC, mqtt_info->packet_id) <= 0)
         {
             LogError("Failed constructing get Prop topic.");
             free(mqtt_info);
@@ -750,7 +774,7 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
         }
         else
         {
-            MQTT_MESSAGE_HANDLE mqtt_get_msg = mqttmessage_create(mqtt_info->packet_id, STRING_c_str(msg_topic), DELIVER_AT_MOST_ONCE, NULL, 0);
+            MQTT_MESSAGE_HANDLE mqtt_get_msg = MQTTMESSAGE_CREATE(mqtt_info->packet_id, msg_topic, DELIVER_AT_MOST_ONCE, NULL, 0);
             if (mqtt_get_msg == NULL)
             {
                 LogError("Failed constructing mqtt message.");
@@ -772,7 +796,6 @@ static int publish_device_twin_get_message(MQTTTRANSPORT_HANDLE_DATA* transport_
                 }
                 mqttmessage_destroy(mqtt_get_msg);
             }
-            STRING_delete(msg_topic);
         }
     }
     return result;
@@ -783,8 +806,9 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
     int result;
     mqtt_info->packet_id = get_next_packet_id(transport_data);
     mqtt_info->device_twin_msg_type = REPORTED_STATE;
-    STRING_HANDLE msgTopic = STRING_construct_sprintf(REPORTED_PROPERTIES_TOPIC, mqtt_info->packet_id);
-    if (msgTopic == NULL)
+    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_019: [ The twin get and reported properties topics shall be rendered into a stack buffer. ] */
+    char msgTopic[PUBLISH_TOPIC_BUFFER_SIZE];
+    if (snprintf(msgTopic, sizeof(msgTopic), REPORTED_PROPERTIES_TOPIC, mqtt_info->packet_id) <= 0)
     {
         LogError("Failed constructing reported prop topic.");
         result = __FAILURE__;
@@ -792,7 +816,7 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
     else
     {
         const CONSTBUFFER* data_buff = CONSTBUFFER_GetContent(device_twin_info->report_data_handle);
-        MQTT_MESSAGE_HANDLE mqtt_rpt_msg = mqttmessage_create(mqtt_info->packet_id, STRING_c_str(msgTopic), DELIVER_AT_MOST_ONCE, data_buff->buffer, data_buff->size);
+        MQTT_MESSAGE_HANDLE mqtt_rpt_msg = MQTTMESSAGE_CREATE(mqtt_info->packet_id, msgTopic, DELIVER_AT_MOST_ONCE, data_buff->buffer, data_buff->size);
         if (mqtt_rpt_msg == NULL)
         {
             LogError("Failed creating mqtt message");
@@ -820,7 +844,6 @@ static int publish_device_twin_message(MQTTTRANSPORT_HANDLE_DATA* transport_data
             }
             mqttmessage_destroy(mqtt_rpt_msg);
         }
-        STRING_delete(msgTopic);
     }
     return result;
 }
@@ -1078,45 +1101,55 @@ static void mqtt_notification_callback(MQTT_MESSAGE_HANDLE msgHandle, void* call
             }
             else if (type == IOTHUB_TYPE_DEVICE_METHODS)
             {
-                STRING_HANDLE method_name = STRING_new();
-                if (method_name == NULL)
+                const char* method_name;
+                size_t method_name_length;
+                const char* request_id;
+                size_t request_id_length;
+                if (retrieve_device_method_rid_info(topic_resp, &method_name, &method_name_length, &request_id, &request_id_length) != 0)
                 {
-                    LogError("Failure: allocating method_name string value");
+                    LogError("Failure: retrieve device topic info");
                 }
                 else
                 {
-                    DEVICE_METHOD_INFO* dev_method_info = malloc(sizeof(DEVICE_METHOD_INFO) );
+                    /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_020: [ The method name and request id shall be stored in a single allocation with the DEVICE_METHOD_INFO, which shall be tracked in the transport's pending method requests until responded to. ] */
+                    DEVICE_METHOD_INFO* dev_method_info = (DEVICE_METHOD_INFO*)malloc(sizeof(DEVICE_METHOD_INFO) + method_name_length + request_id_length + 2);
                     if (dev_method_info == NULL)
                     {
                         LogError("Failure: allocating DEVICE_METHOD_INFO object");
                     }
                     else
                     {
-                        dev_method_info->request_id = STRING_new();
-                        if (dev_method_info->request_id == NULL)
+                        char* method_name_value = (char*)(dev_method_info + 1);
+                        char* request_id_value = method_name_value + method_name_length + 1;
+                        (void)memcpy(method_name_value, method_name, method_name_length);
+                        method_name_value[method_name_length] = '\0';
+                        (void)memcpy(request_id_value, request_id, request_id_length);
+                        request_id_value[request_id_length] = '\0';
+                        dev_method_info->request_id = request_id_value;
+                        dev_method_info->in_method_callback = true;
+                        dev_method_info->responded = false;
+                        DList_InsertTailList(&transportData->pending_method_requests, &dev_method_info->entry);
+
+                        /* CodesSRS_IOTHUB_MQTT_TRANSPORT_07_053: [ If type is IOTHUB_TYPE_DEVICE_METHODS, then on success mqtt_notification_callback shall call IoTHubClient_LL_DeviceMethodComplete. ] */
+                        const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
+                        int method_complete_result = IoTHubClient_LL_DeviceMethodComplete(transportData->llClientHandle, method_name_value, payload->message, payload->length, (void*)dev_method_info);
+                        dev_method_info->in_method_callback = false;
+                        if (method_complete_result != 0)
                         {
-                            LogError("Failure constructing request_id string");
+                            LogError("Failure: IoTHubClient_LL_DeviceMethodComplete");
+                            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_021: [ If IoTHubClient_LL_DeviceMethodComplete fails, the DEVICE_METHOD_INFO shall be freed and removed from the pending method requests unless a response was already sent for it. ] */
+                            if (!dev_method_info->responded)
+                            {
+                                (void)DList_RemoveEntryList(&dev_method_info->entry);
+                            }
                             free(dev_method_info);
                         }
-                        else if (retrieve_device_method_rid_info(topic_resp, method_name, dev_method_info->request_id) != 0)
+                        else if (dev_method_info->responded)
                         {
-                            LogError("Failure: retrieve device topic info");
-                            STRING_delete(dev_method_info->request_id);
+                            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_023: [ If the response was sent from within IoTHubClient_LL_DeviceMethodComplete, the DEVICE_METHOD_INFO shall be freed once IoTHubClient_LL_DeviceMethodComplete returns. ] */
                             free(dev_method_info);
                         }
-                        else
-                        {
-                            /* CodesSRS_IOTHUB_MQTT_TRANSPORT_07_053: [ If type is IOTHUB_TYPE_DEVICE_METHODS, then on success mqtt_notification_callback shall call IoTHubClient_LL_DeviceMethodComplete. ] */
-                            const APP_PAYLOAD* payload = mqttmessage_getApplicationMsg(msgHandle);
-                            if (IoTHubClient_LL_DeviceMethodComplete(transportData->llClientHandle, STRING_c_str(method_name), payload->message, payload->length, (void*)dev_method_info) != 0)
-                            {
-                                LogError("Failure: IoTHubClient_LL_DeviceMethodComplete");
-                                STRING_delete(dev_method_info->request_id);
-                                free(dev_method_info);
-                            }
-                        }
                     }
-                    STRING_delete(method_name);
                 }
             }
             else
@@ -1890,6 +1923,7 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_010: [IoTHubTransport_MQTT_Common_Create shall allocate memory to save its internal state where all topics, hostname, device_id, device_key, sasTokenSr and client handle shall be saved.] */
                         DList_InitializeListHead(&(state->telemetry_waitingForAck));
                         DList_InitializeListHead(&(state->ack_waiting_queue));
+                        DList_InitializeListHead(&(state->pending_method_requests));
                         state->isDestroyCalled = false;
                         state->isRegistered = false;
                         state->mqttClientStatus = MQTT_CLIENT_STATUS_NOT_CONNECTED;
@@ -1910,6 +1944,7 @@ static PMQTTTRANSPORT_HANDLE_DATA InitializeTransportHandleData(const IOTHUB_CLI
                         state->topics_ToSubscribe = UNSUBSCRIBE_FROM_TOPIC;
                         state->topic_DeviceMethods = NULL;
                         state->log_trace = state->raw_trace = false;
+                        state->telemetry_at_most_once = false;
                         srand((unsigned int)get_time(NULL));
                         state->authorization_module = auth_module;
                         state->isProductInfoSet = false;
@@ -2024,6 +2059,13 @@ void IoTHubTransport_MQTT_Common_Destroy(TRANSPORT_LL_HANDLE handle)
             IoTHubClient_LL_ReportedStateComplete(transport_data->llClientHandle, mqtt_device_twin->iothub_msg_id, STATUS_CODE_TIMEOUT_VALUE);
             free(mqtt_device_twin);
         }
+        /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_022: [ IoTHubTransport_MQTT_Common_Destroy shall free any device method request that has not been responded to. ] */
+        while (!DList_IsListEmpty(&transport_data->pending_method_requests))
+        {
+            PDLIST_ENTRY currentEntry = DList_RemoveHeadList(&transport_data->pending_method_requests);
+            DEVICE_METHOD_INFO* dev_method_info = containingRecord(currentEntry, DEVICE_METHOD_INFO, entry);
+            free(dev_method_info);
+        }
 
         STRING_delete(transport_data->devicesPath);
 
@@ -2246,8 +2288,16 @@ int IoTHubTransport_MQTT_Common_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handl
             {
                 result = 0;
             }
-            STRING_delete(dev_method_info->request_id);
-            free(dev_method_info);
+            (void)DList_RemoveEntryList(&dev_method_info->entry);
+            if (dev_method_info->in_method_callback)
+            {
+                // Still referenced by mqtt_notification_callback, which frees it when IoTHubClient_LL_DeviceMethodComplete returns
+                dev_method_info->responded = true;
+            }
+            else
+            {
+                free(dev_method_info);
+            }
         }
     }
     else
@@ -2490,6 +2540,19 @@ void IoTHubTransport_MQTT_Common_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIEN
                     {
                         LogError("Failure result from IoTHubMessage_GetData");
                     }
+                    else if (transport_data->telemetry_at_most_once)
+                    {
+                        (void)(DList_RemoveEntryList(currentListEntry));
+                        if (publish_mqtt_telemetry_msg_with_qos(transport_data, iothubMsgList->messageHandle, DELIVER_AT_MOST_ONCE, NULL, messagePayload, messageLength) != 0)
+                        {
+                            sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+                        }
+                        else
+                        {
+                            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_016: [ Telemetry sent at most once shall not be added to the list of messages waiting for acknowledgement and shall be completed with IOTHUB_CLIENT_CONFIRMATION_OK as soon as mqtt_client_publish succeeds ] */
+                            sendMsgComplete(iothubMsgList, transport_data, IOTHUB_CLIENT_CONFIRMATION_OK);
+                        }
+                    }
                     else
                     {
                         /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_029: [IoTHubTransport_MQTT_Common_DoWork shall create a MQTT_MESSAGE_HANDLE and pass this to a call to mqtt_client_publish.] */
@@ -2585,6 +2648,12 @@ IOTHUB_CLIENT_RESULT IoTHubTransport_MQTT_Common_SetOption(TRANSPORT_LL_HANDLE h
             mqtt_client_set_trace(transport_data->mqttClient, transport_data->log_trace, transport_data->raw_trace);
             result = IOTHUB_CLIENT_OK;
         }
+        else if (strcmp(OPTION_TELEMETRY_AT_MOST_ONCE, option) == 0)
+        {
+            /* Codes_SRS_IOTHUB_TRANSPORT_MQTT_COMMON_09_014: [ If the option parameter is set to "telemetry_at_most_once" then the value shall be a bool_ptr and the value will determine if telemetry is published with QOS DELIVER_AT_MOST_ONCE. ] */
+            transport_data->telemetry_at_most_once = *((bool*)value);
+            result = IOTHUB_CLIENT_OK;
+        }
         else if (strcmp(OPTION_KEEP_ALIVE, option) == 0)
         {
             /* Codes_SRS_IOTHUB_MQTT_TRANSPORT_07_036: [If the option parameter is set to "keepalive" then the value shall be a int_ptr and the value will determine the mqtt keepalive time that is set for pings.] */
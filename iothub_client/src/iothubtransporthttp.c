@@ -2,6 +2,8 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "azure_c_shared_utility/gballoc.h"
 
 #include <time.h>
@@ -10,6 +12,8 @@
 #include "iothub_client_private.h"
 #include "iothub_transport_ll.h"
 #include "iothubtransporthttp.h"
+#include "hash_index.h"
+#include "iothubtransport_http_common.h"
 
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
@@ -18,42 +22,36 @@
 #include "azure_c_shared_utility/httpapiex.h"
 #include "azure_c_shared_utility/httpapiexsas.h"
 #include "azure_c_shared_utility/strings.h"
-#include "azure_c_shared_utility/base64.h"
 #include "azure_c_shared_utility/doublylinkedlist.h"
 #include "azure_c_shared_utility/vector.h"
 #include "azure_c_shared_utility/httpheaders.h"
 #include "azure_c_shared_utility/agenttime.h"
 
-#define IOTHUB_APP_PREFIX "iothub-app-"
 static const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
 static const char* IOTHUB_CORRELATION_ID = "iothub-correlationid";
 static const char* IOTHUB_CONTENT_TYPE_D2C = "iothub-contenttype";
 static const char* IOTHUB_CONTENT_ENCODING_D2C = "iothub-contentencoding";
-static const char* IOTHUB_CONTENT_TYPE_C2D = "ContentType";
-static const char* IOTHUB_CONTENT_ENCODING_C2D = "ContentEncoding";
 
 #define CONTENT_TYPE "Content-Type"
 #define APPLICATION_OCTET_STREAM "application/octet-stream"
 #define APPLICATION_VND_MICROSOFT_IOTHUB_JSON "application/vnd.microsoft.iothub.json"
 
-/*DEFAULT_GETMINIMUMPOLLINGTIME is the minimum time in seconds allowed between 2 consecutive GET issues to the service (GET=fetch messages)*/
-/*the default is 25 minutes*/
-#define DEFAULT_GETMINIMUMPOLLINGTIME ((unsigned int)25*60) 
-
 #define MAXIMUM_MESSAGE_SIZE (255*1024-1)
 #define MAXIMUM_PAYLOAD_OVERHEAD 384
 #define MAXIMUM_PROPERTY_OVERHEAD 16
 
-/*forward declaration*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count);
-
 typedef struct HTTPTRANSPORT_HANDLE_DATA_TAG
 {
     STRING_HANDLE hostName;
     HTTPAPIEX_HANDLE httpApiExHandle;
     bool doBatchedTransfers;
     unsigned int getMinimumPollingTime;
+    unsigned int getMaximumPollingTime;
     VECTOR_HANDLE perDeviceList;
+    HASH_INDEX_HANDLE perDeviceIndex;
+    size_t nextDeviceToService; /*index in perDeviceList where the next DoWork round-robin starts*/
+    bool isConnectionLost; /*set when the shared connection could not be recovered during the current DoWork*/
+    size_t registeredDeviceCount; /*devices registered so far, it gives each new device its polling phase*/
 }HTTPTRANSPORT_HANDLE_DATA;
 
 typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
@@ -71,7 +69,13 @@ typedef struct HTTPTRANSPORT_PERDEVICE_DATA_TAG
     HTTPAPIEX_SAS_HANDLE sasObject;
     bool DoWork_PullMessage;
     time_t lastPollTime;
-    bool isFirstPoll;
+    bool isPollDue; /*the next GET does not wait for the polling interval (first GET, or the last GET received a message)*/
+    unsigned int pollingInterval; /*seconds to wait after lastPollTime before the next GET*/
+    unsigned int pollingBaseInterval; /*pollingInterval before jitter is added, the value that doubles when backing off*/
+    size_t pollingPhaseIndex; /*order in which the device was registered, it offsets its first polling interval*/
+    bool isPollingPhaseOffsetDue; /*the next polling interval is the first one, and gets the polling phase offset added*/
+    char* propertyHeaderName; /*"iothub-app-" followed by the name of the property being added to the event HTTP request headers*/
+    size_t propertyHeaderNameSize;
 
     IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
     PDLIST_ENTRY waitingToSend;
@@ -172,22 +176,7 @@ static void destroy_eventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handle
     handleData->eventHTTPrequestHeaders = NULL;
 }
 
-static HTTP_HEADERS_RESULT addUserAgentHeaderInfo(IOTHUB_CLIENT_LL_HANDLE hClient, HTTP_HEADERS_HANDLE eventHTTPrequestHeaders)
-{
-    void* product_info;
-    HTTP_HEADERS_RESULT result;
-    if ((IoTHubClient_LL_GetOption(hClient, OPTION_PRODUCT_INFO, &product_info) == IOTHUB_CLIENT_ERROR) || (product_info == NULL))
-    {
-        result = HTTPHeaders_AddHeaderNameValuePair(eventHTTPrequestHeaders, "User-Agent", CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION);
-    }
-    else
-    {
-        result = HTTPHeaders_AddHeaderNameValuePair(eventHTTPrequestHeaders, "User-Agent", STRING_c_str((STRING_HANDLE)product_info));
-    }
-    return result;
-}
-
-static bool create_eventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData, const char * deviceId, bool is_x509_used)
+static bool create_eventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData, const char * deviceId, const char* authorization, bool is_x509_used)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_021: [ IoTHubTransportHttp_Register shall create a set of HTTP headers (further called "event HTTP request headers") consisting of the following fixed field names and values: "iothub-to":"/devices/" + URL_ENCODED(deviceId) + "/messages/events"; "Authorization":""
     "Accept":"application/json"
@@ -225,10 +214,10 @@ static bool create_eventHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleD
             {
                 if (!(
                     (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, "iothub-to", STRING_c_str(temp)) == HTTP_HEADERS_OK) &&
-                    (is_x509_used || (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, "Authorization", " ") == HTTP_HEADERS_OK)) &&
+                    (is_x509_used || (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, "Authorization", authorization) == HTTP_HEADERS_OK)) &&
                     (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, "Accept", "application/json") == HTTP_HEADERS_OK) &&
                     (HTTPHeaders_AddHeaderNameValuePair(handleData->eventHTTPrequestHeaders, "Connection", "Keep-Alive") == HTTP_HEADERS_OK) &&
-                    (addUserAgentHeaderInfo(handleData->iotHubClientHandle, handleData->eventHTTPrequestHeaders) == HTTP_HEADERS_OK)
+                    (IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(handleData->iotHubClientHandle, handleData->eventHTTPrequestHeaders) == HTTP_HEADERS_OK)
                     ))
                 {
                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_022: [ If creating the event HTTP request headers fails, then IoTHubTransportHttp_Register shall fail and return NULL.] */
@@ -254,7 +243,7 @@ static void destroy_messageHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* hand
     handleData->messageHTTPrequestHeaders = NULL;
 }
 
-static bool create_messageHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData, bool is_x509_used)
+static bool create_messageHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handleData, const char* authorization, bool is_x509_used)
 {
     /*Codes_SRS_TRANSPORTMULTITHTTP_17_132: [ IoTHubTransportHttp_Register shall create a set of HTTP headers (further called "message HTTP request headers") consisting of the following fixed field names and values:
     "Authorization": "" ]*/
@@ -268,8 +257,8 @@ static bool create_messageHTTPrequestHeaders(HTTPTRANSPORT_PERDEVICE_DATA* handl
     else
     {
         if (!(
-            (addUserAgentHeaderInfo(handleData->iotHubClientHandle, handleData->eventHTTPrequestHeaders) == HTTP_HEADERS_OK) &&
-            (is_x509_used || (HTTPHeaders_AddHeaderNameValuePair(handleData->messageHTTPrequestHeaders, "Authorization", " ") == HTTP_HEADERS_OK))
+            (IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(handleData->iotHubClientHandle, handleData->eventHTTPrequestHeaders) == HTTP_HEADERS_OK) &&
+            (is_x509_used || (HTTPHeaders_AddHeaderNameValuePair(handleData->messageHTTPrequestHeaders, "Authorization", authorization) == HTTP_HEADERS_OK))
             ))
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_023: [ If creating message HTTP request headers then IoTHubTransportHttp_Register shall fail and return NULL. ]*/
@@ -478,10 +467,9 @@ static bool create_deviceSasToken(HTTPTRANSPORT_PERDEVICE_DATA* handleData, cons
 }
 
 /*
-* List queries  Find by handle and find by device name
+* List queries  Find by handle (devices are found by name through perDeviceIndex)
 */
 
-/*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]*/
 static bool findDeviceHandle(const void* element, const void* value)
 {
     bool result;
@@ -492,17 +480,6 @@ static bool findDeviceHandle(const void* element, const void* value)
     return result;
 }
 
-static bool findDeviceById(const void* element, const void* value)
-{
-    bool result;
-    const char* deviceId = (const char *)value;
-    const HTTPTRANSPORT_PERDEVICE_DATA * perDeviceElement = *(const HTTPTRANSPORT_PERDEVICE_DATA **)element;
-
-    result = (strcmp(STRING_c_str(perDeviceElement->deviceId), deviceId) == 0);
-
-    return result;
-}
-
 static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
 {
     HTTPTRANSPORT_PERDEVICE_DATA* result;
@@ -526,8 +503,8 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
     {
         HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]*/
-        void* listItem = VECTOR_find_if(handleData->perDeviceList, findDeviceById, device->deviceId);
-        if (listItem != NULL)
+        /*Codes_SRS_TRANSPORTMULTITHTTP_09_001: [ IoTHubTransportHttp_Register shall look deviceId up in the devices index by calling hash_index_find. ]*/
+        if (hash_index_find(handleData->perDeviceIndex, device->deviceId) != NULL)
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]*/
             LogError("Transport already has device registered by id: [%s]", device->deviceId);
@@ -573,16 +550,18 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
             bool was_eventHTTPrelativePath_ok = (was_create_deviceKey_ok || was_create_deviceSasToken_ok || was_x509_ok) && create_eventHTTPrelativePath(result, device->deviceId);
             bool was_messageHTTPrelativePath_ok = was_eventHTTPrelativePath_ok && create_messageHTTPrelativePath(result, device->deviceId);
             bool was_eventHTTPrequestHeaders_ok;
+            /*Codes_SRS_TRANSPORTMULTITHTTP_09_014: [ If a deviceSasToken exists, the "Authorization" header of the event HTTP request headers and of the message HTTP request headers shall be set to it, instead of "". ]*/
+            const char* authorization = (device->deviceSasToken != NULL) ? device->deviceSasToken : " ";
             if (was_messageHTTPrelativePath_ok)
             {
                 result->iotHubClientHandle = iotHubClientHandle;
-                was_eventHTTPrequestHeaders_ok = create_eventHTTPrequestHeaders(result, device->deviceId, was_x509_ok);
+                was_eventHTTPrequestHeaders_ok = create_eventHTTPrequestHeaders(result, device->deviceId, authorization, was_x509_ok);
             }
             else
             {
                 was_eventHTTPrequestHeaders_ok = false;
             }
-            bool was_messageHTTPrequestHeaders_ok = was_eventHTTPrequestHeaders_ok && create_messageHTTPrequestHeaders(result, was_x509_ok);
+            bool was_messageHTTPrequestHeaders_ok = was_eventHTTPrequestHeaders_ok && create_messageHTTPrequestHeaders(result, authorization, was_x509_ok);
             bool was_abandonHTTPrelativePathBegin_ok = was_messageHTTPrequestHeaders_ok && create_abandonHTTPrelativePathBegin(result, device->deviceId);
 
             if (was_x509_ok)
@@ -598,8 +577,10 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 }
             }
 
+            /*Codes_SRS_TRANSPORTMULTITHTTP_09_002: [ IoTHubTransportHttp_Register shall index the new device by deviceId by calling hash_index_add. ]*/
+            bool was_index_add_ok = (was_sasObject_ok || was_create_deviceSasToken_ok || was_x509_ok) && (hash_index_add(handleData->perDeviceIndex, device->deviceId, result) == 0);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_041: [ IoTHubTransportHttp_Register shall call VECTOR_push_back to store the new device information. ]*/
-            bool was_list_add_ok = (was_sasObject_ok || was_create_deviceSasToken_ok || was_x509_ok) && (VECTOR_push_back(handleData->perDeviceList, &result, 1) == 0);
+            bool was_list_add_ok = was_index_add_ok && (VECTOR_push_back(handleData->perDeviceList, &result, 1) == 0);
 
             if (was_list_add_ok)
             {
@@ -607,7 +588,13 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_040: [ IoTHubTransportHttp_Register shall put event HTTP relative path, message HTTP relative path, event HTTP request headers, message HTTP request headers, abandonHTTPrelativePathBegin, HTTPAPIEX_SAS_HANDLE, and the device handle into a device structure. ]*/
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]*/
                 result->DoWork_PullMessage = false;
-                result->isFirstPoll = true;
+                result->isPollDue = true;
+                result->pollingInterval = 0;
+                result->pollingBaseInterval = 0;
+                result->pollingPhaseIndex = handleData->registeredDeviceCount++;
+                result->isPollingPhaseOffsetDue = true;
+                result->propertyHeaderName = NULL;
+                result->propertyHeaderNameSize = 0;
                 result->waitingToSend = waitingToSend;
                 DList_InitializeListHead(&(result->eventConfirmations));
                 result->transportHandle = (HTTPTRANSPORT_HANDLE_DATA *) handle;
@@ -615,6 +602,8 @@ static IOTHUB_DEVICE_HANDLE IoTHubTransportHttp_Register(TRANSPORT_LL_HANDLE han
             else
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_042: [ If the singlylinkedlist_add fails then IoTHubTransportHttp_Register shall fail and return NULL. ]*/
+                /*Codes_SRS_TRANSPORTMULTITHTTP_09_003: [ If hash_index_add fails then IoTHubTransportHttp_Register shall fail and return NULL. ]*/
+                if (was_index_add_ok) (void)hash_index_remove(handleData->perDeviceIndex, device->deviceId);
                 if (was_sasObject_ok) destroy_SASObject(result);
                 if (was_abandonHTTPrelativePathBegin_ok) destroy_abandonHTTPrelativePathBegin(result);
                 if (was_messageHTTPrelativePath_ok) destroy_messageHTTPrelativePath(result);
@@ -646,27 +635,32 @@ static void destroy_perDeviceData(HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem)
     destroy_messageHTTPrequestHeaders(perDeviceItem);
     destroy_abandonHTTPrelativePathBegin(perDeviceItem);
     destroy_SASObject(perDeviceItem);
+    if (perDeviceItem->propertyHeaderName != NULL)
+    {
+        free(perDeviceItem->propertyHeaderName);
+        perDeviceItem->propertyHeaderName = NULL;
+    }
 }
 
-static IOTHUB_DEVICE_HANDLE* get_perDeviceDataItem(IOTHUB_DEVICE_HANDLE deviceHandle)
+static HTTPTRANSPORT_PERDEVICE_DATA* get_perDeviceDataItem(IOTHUB_DEVICE_HANDLE deviceHandle)
 {
     HTTPTRANSPORT_PERDEVICE_DATA* deviceHandleData = (HTTPTRANSPORT_PERDEVICE_DATA*)deviceHandle;
-    IOTHUB_DEVICE_HANDLE* listItem;
+    HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem;
 
     HTTPTRANSPORT_HANDLE_DATA* handleData = deviceHandleData->transportHandle;
 
-    listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_find_if(handleData->perDeviceList, findDeviceHandle, deviceHandle);
-    if (listItem == NULL)
+    perDeviceItem = (HTTPTRANSPORT_PERDEVICE_DATA*)hash_index_find(handleData->perDeviceIndex, STRING_c_str(deviceHandleData->deviceId));
+    if (perDeviceItem != deviceHandleData)
     {
         LogError("device handle not found in transport device list");
-        listItem = NULL;
+        perDeviceItem = NULL;
     }
     else
     {
         /* sucessfully found device in list. */
     }
 
-    return listItem;
+    return perDeviceItem;
 }
 
 static void IoTHubTransportHttp_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
@@ -681,7 +675,7 @@ static void IoTHubTransportHttp_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
         HTTPTRANSPORT_PERDEVICE_DATA* deviceHandleData = (HTTPTRANSPORT_PERDEVICE_DATA*)deviceHandle;
         HTTPTRANSPORT_HANDLE_DATA* handleData = deviceHandleData->transportHandle;
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_045: [ IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
-        IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(deviceHandle);
+        IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_find_if(handleData->perDeviceList, findDeviceHandle, deviceHandle);
         if (listItem == NULL)
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_046: [ If the device structure is not found, then this function shall fail and do nothing. ]*/
@@ -691,6 +685,8 @@ static void IoTHubTransportHttp_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
         {
             HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem = (HTTPTRANSPORT_PERDEVICE_DATA *)(*listItem);
 
+            /*Codes_SRS_TRANSPORTMULTITHTTP_09_004: [ IoTHubTransportHttp_Unregister shall remove the device from the devices index by calling hash_index_remove. ]*/
+            (void)hash_index_remove(handleData->perDeviceIndex, STRING_c_str(perDeviceItem->deviceId));
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_047: [ IoTHubTransportHttp_Unregister shall free all the resources used in the device structure. ]*/
             destroy_perDeviceData(perDeviceItem);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_048: [ IoTHubTransportHttp_Unregister shall call singlylinkedlist_remove to remove device from devices list. ]*/
@@ -777,6 +773,12 @@ static void destroy_perDeviceList(HTTPTRANSPORT_HANDLE_DATA* handleData)
     handleData->perDeviceList = NULL;
 }
 
+static void destroy_perDeviceIndex(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    hash_index_destroy(handleData->perDeviceIndex);
+    handleData->perDeviceIndex = NULL;
+}
+
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_009: [ IoTHubTransportHttp_Create shall call singlylinkedlist_create to create a list of registered devices. ]*/
 static bool create_perDeviceList(HTTPTRANSPORT_HANDLE_DATA* handleData)
 {
@@ -794,6 +796,23 @@ static bool create_perDeviceList(HTTPTRANSPORT_HANDLE_DATA* handleData)
     return result;
 }
 
+/*Codes_SRS_TRANSPORTMULTITHTTP_09_005: [ IoTHubTransportHttp_Create shall call hash_index_create to create an index of the registered devices by device id. ]*/
+static bool create_perDeviceIndex(HTTPTRANSPORT_HANDLE_DATA* handleData)
+{
+    bool result;
+    handleData->perDeviceIndex = hash_index_create(0);
+    if (handleData->perDeviceIndex == NULL)
+    {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_09_006: [ If creating the index fails, then IoTHubTransportHttp_Create shall fail and return NULL. ]*/
+        result = false;
+    }
+    else
+    {
+        result = true;
+    }
+    return result;
+}
+
 
 static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONFIG* config)
 {
@@ -842,16 +861,22 @@ static TRANSPORT_LL_HANDLE IoTHubTransportHttp_Create(const IOTHUBTRANSPORT_CONF
             bool was_hostName_ok = create_hostName(result, config);
             bool was_httpApiExHandle_ok = was_hostName_ok && create_httpApiExHandle(result, config);
             bool was_perDeviceList_ok = was_httpApiExHandle_ok && create_perDeviceList(result);
+            bool was_perDeviceIndex_ok = was_perDeviceList_ok && create_perDeviceIndex(result);
 
 
-            if (was_perDeviceList_ok)
+            if (was_perDeviceIndex_ok)
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]*/
                 result->doBatchedTransfers = false;
                 result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+                result->getMaximumPollingTime = DEFAULT_GETMAXIMUMPOLLINGTIME;
+                result->nextDeviceToService = 0;
+                result->isConnectionLost = false;
+                result->registeredDeviceCount = 0;
             }
             else
             {
+                if (was_perDeviceList_ok) destroy_perDeviceList(result);
                 if (was_httpApiExHandle_ok) destroy_httpApiExHandle(result);
                 if (was_hostName_ok) destroy_hostName(result);
 
@@ -885,6 +910,7 @@ static void IoTHubTransportHttp_Destroy(TRANSPORT_LL_HANDLE handle)
         destroy_hostName((HTTPTRANSPORT_HANDLE_DATA *) handle);
         destroy_httpApiExHandle((HTTPTRANSPORT_HANDLE_DATA *) handle);
         destroy_perDeviceList((HTTPTRANSPORT_HANDLE_DATA *)handle);
+        destroy_perDeviceIndex((HTTPTRANSPORT_HANDLE_DATA *)handle);
         free(handle);
     }
 }
@@ -901,9 +927,9 @@ static int IoTHubTransportHttp_Subscribe(IOTHUB_DEVICE_HANDLE handle)
     else
     {
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_104: [ IoTHubTransportHttp_Subscribe shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
-        IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(handle);
+        HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = get_perDeviceDataItem(handle);
 
-        if (listItem == NULL)
+        if (perDeviceItem == NULL)
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_105: [ If the device structure is not found, then this function shall fail and return a non-zero value. ]*/
             LogError("did not find device in transport handle");
@@ -911,9 +937,6 @@ static int IoTHubTransportHttp_Subscribe(IOTHUB_DEVICE_HANDLE handle)
         }
         else
         {
-            HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem;
-
-            perDeviceItem = (HTTPTRANSPORT_PERDEVICE_DATA *)(*listItem);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_106: [ Otherwise, IoTHubTransportHttp_Subscribe shall set the device so that subsequent calls to DoWork should execute HTTP requests. ]*/
             perDeviceItem->DoWork_PullMessage = true;
         }
@@ -928,11 +951,10 @@ static void IoTHubTransportHttp_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
     if (handle != NULL)
     {
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_108: [ IoTHubTransportHttp_Unsubscribe shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
-        IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(handle);
+        HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = get_perDeviceDataItem(handle);
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_109: [ If the device structure is not found, then this function shall fail and do nothing. ]*/
-        if (listItem != NULL)
+        if (perDeviceItem != NULL)
         {
-            HTTPTRANSPORT_PERDEVICE_DATA * perDeviceItem = (HTTPTRANSPORT_PERDEVICE_DATA *)(*listItem);
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_110: [ Otherwise, IoTHubTransportHttp_Subscribe shall set the device so that subsequent calls to DoWork shall not execute HTTP requests. ]*/
             perDeviceItem->DoWork_PullMessage = false;
         }
@@ -988,229 +1010,236 @@ static int IoTHubTransportHttp_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle
     return __FAILURE__;
 }
 
-/*produces a representation of the properties, if they exist*/
-/*if they do not exist, produces ""*/
-static int concat_Properties(STRING_HANDLE existing, MAP_HANDLE map, size_t* propertiesMessageSizeContribution)
+#define EVENT_BODY_BEGIN "{\"body\":\""
+#define EVENT_BODY_END "\""
+#define EVENT_STRING_BODY_BEGIN "{\"body\":"
+#define EVENT_STRING_BODY_END ",\"base64Encoded\":false"
+#define EVENT_PROPERTIES_BEGIN ",\"properties\":{"
+#define EVENT_PROPERTY_NAME_BEGIN "\"" IOTHUB_APP_PREFIX
+#define EVENT_PROPERTY_NAME_END "\":\""
+#define EVENT_PROPERTY_VALUE_END "\""
+#define EVENT_END "}"
+#define LITERAL_LENGTH(literal) (sizeof(literal) - 1)
+/*a batch of events, serialized as a JSON array straight into 1 growable buffer*/
+typedef struct EVENT_PAYLOAD_TAG
 {
-    int result;
-    const char*const* keys;
-    const char*const* values;
+    char* content;
+    size_t length;
+    size_t capacity;
+} EVENT_PAYLOAD;
+
+/*everything needed to account for and serialize 1 event, gathered before any encoding happens*/
+typedef struct EVENT_ITEM_TAG
+{
+    IOTHUB_MESSAGE_HANDLE messageHandle;
+    IOTHUBMESSAGE_CONTENT_TYPE contentType;
+    const unsigned char* source;
+    size_t size;
+    const char* const* keys;
+    const char* const* values;
     size_t count;
-    if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+    size_t propertiesLength;
+    size_t messageSizeContribution;
+} EVENT_ITEM;
+
+static int reserveEventPayload(EVENT_PAYLOAD* payload, size_t extraLength)
+{
+    int result;
+    size_t neededCapacity = payload->length + extraLength;
+    if (neededCapacity <= payload->capacity)
     {
-        result = __FAILURE__;
-        LogError("error while Map_GetInternals");
+        result = 0;
     }
     else
     {
-
-        if (count == 0)
+        /*growing geometrically keeps the batch building linear in the number of bytes*/
+        size_t newCapacity = (payload->capacity * 2 > neededCapacity) ? (payload->capacity * 2) : neededCapacity;
+        char* newContent = (char*)realloc(payload->content, newCapacity);
+        if (newContent == NULL)
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
-            /*no properties - do nothing with existing*/
-            result = 0;
-            *propertiesMessageSizeContribution = 0;
+            LogError("unable to realloc");
+            result = __FAILURE__;
         }
         else
         {
-            /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
-            if (STRING_concat(existing, ",\"properties\":") != 0)
-            {
-                /*go ahead and return it*/
-                result = __FAILURE__;
-                LogError("failed STRING_concat");
-            }
-            else if (appendMapToJSON(existing, keys, values, count) != 0)
-            {
-                result = __FAILURE__;
-                LogError("unable to append the properties");
-            }
-            else
-            {
-                /*all is fine*/
-                size_t i;
-                *propertiesMessageSizeContribution = 0;
-                for (i = 0;i < count;i++)
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
-                    *propertiesMessageSizeContribution += (strlen(keys[i]) + strlen(values[i]) + MAXIMUM_PROPERTY_OVERHEAD);
-                }
-                result = 0;
-            }
+            payload->content = newContent;
+            payload->capacity = newCapacity;
+            result = 0;
         }
     }
     return result;
 }
 
-/*produces a JSON representation of the map : {"a": "value_of_a","b":"value_of_b"}*/
-static int appendMapToJSON(STRING_HANDLE existing, const char* const* keys, const char* const* values, size_t count) /*under consideration: move to MAP module when it has more than 1 user*/
+/*the space needed has always been reserved by the caller*/
+static void appendToEventPayload(EVENT_PAYLOAD* payload, const char* source, size_t length)
 {
-    int result;
-    if (STRING_concat(existing, "{") != 0)
-    {
-        /*go on and return it*/
-        LogError("STRING_construct failed");
-        result = __FAILURE__;
-    }
-    else
+    (void)memcpy(payload->content + payload->length, source, length);
+    payload->length += length;
+}
+
+static void appendBase64ToEventPayload(EVENT_PAYLOAD* payload, const unsigned char* source, size_t size)
+{
+    payload->length += IoTHubTransport_HTTP_Common_EncodeBase64(payload->content + payload->length, source, size);
+}
+
+/*produces the representation of the properties, if they exist: ,"properties":{"iothub-app-a":"valueOfA"}*/
+/*if they do not exist, produces ""*/
+static void appendPropertiesToEventPayload(EVENT_PAYLOAD* payload, const EVENT_ITEM* eventItem)
+{
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_064: [If IoTHubMessage does not have properties, then "properties":{...} shall be missing from the payload*/
+    if (eventItem->count > 0)
     {
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_058: [If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2*/
         size_t i;
-        for (i = 0; i < count; i++)
+        appendToEventPayload(payload, EVENT_PROPERTIES_BEGIN, LITERAL_LENGTH(EVENT_PROPERTIES_BEGIN));
+        for (i = 0; i < eventItem->count; i++)
         {
-            if (!(
-                (STRING_concat(existing, (i == 0) ? "\"" IOTHUB_APP_PREFIX : ",\"" IOTHUB_APP_PREFIX) == 0) &&
-                (STRING_concat(existing, keys[i]) == 0) &&
-                (STRING_concat(existing, "\":\"") == 0) &&
-                (STRING_concat(existing, values[i]) == 0) &&
-                (STRING_concat(existing, "\"") == 0)
-                ))
+            if (i > 0)
             {
-                LogError("unable to STRING_concat");
-                break;
+                appendToEventPayload(payload, ",", 1);
             }
+            appendToEventPayload(payload, EVENT_PROPERTY_NAME_BEGIN, LITERAL_LENGTH(EVENT_PROPERTY_NAME_BEGIN));
+            appendToEventPayload(payload, eventItem->keys[i], strlen(eventItem->keys[i]));
+            appendToEventPayload(payload, EVENT_PROPERTY_NAME_END, LITERAL_LENGTH(EVENT_PROPERTY_NAME_END));
+            appendToEventPayload(payload, eventItem->values[i], strlen(eventItem->values[i]));
+            appendToEventPayload(payload, EVENT_PROPERTY_VALUE_END, LITERAL_LENGTH(EVENT_PROPERTY_VALUE_END));
         }
+        appendToEventPayload(payload, EVENT_END, LITERAL_LENGTH(EVENT_END));
+    }
+}
+
+/*collects the content and the properties of the message and computes its contribution to the message size, without encoding anything*/
+static int getEventItem(PDLIST_ENTRY item, EVENT_ITEM* eventItem)
+{
+    int result;
+    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
+    eventItem->messageHandle = message->messageHandle;
+    eventItem->contentType = IoTHubMessage_GetContentType(message->messageHandle);
 
-        if (i < count)
+    switch (eventItem->contentType)
+    {
+    case IOTHUBMESSAGE_BYTEARRAY:
+    {
+        if (IoTHubMessage_GetByteArray(message->messageHandle, &eventItem->source, &eventItem->size) != IOTHUB_MESSAGE_OK)
         {
+            LogError("unable to get the data for the message.");
             result = __FAILURE__;
-            /*error, let it go through*/
         }
-        else if (STRING_concat(existing, "}") != 0)
+        else
         {
-            LogError("unable to STRING_concat");
+            result = 0;
+        }
+        break;
+    }
+    /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
+    case IOTHUBMESSAGE_STRING:
+    {
+        const char* source = IoTHubMessage_GetString(message->messageHandle);
+        if (source == NULL)
+        {
+            LogError("unable to IoTHubMessage_GetString");
             result = __FAILURE__;
         }
         else
         {
-            /*all is fine*/
+            eventItem->source = (const unsigned char*)source;
+            eventItem->size = strlen(source);
             result = 0;
         }
+        break;
+    }
+    default:
+    {
+        LogError("an unknown message type was encountered (%d)", eventItem->contentType);
+        result = __FAILURE__; /*unknown message type*/
+        break;
     }
+    }
+
+    if (result == 0)
+    {
+        if (Map_GetInternals(IoTHubMessage_Properties(message->messageHandle), &eventItem->keys, &eventItem->values, &eventItem->count) != MAP_OK)
+        {
+            LogError("error while Map_GetInternals");
+            result = __FAILURE__;
+        }
+        else
+        {
+            size_t i;
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
+            eventItem->messageSizeContribution = eventItem->size + MAXIMUM_PAYLOAD_OVERHEAD;
+            eventItem->propertiesLength = (eventItem->count == 0) ? 0 : (LITERAL_LENGTH(EVENT_PROPERTIES_BEGIN) + (eventItem->count - 1) + LITERAL_LENGTH(EVENT_END));
+            for (i = 0; i < eventItem->count; i++)
+            {
+                size_t keyLength = strlen(eventItem->keys[i]);
+                size_t valueLength = strlen(eventItem->values[i]);
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_063: [Every property name shall add to the message size the length of the property name + the length of the property value + 16 bytes.] */
+                eventItem->messageSizeContribution += (keyLength + valueLength + MAXIMUM_PROPERTY_OVERHEAD);
+                eventItem->propertiesLength += LITERAL_LENGTH(EVENT_PROPERTY_NAME_BEGIN) + keyLength + LITERAL_LENGTH(EVENT_PROPERTY_NAME_END) + valueLength + LITERAL_LENGTH(EVENT_PROPERTY_VALUE_END);
+            }
+        }
+    }
+
     return result;
 }
 
-/*makes the following string:{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-/*return NULL if there was a failure, or a non-NULL STRING_HANDLE that contains the intended data*/
-static STRING_HANDLE make1EventJSONitem(PDLIST_ENTRY item, size_t *messageSizeContribution)
+/*appends [ or , followed by {"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]} to the payload*/
+/*on failure the payload is left as it was*/
+static int appendEventItem(EVENT_PAYLOAD* payload, const EVENT_ITEM* eventItem)
 {
-    STRING_HANDLE result; /*temp wants to contain :{"body":"base64 encoding of the message content"[,"properties":{"a":"valueOfA"}]}*/
-    IOTHUB_MESSAGE_LIST* message = containingRecord(item, IOTHUB_MESSAGE_LIST, entry);
-    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
+    int result;
 
-    switch (contentType)
-    {
-    case IOTHUBMESSAGE_BYTEARRAY:
+    if (eventItem->contentType == IOTHUBMESSAGE_BYTEARRAY)
     {
-        result = STRING_construct("{\"body\":\"");
-        if (result == NULL)
+        /*1 more character is always reserved for the closing ']'*/
+        size_t itemLength = LITERAL_LENGTH(EVENT_BODY_BEGIN) + IOTHUB_BASE64_ENCODED_LENGTH(eventItem->size) + LITERAL_LENGTH(EVENT_BODY_END) + eventItem->propertiesLength + LITERAL_LENGTH(EVENT_END);
+        if (reserveEventPayload(payload, 1 + itemLength + 1) != 0)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to reserve the event payload");
+            result = __FAILURE__;
         }
         else
         {
-            const unsigned char* source;
-            size_t size;
-
-            if (IoTHubMessage_GetByteArray(message->messageHandle, &source, &size) != IOTHUB_MESSAGE_OK)
-            {
-                LogError("unable to get the data for the message.");
-                STRING_delete(result);
-                result = NULL;
-            }
-            else
-            {
-                STRING_HANDLE encoded = Base64_Encode_Bytes(source, size);
-                if (encoded == NULL)
-                {
-                    LogError("unable to Base64_Encode_Bytes.");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, encoded) == 0) &&
-                        (STRING_concat(result, "\"") == 0) && /*\" because closing value*/
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        STRING_delete(result);
-                        result = NULL;
-                        LogError("unable to STRING_concat_with_STRING.");
-                    }
-                    else
-                    {
-                        /*all is fine... */
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = size + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(encoded);
-                }
-            }
+            appendToEventPayload(payload, (payload->length == 0) ? "[" : ",", 1);
+            appendToEventPayload(payload, EVENT_BODY_BEGIN, LITERAL_LENGTH(EVENT_BODY_BEGIN));
+            appendBase64ToEventPayload(payload, eventItem->source, eventItem->size);
+            appendToEventPayload(payload, EVENT_BODY_END, LITERAL_LENGTH(EVENT_BODY_END));
+            appendPropertiesToEventPayload(payload, eventItem);
+            appendToEventPayload(payload, EVENT_END, LITERAL_LENGTH(EVENT_END));
+            result = 0;
         }
-        break;
     }
-    /*Codes_SRS_TRANSPORTMULTITHTTP_17_057: [If a messages to be send has type IOTHUBMESSAGE_STRING, then its serialization shall be {"body":"JSON encoding of the string", "base64Encoded":false}] */
-    case IOTHUBMESSAGE_STRING:
+    else
     {
-        result = STRING_construct("{\"body\":");
-        if (result == NULL)
+        STRING_HANDLE asJson = STRING_new_JSON((const char*)eventItem->source);
+        if (asJson == NULL)
         {
-            LogError("unable to STRING_construct");
+            LogError("unable to STRING_new_JSON");
+            result = __FAILURE__;
         }
         else
         {
-            const char* source = IoTHubMessage_GetString(message->messageHandle);
-            if (source == NULL)
+            size_t asJsonLength = STRING_length(asJson);
+            size_t itemLength = LITERAL_LENGTH(EVENT_STRING_BODY_BEGIN) + asJsonLength + LITERAL_LENGTH(EVENT_STRING_BODY_END) + eventItem->propertiesLength + LITERAL_LENGTH(EVENT_END);
+            if (reserveEventPayload(payload, 1 + itemLength + 1) != 0)
             {
-                LogError("unable to IoTHubMessage_GetString");
-                STRING_delete(result);
-                result = NULL;
+                LogError("unable to reserve the event payload");
+                result = __FAILURE__;
             }
             else
             {
-                STRING_HANDLE asJson = STRING_new_JSON(source);
-                if (asJson == NULL)
-                {
-                    LogError("unable to STRING_new_JSON");
-                    STRING_delete(result);
-                    result = NULL;
-                }
-                else
-                {
-                    size_t propertiesSize;
-                    if (!(
-                        (STRING_concat_with_STRING(result, asJson) == 0) &&
-                        (STRING_concat(result, ",\"base64Encoded\":false") == 0) &&
-                        (concat_Properties(result, IoTHubMessage_Properties(message->messageHandle), &propertiesSize) == 0) &&
-                        (STRING_concat(result, "},") == 0) /*the last comma shall be replaced by a ']' by DaCr's suggestion (which is awesome enough to receive credits in the source code)*/
-                        ))
-                    {
-                        LogError("unable to STRING_concat_with_STRING");
-                        STRING_delete(result);
-                        result = NULL;
-                    }
-                    else
-                    {
-                        /*result has the intended content*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_062: [The message size is computed from the length of the payload + 384.] */
-                        *messageSizeContribution = strlen(source) + MAXIMUM_PAYLOAD_OVERHEAD + propertiesSize;
-                    }
-                    STRING_delete(asJson);
-                }
+                appendToEventPayload(payload, (payload->length == 0) ? "[" : ",", 1);
+                appendToEventPayload(payload, EVENT_STRING_BODY_BEGIN, LITERAL_LENGTH(EVENT_STRING_BODY_BEGIN));
+                appendToEventPayload(payload, STRING_c_str(asJson), asJsonLength);
+                appendToEventPayload(payload, EVENT_STRING_BODY_END, LITERAL_LENGTH(EVENT_STRING_BODY_END));
+                appendPropertiesToEventPayload(payload, eventItem);
+                appendToEventPayload(payload, EVENT_END, LITERAL_LENGTH(EVENT_END));
+                result = 0;
             }
+            STRING_delete(asJson);
         }
-        break;
-    }
-    default:
-    {
-        LogError("an unknown message type was encountered (%d)", contentType);
-        result = NULL; /*unknown message type*/
-        break;
-    }
     }
+
     return result;
 }
 
@@ -1224,129 +1253,94 @@ DEFINE_ENUM(MAKE_PAYLOAD_RESULT, MAKE_PAYLOAD_RESULT_VALUES);
 
 /*this function assembles several {"body":"base64 encoding of the message content"," base64Encoded": true} into 1 payload*/
 /*Codes_SRS_TRANSPORTMULTITHTTP_17_056: [IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...]]*/
-static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, STRING_HANDLE* payload)
+/*Codes_SRS_TRANSPORTMULTITHTTP_09_009: [ The size of each message shall be checked against the message size limit before its content is encoded into the payload. ]*/
+static MAKE_PAYLOAD_RESULT makePayload(HTTPTRANSPORT_PERDEVICE_DATA* deviceData, EVENT_PAYLOAD* payload)
 {
-    MAKE_PAYLOAD_RESULT result;
+    MAKE_PAYLOAD_RESULT result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
     size_t allMessagesSize = 0;
-    *payload = STRING_construct("[");
-    if (*payload == NULL)
-    {
-        LogError("unable to STRING_construct");
-        result = MAKE_PAYLOAD_ERROR;
-    }
-    else
+    bool isFirst = true;
+    PDLIST_ENTRY actual;
+    bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
+                           /*either all the items enter the list or only some*/
+
+    payload->content = NULL;
+    payload->length = 0;
+    payload->capacity = 0;
+
+    while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
     {
-        bool isFirst = true;
-        PDLIST_ENTRY actual;
-        bool keepGoing = true; /*keepGoing gets sometimes to false from within the loop*/
-                               /*either all the items enter the list or only some*/
-        result = MAKE_PAYLOAD_OK; /*optimistically initializing it*/
-        while (keepGoing && ((actual = deviceData->waitingToSend->Flink) != deviceData->waitingToSend))
+        EVENT_ITEM eventItem;
+        if (getEventItem(actual, &eventItem) != 0)
+        {
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+            result = isFirst ? MAKE_PAYLOAD_ERROR : MAKE_PAYLOAD_OK;
+            keepGoing = false;
+        }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
+        else if (allMessagesSize + eventItem.messageSizeContribution > MAXIMUM_MESSAGE_SIZE)
         {
-            size_t messageSize;
-            STRING_HANDLE temp = make1EventJSONitem(actual, &messageSize);
             if (isFirst)
             {
-                isFirst = false;
-                /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                if (temp == NULL) /*first item failed to create, nothing to send*/
-                {
-                    result = MAKE_PAYLOAD_ERROR;
-                    STRING_delete(*payload);
-                    *payload = NULL;
-                    keepGoing = false;
-                }
-                else
-                {
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_061: [The message size shall be limited to 255KB - 1 byte.]*/
-                    if (messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
-                        STRING_delete(*payload);
-                        *payload = NULL;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        if (STRING_concat_with_STRING(*payload, temp) != 0)
-                        {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            result = MAKE_PAYLOAD_ERROR;
-                            STRING_delete(*payload);
-                            *payload = NULL;
-                            keepGoing = false;
-                        }
-                        else
-                        {
-                            /*first item was put nicely in the payload*/
-                            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                            DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                            allMessagesSize += messageSize;
-                        }
-                    }
-                    STRING_delete(temp);
-                }
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_065: [If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED.]*/
+                PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+                DList_InsertTailList(&(deviceData->eventConfirmations), head);
+                result = MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT;
             }
             else
             {
-                /*there is at least 1 item already in the payload*/
-                if (temp == NULL)
-                {
-                    /*there are multiple payloads encoded, the last one had an internal error, just go with those - closing the payload happens "after the loop"*/
-                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                    result = MAKE_PAYLOAD_OK;
-                    keepGoing = false;
-                }
-                else
-                {
-                    if (allMessagesSize + messageSize > MAXIMUM_MESSAGE_SIZE)
-                    {
-                        /*this item doesn't make it to the payload, but the payload is valid so far*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else if (STRING_concat_with_STRING(*payload, temp) != 0)
-                    {
-                        /*should still send what there is so far...*/
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
-                        result = MAKE_PAYLOAD_OK;
-                        keepGoing = false;
-                    }
-                    else
-                    {
-                        /*cool, the payload made it there, let's continue... */
-                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
-                        DList_InsertTailList(&(deviceData->eventConfirmations), head);
-                        allMessagesSize += messageSize;
-                    }
-                    STRING_delete(temp);
-                }
+                /*this item doesn't make it to the payload, but the payload is valid so far*/
+                /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+                result = MAKE_PAYLOAD_OK;
             }
+            keepGoing = false;
         }
-
-        /*closing the payload*/
-        if (result == MAKE_PAYLOAD_OK)
+        else if (appendEventItem(payload, &eventItem) != 0)
         {
-            ((char*)STRING_c_str(*payload))[STRING_length(*payload) - 1] = ']'; /*TODO - do this in STRING_HANDLE*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
+            /*Codes_SRS_TRANSPORTMULTITHTTP_17_066: [If at any point during construction of the string there are errors, IoTHubTransportHttp_DoWork shall use the so far constructed string as payload.]*/
+            result = isFirst ? MAKE_PAYLOAD_ERROR : MAKE_PAYLOAD_OK;
+            keepGoing = false;
         }
         else
         {
-            /*no need to close anything*/
+            /*cool, the item made it to the payload, let's continue... */
+            PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend); /*actually this is the same as "actual", but now it is removed*/
+            DList_InsertTailList(&(deviceData->eventConfirmations), head);
+            allMessagesSize += eventItem.messageSizeContribution;
+            isFirst = false;
         }
     }
+
+    /*closing the payload*/
+    if ((result == MAKE_PAYLOAD_OK) && (payload->length > 0))
+    {
+        /*appendEventItem always reserves the space for this*/
+        appendToEventPayload(payload, "]", 1);
+    }
+    else
+    {
+        if (result == MAKE_PAYLOAD_OK)
+        {
+            result = MAKE_PAYLOAD_NO_ITEMS;
+        }
+        free(payload->content);
+        payload->content = NULL;
+        payload->length = 0;
+        payload->capacity = 0;
+    }
+
     return result;
 }
 
-static void reversePutListBackIn(PDLIST_ENTRY source, PDLIST_ENTRY destination)
+static void checkConnectionRecovery(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPAPIEX_RESULT executeResult)
 {
-    /*this function takes a list, and inserts it in another list. When done in the context of this file, it reverses the effects of a not-able-to-send situation*/
-    DList_AppendTailList(destination->Flink, source);
-    DList_RemoveEntryList(source);
-    DList_InitializeListHead(source);
+    /*Codes_SRS_TRANSPORTMULTITHTTP_09_007: [ If an HTTP request fails with HTTPAPIEX_RECOVERYFAILED, IoTHubTransportHttp_DoWork shall not execute HTTP requests for the remaining devices. ]*/
+    if (executeResult == HTTPAPIEX_RECOVERYFAILED)
+    {
+        LogError("unable to recover the connection to the IoT Hub; remaining devices will be serviced on the next DoWork");
+        handleData->isConnectionLost = true;
+    }
 }
 
 static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
@@ -1370,7 +1364,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
             else
             {
                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_059: [It shall inspect the "waitingToSend" DLIST passed in config structure.] */
-                STRING_HANDLE payload;
+                EVENT_PAYLOAD payload;
                 switch (makePayload(deviceData, &payload))
                 {
                 case MAKE_PAYLOAD_OK:
@@ -1381,21 +1375,22 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                     {
                         LogError("unable to BUFFER_new");
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                        reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                        IoTHubTransport_HTTP_Common_ReversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                     }
                     else
                     {
-                        if (BUFFER_build(temp, (const unsigned char*)STRING_c_str(payload), STRING_length(payload)) != 0)
+                        if (BUFFER_build(temp, (const unsigned char*)payload.content, payload.length) != 0)
                         {
                             LogError("unable to BUFFER_build");
                             //items go back to waitingToSend
                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_067: [If there is no valid payload, IoTHubTransportHttp_DoWork shall advance to the next activity.]*/
-                            reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                            IoTHubTransport_HTTP_Common_ReversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                         }
                         else
                         {
                             unsigned int statusCode;
-                            if (HTTPAPIEX_SAS_ExecuteRequest(
+                            HTTPAPIEX_RESULT r;
+                            if ((r = HTTPAPIEX_SAS_ExecuteRequest(
                                 deviceData->sasObject,
                                 handleData->httpApiExHandle,
                                 HTTPAPI_REQUEST_POST,
@@ -1405,12 +1400,13 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                 &statusCode,
                                 NULL,
                                 NULL
-                                ) != HTTPAPIEX_OK)
+                                )) != HTTPAPIEX_OK)
                             {
                                 LogError("unable to HTTPAPIEX_ExecuteRequest");
+                                checkConnectionRecovery(handleData, r);
                                 //items go back to waitingToSend
                                 /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
-                                reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                                IoTHubTransport_HTTP_Common_ReversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                             }
                             else
                             {
@@ -1424,13 +1420,13 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                     //items go back to waitingToSend
                                     /*Codes_SRS_TRANSPORTMULTITHTTP_17_069: [if HTTPAPIEX_SAS_ExecuteRequest fails or the http status code >=300 then IoTHubTransportHttp_DoWork shall not do any other action (it is assumed at the next _DoWork it shall be retried).] */
                                     LogError("unexpected HTTP status code (%u)", statusCode);
-                                    reversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
+                                    IoTHubTransport_HTTP_Common_ReversePutListBackIn(&(deviceData->eventConfirmations), deviceData->waitingToSend);
                                 }
                             }
                         }
                         BUFFER_delete(temp);
                     }
-                    STRING_delete(payload);
+                    free(payload.content);
                     break;
                 }
                 case MAKE_PAYLOAD_FIRST_ITEM_DOES_NOT_FIT:
@@ -1544,31 +1540,17 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                     }
                                     else
                                     {
-                                        STRING_HANDLE temp = STRING_construct(IOTHUB_APP_PREFIX);
-                                        if (temp == NULL)
+                                        const char* propertyHeaderName = IoTHubTransport_HTTP_Common_GetPropertyHeaderName(&deviceData->propertyHeaderName, &deviceData->propertyHeaderNameSize, keys[i]);
+                                        if (propertyHeaderName == NULL)
                                         {
                                             /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                            LogError("unable to STRING_construct");
                                             goOn = false;
                                         }
-                                        else
+                                        else if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, propertyHeaderName, values[i]) != HTTP_HEADERS_OK)
                                         {
-                                            if (STRING_concat(temp, keys[i]) != 0)
-                                            {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                                LogError("unable to STRING_concat");
-                                                goOn = false;
-                                            }
-                                            else
-                                            {
-                                                if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, STRING_c_str(temp), values[i]) != HTTP_HEADERS_OK)
-                                                {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
-                                                    LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
-                                                    goOn = false;
-                                                }
-                                            }
-                                            STRING_delete(temp);
+                                            /*Codes_SRS_TRANSPORTMULTITHTTP_17_079: [If any HTTP header operation fails, _DoWork shall advance to the next action.] */
+                                            LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
+                                            goOn = false;
                                         }
                                     }
                                 }
@@ -1639,16 +1621,9 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                             HTTPAPIEX_RESULT r;
                                             if (deviceData->deviceSasToken != NULL)
                                             {
-                                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                                                if (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, "Authorization", STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                                                {
-                                                    r = HTTPAPIEX_ERROR;
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                                                    LogError("Unable to replace the old SAS Token.");
-                                                }
-
+                                                /*the "Authorization" header already holds deviceSasToken (cloned from the event HTTP request headers)*/
                                                 /*Codes_SRS_TRANSPORTMULTITHTTP_03_003: [If a deviceSasToken exists, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_ExecuteRequest passing the following parameters] */
-                                                else if ((r = HTTPAPIEX_ExecuteRequest(
+                                                if ((r = HTTPAPIEX_ExecuteRequest(
                                                     handleData->httpApiExHandle,
                                                     HTTPAPI_REQUEST_POST,
                                                     STRING_c_str(deviceData->eventHTTPrelativePath),
@@ -1680,6 +1655,7 @@ static void DoEvent(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERDEVI
                                                     LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
                                                 }
                                             }
+                                            checkConnectionRecovery(handleData, r);
                                             if (r == HTTPAPIEX_OK)
                                             {
                                                 if (statusCode < 300)
@@ -1790,8 +1766,8 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                 else
                 {
                     if (!(
-                        (addUserAgentHeaderInfo(deviceData->iotHubClientHandle, abandonRequestHttpHeaders) == HTTP_HEADERS_OK) &&
-                        (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, "Authorization", " ") == HTTP_HEADERS_OK) &&
+                        (IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(deviceData->iotHubClientHandle, abandonRequestHttpHeaders) == HTTP_HEADERS_OK) &&
+                        (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, "Authorization", (deviceData->deviceSasToken != NULL) ? STRING_c_str(deviceData->deviceSasToken) : " ") == HTTP_HEADERS_OK) &&
                         (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, "If-Match", ETag) == HTTP_HEADERS_OK)
                         ))
                     {
@@ -1807,15 +1783,7 @@ static bool abandonOrAcceptMessage(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTR
                         HTTPAPIEX_RESULT r;
                         if (deviceData->deviceSasToken != NULL)
                         {
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                            if (HTTPHeaders_ReplaceHeaderNameValuePair(abandonRequestHttpHeaders, "Authorization", STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                            {
-                                r = HTTPAPIEX_ERROR;
-                                /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                                LogError("Unable to replace the old SAS Token.");
-                                result = false;
-                            }
-                            else if ((r = HTTPAPIEX_ExecuteRequest(
+                            if ((r = HTTPAPIEX_ExecuteRequest(
                                 handleData->httpApiExHandle,
                                 (action == IOTHUBMESSAGE_ABANDONED) ? HTTPAPI_REQUEST_POST : HTTPAPI_REQUEST_DELETE,                               /*-requestType: POST                                                                                                       */
                                 STRING_c_str(fullAbandonRelativePath),              /*-relativePath: abandon relative path begin (as created by _Create) + value of ETag + "/abandon?api-version=2016-11-14"   */
@@ -2002,7 +1970,7 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_124: [If time is not available then all calls shall be treated as if they are the first one.] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_122: [A GET request that happens earlier than GetMinimumPollingTime shall be ignored.] */
         time_t timeNow = get_time(NULL);
-        bool isPollingAllowed = deviceData->isFirstPoll || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > handleData->getMinimumPollingTime);
+        bool isPollingAllowed = deviceData->isPollDue || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > deviceData->pollingInterval);
         if (isPollingAllowed)
         {
             HTTP_HEADERS_HANDLE responseHTTPHeaders = HTTPHeaders_Alloc();
@@ -2025,14 +1993,8 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                     HTTPAPIEX_RESULT r;
                     if (deviceData->deviceSasToken != NULL)
                     {
-                        /*Codes_SRS_TRANSPORTMULTITHTTP_03_001: [if a deviceSasToken exists, HTTPHeaders_ReplaceHeaderNameValuePair shall be invoked with "Authorization" as its second argument and STRING_c_str (deviceSasToken) as its third argument.]*/
-                        if (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, "Authorization", STRING_c_str(deviceData->deviceSasToken)) != HTTP_HEADERS_OK)
-                        {
-                            r = HTTPAPIEX_ERROR;
-                            /*Codes_SRS_TRANSPORTMULTITHTTP_03_002: [If the result of the invocation of HTTPHeaders_ReplaceHeaderNameValuePair is NOT HTTP_HEADERS_OK then fallthrough.]*/
-                            LogError("Unable to replace the old SAS Token.");
-                        }
-                        else if ((r = HTTPAPIEX_ExecuteRequest(
+                        /*the "Authorization" header of the message HTTP request headers already holds deviceSasToken*/
+                        if ((r = HTTPAPIEX_ExecuteRequest(
                             handleData->httpApiExHandle,
                             HTTPAPI_REQUEST_GET,                                            /*requestType: GET*/
                             STRING_c_str(deviceData->messageHTTPrelativePath),         /*relativePath: the message HTTP relative path*/
@@ -2072,17 +2034,39 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_085: [If the call to HTTPAPIEX_SAS_ExecuteRequest did not executed successfully or building any part of the prerequisites of the call fails, then _DoWork shall advance to the next action in this description.] */
                         LogError("unable to HTTPAPIEX_SAS_ExecuteRequest");
                     }
+                    checkConnectionRecovery(handleData, r);
                     if (r == HTTPAPIEX_OK)
                     {
                         /*HTTP dialogue was succesfull*/
                         if (timeNow == (time_t)(-1))
                         {
-                            deviceData->isFirstPoll = true;
+                            deviceData->isPollDue = true;
                         }
                         else
                         {
-                            deviceData->isFirstPoll = false;
+                            /*Codes_SRS_TRANSPORTMULTITHTTP_09_011: [ If status code is 200, the next GET shall not wait for the polling interval, since more messages might be waiting. ]*/
+                            deviceData->isPollDue = (statusCode == 200);
                             deviceData->lastPollTime = timeNow;
+                            if (statusCode == 204)
+                            {
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_09_010: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", the polling interval shall double after every GET answered without a message, starting at "MinimumPollingTime" and capped at "MaximumPollingTime". ]*/
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_09_012: [ Up to 10% of the doubled interval, chosen at random, shall be added to it; the jitter shall not be doubled by later GETs and the result shall not exceed "MaximumPollingTime". ]*/
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_09_015: [ If "MaximumPollingTime" is not greater than "MinimumPollingTime", the polling interval shall be "MinimumPollingTime", without back off or jitter. ]*/
+                                deviceData->pollingInterval = IoTHubTransport_HTTP_Common_GetNextPollingInterval(handleData->getMinimumPollingTime, handleData->getMaximumPollingTime, &deviceData->pollingBaseInterval);
+
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_09_016: [ The first polling interval of a device shall be delayed by IoTHubTransport_HTTP_Common_GetPollingPhaseOffset of that interval and of the order in which the device was registered, whether or not "MaximumPollingTime" is set. ]*/
+                                if (deviceData->isPollingPhaseOffsetDue)
+                                {
+                                    deviceData->pollingInterval += IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(deviceData->pollingInterval, deviceData->pollingPhaseIndex);
+                                    deviceData->isPollingPhaseOffsetDue = false;
+                                }
+                            }
+                            else
+                            {
+                                /*Codes_SRS_TRANSPORTMULTITHTTP_09_017: [ After a GET that is not answered with 204, the back off shall start over, so the next GET answered without a message waits "MinimumPollingTime". ]*/
+                                deviceData->pollingBaseInterval = 0;
+                                deviceData->pollingInterval = handleData->getMinimumPollingTime;
+                            }
                         }
                         if (statusCode == 204)
                         {
@@ -2137,10 +2121,11 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                     {
                                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_090: [All the HTTP headers of the form iothub-app-name:somecontent shall be transformed in message properties {name, somecontent}.]*/
                                         /*Codes_SRS_TRANSPORTMULTITHTTP_17_091: [The HTTP header of iothub-messageid shall be set in the MessageId.]*/
-                                        size_t nHeaders;
-                                        if (HTTPHeaders_GetHeaderCount(responseHTTPHeaders, &nHeaders) != HTTP_HEADERS_OK)
+                                        // Codes_SRS_TRANSPORTMULTITHTTP_09_003: [ The HTTP header value of `ContentType` shall be set in the `IoTHubMessage_SetContentTypeSystemProperty`. ] 
+                                        // Codes_SRS_TRANSPORTMULTITHTTP_09_004: [ The HTTP header value of `ContentEncoding` shall be set in the `IoTHub_SetContentEncoding`. ] 
+                                        if (!IoTHubTransport_HTTP_Common_SetMessageProperties(receivedMessage, responseHTTPHeaders))
                                         {
-                                            LogError("unable to get the count of HTTP headers");
+                                            LogError("unable to copy the HTTP headers to the message");
                                             if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                                             {
                                                 LogError("HTTP Transport layer failed to report ABANDON disposition");
@@ -2148,95 +2133,11 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                         }
                                         else
                                         {
-                                            size_t i;
-                                            MAP_HANDLE properties = (nHeaders > 0) ? IoTHubMessage_Properties(receivedMessage) : NULL;
-                                            for (i = 0; i < nHeaders; i++)
-                                            {
-                                                char* completeHeader;
-                                                if (HTTPHeaders_GetHeader(responseHTTPHeaders, i, &completeHeader) != HTTP_HEADERS_OK)
-                                                {
-                                                    break;
-                                                }
-                                                else
-                                                {
-                                                    if (strncmp(IOTHUB_APP_PREFIX, completeHeader, strlen(IOTHUB_APP_PREFIX)) == 0)
-                                                    {
-                                                        /*looks like a property headers*/
-                                                        /*there's a guaranteed ':' in the completeHeader, by HTTP_HEADERS module*/
-                                                        char* whereIsColon = strchr(completeHeader, ':');
-                                                        if (whereIsColon != NULL)
-                                                        {
-                                                            *whereIsColon = '\0'; /*cut it down*/
-                                                            if (Map_AddOrUpdate(properties, completeHeader + strlen(IOTHUB_APP_PREFIX), whereIsColon + 2) != MAP_OK) /*whereIsColon+1 is a space because HTTPEHADERS outputs a ": " between name and value*/
-                                                            {
-                                                                free(completeHeader);
-                                                                break;
-                                                            }
-                                                        }
-                                                    }
-                                                    else if (strncmp(IOTHUB_MESSAGE_ID, completeHeader, strlen(IOTHUB_MESSAGE_ID)) == 0)
-                                                    {
-                                                        char* whereIsColon = strchr(completeHeader, ':');
-                                                        if (whereIsColon != NULL)
-                                                        {
-                                                            *whereIsColon = '\0'; /*cut it down*/
-                                                            if (IoTHubMessage_SetMessageId(receivedMessage, whereIsColon + 2) != IOTHUB_MESSAGE_OK)
-                                                            {
-                                                                free(completeHeader);
-                                                                break;
-                                                            }
-                                                        }
-                                                    }
-                                                    else if (strncmp(IOTHUB_CORRELATION_ID, completeHeader, strlen(IOTHUB_CORRELATION_ID)) == 0)
-                                                    {
-                                                        char* whereIsColon = strchr(completeHeader, ':');
-                                                        if (whereIsColon != NULL)
-                                                        {
-                                                            *whereIsColon = '\0'; /*cut it down*/
-                                                            if (IoTHubMessage_SetCorrelationId(receivedMessage, whereIsColon + 2) != IOTHUB_MESSAGE_OK)
-                                                            {
-                                                                free(completeHeader);
-                                                                break;
-                                                            }
-                                                        }
-                                                    }
-                                                    // Codes_SRS_TRANSPORTMULTITHTTP_09_003: [ The HTTP header value of `ContentType` shall be set in the `IoTHubMessage_SetContentTypeSystemProperty`. ] 
-                                                    else if (strncmp(IOTHUB_CONTENT_TYPE_C2D, completeHeader, strlen(IOTHUB_CONTENT_TYPE_C2D)) == 0)
-                                                    {
-                                                        char* whereIsColon = strchr(completeHeader, ':');
-                                                        if (whereIsColon != NULL)
-                                                        {
-                                                            *whereIsColon = '\0'; /*cut it down*/
-                                                            if (IoTHubMessage_SetContentTypeSystemProperty(receivedMessage, whereIsColon + 2) != IOTHUB_MESSAGE_OK)
-                                                            {
-                                                                LogError("Failed setting IoTHubMessage content-type");
-                                                                free(completeHeader);
-                                                                break;
-                                                            }
-                                                        }
-                                                    }
-                                                    // Codes_SRS_TRANSPORTMULTITHTTP_09_004: [ The HTTP header value of `ContentEncoding` shall be set in the `IoTHub_SetContentEncoding`. ] 
-                                                    else if (strncmp(IOTHUB_CONTENT_ENCODING_C2D, completeHeader, strlen(IOTHUB_CONTENT_ENCODING_C2D)) == 0)
-                                                    {
-                                                        char* whereIsColon = strchr(completeHeader, ':');
-                                                        if (whereIsColon != NULL)
-                                                        {
-                                                            *whereIsColon = '\0'; /*cut it down*/
-                                                            if (IoTHubMessage_SetContentEncodingSystemProperty(receivedMessage, whereIsColon + 2) != IOTHUB_MESSAGE_OK)
-                                                            {
-                                                                LogError("Failed setting IoTHubMessage content-encoding");
-                                                                free(completeHeader);
-                                                                break;
-                                                            }
-                                                        }
-                                                    }
-
-                                                    free(completeHeader);
-                                                }
-                                            }
-
-                                            if (i < nHeaders)
+                                            MESSAGE_CALLBACK_INFO* messageData = MESSAGE_CALLBACK_INFO_Create(receivedMessage, handleData, deviceData, etagValue);
+                                            if (messageData == NULL)
                                             {
+                                                /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
+                                                LogError("failed to assemble callback info");
                                                 if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
                                                 {
                                                     LogError("HTTP Transport layer failed to report ABANDON disposition");
@@ -2244,34 +2145,21 @@ static void DoMessages(HTTPTRANSPORT_HANDLE_DATA* handleData, HTTPTRANSPORT_PERD
                                             }
                                             else
                                             {
-                                                MESSAGE_CALLBACK_INFO* messageData = MESSAGE_CALLBACK_INFO_Create(receivedMessage, handleData, deviceData, etagValue);
-                                                if (messageData == NULL)
+                                                bool abandon;
+                                                if (IoTHubClient_LL_MessageCallback(iotHubClientHandle, messageData))
                                                 {
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_10_006: [If assembling the transport context fails, _DoWork shall "abandon" the message.] */
-                                                    LogError("failed to assemble callback info");
-                                                    if (!abandonOrAcceptMessage(handleData, deviceData, etagValue, IOTHUBMESSAGE_ABANDONED))
-                                                    {
-                                                        LogError("HTTP Transport layer failed to report ABANDON disposition");
-                                                    }
+                                                    abandon = false;
                                                 }
                                                 else
                                                 {
-                                                    bool abandon;
-                                                    if (IoTHubClient_LL_MessageCallback(iotHubClientHandle, messageData))
-                                                    {
-                                                        abandon = false;
-                                                    }
-                                                    else
-                                                    {
-                                                        LogError("IoTHubClient_LL_MessageCallback failed");
-                                                        abandon = true;
-                                                    }
-
-                                                    /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClient_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
-                                                    if (abandon)
-                                                    {
-                                                        (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
-                                                    }
+                                                    LogError("IoTHubClient_LL_MessageCallback failed");
+                                                    abandon = true;
+                                                }
+
+                                                /*Codes_SRS_TRANSPORTMULTITHTTP_17_096: [If IoTHubClient_LL_MessageCallback returns false then _DoWork shall "abandon" the message.] */
+                                                if (abandon)
+                                                {
+                                                    (void)IoTHubTransportHttp_SendMessageDisposition(messageData, IOTHUBMESSAGE_ABANDONED);
                                                 }
                                             }
                                         }
@@ -2314,16 +2202,26 @@ static void IoTHubTransportHttp_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT
         HTTPTRANSPORT_HANDLE_DATA* handleData = (HTTPTRANSPORT_HANDLE_DATA*)handle;
         IOTHUB_DEVICE_HANDLE* listItem;
         size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        size_t i;
+        handleData->isConnectionLost = false;
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_052: [ IoTHubTransportHttp_DoWork shall perform a round-robin loop through every deviceHandle in the transport device list, using the iotHubClientHandle field saved in the IOTHUB_DEVICE_HANDLE. ]*/
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_050: [ IoTHubTransportHttp_DoWork shall call loop through the device list. ] */
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_051: [ IF the list is empty, then IoTHubTransportHttp_DoWork shall do nothing. ]*/
-        for (size_t i = 0; i < deviceListSize; i++)
+        for (i = 0; (i < deviceListSize) && !handleData->isConnectionLost; i++)
         {
-            listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, i);
+            /*Codes_SRS_TRANSPORTMULTITHTTP_09_008: [ IoTHubTransportHttp_DoWork shall start the loop at the device following the one being serviced when the connection was lost. ]*/
+            listItem = (IOTHUB_DEVICE_HANDLE *) VECTOR_element(handleData->perDeviceList, (handleData->nextDeviceToService + i) % deviceListSize);
             HTTPTRANSPORT_PERDEVICE_DATA* perDeviceItem = *(HTTPTRANSPORT_PERDEVICE_DATA**)(listItem);
             DoEvent(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
-            DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+            if (!handleData->isConnectionLost)
+            {
+                DoMessages(handleData, perDeviceItem, perDeviceItem->iotHubClientHandle);
+            }
+        }
 
+        if (deviceListSize > 0)
+        {
+            handleData->nextDeviceToService = (handleData->nextDeviceToService + i) % deviceListSize;
         }
     }
     else
@@ -2350,8 +2248,8 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSendStatus(IOTHUB_DEVICE_HAND
     else
     {
         /*Codes_SRS_TRANSPORTMULTITHTTP_17_138: [ IoTHubTransportHttp_GetSendStatus shall locate deviceHandle in the transport device list by calling list_find_if. ]*/
-        IOTHUB_DEVICE_HANDLE* listItem = get_perDeviceDataItem(handle);
-        if (listItem == NULL)
+        HTTPTRANSPORT_PERDEVICE_DATA* deviceData = get_perDeviceDataItem(handle);
+        if (deviceData == NULL)
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_139: [ If the device structure is not found, then this function shall fail and return with IOTHUB_CLIENT_INVALID_ARG. ]*/
             result = IOTHUB_CLIENT_INVALID_ARG;
@@ -2359,7 +2257,6 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_GetSendStatus(IOTHUB_DEVICE_HAND
         }
         else
         {
-            HTTPTRANSPORT_PERDEVICE_DATA* deviceData = (HTTPTRANSPORT_PERDEVICE_DATA*)(*listItem);
             /* Codes_SRS_TRANSPORTMULTITHTTP_17_113: [ IoTHubTransportHttp_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if there are currently event items to be sent or being sent. ] */
             if (!DList_IsListEmpty(deviceData->waitingToSend))
             {
@@ -2408,6 +2305,12 @@ static IOTHUB_CLIENT_RESULT IoTHubTransportHttp_SetOption(TRANSPORT_LL_HANDLE ha
             handleData->getMinimumPollingTime = *(unsigned int*)value;
             result = IOTHUB_CLIENT_OK;
         }
+        /*Codes_SRS_TRANSPORTMULTITHTTP_09_013: ["MaximumPollingTime"] */
+        else if (strcmp(OPTION_MAX_POLLING_TIME, option) == 0)
+        {
+            handleData->getMaximumPollingTime = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
         else
         {
             /*Codes_SRS_TRANSPORTMULTITHTTP_17_126: [ "TrustedCerts"] */
@@ -0,0 +1,1467 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdlib.h>
+#include <string.h>
+#include "azure_c_shared_utility/gballoc.h"
+
+#include <time.h>
+#include "iothub_client_options.h"
+#include "iothub_client_version.h"
+#include "iothub_client_private.h"
+#include "iothub_transport_ll.h"
+#include "iothubtransporthttp_async.h"
+#include "iothubtransport_http_common.h"
+
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tlsio.h"
+#include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/xlogging.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/crt_abstractions.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/vector.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/agenttime.h"
+
+#include "azure_hub_modules/uhttp.h"
+
+static const char* IOTHUB_MESSAGE_ID = "iothub-messageid";
+static const char* IOTHUB_CORRELATION_ID = "iothub-correlationid";
+static const char* IOTHUB_CONTENT_TYPE_D2C = "iothub-contenttype";
+static const char* IOTHUB_CONTENT_ENCODING_D2C = "iothub-contentencoding";
+
+#define AUTHORIZATION "Authorization"
+#define CONTENT_TYPE "Content-Type"
+#define APPLICATION_OCTET_STREAM "application/octet-stream"
+
+#define HTTPS_PORT_NUM 443
+
+/*a connection that is not open, or a request that is not answered, within this many seconds is closed and retried*/
+#define REQUEST_TIMEOUT_SECS 60
+/*after a connection fails, a new one is not opened before this many seconds*/
+#define RECONNECT_DELAY_SECS 5
+
+#define SAS_TOKEN_DEFAULT_LIFETIME 3600
+/*the "Authorization" headers get a new SAS token after this many seconds*/
+#define SAS_TOKEN_REFRESH_TIME 2880
+
+#define MAXIMUM_MESSAGE_SIZE (255*1024-1)
+#define MAXIMUM_PAYLOAD_OVERHEAD 384
+#define MAXIMUM_PROPERTY_OVERHEAD 16
+
+typedef enum HTTPASYNC_CONNECTION_STATE_TAG
+{
+    HTTPASYNC_CONNECTION_CLOSED,
+    HTTPASYNC_CONNECTION_OPENING,
+    HTTPASYNC_CONNECTION_OPEN,
+    HTTPASYNC_CONNECTION_ERROR
+} HTTPASYNC_CONNECTION_STATE;
+
+typedef enum HTTPASYNC_REQUEST_TAG
+{
+    HTTPASYNC_REQUEST_NONE,
+    HTTPASYNC_REQUEST_SEND_EVENT,
+    HTTPASYNC_REQUEST_GET_MESSAGE,
+    HTTPASYNC_REQUEST_MESSAGE_DISPOSITION
+} HTTPASYNC_REQUEST;
+
+typedef struct HTTPASYNCTRANSPORT_HANDLE_DATA_TAG
+{
+    STRING_HANDLE hostName;
+    VECTOR_HANDLE perDeviceList;
+    unsigned int getMinimumPollingTime;
+    unsigned int getMaximumPollingTime;
+    size_t registeredDeviceCount; /*devices registered so far, it gives each new device its polling phase*/
+    char* trustedCertificates;
+    char* x509Certificate;
+    char* x509PrivateKey;
+    bool logTrace;
+} HTTPASYNCTRANSPORT_HANDLE_DATA;
+
+typedef struct HTTPASYNCTRANSPORT_PERDEVICE_DATA_TAG
+{
+    HTTPASYNCTRANSPORT_HANDLE_DATA* transportHandle;
+
+    STRING_HANDLE deviceId;
+    IOTHUB_AUTHORIZATION_HANDLE authorization;
+    bool usesAuthorizationHeader; /*false when the TLS connection authenticates the device (x509)*/
+    bool isAuthorizationSet;
+    time_t authorizationTime; /*when the "Authorization" headers last got a SAS token*/
+    STRING_HANDLE sasTokenScope;
+    STRING_HANDLE eventHTTPrelativePath;
+    STRING_HANDLE messageHTTPrelativePath;
+    STRING_HANDLE abandonHTTPrelativePathBegin;
+    HTTP_HEADERS_HANDLE eventHTTPrequestHeaders;
+    HTTP_HEADERS_HANDLE messageHTTPrequestHeaders;
+    char* propertyHeaderName; /*"iothub-app-" followed by the name of the property being added to the event HTTP request headers*/
+    size_t propertyHeaderNameSize;
+
+    HTTP_CLIENT_HANDLE httpClient;
+    HTTPASYNC_CONNECTION_STATE connectionState;
+    time_t connectionStateTime; /*when the connection was opened, or when it was closed after a failure*/
+    bool isReconnectDelayed;
+    HTTPASYNC_REQUEST requestInProgress;
+    time_t requestStartTime;
+
+    bool DoWork_PullMessage;
+    time_t lastPollTime;
+    bool isPollDue; /*the next GET does not wait for the polling interval (first GET, or the last GET received a message)*/
+    unsigned int pollingInterval; /*seconds to wait after lastPollTime before the next GET*/
+    unsigned int pollingBaseInterval; /*pollingInterval before jitter is added, the value that doubles when backing off*/
+    size_t pollingPhaseIndex; /*order in which the device was registered, it offsets its first polling interval*/
+    bool isPollingPhaseOffsetDue; /*the next polling interval is the first one, and gets the polling phase offset added*/
+
+    IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle;
+    PDLIST_ENTRY waitingToSend;
+    DLIST_ENTRY eventsInProgress; /*holds the event being sent by the request in progress*/
+    SINGLYLINKEDLIST_HANDLE pendingDispositions; /*holds MESSAGE_DISPOSITION_CONTEXTs waiting to be sent to the service*/
+} HTTPASYNCTRANSPORT_PERDEVICE_DATA;
+
+typedef struct MESSAGE_DISPOSITION_CONTEXT_TAG
+{
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData;
+    char* etagValue;
+    IOTHUBMESSAGE_DISPOSITION_RESULT disposition;
+} MESSAGE_DISPOSITION_CONTEXT;
+
+static void destroyDispositionContext(MESSAGE_DISPOSITION_CONTEXT* dispositionContext)
+{
+    free(dispositionContext->etagValue);
+    free(dispositionContext);
+}
+
+/*creates "/devices/" + URL_ENCODED(deviceId) + suffix*/
+static STRING_HANDLE createDevicePath(const char* prefix, const char* deviceId, const char* suffix)
+{
+    STRING_HANDLE result;
+    STRING_HANDLE urlEncodedDeviceId;
+
+    if ((urlEncodedDeviceId = URL_EncodeString(deviceId)) == NULL)
+    {
+        LogError("URL_EncodeString failed.");
+        result = NULL;
+    }
+    else
+    {
+        if ((result = STRING_construct(prefix)) == NULL)
+        {
+            LogError("STRING_construct failed.");
+        }
+        else if (
+            (STRING_concat(result, "/devices/") != 0) ||
+            (STRING_concat_with_STRING(result, urlEncodedDeviceId) != 0) ||
+            (STRING_concat(result, suffix) != 0)
+            )
+        {
+            LogError("unable to build the path of device [%s].", deviceId);
+            STRING_delete(result);
+            result = NULL;
+        }
+        STRING_delete(urlEncodedDeviceId);
+    }
+
+    return result;
+}
+
+static HTTP_HEADERS_HANDLE createRequestHeaders(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData, const char* iothubTo)
+{
+    HTTP_HEADERS_HANDLE result = HTTPHeaders_Alloc();
+    if (result == NULL)
+    {
+        LogError("HTTPHeaders_Alloc failed.");
+    }
+    else if (!(
+        (IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(deviceData->iotHubClientHandle, result) == HTTP_HEADERS_OK) &&
+        (HTTPHeaders_AddHeaderNameValuePair(result, "Connection", "Keep-Alive") == HTTP_HEADERS_OK) &&
+        (!deviceData->usesAuthorizationHeader || (HTTPHeaders_AddHeaderNameValuePair(result, AUTHORIZATION, " ") == HTTP_HEADERS_OK)) &&
+        ((iothubTo == NULL) || (
+            (HTTPHeaders_AddHeaderNameValuePair(result, "iothub-to", iothubTo) == HTTP_HEADERS_OK) &&
+            (HTTPHeaders_AddHeaderNameValuePair(result, "Accept", "application/json") == HTTP_HEADERS_OK) &&
+            (HTTPHeaders_AddHeaderNameValuePair(result, CONTENT_TYPE, APPLICATION_OCTET_STREAM) == HTTP_HEADERS_OK)
+            ))
+        ))
+    {
+        LogError("adding header properties failed.");
+        HTTPHeaders_Free(result);
+        result = NULL;
+    }
+    return result;
+}
+
+static void closeConnection(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    if (deviceData->httpClient != NULL)
+    {
+        uhttp_client_close(deviceData->httpClient, NULL, NULL);
+        uhttp_client_destroy(deviceData->httpClient);
+        deviceData->httpClient = NULL;
+    }
+
+    /*the event being sent goes back to waitingToSend, a GET is issued again on the next connection*/
+    if (!DList_IsListEmpty(&(deviceData->eventsInProgress)))
+    {
+        IoTHubTransport_HTTP_Common_ReversePutListBackIn(&(deviceData->eventsInProgress), deviceData->waitingToSend);
+    }
+    if (deviceData->requestInProgress == HTTPASYNC_REQUEST_GET_MESSAGE)
+    {
+        deviceData->isPollDue = true;
+    }
+    deviceData->requestInProgress = HTTPASYNC_REQUEST_NONE;
+    deviceData->connectionState = HTTPASYNC_CONNECTION_CLOSED;
+}
+
+static void destroy_perDeviceData(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    LIST_ITEM_HANDLE dispositionItem;
+
+    closeConnection(deviceData);
+
+    while ((dispositionItem = singlylinkedlist_get_head_item(deviceData->pendingDispositions)) != NULL)
+    {
+        destroyDispositionContext((MESSAGE_DISPOSITION_CONTEXT*)singlylinkedlist_item_get_value(dispositionItem));
+        (void)singlylinkedlist_remove(deviceData->pendingDispositions, dispositionItem);
+    }
+    singlylinkedlist_destroy(deviceData->pendingDispositions);
+
+    STRING_delete(deviceData->deviceId);
+    STRING_delete(deviceData->sasTokenScope);
+    STRING_delete(deviceData->eventHTTPrelativePath);
+    STRING_delete(deviceData->messageHTTPrelativePath);
+    STRING_delete(deviceData->abandonHTTPrelativePathBegin);
+    HTTPHeaders_Free(deviceData->eventHTTPrequestHeaders);
+    HTTPHeaders_Free(deviceData->messageHTTPrequestHeaders);
+    if (deviceData->propertyHeaderName != NULL)
+    {
+        free(deviceData->propertyHeaderName);
+    }
+    free(deviceData);
+}
+
+static bool findDeviceHandle(const void* element, const void* value)
+{
+    /* data stored at element is device handle */
+    const IOTHUB_DEVICE_HANDLE * guess = (const IOTHUB_DEVICE_HANDLE *)element;
+    IOTHUB_DEVICE_HANDLE match = (IOTHUB_DEVICE_HANDLE)value;
+    return (*guess == match) ? true : false;
+}
+
+static bool findDeviceById(const void* element, const void* value)
+{
+    const HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData = *(const HTTPASYNCTRANSPORT_PERDEVICE_DATA* const*)element;
+    return (strcmp(STRING_c_str(deviceData->deviceId), (const char*)value) == 0) ? true : false;
+}
+
+static HTTPASYNCTRANSPORT_PERDEVICE_DATA* get_perDeviceDataItem(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceHandleData = (HTTPASYNCTRANSPORT_PERDEVICE_DATA*)deviceHandle;
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* result;
+
+    if (VECTOR_find_if(deviceHandleData->transportHandle->perDeviceList, findDeviceHandle, deviceHandle) == NULL)
+    {
+        LogError("device handle not found in transport device list");
+        result = NULL;
+    }
+    else
+    {
+        result = deviceHandleData;
+    }
+
+    return result;
+}
+
+static IOTHUB_DEVICE_HANDLE IoTHubTransportHttpAsync_Register(TRANSPORT_LL_HANDLE handle, const IOTHUB_DEVICE_CONFIG* device, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle, PDLIST_ENTRY waitingToSend)
+{
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* result;
+    if (handle == NULL || device == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_008: [ If handle or device is NULL, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+        LogError("Transport handle is NULL");
+        result = NULL;
+    }
+    else if (device->deviceId == NULL || device->authorization_module == NULL || waitingToSend == NULL || iotHubClientHandle == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_009: [ If the deviceId or the authorization_module of the device, waitingToSend or iotHubClientHandle are NULL, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+        LogError("invalid parameters detected TRANSPORT_LL_HANDLE handle=%p, const IOTHUB_DEVICE_CONFIG* device=%p, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle=%p, PDLIST_ENTRY waitingToSend=%p",
+            handle, device, iotHubClientHandle, waitingToSend);
+        result = NULL;
+    }
+    else
+    {
+        HTTPASYNCTRANSPORT_HANDLE_DATA* handleData = (HTTPASYNCTRANSPORT_HANDLE_DATA*)handle;
+        IOTHUB_CREDENTIAL_TYPE credentialType = IoTHubClient_Auth_Get_Credential_Type(device->authorization_module);
+
+        if (credentialType == IOTHUB_CREDENTIAL_TYPE_X509_ECC)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_010: [ If the credential type of the device is IOTHUB_CREDENTIAL_TYPE_X509_ECC, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+            LogError("x509 ECC authentication is not supported by the HTTP async transport");
+            result = NULL;
+        }
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_011: [ If a device with the same deviceId is already registered, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+        else if (VECTOR_find_if(handleData->perDeviceList, findDeviceById, device->deviceId) != NULL)
+        {
+            LogError("Transport already has device registered by id: [%s]", device->deviceId);
+            result = NULL;
+        }
+        else if ((result = (HTTPASYNCTRANSPORT_PERDEVICE_DATA*)malloc(sizeof(HTTPASYNCTRANSPORT_PERDEVICE_DATA))) == NULL)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_013: [ If any of the device resources fails to be created, then IoTHubTransportHttpAsync_Register shall fail and return NULL. ]*/
+            LogError("unable to malloc");
+        }
+        else
+        {
+            STRING_HANDLE iothubTo;
+
+            memset(result, 0, sizeof(HTTPASYNCTRANSPORT_PERDEVICE_DATA));
+            result->transportHandle = handleData;
+            result->iotHubClientHandle = iotHubClientHandle;
+            result->waitingToSend = waitingToSend;
+            result->authorization = device->authorization_module;
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_012: [ The event and message HTTP request headers shall have an "Authorization" header, unless the credential type is IOTHUB_CREDENTIAL_TYPE_X509 or IOTHUB_CREDENTIAL_TYPE_UNKNOWN (x509 certificates set through options). ]*/
+            result->usesAuthorizationHeader = (credentialType != IOTHUB_CREDENTIAL_TYPE_X509) && (credentialType != IOTHUB_CREDENTIAL_TYPE_UNKNOWN);
+            result->connectionState = HTTPASYNC_CONNECTION_CLOSED;
+            result->requestInProgress = HTTPASYNC_REQUEST_NONE;
+            result->isPollDue = true;
+            result->isPollingPhaseOffsetDue = true;
+            DList_InitializeListHead(&(result->eventsInProgress));
+
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_014: [ IoTHubTransportHttpAsync_Register shall create the event path "/devices/" + URL_ENCODED(deviceId) + "/messages/events" + APIVERSION, the message path "/devices/" + URL_ENCODED(deviceId) + "/messages/devicebound" + APIVERSION, the abandon path "/devices/" + URL_ENCODED(deviceId) + "/messages/devicebound/" and the SAS token scope hostname + "/devices/" + URL_ENCODED(deviceId). ]*/
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_015: [ IoTHubTransportHttpAsync_Register shall create the event HTTP request headers ("User-Agent", "Connection": "Keep-Alive", "Authorization", "iothub-to": "/devices/" + URL_ENCODED(deviceId) + "/messages/events", "Accept": "application/json" and "Content-Type": "application/octet-stream") and the message HTTP request headers ("User-Agent", "Connection": "Keep-Alive" and "Authorization"). ]*/
+            if (((result->deviceId = STRING_construct(device->deviceId)) == NULL) ||
+                ((result->sasTokenScope = createDevicePath(STRING_c_str(handleData->hostName), device->deviceId, "")) == NULL) ||
+                ((result->eventHTTPrelativePath = createDevicePath("", device->deviceId, EVENT_ENDPOINT API_VERSION)) == NULL) ||
+                ((result->messageHTTPrelativePath = createDevicePath("", device->deviceId, MESSAGE_ENDPOINT_HTTP API_VERSION)) == NULL) ||
+                ((result->abandonHTTPrelativePathBegin = createDevicePath("", device->deviceId, MESSAGE_ENDPOINT_HTTP_ETAG)) == NULL) ||
+                ((result->messageHTTPrequestHeaders = createRequestHeaders(result, NULL)) == NULL) ||
+                ((result->pendingDispositions = singlylinkedlist_create()) == NULL))
+            {
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_013: [ If any of the device resources fails to be created, then IoTHubTransportHttpAsync_Register shall fail and return NULL. ]*/
+                LogError("unable to create the resources of device [%s]", device->deviceId);
+                destroy_perDeviceData(result);
+                result = NULL;
+            }
+            else if ((iothubTo = createDevicePath("", device->deviceId, EVENT_ENDPOINT)) == NULL)
+            {
+                LogError("unable to create the iothub-to header of device [%s]", device->deviceId);
+                destroy_perDeviceData(result);
+                result = NULL;
+            }
+            else
+            {
+                result->eventHTTPrequestHeaders = createRequestHeaders(result, STRING_c_str(iothubTo));
+                STRING_delete(iothubTo);
+
+                if (result->eventHTTPrequestHeaders == NULL)
+                {
+                    LogError("unable to create the event HTTP request headers of device [%s]", device->deviceId);
+                    destroy_perDeviceData(result);
+                    result = NULL;
+                }
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_016: [ IoTHubTransportHttpAsync_Register shall add the device to the devices list by calling VECTOR_push_back. ]*/
+                else if (VECTOR_push_back(handleData->perDeviceList, &result, 1) != 0)
+                {
+                    LogError("unable to add device [%s] to the devices list", device->deviceId);
+                    destroy_perDeviceData(result);
+                    result = NULL;
+                }
+                else
+                {
+                    result->pollingPhaseIndex = handleData->registeredDeviceCount++;
+                }
+            }
+        }
+    }
+    return (IOTHUB_DEVICE_HANDLE)result;
+}
+
+static void IoTHubTransportHttpAsync_Unregister(IOTHUB_DEVICE_HANDLE deviceHandle)
+{
+    if (deviceHandle == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_017: [ If deviceHandle is NULL, then IoTHubTransportHttpAsync_Unregister shall do nothing. ]*/
+        LogError("Unregister a NULL device handle");
+    }
+    else
+    {
+        HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceHandleData = (HTTPASYNCTRANSPORT_PERDEVICE_DATA*)deviceHandle;
+        HTTPASYNCTRANSPORT_HANDLE_DATA* handleData = deviceHandleData->transportHandle;
+        IOTHUB_DEVICE_HANDLE* listItem = (IOTHUB_DEVICE_HANDLE *)VECTOR_find_if(handleData->perDeviceList, findDeviceHandle, deviceHandle);
+        if (listItem == NULL)
+        {
+            LogError("Device Handle [%p] not found in transport", deviceHandle);
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_018: [ IoTHubTransportHttpAsync_Unregister shall close the connection of the device, put the event being sent back in waitingToSend, free all the resources of the device and remove it from the devices list. ]*/
+            VECTOR_erase(handleData->perDeviceList, listItem, 1);
+            destroy_perDeviceData(deviceHandleData);
+        }
+    }
+}
+
+static TRANSPORT_LL_HANDLE IoTHubTransportHttpAsync_Create(const IOTHUBTRANSPORT_CONFIG* config)
+{
+    HTTPASYNCTRANSPORT_HANDLE_DATA* result;
+    if (config == NULL || config->upperConfig == NULL || config->upperConfig->protocol == NULL ||
+        config->upperConfig->iotHubName == NULL || config->upperConfig->iotHubSuffix == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_001: [ If config, config->upperConfig, or its fields protocol, iotHubName or iotHubSuffix are NULL, then IoTHubTransportHttpAsync_Create shall return NULL. ]*/
+        LogError("invalid arg (configuration is missing or incomplete)");
+        result = NULL;
+    }
+    else if ((result = (HTTPASYNCTRANSPORT_HANDLE_DATA*)malloc(sizeof(HTTPASYNCTRANSPORT_HANDLE_DATA))) == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_005: [ If any of the transport resources fails to be created, then IoTHubTransportHttpAsync_Create shall fail and return NULL. ]*/
+        LogError("unable to malloc");
+    }
+    else
+    {
+        memset(result, 0, sizeof(HTTPASYNCTRANSPORT_HANDLE_DATA));
+
+        if (config->upperConfig->protocolGatewayHostName != NULL)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_003: [ If config->upperConfig->protocolGatewayHostName is not NULL, IoTHubTransportHttpAsync_Create shall use it as hostname. ]*/
+            result->hostName = STRING_construct(config->upperConfig->protocolGatewayHostName);
+        }
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_002: [ Otherwise IoTHubTransportHttpAsync_Create shall create the hostname iotHubName + "." + iotHubSuffix. ]*/
+        else if ((result->hostName = STRING_construct(config->upperConfig->iotHubName)) != NULL &&
+            ((STRING_concat(result->hostName, ".") != 0) || (STRING_concat(result->hostName, config->upperConfig->iotHubSuffix) != 0)))
+        {
+            STRING_delete(result->hostName);
+            result->hostName = NULL;
+        }
+
+        if (result->hostName == NULL)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_005: [ If any of the transport resources fails to be created, then IoTHubTransportHttpAsync_Create shall fail and return NULL. ]*/
+            LogError("unable to create the hostname");
+            free(result);
+            result = NULL;
+        }
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_004: [ IoTHubTransportHttpAsync_Create shall call VECTOR_create to create a list of registered devices. ]*/
+        else if ((result->perDeviceList = VECTOR_create(sizeof(IOTHUB_DEVICE_HANDLE))) == NULL)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_005: [ If any of the transport resources fails to be created, then IoTHubTransportHttpAsync_Create shall fail and return NULL. ]*/
+            LogError("unable to VECTOR_create");
+            STRING_delete(result->hostName);
+            free(result);
+            result = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_006: [ Otherwise, IoTHubTransportHttpAsync_Create shall succeed and return a non-NULL value. No connection is opened until a device has work to do. ]*/
+            result->getMinimumPollingTime = DEFAULT_GETMINIMUMPOLLINGTIME;
+            result->getMaximumPollingTime = DEFAULT_GETMAXIMUMPOLLINGTIME;
+        }
+    }
+    return result;
+}
+
+static void IoTHubTransportHttpAsync_Destroy(TRANSPORT_LL_HANDLE handle)
+{
+    /*Codes_SRS_TRANSPORTHTTPASYNC_09_007: [ IoTHubTransportHttpAsync_Destroy shall do nothing if handle is NULL, otherwise it shall destroy every registered device and free all the resources of the transport. ]*/
+    if (handle != NULL)
+    {
+        HTTPASYNCTRANSPORT_HANDLE_DATA* handleData = (HTTPASYNCTRANSPORT_HANDLE_DATA*)handle;
+        size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        size_t i;
+
+        for (i = 0; i < deviceListSize; i++)
+        {
+            destroy_perDeviceData(*(HTTPASYNCTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i));
+        }
+
+        VECTOR_destroy(handleData->perDeviceList);
+        STRING_delete(handleData->hostName);
+        free(handleData->trustedCertificates);
+        free(handleData->x509Certificate);
+        free(handleData->x509PrivateKey);
+        free(handleData);
+    }
+}
+
+static int IoTHubTransportHttpAsync_Subscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    int result;
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* perDeviceItem;
+    if (handle == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_019: [ If handle is NULL or the device is not registered, then IoTHubTransportHttpAsync_Subscribe shall fail and return a non-zero value. ]*/
+        LogError("invalid arg passed to IoTHubTransportHttpAsync_Subscribe");
+        result = __FAILURE__;
+    }
+    else if ((perDeviceItem = get_perDeviceDataItem(handle)) == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_019: [ If handle is NULL or the device is not registered, then IoTHubTransportHttpAsync_Subscribe shall fail and return a non-zero value. ]*/
+        LogError("did not find device in transport handle");
+        result = __FAILURE__;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_020: [ Otherwise, IoTHubTransportHttpAsync_Subscribe shall set the device so that subsequent calls to DoWork issue GET requests for messages, and return 0. ]*/
+        perDeviceItem->DoWork_PullMessage = true;
+        result = 0;
+    }
+    return result;
+}
+
+static void IoTHubTransportHttpAsync_Unsubscribe(IOTHUB_DEVICE_HANDLE handle)
+{
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* perDeviceItem;
+    if (handle == NULL)
+    {
+        LogError("Null handle passed to Unsuscribe.");
+    }
+    else if ((perDeviceItem = get_perDeviceDataItem(handle)) == NULL)
+    {
+        LogError("Device not found to unsuscribe.");
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_021: [ IoTHubTransportHttpAsync_Unsubscribe shall set the device so that subsequent calls to DoWork do not issue GET requests for messages. ]*/
+        perDeviceItem->DoWork_PullMessage = false;
+    }
+}
+
+static int IoTHubTransportHttpAsync_Subscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    LogError("IoTHubTransportHttpAsync_Subscribe_DeviceTwin Not supported");
+    return __FAILURE__;
+}
+
+static void IoTHubTransportHttpAsync_Unsubscribe_DeviceTwin(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    LogError("IoTHubTransportHttpAsync_Unsubscribe_DeviceTwin Not supported");
+}
+
+static int IoTHubTransportHttpAsync_Subscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    LogError("IoTHubTransportHttpAsync_Subscribe_DeviceMethod Not supported");
+    return __FAILURE__;
+}
+
+static void IoTHubTransportHttpAsync_Unsubscribe_DeviceMethod(IOTHUB_DEVICE_HANDLE handle)
+{
+    (void)handle;
+    LogError("IoTHubTransportHttpAsync_Unsubscribe_DeviceMethod Not supported");
+}
+
+static int IoTHubTransportHttpAsync_DeviceMethod_Response(IOTHUB_DEVICE_HANDLE handle, METHOD_HANDLE methodId, const unsigned char* response, size_t response_size, int status_response)
+{
+    (void)handle;
+    (void)methodId;
+    (void)response;
+    (void)response_size;
+    (void)status_response;
+    LogError("IoTHubTransportHttpAsync_DeviceMethod_Response Not supported");
+    return __FAILURE__;
+}
+
+static IOTHUB_PROCESS_ITEM_RESULT IoTHubTransportHttpAsync_ProcessItem(TRANSPORT_LL_HANDLE handle, IOTHUB_IDENTITY_TYPE item_type, IOTHUB_IDENTITY_INFO* iothub_item)
+{
+    (void)handle;
+    (void)item_type;
+    (void)iothub_item;
+    LogError("Currently Not Supported.");
+    return IOTHUB_PROCESS_ERROR;
+}
+
+/*puts a fresh SAS token in the "Authorization" headers of the device when the one they hold is about to expire*/
+static int refreshAuthorization(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    int result;
+    time_t timeNow = get_time(NULL);
+
+    if (!deviceData->usesAuthorizationHeader ||
+        (deviceData->isAuthorizationSet && (timeNow != (time_t)(-1)) && (get_difftime(timeNow, deviceData->authorizationTime) < SAS_TOKEN_REFRESH_TIME)))
+    {
+        result = 0;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_022: [ Before a request is started, the "Authorization" headers of the device shall get a new SAS token if they have none yet, or if the one they hold was obtained 2880 seconds ago or more. ]*/
+        char* sasToken;
+        IOTHUB_CREDENTIAL_TYPE credentialType = IoTHubClient_Auth_Get_Credential_Type(deviceData->authorization);
+
+        if (credentialType == IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_024: [ If the device uses a SAS token provided by the application, that token shall be used as long as IoTHubClient_Auth_Is_SasToken_Valid reports it valid. ]*/
+            if (IoTHubClient_Auth_Is_SasToken_Valid(deviceData->authorization) != SAS_TOKEN_STATUS_VALID)
+            {
+                LogError("the SAS token of device [%s] is not valid", STRING_c_str(deviceData->deviceId));
+                sasToken = NULL;
+            }
+            else
+            {
+                sasToken = IoTHubClient_Auth_Get_SasToken(deviceData->authorization, NULL, 0);
+            }
+        }
+        else if (timeNow == (time_t)(-1))
+        {
+            LogError("unable to get the time to create a SAS token");
+            sasToken = NULL;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_023: [ Otherwise the SAS token shall be created by IoTHubClient_Auth_Get_SasToken for the SAS token scope, expiring in 3600 seconds. ]*/
+            size_t expiryTime = (size_t)get_difftime(timeNow, (time_t)0) + SAS_TOKEN_DEFAULT_LIFETIME;
+            sasToken = IoTHubClient_Auth_Get_SasToken(deviceData->authorization, STRING_c_str(deviceData->sasTokenScope), expiryTime);
+        }
+
+        if (sasToken == NULL)
+        {
+            LogError("unable to get a SAS token for device [%s]", STRING_c_str(deviceData->deviceId));
+            result = __FAILURE__;
+        }
+        else
+        {
+            if ((HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->eventHTTPrequestHeaders, AUTHORIZATION, sasToken) != HTTP_HEADERS_OK) ||
+                (HTTPHeaders_ReplaceHeaderNameValuePair(deviceData->messageHTTPrequestHeaders, AUTHORIZATION, sasToken) != HTTP_HEADERS_OK))
+            {
+                LogError("unable to HTTPHeaders_ReplaceHeaderNameValuePair");
+                result = __FAILURE__;
+            }
+            else
+            {
+                deviceData->isAuthorizationSet = true;
+                deviceData->authorizationTime = timeNow;
+                result = 0;
+            }
+            free(sasToken);
+        }
+    }
+
+    return result;
+}
+
+static void completeOldestEvent(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData, IOTHUB_CLIENT_CONFIRMATION_RESULT confirmationResult)
+{
+    PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend);
+    DList_InsertTailList(&(deviceData->eventsInProgress), head);
+    IoTHubClient_LL_SendComplete(deviceData->iotHubClientHandle, &(deviceData->eventsInProgress), confirmationResult); /*takes care of emptying the list too*/
+}
+
+static void onRequestComplete(void* context, HTTP_CALLBACK_REASON request_result, const unsigned char* content, size_t content_length, unsigned int status_code, HTTP_HEADERS_HANDLE response_headers);
+
+/*sends the oldest event in waitingToSend; returns true if a request was started*/
+static bool startSendEvent(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    bool result = false;
+    bool isContentAvailable;
+    const unsigned char* messageContent = NULL;
+    size_t originalMessageSize = 0;
+    IOTHUB_MESSAGE_LIST* message = containingRecord(deviceData->waitingToSend->Flink, IOTHUB_MESSAGE_LIST, entry);
+    IOTHUBMESSAGE_CONTENT_TYPE contentType = IoTHubMessage_GetContentType(message->messageHandle);
+
+    if (contentType == IOTHUBMESSAGE_BYTEARRAY)
+    {
+        isContentAvailable = (IoTHubMessage_GetByteArray(message->messageHandle, &messageContent, &originalMessageSize) == IOTHUB_MESSAGE_OK);
+    }
+    else if ((contentType == IOTHUBMESSAGE_STRING) && ((messageContent = (const unsigned char*)IoTHubMessage_GetString(message->messageHandle)) != NULL))
+    {
+        originalMessageSize = strlen((const char*)messageContent);
+        isContentAvailable = true;
+    }
+    else
+    {
+        isContentAvailable = false;
+    }
+
+    if (!isContentAvailable)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_029: [ If the content of the event cannot be obtained, or the event exceeds 255KB - 1 bytes (payload + 384 bytes, plus every property name and value + 16 bytes), it shall be removed from waitingToSend and IoTHubClient_LL_SendComplete shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+        LogError("unable to get the message content");
+        completeOldestEvent(deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+    }
+    else
+    {
+        MAP_HANDLE map = IoTHubMessage_Properties(message->messageHandle);
+        const char*const* keys;
+        const char*const* values;
+        size_t count;
+        size_t messageSize = originalMessageSize + MAXIMUM_PAYLOAD_OVERHEAD;
+        size_t i;
+
+        if (Map_GetInternals(map, &keys, &values, &count) != MAP_OK)
+        {
+            LogError("unable to Map_GetInternals");
+        }
+        else
+        {
+            for (i = 0; i < count; i++)
+            {
+                messageSize += (strlen(values[i]) + strlen(keys[i]) + MAXIMUM_PROPERTY_OVERHEAD);
+            }
+
+            if (messageSize > MAXIMUM_MESSAGE_SIZE)
+            {
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_029: [ If the content of the event cannot be obtained, or the event exceeds 255KB - 1 bytes (payload + 384 bytes, plus every property name and value + 16 bytes), it shall be removed from waitingToSend and IoTHubClient_LL_SendComplete shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+                LogError("message size (%lu) exceeds the maximum allowed", (unsigned long)messageSize);
+                completeOldestEvent(deviceData, IOTHUB_CLIENT_CONFIRMATION_ERROR);
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_030: [ The event shall be sent with a clone of the event HTTP request headers, to which every message property is added as "iothub-app-name":"value", and the message id, correlation id, content type and content encoding as "iothub-messageid", "iothub-correlationid", "iothub-contenttype" and "iothub-contentencoding". ]*/
+                HTTP_HEADERS_HANDLE clonedEventHTTPrequestHeaders = HTTPHeaders_Clone(deviceData->eventHTTPrequestHeaders);
+                if (clonedEventHTTPrequestHeaders == NULL)
+                {
+                    LogError("HTTPHeaders_Clone failed");
+                }
+                else
+                {
+                    bool goOn = true;
+                    const char* msgId = IoTHubMessage_GetMessageId(message->messageHandle);
+                    const char* corrId = IoTHubMessage_GetCorrelationId(message->messageHandle);
+                    const char* userDefinedContentType = IoTHubMessage_GetContentTypeSystemProperty(message->messageHandle);
+                    const char* contentEncoding = IoTHubMessage_GetContentEncodingSystemProperty(message->messageHandle);
+
+                    for (i = 0; (i < count) && goOn; i++)
+                    {
+                        const char* propertyHeaderName = IoTHubTransport_HTTP_Common_GetPropertyHeaderName(&deviceData->propertyHeaderName, &deviceData->propertyHeaderNameSize, keys[i]);
+                        goOn = (propertyHeaderName != NULL) && (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, propertyHeaderName, values[i]) == HTTP_HEADERS_OK);
+                    }
+
+                    if (!(
+                        goOn &&
+                        ((msgId == NULL) || (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_MESSAGE_ID, msgId) == HTTP_HEADERS_OK)) &&
+                        ((corrId == NULL) || (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_CORRELATION_ID, corrId) == HTTP_HEADERS_OK)) &&
+                        ((userDefinedContentType == NULL) || (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_CONTENT_TYPE_D2C, userDefinedContentType) == HTTP_HEADERS_OK)) &&
+                        ((contentEncoding == NULL) || (HTTPHeaders_ReplaceHeaderNameValuePair(clonedEventHTTPrequestHeaders, IOTHUB_CONTENT_ENCODING_D2C, contentEncoding) == HTTP_HEADERS_OK))
+                        ))
+                    {
+                        /*Codes_SRS_TRANSPORTHTTPASYNC_09_031: [ If building the request fails, the event shall stay in waitingToSend and be retried on a later DoWork. ]*/
+                        LogError("unable to add the message properties to the HTTP headers");
+                    }
+                    /*Codes_SRS_TRANSPORTHTTPASYNC_09_032: [ The event shall be sent by calling uhttp_client_execute_request with HTTP_CLIENT_REQUEST_POST, the event path, the cloned headers and the message content. ]*/
+                    else if (uhttp_client_execute_request(deviceData->httpClient, HTTP_CLIENT_REQUEST_POST, STRING_c_str(deviceData->eventHTTPrelativePath), clonedEventHTTPrequestHeaders,
+                        (originalMessageSize == 0) ? NULL : messageContent, originalMessageSize, onRequestComplete, deviceData) != HTTP_CLIENT_OK)
+                    {
+                        /*Codes_SRS_TRANSPORTHTTPASYNC_09_031: [ If building the request fails, the event shall stay in waitingToSend and be retried on a later DoWork. ]*/
+                        LogError("unable to uhttp_client_execute_request");
+                    }
+                    else
+                    {
+                        /*Codes_SRS_TRANSPORTHTTPASYNC_09_033: [ Once the request is queued, the event shall be moved from waitingToSend to the events in progress of the device. ]*/
+                        PDLIST_ENTRY head = DList_RemoveHeadList(deviceData->waitingToSend);
+                        DList_InsertTailList(&(deviceData->eventsInProgress), head);
+                        deviceData->requestInProgress = HTTPASYNC_REQUEST_SEND_EVENT;
+                        result = true;
+                    }
+                    HTTPHeaders_Free(clonedEventHTTPrequestHeaders);
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+static bool startGetMessage(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    bool result;
+
+    /*Codes_SRS_TRANSPORTHTTPASYNC_09_034: [ Messages shall be requested by calling uhttp_client_execute_request with HTTP_CLIENT_REQUEST_GET, the message path and the message HTTP request headers. ]*/
+    if (uhttp_client_execute_request(deviceData->httpClient, HTTP_CLIENT_REQUEST_GET, STRING_c_str(deviceData->messageHTTPrelativePath), deviceData->messageHTTPrequestHeaders,
+        NULL, 0, onRequestComplete, deviceData) != HTTP_CLIENT_OK)
+    {
+        LogError("unable to uhttp_client_execute_request");
+        result = false;
+    }
+    else
+    {
+        time_t timeNow = get_time(NULL);
+        deviceData->isPollDue = false;
+        if (timeNow != (time_t)(-1))
+        {
+            deviceData->lastPollTime = timeNow;
+        }
+        deviceData->requestInProgress = HTTPASYNC_REQUEST_GET_MESSAGE;
+        result = true;
+    }
+
+    return result;
+}
+
+static bool startMessageDisposition(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    bool result = false;
+    LIST_ITEM_HANDLE dispositionItem = singlylinkedlist_get_head_item(deviceData->pendingDispositions);
+    MESSAGE_DISPOSITION_CONTEXT* dispositionContext = (MESSAGE_DISPOSITION_CONTEXT*)singlylinkedlist_item_get_value(dispositionItem);
+    STRING_HANDLE fullAbandonRelativePath;
+    STRING_HANDLE ETagUnquoted;
+    HTTP_HEADERS_HANDLE abandonRequestHttpHeaders;
+    IOTHUBMESSAGE_DISPOSITION_RESULT action = dispositionContext->disposition;
+
+    /*Codes_SRS_TRANSPORTHTTPASYNC_09_035: [ A message disposition shall be sent by calling uhttp_client_execute_request with:
+    - HTTP_CLIENT_REQUEST_POST and the abandon path + ETag + "/abandon" + APIVERSION for IOTHUBMESSAGE_ABANDONED,
+    - HTTP_CLIENT_REQUEST_DELETE and the abandon path + ETag + APIVERSION + "&reject" for IOTHUBMESSAGE_REJECTED,
+    - HTTP_CLIENT_REQUEST_DELETE and the abandon path + ETag + APIVERSION for IOTHUBMESSAGE_ACCEPTED,
+    and a clone of the message HTTP request headers with "If-Match": ETag added. ]*/
+    if ((fullAbandonRelativePath = STRING_clone(deviceData->abandonHTTPrelativePathBegin)) == NULL)
+    {
+        LogError("unable to STRING_clone");
+    }
+    else
+    {
+        const char* etagValue = dispositionContext->etagValue;
+        if ((ETagUnquoted = STRING_construct_n(etagValue + 1, strlen(etagValue) - 2)) == NULL) /*skip first character which is '"' and the last one (which is also '"')*/
+        {
+            LogError("unable to STRING_construct_n");
+        }
+        else if (!(
+            (STRING_concat_with_STRING(fullAbandonRelativePath, ETagUnquoted) == 0) &&
+            (STRING_concat(fullAbandonRelativePath, (action == IOTHUBMESSAGE_ABANDONED) ? "/abandon" API_VERSION : ((action == IOTHUBMESSAGE_REJECTED) ? API_VERSION "&reject" : API_VERSION)) == 0)
+            ))
+        {
+            LogError("unable to STRING_concat");
+        }
+        else if ((abandonRequestHttpHeaders = HTTPHeaders_Clone(deviceData->messageHTTPrequestHeaders)) == NULL)
+        {
+            LogError("unable to HTTPHeaders_Clone");
+        }
+        else
+        {
+            if (HTTPHeaders_AddHeaderNameValuePair(abandonRequestHttpHeaders, "If-Match", etagValue) != HTTP_HEADERS_OK)
+            {
+                LogError("unable to HTTPHeaders_AddHeaderNameValuePair");
+            }
+            else if (uhttp_client_execute_request(deviceData->httpClient, (action == IOTHUBMESSAGE_ABANDONED) ? HTTP_CLIENT_REQUEST_POST : HTTP_CLIENT_REQUEST_DELETE,
+                STRING_c_str(fullAbandonRelativePath), abandonRequestHttpHeaders, NULL, 0, onRequestComplete, deviceData) != HTTP_CLIENT_OK)
+            {
+                LogError("unable to uhttp_client_execute_request");
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_036: [ The disposition shall stay first in the pending dispositions of the device while its request is in progress, so that it is sent again on the next connection if the request does not complete with HTTP_CALLBACK_REASON_OK. ]*/
+                deviceData->requestInProgress = HTTPASYNC_REQUEST_MESSAGE_DISPOSITION;
+                result = true;
+            }
+            HTTPHeaders_Free(abandonRequestHttpHeaders);
+        }
+        STRING_delete(ETagUnquoted);
+        STRING_delete(fullAbandonRelativePath);
+    }
+
+    return result;
+}
+
+static bool isPollingAllowed(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    bool result;
+    if (!deviceData->DoWork_PullMessage)
+    {
+        result = false;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_037: [ A GET shall not be issued earlier than the polling interval after the previous one, except for the first GET, when the previous GET received a message, or when time is not available. ]*/
+        time_t timeNow = get_time(NULL);
+        result = deviceData->isPollDue || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->lastPollTime) > deviceData->pollingInterval);
+    }
+    return result;
+}
+
+static bool hasWorkToDo(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    return (singlylinkedlist_get_head_item(deviceData->pendingDispositions) != NULL) ||
+        !DList_IsListEmpty(deviceData->waitingToSend) ||
+        isPollingAllowed(deviceData);
+}
+
+static void startNextRequest(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    if (refreshAuthorization(deviceData) != 0)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_025: [ If no SAS token can be obtained, no request shall be started. ]*/
+        LogError("unable to refresh the authorization of device [%s]", STRING_c_str(deviceData->deviceId));
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_028: [ When the connection of a device is open and no request is in progress, DoWork shall start, in this order of preference, the oldest pending message disposition, the oldest event in waitingToSend, or a GET for messages if polling is allowed. ]*/
+        bool isStarted = (singlylinkedlist_get_head_item(deviceData->pendingDispositions) != NULL) && startMessageDisposition(deviceData);
+
+        while (!isStarted && !DList_IsListEmpty(deviceData->waitingToSend))
+        {
+            PDLIST_ENTRY oldestEvent = deviceData->waitingToSend->Flink;
+            isStarted = startSendEvent(deviceData);
+            if (!isStarted && (deviceData->waitingToSend->Flink == oldestEvent))
+            {
+                /*the event stays in waitingToSend, it is retried on a later DoWork*/
+                break;
+            }
+        }
+
+        if (!isStarted && isPollingAllowed(deviceData))
+        {
+            (void)startGetMessage(deviceData);
+        }
+    }
+}
+
+static MESSAGE_DISPOSITION_CONTEXT* createDispositionContext(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData, const char* etagValue)
+{
+    MESSAGE_DISPOSITION_CONTEXT* result = (MESSAGE_DISPOSITION_CONTEXT*)malloc(sizeof(MESSAGE_DISPOSITION_CONTEXT));
+    if (result == NULL)
+    {
+        LogError("malloc failed");
+    }
+    else if (mallocAndStrcpy_s(&result->etagValue, etagValue) != 0)
+    {
+        LogError("mallocAndStrcpy_s failed");
+        free(result);
+        result = NULL;
+    }
+    else
+    {
+        result->deviceData = deviceData;
+        result->disposition = IOTHUBMESSAGE_ABANDONED;
+    }
+    return result;
+}
+
+static int queueDisposition(MESSAGE_DISPOSITION_CONTEXT* dispositionContext, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    int result;
+    dispositionContext->disposition = disposition;
+    if (singlylinkedlist_add(dispositionContext->deviceData->pendingDispositions, dispositionContext) == NULL)
+    {
+        LogError("unable to queue the message disposition");
+        result = __FAILURE__;
+    }
+    else
+    {
+        result = 0;
+    }
+    return result;
+}
+
+static void abandonMessage(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData, const char* etagValue)
+{
+    MESSAGE_DISPOSITION_CONTEXT* dispositionContext = createDispositionContext(deviceData, etagValue);
+    if (dispositionContext == NULL)
+    {
+        LogError("HTTP Transport layer failed to report ABANDON disposition");
+    }
+    else if (queueDisposition(dispositionContext, IOTHUBMESSAGE_ABANDONED) != 0)
+    {
+        LogError("HTTP Transport layer failed to report ABANDON disposition");
+        destroyDispositionContext(dispositionContext);
+    }
+}
+
+static void onMessageReceived(HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData, const unsigned char* content, size_t content_length, HTTP_HEADERS_HANDLE response_headers)
+{
+    /*Codes_SRS_TRANSPORTHTTPASYNC_09_042: [ If the GET is answered with status code 200, the message shall be assembled from the content, its "iothub-app-" headers shall become properties and "iothub-messageid", "iothub-correlationid", "ContentType" and "ContentEncoding" shall become the message id, correlation id, content type and content encoding. ]*/
+    const char* etagValue = HTTPHeaders_FindHeaderValue(response_headers, "ETag");
+    size_t etagsize;
+    if (etagValue == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_043: [ If the "ETag" header is missing or is not a quoted string, the message shall be ignored. ]*/
+        LogError("unable to find a received header called \"E-Tag\"");
+    }
+    else if (((etagsize = strlen(etagValue)) < 2) || (etagValue[0] != '"') || (etagValue[etagsize - 1] != '"'))
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_043: [ If the "ETag" header is missing or is not a quoted string, the message shall be ignored. ]*/
+        LogError("ETag is not a valid quoted string");
+    }
+    else
+    {
+        IOTHUB_MESSAGE_HANDLE receivedMessage = IoTHubMessage_CreateFromByteArray(content, content_length);
+        if (receivedMessage == NULL)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_044: [ If assembling the message or its transport context fails, the message shall be queued to be abandoned. ]*/
+            LogError("unable to IoTHubMessage_CreateFromByteArray, trying to abandon the message... ");
+            abandonMessage(deviceData, etagValue);
+        }
+        else
+        {
+            MESSAGE_CALLBACK_INFO* messageData;
+            if (!IoTHubTransport_HTTP_Common_SetMessageProperties(receivedMessage, response_headers))
+            {
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_044: [ If assembling the message or its transport context fails, the message shall be queued to be abandoned. ]*/
+                LogError("unable to set the message properties");
+                abandonMessage(deviceData, etagValue);
+            }
+            else if ((messageData = (MESSAGE_CALLBACK_INFO*)malloc(sizeof(MESSAGE_CALLBACK_INFO))) == NULL)
+            {
+                LogError("malloc failed");
+                abandonMessage(deviceData, etagValue);
+            }
+            else if ((messageData->transportContext = createDispositionContext(deviceData, etagValue)) == NULL)
+            {
+                LogError("failed to assemble callback info");
+                free(messageData);
+                abandonMessage(deviceData, etagValue);
+            }
+            else
+            {
+                messageData->messageHandle = receivedMessage;
+                receivedMessage = NULL; /*owned by messageData*/
+
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_045: [ The message shall be given to IoTHubClient_LL_MessageCallback; if it returns false, the message shall be queued to be abandoned. ]*/
+                if (!IoTHubClient_LL_MessageCallback(deviceData->iotHubClientHandle, messageData))
+                {
+                    LogError("IoTHubClient_LL_MessageCallback failed");
+                    if (queueDisposition(messageData->transportContext, IOTHUBMESSAGE_ABANDONED) != 0)
+                    {
+                        destroyDispositionContext(messageData->transportContext);
+                    }
+                    IoTHubMessage_Destroy(messageData->messageHandle);
+                    free(messageData);
+                }
+            }
+
+            if (receivedMessage != NULL)
+            {
+                IoTHubMessage_Destroy(receivedMessage);
+            }
+        }
+    }
+}
+
+static void onRequestComplete(void* context, HTTP_CALLBACK_REASON request_result, const unsigned char* content, size_t content_length, unsigned int status_code, HTTP_HEADERS_HANDLE response_headers)
+{
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData = (HTTPASYNCTRANSPORT_PERDEVICE_DATA*)context;
+    HTTPASYNC_REQUEST request = deviceData->requestInProgress;
+    deviceData->requestInProgress = HTTPASYNC_REQUEST_NONE;
+
+    if (request_result != HTTP_CALLBACK_REASON_OK)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_046: [ If a request completes with a reason other than HTTP_CALLBACK_REASON_OK, the connection of the device shall be closed on the same DoWork. ]*/
+        LogError("HTTP request of device [%s] failed (reason %d)", STRING_c_str(deviceData->deviceId), (int)request_result);
+        deviceData->connectionState = HTTPASYNC_CONNECTION_ERROR;
+    }
+
+    switch (request)
+    {
+    case HTTPASYNC_REQUEST_SEND_EVENT:
+    {
+        if ((request_result == HTTP_CALLBACK_REASON_OK) && (status_code < 300))
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_047: [ If the POST of an event completes with a status code < 300, IoTHubClient_LL_SendComplete shall be called with the events in progress and IOTHUB_CLIENT_CONFIRMATION_OK. ]*/
+            IoTHubClient_LL_SendComplete(deviceData->iotHubClientHandle, &(deviceData->eventsInProgress), IOTHUB_CLIENT_CONFIRMATION_OK);
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_048: [ Otherwise the events in progress shall be put back at the front of waitingToSend, to be retried. ]*/
+            if (request_result == HTTP_CALLBACK_REASON_OK)
+            {
+                LogError("unexpected HTTP status code (%u)", status_code);
+            }
+            IoTHubTransport_HTTP_Common_ReversePutListBackIn(&(deviceData->eventsInProgress), deviceData->waitingToSend);
+        }
+        break;
+    }
+    case HTTPASYNC_REQUEST_GET_MESSAGE:
+    {
+        if (request_result != HTTP_CALLBACK_REASON_OK)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_039: [ If the GET fails, the next GET shall not wait for the polling interval. ]*/
+            deviceData->isPollDue = true;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_041: [ If the GET is answered with status code 200, the next GET shall not wait for the polling interval, since more messages might be waiting. ]*/
+            deviceData->isPollDue = (status_code == 200) || (get_time(NULL) == (time_t)(-1));
+            if (status_code == 204)
+            {
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_040: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", the polling interval shall double after every GET answered without a message, starting at "MinimumPollingTime" and capped at "MaximumPollingTime". Up to 10% of the doubled interval, chosen at random, shall be added to it, without exceeding "MaximumPollingTime". ]*/
+                deviceData->pollingInterval = IoTHubTransport_HTTP_Common_GetNextPollingInterval(deviceData->transportHandle->getMinimumPollingTime, deviceData->transportHandle->getMaximumPollingTime, &deviceData->pollingBaseInterval);
+
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_065: [ The first polling interval of a device shall be delayed by IoTHubTransport_HTTP_Common_GetPollingPhaseOffset of that interval and of the order in which the device was registered, whether or not "MaximumPollingTime" is set. ]*/
+                if (deviceData->isPollingPhaseOffsetDue)
+                {
+                    deviceData->pollingInterval += IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(deviceData->pollingInterval, deviceData->pollingPhaseIndex);
+                    deviceData->isPollingPhaseOffsetDue = false;
+                }
+            }
+            else
+            {
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_038: [ The polling interval shall be "MinimumPollingTime" (default 25 minutes), without jitter, when "MaximumPollingTime" is not greater than it, or after a GET that did not answer with status code 204. ]*/
+                /*Codes_SRS_TRANSPORTHTTPASYNC_09_066: [ After a GET that is not answered with 204, the back off shall start over, so the next GET answered without a message waits "MinimumPollingTime". ]*/
+                deviceData->pollingBaseInterval = 0;
+                deviceData->pollingInterval = deviceData->transportHandle->getMinimumPollingTime;
+            }
+
+            if (status_code == 200)
+            {
+                onMessageReceived(deviceData, content, content_length, response_headers);
+            }
+            else if (status_code != 204)
+            {
+                LogError("expected status code was 200, but actually was received %u... moving on", status_code);
+            }
+        }
+        break;
+    }
+    case HTTPASYNC_REQUEST_MESSAGE_DISPOSITION:
+    {
+        if (request_result == HTTP_CALLBACK_REASON_OK)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_049: [ Once the request of a message disposition completes with HTTP_CALLBACK_REASON_OK, the disposition shall be removed from the pending dispositions of the device; it is successful if the status code is 204, other status codes shall only be logged. ]*/
+            LIST_ITEM_HANDLE dispositionItem = singlylinkedlist_get_head_item(deviceData->pendingDispositions);
+            if (dispositionItem != NULL)
+            {
+                destroyDispositionContext((MESSAGE_DISPOSITION_CONTEXT*)singlylinkedlist_item_get_value(dispositionItem));
+                (void)singlylinkedlist_remove(deviceData->pendingDispositions, dispositionItem);
+            }
+
+            if (status_code != 204)
+            {
+                LogError("unexpected status code returned %u (was expecting 204)", status_code);
+            }
+        }
+        break;
+    }
+    default:
+    {
+        LogError("internal error: HTTP request completed while none was in progress");
+        break;
+    }
+    }
+}
+
+static void onHttpOpenComplete(void* context, HTTP_CALLBACK_REASON open_result)
+{
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData = (HTTPASYNCTRANSPORT_PERDEVICE_DATA*)context;
+    if (open_result == HTTP_CALLBACK_REASON_OK)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_027: [ Once the connection is open, requests can be started for the device. ]*/
+        deviceData->connectionState = HTTPASYNC_CONNECTION_OPEN;
+    }
+    else
+    {
+        LogError("unable to open the connection of device [%s] (reason %d)", STRING_c_str(deviceData->deviceId), (int)open_result);
+        deviceData->connectionState = HTTPASYNC_CONNECTION_ERROR;
+    }
+}
+
+static void onHttpError(void* context, HTTP_CALLBACK_REASON error_result)
+{
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData = (HTTPASYNCTRANSPORT_PERDEVICE_DATA*)context;
+    /*Codes_SRS_TRANSPORTHTTPASYNC_09_046: [ If a request completes with a reason other than HTTP_CALLBACK_REASON_OK, the connection of the device shall be closed on the same DoWork. ]*/
+    LogError("HTTP connection of device [%s] failed (reason %d)", STRING_c_str(deviceData->deviceId), (int)error_result);
+    deviceData->connectionState = HTTPASYNC_CONNECTION_ERROR;
+}
+
+static void openConnection(HTTPASYNCTRANSPORT_HANDLE_DATA* handleData, HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData, time_t timeNow)
+{
+    TLSIO_CONFIG tlsio_config;
+    const IO_INTERFACE_DESCRIPTION* tlsio_interface;
+
+    memset(&tlsio_config, 0, sizeof(TLSIO_CONFIG));
+    tlsio_config.hostname = STRING_c_str(handleData->hostName);
+    tlsio_config.port = HTTPS_PORT_NUM;
+
+    /*Codes_SRS_TRANSPORTHTTPASYNC_09_026: [ DoWork shall open the connection of a device that has work to do by calling uhttp_client_create with the default TLS IO, setting the "TrustedCerts", x509 certificate and private key and "logtrace" options received by SetOption, and calling uhttp_client_open on port 443 of the hostname. ]*/
+    if ((tlsio_interface = platform_get_default_tlsio()) == NULL)
+    {
+        LogError("platform_get_default_tlsio return NULL IO Interface");
+    }
+    else if ((deviceData->httpClient = uhttp_client_create(tlsio_interface, &tlsio_config, onHttpError, deviceData)) == NULL)
+    {
+        LogError("unable to uhttp_client_create");
+    }
+    else
+    {
+        (void)uhttp_client_set_trace(deviceData->httpClient, handleData->logTrace, handleData->logTrace);
+
+        if ((handleData->trustedCertificates != NULL) && (uhttp_client_set_trusted_cert(deviceData->httpClient, handleData->trustedCertificates) != HTTP_CLIENT_OK))
+        {
+            LogError("unable to uhttp_client_set_trusted_cert");
+        }
+        else if ((handleData->x509Certificate != NULL) && (handleData->x509PrivateKey != NULL) &&
+            (uhttp_client_set_X509_cert(deviceData->httpClient, false, handleData->x509Certificate, handleData->x509PrivateKey) != HTTP_CLIENT_OK))
+        {
+            LogError("unable to uhttp_client_set_X509_cert");
+        }
+        else if (uhttp_client_open(deviceData->httpClient, STRING_c_str(handleData->hostName), HTTPS_PORT_NUM, onHttpOpenComplete, deviceData) != HTTP_CLIENT_OK)
+        {
+            LogError("unable to uhttp_client_open");
+        }
+        else
+        {
+            deviceData->connectionState = HTTPASYNC_CONNECTION_OPENING;
+        }
+
+        if (deviceData->connectionState != HTTPASYNC_CONNECTION_OPENING)
+        {
+            uhttp_client_destroy(deviceData->httpClient);
+            deviceData->httpClient = NULL;
+        }
+    }
+
+    deviceData->connectionStateTime = timeNow;
+    deviceData->isReconnectDelayed = (deviceData->connectionState != HTTPASYNC_CONNECTION_OPENING);
+}
+
+static bool hasTimedOut(time_t timeNow, time_t startTime)
+{
+    return (timeNow != (time_t)(-1)) && (startTime != (time_t)(-1)) && (get_difftime(timeNow, startTime) > REQUEST_TIMEOUT_SECS);
+}
+
+static void DoWorkDevice(HTTPASYNCTRANSPORT_HANDLE_DATA* handleData, HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData)
+{
+    time_t timeNow = get_time(NULL);
+
+    if (deviceData->connectionState == HTTPASYNC_CONNECTION_CLOSED)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_050: [ After a connection fails, a new one shall not be opened for the device before 5 seconds have passed. ]*/
+        if (hasWorkToDo(deviceData) &&
+            (!deviceData->isReconnectDelayed || (timeNow == (time_t)(-1)) || (get_difftime(timeNow, deviceData->connectionStateTime) >= RECONNECT_DELAY_SECS)))
+        {
+            openConnection(handleData, deviceData, timeNow);
+        }
+    }
+    else if ((deviceData->connectionState == HTTPASYNC_CONNECTION_OPEN) && (deviceData->requestInProgress == HTTPASYNC_REQUEST_NONE))
+    {
+        startNextRequest(deviceData);
+        if (deviceData->requestInProgress != HTTPASYNC_REQUEST_NONE)
+        {
+            deviceData->requestStartTime = timeNow;
+        }
+    }
+
+    if (deviceData->httpClient != NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_051: [ DoWork shall call uhttp_client_dowork for every device with a connection; it shall not wait for any request to complete. ]*/
+        uhttp_client_dowork(deviceData->httpClient);
+
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_052: [ If a connection is not open, or a request is not completed, within 60 seconds, the connection of the device shall be closed. ]*/
+        if (((deviceData->connectionState == HTTPASYNC_CONNECTION_OPENING) && hasTimedOut(timeNow, deviceData->connectionStateTime)) ||
+            ((deviceData->connectionState == HTTPASYNC_CONNECTION_OPEN) && (deviceData->requestInProgress != HTTPASYNC_REQUEST_NONE) && hasTimedOut(timeNow, deviceData->requestStartTime)))
+        {
+            LogError("HTTP connection of device [%s] timed out", STRING_c_str(deviceData->deviceId));
+            deviceData->connectionState = HTTPASYNC_CONNECTION_ERROR;
+        }
+    }
+
+    if (deviceData->connectionState == HTTPASYNC_CONNECTION_ERROR)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_053: [ When the connection of a device is closed, the event in progress shall be put back at the front of waitingToSend. ]*/
+        closeConnection(deviceData);
+        deviceData->connectionStateTime = timeNow;
+        deviceData->isReconnectDelayed = true;
+    }
+}
+
+static void IoTHubTransportHttpAsync_DoWork(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_LL_HANDLE iotHubClientHandle)
+{
+    (void)iotHubClientHandle; // use the perDevice handle.
+    if (handle == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_054: [ If handle is NULL, then IoTHubTransportHttpAsync_DoWork shall do nothing. ]*/
+        LogError("Invalid Argument NULL call on DoWork.");
+    }
+    else
+    {
+        HTTPASYNCTRANSPORT_HANDLE_DATA* handleData = (HTTPASYNCTRANSPORT_HANDLE_DATA*)handle;
+        size_t deviceListSize = VECTOR_size(handleData->perDeviceList);
+        size_t i;
+
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_055: [ IoTHubTransportHttpAsync_DoWork shall service every registered device, each on its own connection, so requests of different devices are outstanding at the same time. ]*/
+        for (i = 0; i < deviceListSize; i++)
+        {
+            DoWorkDevice(handleData, *(HTTPASYNCTRANSPORT_PERDEVICE_DATA**)VECTOR_element(handleData->perDeviceList, i));
+        }
+    }
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportHttpAsync_SendMessageDisposition(MESSAGE_CALLBACK_INFO* message_data, IOTHUBMESSAGE_DISPOSITION_RESULT disposition)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if (message_data == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_056: [ If message_data, its messageHandle or its transportContext are NULL, IoTHubTransportHttpAsync_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+        LogError("invalid argument messageData is NULL");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        if (message_data->messageHandle == NULL || message_data->transportContext == NULL)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_056: [ If message_data, its messageHandle or its transportContext are NULL, IoTHubTransportHttpAsync_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+            LogError("invalid message data");
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_057: [ IoTHubTransportHttpAsync_SendMessageDisposition shall queue the disposition, to be sent to the service by a later DoWork, and return IOTHUB_CLIENT_OK. ]*/
+        else if (queueDisposition(message_data->transportContext, disposition) != 0)
+        {
+            LogError("HTTP Transport layer failed to queue disposition %d", (int)disposition);
+            destroyDispositionContext(message_data->transportContext);
+            result = IOTHUB_CLIENT_ERROR;
+        }
+        else
+        {
+            result = IOTHUB_CLIENT_OK;
+        }
+
+        if (message_data->messageHandle != NULL)
+        {
+            IoTHubMessage_Destroy(message_data->messageHandle);
+        }
+        free(message_data);
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportHttpAsync_GetSendStatus(IOTHUB_DEVICE_HANDLE handle, IOTHUB_CLIENT_STATUS *iotHubClientStatus)
+{
+    IOTHUB_CLIENT_RESULT result;
+    HTTPASYNCTRANSPORT_PERDEVICE_DATA* deviceData;
+
+    if (handle == NULL || iotHubClientStatus == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_058: [ IoTHubTransportHttpAsync_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with a NULL parameter or a device that is not registered. ]*/
+        LogError("invalid parameter handle=%p, iotHubClientStatus=%p", handle, iotHubClientStatus);
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else if ((deviceData = get_perDeviceDataItem(handle)) == NULL)
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_058: [ IoTHubTransportHttpAsync_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with a NULL parameter or a device that is not registered. ]*/
+        LogError("Device not found in transport list.");
+        result = IOTHUB_CLIENT_INVALID_ARG;
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_059: [ IoTHubTransportHttpAsync_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if events are waiting to be sent or being sent, IOTHUB_CLIENT_SEND_STATUS_IDLE otherwise. ]*/
+        *iotHubClientStatus = (DList_IsListEmpty(deviceData->waitingToSend) && DList_IsListEmpty(&(deviceData->eventsInProgress))) ? IOTHUB_CLIENT_SEND_STATUS_IDLE : IOTHUB_CLIENT_SEND_STATUS_BUSY;
+        result = IOTHUB_CLIENT_OK;
+    }
+
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT copyStringOption(char** destination, const void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    char* copy;
+    if (mallocAndStrcpy_s(&copy, (const char*)value) != 0)
+    {
+        LogError("unable to copy the option value");
+        result = IOTHUB_CLIENT_ERROR;
+    }
+    else
+    {
+        free(*destination);
+        *destination = copy;
+        result = IOTHUB_CLIENT_OK;
+    }
+    return result;
+}
+
+static IOTHUB_CLIENT_RESULT IoTHubTransportHttpAsync_SetOption(TRANSPORT_LL_HANDLE handle, const char* option, const void* value)
+{
+    IOTHUB_CLIENT_RESULT result;
+    if ((handle == NULL) || (option == NULL) || (value == NULL))
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_060: [ If handle, option or value are NULL then IoTHubTransportHttpAsync_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+        result = IOTHUB_CLIENT_INVALID_ARG;
+        LogError("invalid parameter (NULL) passed to IoTHubTransportHttpAsync_SetOption");
+    }
+    else
+    {
+        /*Codes_SRS_TRANSPORTHTTPASYNC_09_061: [ "MinimumPollingTime", "MaximumPollingTime", "TrustedCerts", "x509certificate", "x509privatekey" and "logtrace" shall be stored; certificates and "logtrace" apply to the connections opened afterwards. ]*/
+        HTTPASYNCTRANSPORT_HANDLE_DATA* handleData = (HTTPASYNCTRANSPORT_HANDLE_DATA*)handle;
+        if (strcmp(OPTION_MIN_POLLING_TIME, option) == 0)
+        {
+            handleData->getMinimumPollingTime = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp(OPTION_MAX_POLLING_TIME, option) == 0)
+        {
+            handleData->getMaximumPollingTime = *(unsigned int*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if (strcmp("TrustedCerts", option) == 0)
+        {
+            result = copyStringOption(&handleData->trustedCertificates, value);
+        }
+        else if (strcmp(OPTION_X509_CERT, option) == 0)
+        {
+            result = copyStringOption(&handleData->x509Certificate, value);
+        }
+        else if (strcmp(OPTION_X509_PRIVATE_KEY, option) == 0)
+        {
+            result = copyStringOption(&handleData->x509PrivateKey, value);
+        }
+        else if (strcmp(OPTION_LOG_TRACE, option) == 0)
+        {
+            handleData->logTrace = *(bool*)value;
+            result = IOTHUB_CLIENT_OK;
+        }
+        else if ((strcmp(OPTION_BATCHING, option) == 0) && !*(bool*)value)
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_062: [ "Batching" shall only accept false; every other option shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            result = IOTHUB_CLIENT_OK;
+        }
+        else
+        {
+            /*Codes_SRS_TRANSPORTHTTPASYNC_09_062: [ "Batching" shall only accept false; every other option shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+            LogError("option [%s] is not supported by the HTTP async transport", option);
+            result = IOTHUB_CLIENT_INVALID_ARG;
+        }
+    }
+    return result;
+}
+
+static STRING_HANDLE IoTHubTransportHttpAsync_GetHostname(TRANSPORT_LL_HANDLE handle)
+{
+    STRING_HANDLE result;
+    /*Codes_SRS_TRANSPORTHTTPASYNC_09_063: [ If handle is NULL then IoTHubTransportHttpAsync_GetHostname shall fail and return NULL, otherwise it shall return a clone of the hostname. ]*/
+    if (handle == NULL)
+    {
+        LogError("invalid parameter handle=%p", handle);
+        result = NULL;
+    }
+    else if ((result = STRING_clone(((HTTPASYNCTRANSPORT_HANDLE_DATA*)(handle))->hostName)) == NULL)
+    {
+        LogError("Cannot provide the target host name (STRING_clone failed).");
+    }
+
+    return result;
+}
+
+static int IoTHubTransportHttpAsync_SetRetryPolicy(TRANSPORT_LL_HANDLE handle, IOTHUB_CLIENT_RETRY_POLICY retryPolicy, size_t retryTimeoutLimitInSeconds)
+{
+    (void)handle;
+    (void)retryPolicy;
+    (void)retryTimeoutLimitInSeconds;
+
+    /* Retry Policy is not currently not available for HTTP, failed connections are reopened after RECONNECT_DELAY_SECS */
+
+    return 0;
+}
+
+/*Codes_SRS_TRANSPORTHTTPASYNC_09_064: [ HTTP_Async_Protocol shall return a pointer to a TRANSPORT_PROVIDER holding the IoTHubTransportHttpAsync functions. ]*/
+static TRANSPORT_PROVIDER thisTransportProvider =
+{
+    IoTHubTransportHttpAsync_SendMessageDisposition,     /*pfIotHubTransport_SendMessageDisposition IoTHubTransport_SendMessageDisposition;*/
+    IoTHubTransportHttpAsync_Subscribe_DeviceMethod,     /*pfIoTHubTransport_Subscribe_DeviceMethod IoTHubTransport_Subscribe_DeviceMethod;*/
+    IoTHubTransportHttpAsync_Unsubscribe_DeviceMethod,   /*pfIoTHubTransport_Unsubscribe_DeviceMethod IoTHubTransport_Unsubscribe_DeviceMethod;*/
+    IoTHubTransportHttpAsync_DeviceMethod_Response,      /*pfIoTHubTransport_DeviceMethod_Response IoTHubTransport_DeviceMethod_Response;*/
+    IoTHubTransportHttpAsync_Subscribe_DeviceTwin,       /*pfIoTHubTransport_Subscribe_DeviceTwin IoTHubTransport_Subscribe_DeviceTwin;*/
+    IoTHubTransportHttpAsync_Unsubscribe_DeviceTwin,     /*pfIoTHubTransport_Unsubscribe_DeviceTwin IoTHubTransport_Unsubscribe_DeviceTwin;*/
+    IoTHubTransportHttpAsync_ProcessItem,                /*pfIoTHubTransport_ProcessItem IoTHubTransport_ProcessItem;*/
+    IoTHubTransportHttpAsync_GetHostname,                /*pfIoTHubTransport_GetHostname IoTHubTransport_GetHostname;*/
+    IoTHubTransportHttpAsync_SetOption,                  /*pfIoTHubTransport_SetOption IoTHubTransport_SetOption;*/
+    IoTHubTransportHttpAsync_Create,                     /*pfIoTHubTransport_Create IoTHubTransport_Create;*/
+    IoTHubTransportHttpAsync_Destroy,                    /*pfIoTHubTransport_Destroy IoTHubTransport_Destroy;*/
+    IoTHubTransportHttpAsync_Register,                   /*pfIotHubTransport_Register IoTHubTransport_Register;*/
+    IoTHubTransportHttpAsync_Unregister,                 /*pfIotHubTransport_Unregister IoTHubTransport_Unegister;*/
+    IoTHubTransportHttpAsync_Subscribe,                  /*pfIoTHubTransport_Subscribe IoTHubTransport_Subscribe;*/
+    IoTHubTransportHttpAsync_Unsubscribe,                /*pfIoTHubTransport_Unsubscribe IoTHubTransport_Unsubscribe;*/
+    IoTHubTransportHttpAsync_DoWork,                     /*pfIoTHubTransport_DoWork IoTHubTransport_DoWork;*/
+    IoTHubTransportHttpAsync_SetRetryPolicy,             /*pfIoTHubTransport_DoWork IoTHubTransport_SetRetryPolicy;*/
+    IoTHubTransportHttpAsync_GetSendStatus               /*pfIoTHubTransport_GetSendStatus IoTHubTransport_GetSendStatus;*/
+};
+
+const TRANSPORT_PROVIDER* HTTP_Async_Protocol(void)
+{
+    return &thisTransportProvider;
+}
@@ -8,7 +8,8 @@
 #include "azure_c_shared_utility/gballoc.h"
 #include "azure_c_shared_utility/agenttime.h" 
 #include "azure_c_shared_utility/xlogging.h"
-#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "iothub_client_retry_control.h"
 
 typedef struct MESSAGE_QUEUE_TAG MESSAGE_QUEUE;
 
@@ -20,6 +21,14 @@ typedef struct MESSAGE_QUEUE_TAG MESSAGE_QUEUE;
 static const char* SAVED_OPTION_MAX_RETRY_COUNT = "SAVED_OPTION_MAX_RETRY_COUNT";
 static const char* SAVED_OPTION_MAX_ENQUEUE_TIME_SECS = "SAVED_OPTION_MAX_ENQUEUE_TIME_SECS";
 static const char* SAVED_OPTION_MAX_PROCESSING_TIME_SECS = "SAVED_OPTION_MAX_PROCESSING_TIME_SECS";
+static const char* SAVED_OPTION_RETRY_POLICY = "SAVED_OPTION_RETRY_POLICY";
+
+typedef struct MESSAGE_QUEUE_RETRY_POLICY_TAG
+{
+    IOTHUB_CLIENT_RETRY_POLICY policy;
+    size_t initial_wait_time_secs;
+    size_t max_jitter_percent;
+} MESSAGE_QUEUE_RETRY_POLICY;
 
 
 struct MESSAGE_QUEUE_TAG
@@ -27,36 +36,51 @@ struct MESSAGE_QUEUE_TAG
     size_t max_message_enqueued_time_secs;
     size_t max_message_processing_time_secs;
     size_t max_retry_count;
+    MESSAGE_QUEUE_RETRY_POLICY retry_policy;
+    // Reference for the `retry_not_before_secs` of the delayed items; set on the first delayed retry.
+    time_t retry_epoch;
 
     PROCESS_MESSAGE_CALLBACK on_process_message_callback;
     void* on_process_message_context;
 
-    SINGLYLINKEDLIST_HANDLE pending;
-    SINGLYLINKEDLIST_HANDLE in_progress;
+    DLIST_ENTRY pending;
+    DLIST_ENTRY in_progress;
+    // Items waiting for their retry backoff to expire, sorted by `retry_not_before_secs`.
+    DLIST_ENTRY delayed;
+    // All pending and in-progress items, in the order they were added.
+    DLIST_ENTRY enqueued;
+    // In-progress items that timed out or were cancelled, kept until the processor completes them.
+    DLIST_ENTRY abandoned;
 };
 
+typedef enum MESSAGE_QUEUE_ITEM_STATE_TAG
+{
+    MESSAGE_QUEUE_ITEM_STATE_PENDING,
+    MESSAGE_QUEUE_ITEM_STATE_IN_PROGRESS,
+    MESSAGE_QUEUE_ITEM_STATE_DELAYED,
+    MESSAGE_QUEUE_ITEM_STATE_ABANDONED
+} MESSAGE_QUEUE_ITEM_STATE;
+
 typedef struct MESSAGE_QUEUE_ITEM_TAG
 {
+    // Links the item into `pending`, `in_progress`, `delayed` or `abandoned`, according to `state`.
+    DLIST_ENTRY list_entry;
+    DLIST_ENTRY enqueued_entry;
+    MESSAGE_QUEUE_ITEM_STATE state;
+
     MQ_MESSAGE_HANDLE message;
     MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback;
     void* user_context;
     time_t enqueue_time;
     time_t processing_start_time;
     size_t number_of_attempts;
+    double retry_not_before_secs;
 } MESSAGE_QUEUE_ITEM;
 
 
 
 // ---------- Helper Functions ---------- //
 
-static bool find_item_by_message_ptr(LIST_ITEM_HANDLE list_item, const void* match_context)
-{
-    MESSAGE_QUEUE_ITEM* current_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-    MQ_MESSAGE_HANDLE* target_item = (MQ_MESSAGE_HANDLE*)match_context;
-
-    return (current_item->message == target_item);
-}
-
 static void fire_message_callback(MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RESULT result, void* reason)
 {
     if (mq_item->on_message_processing_completed_callback != NULL)
@@ -75,74 +99,130 @@ static bool should_retry_sending(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUE
     return (result == MESSAGE_QUEUE_RETRYABLE_ERROR && mq_item->number_of_attempts <= message_queue->max_retry_count);
 }
 
-static int retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, LIST_ITEM_HANDLE list_item)
+static unsigned int calculate_retry_wait_time(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
 {
-    int result;
-    MESSAGE_QUEUE_ITEM* mq_item;
-    
-    mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
+    unsigned int result;
 
-    if (singlylinkedlist_remove(message_queue->in_progress, list_item))
+    if (message_queue->retry_policy.policy == IOTHUB_CLIENT_RETRY_NONE ||
+        message_queue->retry_policy.policy == IOTHUB_CLIENT_RETRY_IMMEDIATE)
     {
-        LogError("Failed removing message from in-progress list");
-        result = __FAILURE__;
-    }
-    else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
-    {
-        LogError("Failed moving message back to pending list");
-        result = __FAILURE__;
+        result = 0;
     }
     else
     {
-        result = RESULT_OK;
+        result = retry_control_calculate_wait_time(message_queue->retry_policy.policy,
+            (unsigned int)message_queue->retry_policy.initial_wait_time_secs, (unsigned int)message_queue->retry_policy.max_jitter_percent, (unsigned int)mq_item->number_of_attempts);
     }
 
     return result;
 }
 
-static void dequeue_message_and_fire_callback(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE list_item, MESSAGE_QUEUE_RESULT result, void* reason)
+static void add_to_delayed_list(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
 {
-    MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
+    PDLIST_ENTRY previous = message_queue->delayed.Blink;
+
+    // Most retries are scheduled in order, so the position is searched from the tail.
+    while (previous != &message_queue->delayed &&
+        containingRecord(previous, MESSAGE_QUEUE_ITEM, list_entry)->retry_not_before_secs > mq_item->retry_not_before_secs)
+    {
+        previous = previous->Blink;
+    }
 
-    // Codes_SRS_MESSAGE_QUEUE_09_045: [If `message` is present in `message_queue->in_progress`, it shall be removed]
-    if (singlylinkedlist_remove(list, list_item))
+    mq_item->state = MESSAGE_QUEUE_ITEM_STATE_DELAYED;
+    DList_InsertHeadList(previous, &mq_item->list_entry);
+}
+
+static void retry_sending_message(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item)
+{
+    unsigned int wait_time_secs;
+    time_t current_time;
+
+    (void)DList_RemoveEntryList(&mq_item->list_entry);
+
+    // Codes_SRS_MESSAGE_QUEUE_09_074: [If `message_queue->retry_policy` is not IOTHUB_CLIENT_RETRY_NONE or IOTHUB_CLIENT_RETRY_IMMEDIATE, the wait before re-processing `message` shall be calculated using retry_control_calculate_wait_time(), passing `mq_item->number_of_attempts` as the retry count]
+    if ((wait_time_secs = calculate_retry_wait_time(message_queue, mq_item)) == 0)
+    {
+        mq_item->state = MESSAGE_QUEUE_ITEM_STATE_PENDING;
+        DList_InsertTailList(&message_queue->pending, &mq_item->list_entry);
+    }
+    else if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
+    {
+        // Codes_SRS_MESSAGE_QUEUE_09_076: [If get_time() fails, `mq_item` shall be moved to `message_queue->pending` without delay]
+        LogError("failed delaying the retry of message %p (get_time failed)", mq_item->message);
+        mq_item->state = MESSAGE_QUEUE_ITEM_STATE_PENDING;
+        DList_InsertTailList(&message_queue->pending, &mq_item->list_entry);
+    }
+    else
     {
-        LogError("failed removing message from list (%p)", list);
+        if (message_queue->retry_epoch == INDEFINITE_TIME)
+        {
+            message_queue->retry_epoch = current_time;
+        }
+
+        // Codes_SRS_MESSAGE_QUEUE_09_075: [If the wait is greater than zero, `mq_item` shall be moved to `message_queue->delayed`, not to be re-processed before the wait elapses]
+        mq_item->retry_not_before_secs = get_difftime(current_time, message_queue->retry_epoch) + wait_time_secs;
+        add_to_delayed_list(message_queue, mq_item);
     }
-    
-    // Codes_SRS_MESSAGE_QUEUE_09_049: [Otherwise `mq_item->on_message_processing_completed_callback` shall be invoked passing `mq_item->message`, `result`, `reason` and `mq_item->user_context`]
+}
+
+static void dequeue_message_and_fire_callback(MESSAGE_QUEUE_HANDLE message_queue, MESSAGE_QUEUE_ITEM* mq_item, MESSAGE_QUEUE_RESULT result, void* reason)
+{
+    (void)DList_RemoveEntryList(&mq_item->list_entry);
+    (void)DList_RemoveEntryList(&mq_item->enqueued_entry);
+
     fire_message_callback(mq_item, result, reason);
 
-    // Codes_SRS_MESSAGE_QUEUE_09_050: [The `mq_item` related to `message` shall be freed]
-    free(mq_item);
+    if (mq_item->state == MESSAGE_QUEUE_ITEM_STATE_IN_PROGRESS)
+    {
+        // Codes_SRS_MESSAGE_QUEUE_09_072: [If an `mq_item` in progress is removed by a timeout or cancellation, it shall be kept until on_process_message_completed_callback is invoked for it or `message_queue` is destroyed]
+        mq_item->state = MESSAGE_QUEUE_ITEM_STATE_ABANDONED;
+        DList_InsertTailList(&message_queue->abandoned, &mq_item->list_entry);
+    }
+    else
+    {
+        free(mq_item);
+    }
 }
 
-static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_QUEUE_RESULT result, USER_DEFINED_REASON reason)
+static void on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_queue, MQ_ITEM_HANDLE item, MESSAGE_QUEUE_RESULT result, USER_DEFINED_REASON reason)
 {
-    // Codes_SRS_MESSAGE_QUEUE_09_069: [If `message` or `message_queue` are NULL, on_message_processing_completed_callback shall return immediately]
-    if (message == NULL || message_queue == NULL)
+    // Codes_SRS_MESSAGE_QUEUE_09_069: [If `item` or `message_queue` are NULL, on_message_processing_completed_callback shall return immediately]
+    if (item == NULL || message_queue == NULL)
     {
-        LogError("on_process_message_completed_callback invoked with NULL arguments (message=%p, message_queue=%p)", message, message_queue);
+        LogError("on_process_message_completed_callback invoked with NULL arguments (item=%p, message_queue=%p)", item, message_queue);
     }
     else
     {
-        LIST_ITEM_HANDLE list_item;
-        
-        if ((list_item = singlylinkedlist_find(message_queue->in_progress, find_item_by_message_ptr, message)) == NULL)
+        MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)item;
+
+        if (mq_item->state == MESSAGE_QUEUE_ITEM_STATE_ABANDONED)
+        {
+            // Codes_SRS_MESSAGE_QUEUE_09_071: [If `item` was removed by a timeout or cancellation while in progress, it shall be freed without invoking `mq_item->on_message_processing_completed_callback` again]
+            (void)DList_RemoveEntryList(&mq_item->list_entry);
+            free(mq_item);
+        }
+        else if (mq_item->state != MESSAGE_QUEUE_ITEM_STATE_IN_PROGRESS)
         {
-            // Codes_SRS_MESSAGE_QUEUE_09_044: [If `message` is not present in `message_queue->in_progress`, it shall be ignored]
-            LogError("on_process_message_completed_callback invoked for a message not in the in-progress list (%p)", message);
+            // Codes_SRS_MESSAGE_QUEUE_09_044: [If `item` is not in `message_queue->in_progress`, it shall be ignored]
+            LogError("on_process_message_completed_callback invoked for a message not in progress (%p)", mq_item->message);
+        }
+        // Codes_SRS_MESSAGE_QUEUE_09_047: [If `result` is MESSAGE_QUEUE_RETRYABLE_ERROR and `mq_item->number_of_attempts` is less than or equal `message_queue->max_retry_count`, the `message` shall be moved to `message_queue->pending` to be re-sent]
+        else if (should_retry_sending(message_queue, mq_item, result))
+        {
+            retry_sending_message(message_queue, mq_item);
         }
         else
         {
-            MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-        
-            // Codes_SRS_MESSAGE_QUEUE_09_047: [If `result` is MESSAGE_QUEUE_RETRYABLE_ERROR and `mq_item->number_of_attempts` is less than or equal `message_queue->max_retry_count`, the `message` shall be moved to `message_queue->pending` to be re-sent]
+            // Codes_SRS_MESSAGE_QUEUE_09_045: [If `item` is in `message_queue->in_progress`, it shall be removed]
+            (void)DList_RemoveEntryList(&mq_item->list_entry);
+            (void)DList_RemoveEntryList(&mq_item->enqueued_entry);
+
             // Codes_SRS_MESSAGE_QUEUE_09_048: [If `result` is MESSAGE_QUEUE_RETRYABLE_ERROR and `mq_item->number_of_attempts` is greater than `message_queue->max_retry_count`, result shall be changed to MESSAGE_QUEUE_ERROR]
-            if (!should_retry_sending(message_queue, mq_item, result) || retry_sending_message(message_queue, list_item) != RESULT_OK)
-            {
-                dequeue_message_and_fire_callback(message_queue->in_progress, list_item, result, reason);
-            }
+            // Codes_SRS_MESSAGE_QUEUE_09_049: [Otherwise `mq_item->on_message_processing_completed_callback` shall be invoked passing `mq_item->message`, `result`, `reason` and `mq_item->user_context`]
+            fire_message_callback(mq_item, result, reason);
+
+            // Codes_SRS_MESSAGE_QUEUE_09_050: [The `mq_item` related to `item` shall be freed]
+            free(mq_item);
         }
     }
 }
@@ -157,130 +237,87 @@ static void process_timeouts(MESSAGE_QUEUE_HANDLE message_queue)
     }
     else
     {
-        // Codes_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_secs` is greater than zero, `message_queue->in_progress` and `message_queue->pending` items shall be checked for timeout]
+        // Codes_SRS_MESSAGE_QUEUE_09_035: [If `message_queue->max_message_enqueued_time_secs` is greater than zero, `message_queue->enqueued` items shall be checked for timeout in the order they were added, stopping at the first one not timed out]
         if (message_queue->max_message_enqueued_time_secs > 0)
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->pending);
-
-            while (list_item != NULL)
+            while (!DList_IsListEmpty(&message_queue->enqueued))
             {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
-
-                list_item = singlylinkedlist_get_next_item(list_item);
+                MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->enqueued.Flink, MESSAGE_QUEUE_ITEM, enqueued_entry);
 
-                if (mq_item == NULL)
+                if (get_difftime(current_time, mq_item->enqueue_time) < message_queue->max_message_enqueued_time_secs)
                 {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
-                {
-                    // Codes_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
-                    dequeue_message_and_fire_callback(message_queue->pending, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
-                else
-                {
-                    // The pending list order is already based on enqueue time, so if one message is not expired, later ones won't be either.
                     break;
                 }
-            }
-
-            list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
-
-            while (list_item != NULL)
-            {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
-
-                list_item = singlylinkedlist_get_next_item(list_item);
 
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->enqueue_time) >= message_queue->max_message_enqueued_time_secs)
-                {
-                    // Codes_SRS_MESSAGE_QUEUE_09_038: [If any items are in `message_queue->in_progress` for `message_queue->max_message_processing_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
+                // Codes_SRS_MESSAGE_QUEUE_09_036: [If any items are in `message_queue` lists for `message_queue->max_message_enqueued_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+                dequeue_message_and_fire_callback(message_queue, mq_item, MESSAGE_QUEUE_TIMEOUT, NULL);
             }
         }
 
         // Codes_SRS_MESSAGE_QUEUE_09_037: [If `message_queue->max_message_processing_time_secs` is greater than zero, `message_queue->in_progress` items shall be checked for timeout]
         if (message_queue->max_message_processing_time_secs > 0)
         {
-            LIST_ITEM_HANDLE list_item = singlylinkedlist_get_head_item(message_queue->in_progress);
-
-            while (list_item != NULL)
+            while (!DList_IsListEmpty(&message_queue->in_progress))
             {
-                LIST_ITEM_HANDLE current_list_item = list_item;
-                MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(current_list_item);
+                MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->in_progress.Flink, MESSAGE_QUEUE_ITEM, list_entry);
 
-                list_item = singlylinkedlist_get_next_item(list_item);
-
-                if (mq_item == NULL)
-                {
-                    LogError("failed processing timeouts (unexpected NULL pointer to MESSAGE_QUEUE_ITEM)");
-                }
-                else if (get_difftime(current_time, mq_item->processing_start_time) >= message_queue->max_message_processing_time_secs)
+                // The in-progress list order is already based on start-processing time, so if one message is not expired, later ones won't be either.
+                if (get_difftime(current_time, mq_item->processing_start_time) < message_queue->max_message_processing_time_secs)
                 {
-                    dequeue_message_and_fire_callback(message_queue->in_progress, current_list_item, MESSAGE_QUEUE_TIMEOUT, NULL);
-                }
-                else
-                {
-                    // The in-progress list order is already based on start-processing time, so if one message is not expired, later ones won't be either.
                     break;
                 }
+
+                // Codes_SRS_MESSAGE_QUEUE_09_038: [If any items are in `message_queue->in_progress` for `message_queue->max_message_processing_time_secs` or more, they shall be removed and `message_queue->on_message_processing_completed_callback` invoked with MESSAGE_QUEUE_TIMEOUT]
+                dequeue_message_and_fire_callback(message_queue, mq_item, MESSAGE_QUEUE_TIMEOUT, NULL);
             }
         }
     }
 }
 
-static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
+static void process_delayed_messages(MESSAGE_QUEUE_HANDLE message_queue)
 {
-    LIST_ITEM_HANDLE list_item;
-
-    while ((list_item = singlylinkedlist_get_head_item(message_queue->pending)) != NULL)
+    if (!DList_IsListEmpty(&message_queue->delayed))
     {
-        MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
+        time_t current_time;
 
-        if (mq_item == NULL)
+        if ((current_time = get_time(NULL)) == INDEFINITE_TIME)
         {
-            LogError("internal error, failed to retrieve list node value");
-            break;
+            LogError("failed processing delayed retries (get_time failed)");
         }
-        else if (singlylinkedlist_remove(message_queue->pending, list_item) != 0)
+        else
         {
-            LogError("failed moving message out of pending list (%p)", mq_item->message);
+            double secs_since_retry_epoch = get_difftime(current_time, message_queue->retry_epoch);
 
-            // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
-            if (mq_item->on_message_processing_completed_callback != NULL)
+            // Codes_SRS_MESSAGE_QUEUE_09_077: [Each `mq_item` in `message_queue->delayed` whose wait has elapsed shall be moved to the tail of `message_queue->pending`]
+            while (!DList_IsListEmpty(&message_queue->delayed))
             {
-                mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
-            }
+                MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->delayed.Flink, MESSAGE_QUEUE_ITEM, list_entry);
 
-            // Not freeing since this would cause a memory A/V on the next call.
+                if (mq_item->retry_not_before_secs > secs_since_retry_epoch)
+                {
+                    break;
+                }
 
-            break; // Trying to avoid an infinite loop
+                (void)DList_RemoveEntryList(&mq_item->list_entry);
+                mq_item->state = MESSAGE_QUEUE_ITEM_STATE_PENDING;
+                DList_InsertTailList(&message_queue->pending, &mq_item->list_entry);
+            }
         }
+    }
+}
+
+static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
+{
+    while (!DList_IsListEmpty(&message_queue->pending))
+    {
+        MESSAGE_QUEUE_ITEM* mq_item = containingRecord(DList_RemoveHeadList(&message_queue->pending), MESSAGE_QUEUE_ITEM, list_entry);
+
         // Codes_SRS_MESSAGE_QUEUE_09_040: [`mq_item->processing_start_time` shall be set using get_time()]
-        else if ((mq_item->processing_start_time = get_time(NULL)) == INDEFINITE_TIME)
+        if ((mq_item->processing_start_time = get_time(NULL)) == INDEFINITE_TIME)
         {
             // Codes_SRS_MESSAGE_QUEUE_09_041: [If get_time() fails, `mq_item` shall be removed from `message_queue->in_progress`]
             LogError("failed setting message processing_start_time (%p)", mq_item->message);
-
-            // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
-            if (mq_item->on_message_processing_completed_callback != NULL)
-            {
-                mq_item->on_message_processing_completed_callback(mq_item->message, MESSAGE_QUEUE_ERROR, NULL, mq_item->user_context);
-            }
-
-            free(mq_item);
-        }
-        // Codes_SRS_MESSAGE_QUEUE_09_039: [Each `mq_item` in `message_queue->pending` shall be moved to `message_queue->in_progress`]
-        else if (singlylinkedlist_add(message_queue->in_progress, (const void*)mq_item) == NULL)
-        {
-            LogError("failed moving message to in-progress list (%p)", mq_item->message);
+            (void)DList_RemoveEntryList(&mq_item->enqueued_entry);
 
             // Codes_SRS_MESSAGE_QUEUE_09_042: [If any failures occur, `mq_item->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_ERROR and `mq_item` freed]
             if (mq_item->on_message_processing_completed_callback != NULL)
@@ -292,6 +329,9 @@ static void process_pending_messages(MESSAGE_QUEUE_HANDLE message_queue)
         }
         else
         {
+            // Codes_SRS_MESSAGE_QUEUE_09_039: [Each `mq_item` in `message_queue->pending` shall be moved to `message_queue->in_progress`]
+            mq_item->state = MESSAGE_QUEUE_ITEM_STATE_IN_PROGRESS;
+            DList_InsertTailList(&message_queue->in_progress, &mq_item->list_entry);
             mq_item->number_of_attempts++;
 
             // Codes_SRS_MESSAGE_QUEUE_09_043: [If no failures occur, `message_queue->on_process_message_callback` shall be invoked passing `mq_item->message` and `on_process_message_completed_callback`]
@@ -322,6 +362,17 @@ static void* cloneOption(const char* name, const void* value)
             memcpy(result, value, sizeof(size_t));
         }
     }
+    else if (strcmp(SAVED_OPTION_RETRY_POLICY, name) == 0)
+    {
+        if ((result = malloc(sizeof(MESSAGE_QUEUE_RETRY_POLICY))) == NULL)
+        {
+            LogError("failed cloning option %s (malloc failed)", name);
+        }
+        else
+        {
+            memcpy(result, value, sizeof(MESSAGE_QUEUE_RETRY_POLICY));
+        }
+    }
     else
     {
         LogError("option %s is invalid", name);
@@ -339,7 +390,8 @@ static void destroyOption(const char* name, const void* value)
     }
     else if (strcmp(SAVED_OPTION_MAX_ENQUEUE_TIME_SECS, name) == 0 || 
         strcmp(SAVED_OPTION_MAX_PROCESSING_TIME_SECS, name) == 0 || 
-        strcmp(SAVED_OPTION_MAX_RETRY_COUNT, name) == 0)
+        strcmp(SAVED_OPTION_MAX_RETRY_COUNT, name) == 0 ||
+        strcmp(SAVED_OPTION_RETRY_POLICY, name) == 0)
     {
         free((void*)value);
     }
@@ -358,64 +410,28 @@ void message_queue_remove_all(MESSAGE_QUEUE_HANDLE message_queue)
     // Codes_SRS_MESSAGE_QUEUE_09_026: [If `message_queue` is NULL, message_queue_retrieve_options shall return]
     if (message_queue != NULL)
     {
-        LIST_ITEM_HANDLE list_item;
-
-        // Codes_SRS_MESSAGE_QUEUE_09_027: [Each `mq_item` in `message_queue->pending` and `message_queue->in_progress` lists shall be removed] 
-        while ((list_item = singlylinkedlist_get_head_item(message_queue->in_progress)) != NULL)
+        // Codes_SRS_MESSAGE_QUEUE_09_027: [Each `mq_item` in `message_queue->pending`, `message_queue->delayed` and `message_queue->in_progress` lists shall be removed]
+        while (!DList_IsListEmpty(&message_queue->in_progress))
         {
             // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
-            // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed] 
-            dequeue_message_and_fire_callback(message_queue->in_progress, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+            // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
+            dequeue_message_and_fire_callback(message_queue, containingRecord(message_queue->in_progress.Flink, MESSAGE_QUEUE_ITEM, list_entry), MESSAGE_QUEUE_CANCELLED, NULL);
         }
 
-        while ((list_item = singlylinkedlist_get_head_item(message_queue->pending)) != NULL)
+        while (!DList_IsListEmpty(&message_queue->delayed))
         {
             // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
-            // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed] 
-            dequeue_message_and_fire_callback(message_queue->pending, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
+            // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
+            dequeue_message_and_fire_callback(message_queue, containingRecord(message_queue->delayed.Flink, MESSAGE_QUEUE_ITEM, list_entry), MESSAGE_QUEUE_CANCELLED, NULL);
         }
-    }
-}
-
-static int move_messages_between_lists(SINGLYLINKEDLIST_HANDLE from_list, SINGLYLINKEDLIST_HANDLE to_list)
-{
-    int result;
-    LIST_ITEM_HANDLE list_item;
 
-    result = RESULT_OK;
-
-    while ((list_item = singlylinkedlist_get_head_item(from_list)) != NULL)
-    {
-        if (singlylinkedlist_remove(from_list, list_item) != 0)
+        while (!DList_IsListEmpty(&message_queue->pending))
         {
-            LogError("failed removing message from list");
-            result = __FAILURE__;
-        }
-        else
-        {
-            MESSAGE_QUEUE_ITEM* mq_item = (MESSAGE_QUEUE_ITEM*)singlylinkedlist_item_get_value(list_item);
-
-            if (singlylinkedlist_add(to_list, (const void*)mq_item) != 0)
-            {
-                LogError("failed moving message to list");
-
-                fire_message_callback(mq_item, MESSAGE_QUEUE_CANCELLED, NULL);
-
-                free(mq_item);
-
-                result = __FAILURE__;
-
-                break;
-            }
-            else
-            {
-                mq_item->number_of_attempts = 0;
-                mq_item->processing_start_time = INDEFINITE_TIME;
-            }
+            // Codes_SRS_MESSAGE_QUEUE_09_028: [`message_queue->on_message_processing_completed_callback` shall be invoked with MESSAGE_QUEUE_CANCELLED for each `mq_item` removed]
+            // Codes_SRS_MESSAGE_QUEUE_09_029: [Each `mq_item` shall be freed]
+            dequeue_message_and_fire_callback(message_queue, containingRecord(message_queue->pending.Flink, MESSAGE_QUEUE_ITEM, list_entry), MESSAGE_QUEUE_CANCELLED, NULL);
         }
     }
-
-    return result;
 }
 
 int message_queue_move_all_back_to_pending(MESSAGE_QUEUE_HANDLE message_queue)
@@ -429,47 +445,37 @@ int message_queue_move_all_back_to_pending(MESSAGE_QUEUE_HANDLE message_queue)
     }
     else
     {
-        SINGLYLINKEDLIST_HANDLE temp_list;
+        PDLIST_ENTRY entry;
 
-        if ((temp_list = singlylinkedlist_create()) == NULL)
+        // Retries still waiting for their backoff are not delayed any longer.
+        while (!DList_IsListEmpty(&message_queue->delayed))
         {
-            LogError("failed creating temporary list");
-            result = __FAILURE__;
+            MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->delayed.Blink, MESSAGE_QUEUE_ITEM, list_entry);
+
+            (void)DList_RemoveEntryList(&mq_item->list_entry);
+            mq_item->state = MESSAGE_QUEUE_ITEM_STATE_PENDING;
+            DList_InsertHeadList(&message_queue->pending, &mq_item->list_entry);
         }
-        else
+
+        // In-progress messages go back to the head of the pending list (in their original order), so they are processed first.
+        while (!DList_IsListEmpty(&message_queue->in_progress))
         {
-            if (move_messages_between_lists(message_queue->in_progress, temp_list) != 0)
-            {
-                LogError("failed moving in-progress message to temporary list");
-                result = __FAILURE__;
-            }
-            else if (move_messages_between_lists(message_queue->pending, temp_list) != 0)
-            {
-                LogError("failed moving pending message to temporary list");
-                result = __FAILURE__;
-            }
-            else if (move_messages_between_lists(temp_list, message_queue->pending) != 0)
-            {
-                LogError("failed moving pending message to temporary list");
-                result = __FAILURE__;
-            }
-            else
-            {
-                result = RESULT_OK;
-            }
+            MESSAGE_QUEUE_ITEM* mq_item = containingRecord(message_queue->in_progress.Blink, MESSAGE_QUEUE_ITEM, list_entry);
 
-            if (result != RESULT_OK)
-            {
-                LIST_ITEM_HANDLE list_item;
+            (void)DList_RemoveEntryList(&mq_item->list_entry);
+            mq_item->state = MESSAGE_QUEUE_ITEM_STATE_PENDING;
+            DList_InsertHeadList(&message_queue->pending, &mq_item->list_entry);
+        }
 
-                while ((list_item = singlylinkedlist_get_head_item(temp_list)) != NULL)
-                {
-                    dequeue_message_and_fire_callback(temp_list, list_item, MESSAGE_QUEUE_CANCELLED, NULL);
-                }
-            }
+        for (entry = message_queue->pending.Flink; entry != &message_queue->pending; entry = entry->Flink)
+        {
+            MESSAGE_QUEUE_ITEM* mq_item = containingRecord(entry, MESSAGE_QUEUE_ITEM, list_entry);
 
-			singlylinkedlist_destroy(temp_list);
+            mq_item->number_of_attempts = 0;
+            mq_item->processing_start_time = INDEFINITE_TIME;
         }
+
+        result = RESULT_OK;
     }
 
     return result;
@@ -483,17 +489,13 @@ void message_queue_destroy(MESSAGE_QUEUE_HANDLE message_queue)
         // Codes_SRS_MESSAGE_QUEUE_09_014: [message_queue_destroy shall invoke message_queue_remove_all]
         message_queue_remove_all(message_queue);
 
-        // Codes_SRS_MESSAGE_QUEUE_09_015: [message_queue_destroy shall free all memory allocated and pointed by `message_queue`]
-        if (message_queue->pending != NULL)
+        // Codes_SRS_MESSAGE_QUEUE_09_073: [message_queue_destroy shall free the `mq_item`s still waiting for on_process_message_completed_callback, without invoking any callbacks]
+        while (!DList_IsListEmpty(&message_queue->abandoned))
         {
-            singlylinkedlist_destroy(message_queue->pending);
+            free(containingRecord(DList_RemoveHeadList(&message_queue->abandoned), MESSAGE_QUEUE_ITEM, list_entry));
         }
 
-        if (message_queue->in_progress != NULL)
-        {
-            singlylinkedlist_destroy(message_queue->in_progress);
-        }
-        
+        // Codes_SRS_MESSAGE_QUEUE_09_015: [message_queue_destroy shall free all memory allocated and pointed by `message_queue`]
         free(message_queue);
     }
 }
@@ -525,47 +527,36 @@ MESSAGE_QUEUE_HANDLE message_queue_create(MESSAGE_QUEUE_CONFIG* config)
     {
         memset(result, 0, sizeof(MESSAGE_QUEUE));
 
-        // Codes_SRS_MESSAGE_QUEUE_09_006: [`message_queue->pending` shall be set using singlylinkedlist_create()]
-        if ((result->pending = singlylinkedlist_create()) == NULL)
-        {
-            // Codes_SRS_MESSAGE_QUEUE_09_007: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
-            LogError("failed allocating MESSAGE_QUEUE pending list");
-            // Codes_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
-            message_queue_destroy(result);
-            result = NULL;
-        }
-        // Codes_SRS_MESSAGE_QUEUE_09_008: [`message_queue->in_progress` shall be set using singlylinkedlist_create()]
-        else if ((result->in_progress = singlylinkedlist_create()) == NULL)
-        {
-            // Codes_SRS_MESSAGE_QUEUE_09_009: [If singlylinkedlist_create fails, message_queue_create shall fail and return NULL]
-            LogError("failed allocating MESSAGE_QUEUE in-progress list");
-            // Codes_SRS_MESSAGE_QUEUE_09_011: [If any failures occur, message_queue_create shall release all memory it has allocated]
-            message_queue_destroy(result);
-            result = NULL;
-        }
-        else
-        {
-            // Codes_SRS_MESSAGE_QUEUE_09_010: [All arguments in `config` shall be saved into `message_queue`]
-            // Codes_SRS_MESSAGE_QUEUE_09_012: [If no failures occur, message_queue_create shall return the `message_queue` pointer]
-
-            result->max_message_enqueued_time_secs = config->max_message_enqueued_time_secs;
-            result->max_message_processing_time_secs = config->max_message_processing_time_secs;
-            result->max_retry_count = config->max_retry_count;
-            result->on_process_message_callback = config->on_process_message_callback;
-        }
+        // Codes_SRS_MESSAGE_QUEUE_09_006: [`message_queue->pending`, `message_queue->in_progress`, `message_queue->delayed`, `message_queue->enqueued` and `message_queue->abandoned` shall be initialized using DList_InitializeListHead()]
+        DList_InitializeListHead(&result->pending);
+        DList_InitializeListHead(&result->in_progress);
+        DList_InitializeListHead(&result->delayed);
+        DList_InitializeListHead(&result->enqueued);
+        DList_InitializeListHead(&result->abandoned);
+
+        // Codes_SRS_MESSAGE_QUEUE_09_010: [All arguments in `config` shall be saved into `message_queue`]
+        // Codes_SRS_MESSAGE_QUEUE_09_012: [If no failures occur, message_queue_create shall return the `message_queue` pointer]
+        result->max_message_enqueued_time_secs = config->max_message_enqueued_time_secs;
+        result->max_message_processing_time_secs = config->max_message_processing_time_secs;
+        result->max_retry_count = config->max_retry_count;
+        result->retry_policy.policy = config->retry_policy;
+        result->retry_policy.initial_wait_time_secs = config->initial_retry_wait_time_secs;
+        result->retry_policy.max_jitter_percent = config->max_retry_jitter_percent;
+        result->retry_epoch = INDEFINITE_TIME;
+        result->on_process_message_callback = config->on_process_message_callback;
     }
 
     return result;
 }
 
-int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback, void* user_context)
+int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback, void* user_context, MQ_ITEM_HANDLE* item)
 {
     int result;
 
-    // Codes_SRS_MESSAGE_QUEUE_09_016: [If `message_queue` or `message` are NULL, message_queue_add shall fail and return non-zero]
-    if (message_queue == NULL || message == NULL)
+    // Codes_SRS_MESSAGE_QUEUE_09_016: [If `message_queue`, `message` or `item` are NULL, message_queue_add shall fail and return non-zero]
+    if (message_queue == NULL || message == NULL || item == NULL)
     {
-        LogError("invalid argument (message_queue=%p, message=%p)", message_queue, message);
+        LogError("invalid argument (message_queue=%p, message=%p, item=%p)", message_queue, message, item);
         result = __FAILURE__;
     }
     else
@@ -592,15 +583,6 @@ int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE mess
                 free(mq_item);
                 result = __FAILURE__;
             }
-            // Codes_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to `message_queue->pending` list]
-            else if (singlylinkedlist_add(message_queue->pending, (const void*)mq_item) == NULL)
-            {
-                // Codes_SRS_MESSAGE_QUEUE_09_022: [`mq_item` fails to be added to `message_queue->pending`, message_queue_add shall fail and return non-zero]
-                LogError("failed enqueing message");
-                // Codes_SRS_MESSAGE_QUEUE_09_024: [If any failures occur, message_queue_add shall release all memory it has allocated]
-                free(mq_item);
-                result = __FAILURE__;
-            }
             else
             {
                 // Codes_SRS_MESSAGE_QUEUE_09_023: [`message` shall be saved into `mq_item->message`]
@@ -608,6 +590,15 @@ int message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE mess
                 mq_item->on_message_processing_completed_callback = on_message_processing_completed_callback;
                 mq_item->user_context = user_context;
                 mq_item->processing_start_time = INDEFINITE_TIME;
+                mq_item->state = MESSAGE_QUEUE_ITEM_STATE_PENDING;
+
+                // Codes_SRS_MESSAGE_QUEUE_09_021: [`mq_item` shall be added to the tail of the `message_queue->pending` and `message_queue->enqueued` lists]
+                DList_InsertTailList(&message_queue->pending, &mq_item->list_entry);
+                DList_InsertTailList(&message_queue->enqueued, &mq_item->enqueued_entry);
+
+                // Codes_SRS_MESSAGE_QUEUE_09_070: [`item` shall be set with the handle of `mq_item`]
+                *item = mq_item;
+
                 // Codes_SRS_MESSAGE_QUEUE_09_025: [If no failures occur, message_queue_add shall return 0]
                 result = RESULT_OK;
             }
@@ -629,9 +620,9 @@ int message_queue_is_empty(MESSAGE_QUEUE_HANDLE message_queue, bool* is_empty)
     }
     else
     {
-        // Codes_SRS_MESSAGE_QUEUE_09_031: [If `message_queue->pending` and `message_queue->in_progress` are empty, `is_empty` shall be set to true]
+        // Codes_SRS_MESSAGE_QUEUE_09_031: [If `message_queue->pending`, `message_queue->delayed` and `message_queue->in_progress` are empty, `is_empty` shall be set to true]
         // Codes_SRS_MESSAGE_QUEUE_09_032: [Otherwise `is_empty` shall be set to false]
-        *is_empty = (singlylinkedlist_get_head_item(message_queue->pending) == NULL && singlylinkedlist_get_head_item(message_queue->in_progress) == NULL);
+        *is_empty = (DList_IsListEmpty(&message_queue->pending) && DList_IsListEmpty(&message_queue->delayed) && DList_IsListEmpty(&message_queue->in_progress));
         // Codes_SRS_MESSAGE_QUEUE_09_033: [If no failures occur, message_queue_is_empty shall return 0]
         result = RESULT_OK;
     }
@@ -645,6 +636,7 @@ void message_queue_do_work(MESSAGE_QUEUE_HANDLE message_queue)
     if (message_queue != NULL)
     {
         process_timeouts(message_queue);
+        process_delayed_messages(message_queue);
         process_pending_messages(message_queue);
     }
 }
@@ -712,6 +704,29 @@ int message_queue_set_max_retry_count(MESSAGE_QUEUE_HANDLE message_queue, size_t
     return result;
 }
 
+int message_queue_set_retry_policy(MESSAGE_QUEUE_HANDLE message_queue, IOTHUB_CLIENT_RETRY_POLICY policy, size_t initial_wait_time_secs, size_t max_jitter_percent)
+{
+    int result;
+
+    // Codes_SRS_MESSAGE_QUEUE_09_078: [If `message_queue` is NULL or `max_jitter_percent` is greater than 100, message_queue_set_retry_policy shall fail and return non-zero]
+    if (message_queue == NULL || max_jitter_percent > 100)
+    {
+        LogError("invalid argument (message_queue=%p, max_jitter_percent=%lu)", message_queue, (unsigned long)max_jitter_percent);
+        result = __FAILURE__;
+    }
+    else
+    {
+        // Codes_SRS_MESSAGE_QUEUE_09_079: [`policy`, `initial_wait_time_secs` and `max_jitter_percent` shall be saved into `message_queue->retry_policy`]
+        message_queue->retry_policy.policy = policy;
+        message_queue->retry_policy.initial_wait_time_secs = initial_wait_time_secs;
+        message_queue->retry_policy.max_jitter_percent = max_jitter_percent;
+        // Codes_SRS_MESSAGE_QUEUE_09_080: [If no failures occur, message_queue_set_retry_policy shall return 0]
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
 static int setOption(void* handle, const char* name, const void* value)
 {
     int result;
@@ -757,6 +772,20 @@ static int setOption(void* handle, const char* name, const void* value)
             result = RESULT_OK;
         }
     }
+    else if (strcmp(SAVED_OPTION_RETRY_POLICY, name) == 0)
+    {
+        MESSAGE_QUEUE_RETRY_POLICY* retry_policy = (MESSAGE_QUEUE_RETRY_POLICY*)value;
+
+        if (message_queue_set_retry_policy((MESSAGE_QUEUE_HANDLE)handle, retry_policy->policy, retry_policy->initial_wait_time_secs, retry_policy->max_jitter_percent) != RESULT_OK)
+        {
+            LogError("failed setting option %s", name);
+            result = __FAILURE__;
+        }
+        else
+        {
+            result = RESULT_OK;
+        }
+    }
     else
     {
         LogError("option %s is invalid", name);
@@ -807,6 +836,14 @@ OPTIONHANDLER_HANDLE message_queue_retrieve_options(MESSAGE_QUEUE_HANDLE message
         // Codes_SRS_MESSAGE_QUEUE_09_066: [If OptionHandler_AddOption fails, message_queue_retrieve_options shall fail and return NULL]
         result = NULL;
     }
+    else if (OptionHandler_AddOption(result, SAVED_OPTION_RETRY_POLICY, &message_queue->retry_policy) != OPTIONHANDLER_OK)
+    {
+        LogError("failed retrieving options (failed adding %s)", SAVED_OPTION_RETRY_POLICY);
+        // Codes_SRS_MESSAGE_QUEUE_09_067: [If message_queue_retrieve_options fails, any allocated memory shall be freed]
+        OptionHandler_Destroy(result);
+        // Codes_SRS_MESSAGE_QUEUE_09_066: [If OptionHandler_AddOption fails, message_queue_retrieve_options shall fail and return NULL]
+        result = NULL;
+    }
 
     // Codes_SRS_MESSAGE_QUEUE_09_068: [If no failures occur, message_queue_retrieve_options shall return the OPTIONHANDLER_HANDLE instance]
     return result;
@@ -1,6 +1,8 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include "uamqp_messaging.h"
 #include "azure_c_shared_utility/optimize_size.h"
 #include "azure_c_shared_utility/xlogging.h"
@@ -11,205 +13,146 @@
 #define RESULT_OK 0
 #endif
 
-static int encode_callback(void* context, const unsigned char* bytes, size_t length)
+#define AMQP_DESCRIBED_TYPE_CONSTRUCTOR 0x00
+#define AMQP_SMALLULONG_CONSTRUCTOR 0x53
+#define AMQP_NULL_CONSTRUCTOR 0x40
+#define AMQP_LIST0_CONSTRUCTOR 0x45
+#define AMQP_LIST8_CONSTRUCTOR 0xC0
+#define AMQP_LIST32_CONSTRUCTOR 0xD0
+#define AMQP_MAP8_CONSTRUCTOR 0xC1
+#define AMQP_MAP32_CONSTRUCTOR 0xD1
+#define AMQP_VBIN8_CONSTRUCTOR 0xA0
+#define AMQP_VBIN32_CONSTRUCTOR 0xB0
+#define AMQP_STR8_CONSTRUCTOR 0xA1
+#define AMQP_STR32_CONSTRUCTOR 0xB1
+#define AMQP_SYM8_CONSTRUCTOR 0xA3
+#define AMQP_SYM32_CONSTRUCTOR 0xB3
+
+#define AMQP_PROPERTIES_DESCRIPTOR 0x73
+#define AMQP_APPLICATION_PROPERTIES_DESCRIPTOR 0x74
+#define AMQP_DATA_DESCRIPTOR 0x75
+#define AMQP_DESCRIPTOR_ENCODED_SIZE 3
+
+/*index of the fields of the AMQP properties list we fill; fields in between are encoded as null, trailing ones are omitted*/
+#define PROPERTIES_MESSAGE_ID_INDEX 0
+#define PROPERTIES_CORRELATION_ID_INDEX 5
+#define PROPERTIES_CONTENT_TYPE_INDEX 6
+#define PROPERTIES_CONTENT_ENCODING_INDEX 7
+#define PROPERTIES_FIELD_COUNT 8
+
+typedef struct MESSAGE_ENCODING_INFO_TAG
 {
-    BINARY_DATA* message_body_binary = (BINARY_DATA*)context;
-    (void)memcpy((unsigned char*)message_body_binary->bytes + message_body_binary->length, bytes, length);
-    message_body_binary->length += length;
-    return 0;
+    const char* properties[PROPERTIES_FIELD_COUNT];
+    size_t properties_count;
+    size_t properties_size;
+    const char* const* application_property_keys;
+    const char* const* application_property_values;
+    size_t application_property_count;
+    size_t application_properties_size;
+    const unsigned char* data;
+    size_t data_length;
+} MESSAGE_ENCODING_INFO;
+
+static size_t get_variable_width_encoded_size(size_t length)
+{
+    return ((length <= UINT8_MAX) ? 2 : 5) + length;
 }
 
-// Codes_SRS_UAMQP_MESSAGING_31_112: [If optional message-id is present in the message, encode it into the AMQP message.]
-static int set_message_id_if_needed(IOTHUB_MESSAGE_HANDLE messageHandle, PROPERTIES_HANDLE uamqp_message_properties)
+static size_t get_compound_encoded_size(size_t items_size, size_t count)
 {
-    int result;
-    const char* messageId;
-
-    if (NULL != (messageId = IoTHubMessage_GetMessageId(messageHandle)))
-    {
-        AMQP_VALUE uamqp_message_id;
-
-        if ((uamqp_message_id = amqpvalue_create_string(messageId)) == NULL)
-        {
-            LogError("Failed amqpvalue_create_string for message_id");
-            result = __FAILURE__;
-        }
-        else if (properties_set_message_id(uamqp_message_properties, uamqp_message_id) != 0)
-        {
-            LogError("Failed properties_set_message_id");
-            result = __FAILURE__;
-        }
-        else
-        {
-            result = RESULT_OK;
-        }
-
-        if (NULL != uamqp_message_id)
-        {
-            amqpvalue_destroy(uamqp_message_id);
-        }
-    }
-    else
-    {
-        result = RESULT_OK;
-    }
+    return ((items_size + 1 <= UINT8_MAX && count <= UINT8_MAX) ? 3 : 9) + items_size;
+}
 
-    return result;
+static unsigned char* encode_uint32(unsigned char* destination, size_t value)
+{
+    destination[0] = (unsigned char)((value >> 24) & 0xFF);
+    destination[1] = (unsigned char)((value >> 16) & 0xFF);
+    destination[2] = (unsigned char)((value >> 8) & 0xFF);
+    destination[3] = (unsigned char)(value & 0xFF);
+    return destination + 4;
 }
 
-// Codes_SRS_UAMQP_MESSAGING_31_113: [If optional correlation-id is present in the message, encode it into the AMQP message.]
-static int set_message_correlation_id_if_needed(IOTHUB_MESSAGE_HANDLE messageHandle, PROPERTIES_HANDLE uamqp_message_properties)
+static unsigned char* encode_descriptor(unsigned char* destination, unsigned char descriptor)
 {
-    int result;
-    const char* correlationId;
+    destination[0] = AMQP_DESCRIBED_TYPE_CONSTRUCTOR;
+    destination[1] = AMQP_SMALLULONG_CONSTRUCTOR;
+    destination[2] = descriptor;
+    return destination + AMQP_DESCRIPTOR_ENCODED_SIZE;
+}
 
-    if (NULL != (correlationId = IoTHubMessage_GetCorrelationId(messageHandle)))
+static unsigned char* encode_variable_width(unsigned char* destination, unsigned char constructor8, unsigned char constructor32, const void* bytes, size_t length)
+{
+    if (length <= UINT8_MAX)
     {
-        AMQP_VALUE uamqp_correlation_id;
-
-        if ((uamqp_correlation_id = amqpvalue_create_string(correlationId)) == NULL)
-        {
-            LogError("Failed amqpvalue_create_string for message_id");
-            result = __FAILURE__;
-        }
-        else if (properties_set_correlation_id(uamqp_message_properties, uamqp_correlation_id) != 0)
-        {
-            LogError("Failed properties_set_correlation_id");
-            result = __FAILURE__;
-        }
-        else
-        {
-            result = RESULT_OK;
-        }
-
-        if (uamqp_correlation_id != NULL)
-        {
-            amqpvalue_destroy(uamqp_correlation_id);
-        }
+        *destination++ = constructor8;
+        *destination++ = (unsigned char)length;
     }
     else
     {
-        result = RESULT_OK;
+        *destination++ = constructor32;
+        destination = encode_uint32(destination, length);
     }
 
-    return result;
-}
-
-// Codes_SRS_UAMQP_MESSAGING_31_114: [If optional content-type is present in the message, encode it into the AMQP message.]
-static int set_message_content_type_if_needed(IOTHUB_MESSAGE_HANDLE messageHandle, PROPERTIES_HANDLE uamqp_message_properties)
-{
-    int result;
-    const char* content_type;
-
-    if ((content_type = IoTHubMessage_GetContentTypeSystemProperty(messageHandle)) != NULL)
-    {
-        if (properties_set_content_type(uamqp_message_properties, content_type) != 0)
-        {
-            LogError("Failed properties_set_content_type");
-            result = __FAILURE__;
-        }
-        else
-        {
-            result = RESULT_OK;
-        }
-    }
-    else
+    if (length > 0)
     {
-        result = RESULT_OK;
+        (void)memcpy(destination, bytes, length);
     }
 
-    return result;
+    return destination + length;
 }
 
-// Codes_SRS_UAMQP_MESSAGING_31_115: [If optional content-encoding is present in the message, encode it into the AMQP message.]
-static int set_message_content_encoding_if_needed(IOTHUB_MESSAGE_HANDLE messageHandle, PROPERTIES_HANDLE uamqp_message_properties)
+static unsigned char* encode_compound_header(unsigned char* destination, unsigned char constructor8, unsigned char constructor32, size_t items_size, size_t count)
 {
-    int result;
-    const char* content_encoding;
-
-    if ((content_encoding = IoTHubMessage_GetContentEncodingSystemProperty(messageHandle)) != NULL)
+    if (items_size + 1 <= UINT8_MAX && count <= UINT8_MAX)
     {
-        if (properties_set_content_encoding(uamqp_message_properties, content_encoding) != 0)
-        {
-            LogError("Failed properties_set_content_encoding");
-            result = __FAILURE__;
-        }
-        else
-        {
-            result = RESULT_OK;
-        }
+        *destination++ = constructor8;
+        *destination++ = (unsigned char)(items_size + 1);
+        *destination++ = (unsigned char)count;
     }
     else
     {
-        result = RESULT_OK;
+        *destination++ = constructor32;
+        destination = encode_uint32(destination, items_size + 4);
+        destination = encode_uint32(destination, count);
     }
 
-    return result;
+    return destination;
 }
 
-
 // Codes_SRS_UAMQP_MESSAGING_31_116: [Gets message properties associated with the IOTHUB_MESSAGE_HANDLE to encode, returning the properties and their encoded length.]
-static int create_message_properties_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *message_properties, size_t *message_properties_length)
+static void get_message_properties_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, MESSAGE_ENCODING_INFO* encoding_info)
 {
-    PROPERTIES_HANDLE uamqp_message_properties = NULL;
-    int result;
-
-    if ((uamqp_message_properties = properties_create()) == NULL)
-    {
-        LogError("Failed on properties_create()");
-        result = __FAILURE__;
-    }
-    else if (set_message_id_if_needed(messageHandle, uamqp_message_properties) != RESULT_OK)
-    {
-        LogError("Failed on set_message_id_if_needed()");
-        result = __FAILURE__;
-    }
-    else if (set_message_correlation_id_if_needed(messageHandle, uamqp_message_properties) != RESULT_OK)
-    {
-        LogError("Failed on set_message_correlation_id_if_needed()");
-        result = __FAILURE__;
-    }
-    else if (set_message_content_type_if_needed(messageHandle, uamqp_message_properties) != RESULT_OK)
-    {
-        LogError("Failed on set_message_content_type_if_needed()");
-        result = __FAILURE__;
-    }
-    else if (set_message_content_encoding_if_needed(messageHandle, uamqp_message_properties) != RESULT_OK)
-    {
-        LogError("Failed on set_message_content_encoding_if_needed()");
-        result = __FAILURE__;
-    }
-    else if ((*message_properties = amqpvalue_create_properties(uamqp_message_properties)) == NULL)
-    {
-        LogError("Failed on amqpvalue_create_properties()");
-        result = __FAILURE__;
-    }
-    else if ((amqpvalue_get_encoded_size(*message_properties, message_properties_length)) != 0)
-    {
-        LogError("Failed on amqpvalue_get_encoded_size()");
-        result = __FAILURE__;
-    }
-    else
-    {
-        result = RESULT_OK;
+    size_t index;
+
+    // Codes_SRS_UAMQP_MESSAGING_31_112: [If optional message-id is present in the message, encode it into the AMQP message.]
+    encoding_info->properties[PROPERTIES_MESSAGE_ID_INDEX] = IoTHubMessage_GetMessageId(messageHandle);
+    // Codes_SRS_UAMQP_MESSAGING_31_113: [If optional correlation-id is present in the message, encode it into the AMQP message.]
+    encoding_info->properties[PROPERTIES_CORRELATION_ID_INDEX] = IoTHubMessage_GetCorrelationId(messageHandle);
+    // Codes_SRS_UAMQP_MESSAGING_31_114: [If optional content-type is present in the message, encode it into the AMQP message.]
+    encoding_info->properties[PROPERTIES_CONTENT_TYPE_INDEX] = IoTHubMessage_GetContentTypeSystemProperty(messageHandle);
+    // Codes_SRS_UAMQP_MESSAGING_31_115: [If optional content-encoding is present in the message, encode it into the AMQP message.]
+    encoding_info->properties[PROPERTIES_CONTENT_ENCODING_INDEX] = IoTHubMessage_GetContentEncodingSystemProperty(messageHandle);
+
+    encoding_info->properties_count = 0;
+    encoding_info->properties_size = 0;
+    for (index = 0; index < PROPERTIES_FIELD_COUNT; index++)
+    {
+        if (encoding_info->properties[index] != NULL)
+        {
+            encoding_info->properties_count = index + 1;
+        }
     }
 
-    if (NULL != uamqp_message_properties)
+    for (index = 0; index < encoding_info->properties_count; index++)
     {
-        properties_destroy(uamqp_message_properties);
+        encoding_info->properties_size += (encoding_info->properties[index] == NULL) ? 1 : get_variable_width_encoded_size(strlen(encoding_info->properties[index]));
     }
-
-    return result;
 }
 
 // Codes_SRS_UAMQP_MESSAGING_31_117: [Get application message properties associated with the IOTHUB_MESSAGE_HANDLE to encode, returning the properties and their encoded length.]
-static int create_application_properties_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *application_properties, size_t *application_properties_length)
+static int get_application_properties_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, MESSAGE_ENCODING_INFO* encoding_info)
 {
     MAP_HANDLE properties_map;
-    const char* const* property_keys;
-    const char* const* property_values;
-    size_t property_count = 0;
-    AMQP_VALUE uamqp_properties_map = NULL;
     int result;
 
     if ((properties_map = IoTHubMessage_Properties(messageHandle)) == NULL)
@@ -217,87 +160,31 @@ static int create_application_properties_to_encode(IOTHUB_MESSAGE_HANDLE message
         LogError("Failed to get property map from IoTHub message.");
         result = __FAILURE__;
     }
-    else if (Map_GetInternals(properties_map, &property_keys, &property_values, &property_count) != 0)
+    else if (Map_GetInternals(properties_map, &encoding_info->application_property_keys, &encoding_info->application_property_values, &encoding_info->application_property_count) != 0)
     {
         LogError("Failed reading the incoming uAMQP message properties");
         result = __FAILURE__;
     }
-    else if (property_count > 0)
+    else
     {
         size_t i;
-        if ((uamqp_properties_map = amqpvalue_create_map()) == NULL)
+
+        encoding_info->application_properties_size = 0;
+        for (i = 0; i < encoding_info->application_property_count; i++)
         {
-            LogError("amqpvalue_create_map failed");
-            result = __FAILURE__;
+            encoding_info->application_properties_size +=
+                get_variable_width_encoded_size(strlen(encoding_info->application_property_keys[i])) +
+                get_variable_width_encoded_size(strlen(encoding_info->application_property_values[i]));
         }
-        else
-        {
-            result = RESULT_OK;
-
-            for (i = 0; i < property_count; i++)
-            {
-                AMQP_VALUE map_property_key;
-                AMQP_VALUE map_property_value;
 
-                if ((map_property_key = amqpvalue_create_string(property_keys[i])) == NULL)
-                {
-                    LogError("Failed amqpvalue_create_string for key");
-                    result = __FAILURE__;
-                    break;
-                }
-
-                if ((map_property_value = amqpvalue_create_string(property_values[i])) == NULL)
-                {
-                    LogError("Failed amqpvalue_create_string for value");
-                    amqpvalue_destroy(map_property_key);
-                    result = __FAILURE__;
-                    break;
-                }
-
-                if (amqpvalue_set_map_value(uamqp_properties_map, map_property_key, map_property_value) != 0)
-                {
-                    LogError("Failed amqpvalue_set_map_value");
-                    amqpvalue_destroy(map_property_key);
-                    amqpvalue_destroy(map_property_value);
-                    result = __FAILURE__;
-                    break;
-                }
-
-                amqpvalue_destroy(map_property_key);
-                amqpvalue_destroy(map_property_value);
-            }
-
-            if (RESULT_OK == result)
-            {
-                if ((*application_properties = amqpvalue_create_application_properties(uamqp_properties_map)) == NULL)
-                {
-                    LogError("Failed amqpvalue_create_application_properties");
-                    result = __FAILURE__;
-                }
-                else if (amqpvalue_get_encoded_size(*application_properties, application_properties_length) != 0)
-                {
-                    LogError("Failed amqpvalue_get_encoded_size");
-                    result = __FAILURE__;
-                }
-            }
-        }
-    }
-    else
-    {
         result = RESULT_OK;
     }
 
-    if (NULL != uamqp_properties_map)
-    {
-        amqpvalue_destroy(uamqp_properties_map);
-    }
-
     return result;
 }
 
-
 // Codes_SRS_UAMQP_MESSAGING_31_118: [Gets data associated with IOTHUB_MESSAGE_HANDLE to encode, either from underlying byte array or string format.]
-static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE *data_value, size_t *data_length)
+static int get_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, MESSAGE_ENCODING_INFO* encoding_info)
 {
     int result;
 
@@ -328,28 +215,68 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
         {
             messageContentSize = strlen(messageContent);
         }
-    
-        data bin_data;
-        bin_data.bytes = (const unsigned char *)messageContent;
-        bin_data.length = (uint32_t)messageContentSize;
 
-        if ((*data_value = amqpvalue_create_data(bin_data)) == NULL)
-        {
-            LogError("amqpvalue_create_data failed");
-            result = __FAILURE__;
-        }
-        else if (amqpvalue_get_encoded_size(*data_value, data_length) != 0)
-        {
-            LogError("amqpvalue_get_encoded_size failed");
-            result = __FAILURE__;
-        }
-        else
+        encoding_info->data = (const unsigned char*)messageContent;
+        encoding_info->data_length = messageContentSize;
+        result = RESULT_OK;
+    }
+
+    return result;
+}
+
+static unsigned char* encode_message_properties(unsigned char* destination, const MESSAGE_ENCODING_INFO* encoding_info)
+{
+    size_t index;
+
+    destination = encode_descriptor(destination, AMQP_PROPERTIES_DESCRIPTOR);
+
+    if (encoding_info->properties_count == 0)
+    {
+        *destination++ = AMQP_LIST0_CONSTRUCTOR;
+    }
+    else
+    {
+        destination = encode_compound_header(destination, AMQP_LIST8_CONSTRUCTOR, AMQP_LIST32_CONSTRUCTOR, encoding_info->properties_size, encoding_info->properties_count);
+
+        for (index = 0; index < encoding_info->properties_count; index++)
         {
-            result = RESULT_OK;
+            const char* value = encoding_info->properties[index];
+
+            if (value == NULL)
+            {
+                *destination++ = AMQP_NULL_CONSTRUCTOR;
+            }
+            else if (index >= PROPERTIES_CONTENT_TYPE_INDEX)
+            {
+                // content-type and content-encoding are symbols
+                destination = encode_variable_width(destination, AMQP_SYM8_CONSTRUCTOR, AMQP_SYM32_CONSTRUCTOR, value, strlen(value));
+            }
+            else
+            {
+                destination = encode_variable_width(destination, AMQP_STR8_CONSTRUCTOR, AMQP_STR32_CONSTRUCTOR, value, strlen(value));
+            }
         }
     }
 
-    return result;
+    return destination;
+}
+
+static unsigned char* encode_application_properties(unsigned char* destination, const MESSAGE_ENCODING_INFO* encoding_info)
+{
+    size_t i;
+
+    destination = encode_descriptor(destination, AMQP_APPLICATION_PROPERTIES_DESCRIPTOR);
+    destination = encode_compound_header(destination, AMQP_MAP8_CONSTRUCTOR, AMQP_MAP32_CONSTRUCTOR, encoding_info->application_properties_size, encoding_info->application_property_count * 2);
+
+    for (i = 0; i < encoding_info->application_property_count; i++)
+    {
+        const char* key = encoding_info->application_property_keys[i];
+        const char* value = encoding_info->application_property_values[i];
+        destination = encode_variable_width(destination, AMQP_STR8_CONSTRUCTOR, AMQP_STR32_CONSTRUCTOR, key, strlen(key));
+        destination = encode_variable_width(destination, AMQP_STR8_CONSTRUCTOR, AMQP_STR32_CONSTRUCTOR, value, strlen(value));
+    }
+
+    return destination;
 }
 
 // Codes_SRS_UAMQP_MESSAGING_31_120: [Create a blob that contains AMQP encoding of IOTHUB_MESSAGE_HANDLE.]
@@ -357,72 +284,54 @@ static int create_data_to_encode(IOTHUB_MESSAGE_HANDLE messageHandle, AMQP_VALUE
 int message_create_uamqp_encoding_from_iothub_message(IOTHUB_MESSAGE_HANDLE message_handle, BINARY_DATA* body_binary_data)
 {
     int result;
+    MESSAGE_ENCODING_INFO encoding_info;
 
-    AMQP_VALUE message_properties = NULL;
-    AMQP_VALUE application_properties = NULL;
-    AMQP_VALUE data_value = NULL;
-    size_t message_properties_length = 0;
-    size_t application_properties_length = 0;
-    size_t data_length = 0;
-
+    memset(&encoding_info, 0, sizeof(encoding_info));
     body_binary_data->bytes = NULL;
     body_binary_data->length = 0;
 
-    if (create_message_properties_to_encode(message_handle, &message_properties, &message_properties_length) != RESULT_OK)
-    {
-        LogError("create_message_properties_to_encode() failed");
-        result = __FAILURE__;
-    }
-    else if (create_application_properties_to_encode(message_handle, &application_properties, &application_properties_length) != RESULT_OK)
-    {
-        LogError("create_application_properties_to_encode() failed");
-        result = __FAILURE__;
-    }
-    else if (create_data_to_encode(message_handle, &data_value, &data_length) != RESULT_OK)
-    {
-        LogError("create_data_to_encode() failed");
-        result = __FAILURE__;
-    }
-    else if ((body_binary_data->bytes = malloc(message_properties_length + application_properties_length + data_length)) == NULL)
-    {
-        LogError("malloc of %d bytes failed", message_properties_length + application_properties_length + data_length);
-        result = __FAILURE__;
-    }
-    // Codes_SRS_UAMQP_MESSAGING_31_119: [Invoke underlying AMQP encode routines on data waiting to be encoded.]
-    else if (amqpvalue_encode(message_properties, &encode_callback, body_binary_data) != RESULT_OK)
-    {
-        LogError("amqpvalue_encode() for message properties failed");
-        result = __FAILURE__;
-    }
-    else if ((application_properties_length > 0) && (amqpvalue_encode(application_properties, &encode_callback, body_binary_data)  != RESULT_OK))
+    get_message_properties_to_encode(message_handle, &encoding_info);
+
+    if (get_application_properties_to_encode(message_handle, &encoding_info) != RESULT_OK)
     {
-        LogError("amqpvalue_encode() for application properties failed");
+        LogError("get_application_properties_to_encode() failed");
         result = __FAILURE__;
     }
-    else if (RESULT_OK != amqpvalue_encode(data_value, &encode_callback, body_binary_data))
+    else if (get_data_to_encode(message_handle, &encoding_info) != RESULT_OK)
     {
-        LogError("amqpvalue_encode() for data value failed");
+        LogError("get_data_to_encode() failed");
         result = __FAILURE__;
     }
     else
     {
-        body_binary_data->length = message_properties_length + application_properties_length + data_length;
-        result = RESULT_OK;
-    }
+        // Codes_SRS_UAMQP_MESSAGING_09_047: [The encoded size of every section shall be computed upfront so the whole message is encoded into a single allocation, without creating intermediate AMQP_VALUE instances.]
+        size_t properties_length = AMQP_DESCRIPTOR_ENCODED_SIZE + ((encoding_info.properties_count == 0) ? 1 : get_compound_encoded_size(encoding_info.properties_size, encoding_info.properties_count));
+        size_t application_properties_length = (encoding_info.application_property_count == 0) ? 0 : AMQP_DESCRIPTOR_ENCODED_SIZE + get_compound_encoded_size(encoding_info.application_properties_size, encoding_info.application_property_count * 2);
+        size_t data_length = AMQP_DESCRIPTOR_ENCODED_SIZE + get_variable_width_encoded_size(encoding_info.data_length);
+        unsigned char* encoded_bytes;
 
-    if (NULL != data_value)
-    {
-        amqpvalue_destroy(data_value);
-    }
+        if ((encoded_bytes = (unsigned char*)malloc(properties_length + application_properties_length + data_length)) == NULL)
+        {
+            LogError("malloc of %lu bytes failed", (unsigned long)(properties_length + application_properties_length + data_length));
+            result = __FAILURE__;
+        }
+        else
+        {
+            // Codes_SRS_UAMQP_MESSAGING_31_119: [Encode the message properties, application properties and data sections into the blob.]
+            unsigned char* cursor = encode_message_properties(encoded_bytes, &encoding_info);
 
-    if (NULL != application_properties)
-    {
-        amqpvalue_destroy(application_properties);
-    }
+            if (application_properties_length > 0)
+            {
+                cursor = encode_application_properties(cursor, &encoding_info);
+            }
 
-    if (NULL != message_properties)
-    {
-        amqpvalue_destroy(message_properties);
+            cursor = encode_descriptor(cursor, AMQP_DATA_DESCRIPTOR);
+            cursor = encode_variable_width(cursor, AMQP_VBIN8_CONSTRUCTOR, AMQP_VBIN32_CONSTRUCTOR, encoding_info.data, encoding_info.data_length);
+
+            body_binary_data->bytes = encoded_bytes;
+            body_binary_data->length = (size_t)(cursor - encoded_bytes);
+            result = RESULT_OK;
+        }
     }
 
     return result;
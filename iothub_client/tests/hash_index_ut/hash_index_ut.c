@@ -0,0 +1,578 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+static size_t last_malloc_size;
+
+void* real_malloc(size_t size)
+{
+    last_malloc_size = size;
+    return malloc(size);
+}
+
+void real_free(void* ptr)
+{
+    free(ptr);
+}
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes.h"
+#include "umocktypes_c.h"
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#undef ENABLE_MOCKS
+
+#include "hash_index.h"
+#include "hash_index_internal.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_KEY_1                          "device1"
+#define TEST_KEY_2                          "device2"
+#define TEST_KEY_3                          "device3"
+#define TEST_VALUE_1                        (void*)0x4401
+#define TEST_VALUE_2                        (void*)0x4402
+#define TEST_VALUE_3                        (void*)0x4403
+
+
+// Helpers
+
+static void set_hash_index_create_expected_calls()
+{
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+}
+
+static HASH_INDEX_HANDLE create_hash_index(size_t initial_bucket_count)
+{
+    HASH_INDEX_HANDLE index = hash_index_create(initial_bucket_count);
+    ASSERT_IS_NOT_NULL(index);
+    return index;
+}
+
+static void add_key(HASH_INDEX_HANDLE index, const char* key, void* value)
+{
+    int result = hash_index_add(index, key, value);
+    ASSERT_ARE_EQUAL(int, 0, result);
+}
+
+static void register_global_mock_hooks()
+{
+    REGISTER_GLOBAL_MOCK_HOOK(malloc, real_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(free, real_free);
+}
+
+
+BEGIN_TEST_SUITE(hash_index_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    umock_c_init(on_umock_c_error);
+
+    int result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(HASH_INDEX_HANDLE, void*);
+
+    register_global_mock_hooks();
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("our mutex is ABANDONED. Failure in test framework");
+    }
+
+    umock_c_reset_all_calls();
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+
+// Tests_SRS_HASH_INDEX_09_001: [hash_index_create shall allocate memory for the hash index instance]
+// Tests_SRS_HASH_INDEX_09_003: [If initial_bucket_count is 0, hash_index_create shall use 16 buckets]
+// Tests_SRS_HASH_INDEX_09_004: [hash_index_create shall allocate the buckets and set them all to empty]
+TEST_FUNCTION(create_default_bucket_count_success)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(16 * sizeof(void*)));
+
+    // act
+    HASH_INDEX_HANDLE index = hash_index_create(0);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(index);
+    ASSERT_IS_NULL(hash_index_find(index, TEST_KEY_1));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_004: [hash_index_create shall allocate the buckets and set them all to empty]
+TEST_FUNCTION(create_custom_bucket_count_success)
+{
+    // arrange
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(1024 * sizeof(void*)));
+
+    // act
+    HASH_INDEX_HANDLE index = hash_index_create(1024);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(index);
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_002: [If malloc fails, hash_index_create shall fail and return NULL]
+// Tests_SRS_HASH_INDEX_09_005: [If the buckets cannot be allocated, hash_index_create shall free the instance and return NULL]
+TEST_FUNCTION(create_failure_checks)
+{
+    // arrange
+    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
+
+    set_hash_index_create_expected_calls();
+    umock_c_negative_tests_snapshot();
+
+    size_t i;
+    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
+    {
+        // arrange
+        char error_msg[64];
+        sprintf(error_msg, "On failed call %zu", i);
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(i);
+
+        // act
+        HASH_INDEX_HANDLE index = hash_index_create(0);
+
+        // assert
+        ASSERT_IS_NULL_WITH_MSG(index, error_msg);
+    }
+
+    // cleanup
+    umock_c_negative_tests_deinit();
+}
+
+// Tests_SRS_HASH_INDEX_09_006: [If index is NULL, hash_index_destroy shall return]
+TEST_FUNCTION(destroy_NULL_index)
+{
+    // arrange
+
+    // act
+    hash_index_destroy(NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+// Tests_SRS_HASH_INDEX_09_007: [hash_index_destroy shall free every entry, the buckets and the instance]
+TEST_FUNCTION(destroy_success)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    add_key(index, TEST_KEY_1, TEST_VALUE_1);
+    add_key(index, TEST_KEY_2, TEST_VALUE_2);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(free(index));
+
+    // act
+    hash_index_destroy(index);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+}
+
+// Tests_SRS_HASH_INDEX_09_008: [If index or key are NULL, hash_index_add shall fail and return non-zero]
+TEST_FUNCTION(add_NULL_arguments)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = hash_index_add(NULL, TEST_KEY_1, TEST_VALUE_1);
+    int result2 = hash_index_add(index, NULL, TEST_VALUE_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_010: [hash_index_add shall allocate a single entry holding a copy of key and value]
+// Tests_SRS_HASH_INDEX_09_013: [If no failures occur, hash_index_add shall return 0]
+// Tests_SRS_HASH_INDEX_09_015: [hash_index_find shall return the value stored under key, or NULL if key is not in the index]
+TEST_FUNCTION(add_success)
+{
+    // arrange
+    char key[16];
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    (void)strcpy(key, TEST_KEY_1);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+
+    // act
+    int result = hash_index_add(index, key, TEST_VALUE_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    key[0] = 'x';
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_1, hash_index_find(index, TEST_KEY_1));
+    ASSERT_IS_NULL(hash_index_find(index, key));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_021: [If index or key are NULL, hash_index_add_without_copy shall fail and return non-zero]
+TEST_FUNCTION(add_without_copy_NULL_arguments)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = hash_index_add_without_copy(NULL, TEST_KEY_1, TEST_VALUE_1);
+    int result2 = hash_index_add_without_copy(index, NULL, TEST_VALUE_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_022: [hash_index_add_without_copy shall allocate an entry holding key itself and value, without copying key]
+// Tests_SRS_HASH_INDEX_09_023: [Otherwise hash_index_add_without_copy shall behave as hash_index_add]
+TEST_FUNCTION(add_without_copy_success)
+{
+    // arrange
+    static const char long_key[] = "a key much longer than the other ones added";
+    size_t copied_entry_size;
+    size_t short_key_entry_size;
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    add_key(index, long_key, TEST_VALUE_1);
+    copied_entry_size = last_malloc_size;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+
+    // act
+    int result1 = hash_index_add_without_copy(index, TEST_KEY_2, TEST_VALUE_2);
+    short_key_entry_size = last_malloc_size;
+    int result2 = hash_index_add_without_copy(index, long_key + 1, TEST_VALUE_3);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(size_t, short_key_entry_size, last_malloc_size);
+    ASSERT_IS_TRUE(last_malloc_size < copied_entry_size);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_1, hash_index_find(index, long_key));
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_2, hash_index_find(index, TEST_KEY_2));
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_3, hash_index_find(index, long_key + 1));
+    ASSERT_ARE_EQUAL(int, 0, hash_index_remove(index, TEST_KEY_2));
+    ASSERT_IS_NULL(hash_index_find(index, TEST_KEY_2));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_009: [If key is already in the index, hash_index_add shall fail and return non-zero]
+TEST_FUNCTION(add_duplicate_key_fails)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    add_key(index, TEST_KEY_1, TEST_VALUE_1);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = hash_index_add(index, TEST_KEY_1, TEST_VALUE_2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_1, hash_index_find(index, TEST_KEY_1));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_011: [If malloc fails, hash_index_add shall fail and return non-zero]
+TEST_FUNCTION(add_malloc_fails)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG)).SetReturn(NULL);
+
+    // act
+    int result = hash_index_add(index, TEST_KEY_1, TEST_VALUE_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(hash_index_find(index, TEST_KEY_1));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_012: [If the index holds more items than buckets, hash_index_add shall double the number of buckets and redistribute the entries]
+TEST_FUNCTION(add_grows_buckets)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(2);
+    add_key(index, TEST_KEY_1, TEST_VALUE_1);
+    add_key(index, TEST_KEY_2, TEST_VALUE_2);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(4 * sizeof(void*)));
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    int result = hash_index_add(index, TEST_KEY_3, TEST_VALUE_3);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_1, hash_index_find(index, TEST_KEY_1));
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_2, hash_index_find(index, TEST_KEY_2));
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_3, hash_index_find(index, TEST_KEY_3));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_016: [If the buckets cannot be grown, hash_index_add shall keep the current buckets and still succeed]
+TEST_FUNCTION(add_grow_buckets_fails_still_succeeds)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(1);
+    add_key(index, TEST_KEY_1, TEST_VALUE_1);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(malloc(2 * sizeof(void*))).SetReturn(NULL);
+
+    // act
+    int result = hash_index_add(index, TEST_KEY_2, TEST_VALUE_2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_1, hash_index_find(index, TEST_KEY_1));
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_2, hash_index_find(index, TEST_KEY_2));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_014: [If index or key are NULL, hash_index_find shall return NULL]
+TEST_FUNCTION(find_NULL_arguments)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    add_key(index, TEST_KEY_1, TEST_VALUE_1);
+    umock_c_reset_all_calls();
+
+    // act
+    void* result1 = hash_index_find(NULL, TEST_KEY_1);
+    void* result2 = hash_index_find(index, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_015: [hash_index_find shall return the value stored under key, or NULL if key is not in the index]
+TEST_FUNCTION(find_many_keys_success)
+{
+    // arrange
+    char key[32];
+    size_t i;
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+
+    for (i = 0; i < 1000; i++)
+    {
+        (void)sprintf(key, "device%lu", (unsigned long)i);
+        add_key(index, key, (void*)(i + 1));
+    }
+
+    umock_c_reset_all_calls();
+
+    // act
+    // assert
+    for (i = 0; i < 1000; i++)
+    {
+        (void)sprintf(key, "device%lu", (unsigned long)i);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)(i + 1), hash_index_find(index, key));
+    }
+
+    ASSERT_IS_NULL(hash_index_find(index, "device1000"));
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_017: [If index or key are NULL, hash_index_remove shall fail and return non-zero]
+TEST_FUNCTION(remove_NULL_arguments)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    umock_c_reset_all_calls();
+
+    // act
+    int result1 = hash_index_remove(NULL, TEST_KEY_1);
+    int result2 = hash_index_remove(index, NULL);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_018: [If key is not in the index, hash_index_remove shall fail and return non-zero]
+TEST_FUNCTION(remove_key_not_found)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(0);
+    add_key(index, TEST_KEY_1, TEST_VALUE_1);
+    umock_c_reset_all_calls();
+
+    // act
+    int result = hash_index_remove(index, TEST_KEY_2);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_1, hash_index_find(index, TEST_KEY_1));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_019: [hash_index_remove shall unlink and free the entry of key and return 0]
+TEST_FUNCTION(remove_success)
+{
+    // arrange
+    HASH_INDEX_HANDLE index = create_hash_index(1);
+    add_key(index, TEST_KEY_1, TEST_VALUE_1);
+    add_key(index, TEST_KEY_2, TEST_VALUE_2);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    // act
+    int result = hash_index_remove(index, TEST_KEY_1);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_IS_NULL(hash_index_find(index, TEST_KEY_1));
+    ASSERT_ARE_EQUAL(void_ptr, TEST_VALUE_2, hash_index_find(index, TEST_KEY_2));
+
+    // cleanup
+    hash_index_destroy(index);
+}
+
+// Tests_SRS_HASH_INDEX_09_020: [hash_index_get_key_hash shall return the 32-bit FNV-1a hash of key]
+TEST_FUNCTION(get_key_hash_returns_fnv1a)
+{
+    // arrange
+    umock_c_reset_all_calls();
+
+    // act
+    size_t empty_hash = hash_index_get_key_hash("");
+    size_t a_hash = hash_index_get_key_hash("a");
+    size_t foobar_hash = hash_index_get_key_hash("foobar");
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, (size_t)0x811c9dc5, empty_hash);
+    ASSERT_ARE_EQUAL(size_t, (size_t)0xe40c292c, a_hash);
+    ASSERT_ARE_EQUAL(size_t, (size_t)0xbf9cf968, foobar_hash);
+}
+
+END_TEST_SUITE(hash_index_ut)
@@ -468,6 +468,62 @@ TEST_FUNCTION(is_timeout_reached_failure_checks)
 	// cleanup
 }
 
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_065: [If `policy` is IOTHUB_CLIENT_RETRY_NONE or IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control_calculate_wait_time` shall return 0]
+TEST_FUNCTION(calculate_wait_time_IMMEDIATE_and_NONE)
+{
+	// arrange
+	umock_c_reset_all_calls();
+
+	// act
+	unsigned int immediate_result = retry_control_calculate_wait_time(IOTHUB_CLIENT_RETRY_IMMEDIATE, 5, 5, 3);
+	unsigned int none_result = retry_control_calculate_wait_time(IOTHUB_CLIENT_RETRY_NONE, 5, 5, 3);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 0, (int)immediate_result);
+	ASSERT_ARE_EQUAL(int, 0, (int)none_result);
+
+	// cleanup
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `policy` is IOTHUB_CLIENT_RETRY_INTERVAL, `retry_control_calculate_wait_time` shall return `initial_wait_time_in_secs`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `policy` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `retry_control_calculate_wait_time` shall return (`initial_wait_time_in_secs` * `retry_count`)]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `retry_control_calculate_wait_time` shall return (pow(2, `retry_count` - 1) * `initial_wait_time_in_secs`)]
+TEST_FUNCTION(calculate_wait_time_success)
+{
+	// arrange
+	umock_c_reset_all_calls();
+
+	// act
+	unsigned int interval_result = retry_control_calculate_wait_time(IOTHUB_CLIENT_RETRY_INTERVAL, 5, 0, 3);
+	unsigned int linear_result = retry_control_calculate_wait_time(IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, 5, 0, 3);
+	unsigned int exponential_result = retry_control_calculate_wait_time(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, 5, 0, 3);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 5, (int)interval_result);
+	ASSERT_ARE_EQUAL(int, 15, (int)linear_result);
+	ASSERT_ARE_EQUAL(int, 20, (int)exponential_result);
+
+	// cleanup
+}
+
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `retry_control_calculate_wait_time` shall return ((pow(2, `retry_count` - 1) * `initial_wait_time_in_secs`) * (1 + (`max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
+TEST_FUNCTION(calculate_wait_time_EXPONENTIAL_BACKOFF_WITH_JITTER_success)
+{
+	// arrange
+	umock_c_reset_all_calls();
+
+	// act
+	unsigned int result = retry_control_calculate_wait_time(IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, 10, 50, 2);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_TRUE(result >= 20 && result <= 30);
+
+	// cleanup
+}
+
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_045: [If `retry_control_handle`, `retry_control_retrieve_options` shall fail and return NULL]
 TEST_FUNCTION(Retrieve_Options_NULL_handle)
 {
@@ -885,6 +941,7 @@ TEST_FUNCTION(Should_Retry_NO_MAX_RETRY_TIME_success)
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_015: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW, `retry_control->retry_count` shall be incremented by 1]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_016: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->last_retry_time` shall be set using get_time()]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_017: [If `retry_action` is set to RETRY_ACTION_RETRY_NOW and policy is not IOTHUB_CLIENT_RETRY_IMMEDIATE, `retry_control->current_wait_time_in_secs` shall be set using calculate_next_wait_time()]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_064: [`calculate_next_wait_time` shall return the result of retry_control_calculate_wait_time() for `retry_control->policy`, `retry_control->initial_wait_time_in_secs`, `retry_control->max_jitter_percent` and `retry_control->retry_count`]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_018: [If no errors occur, `retry_control_should_retry` shall return 0]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_019: [If `retry_control->retry_count` is 0, `retry_action` shall be set to RETRY_ACTION_RETRY_NOW]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_021: [`current_time` shall be set using get_time()]
@@ -892,7 +949,7 @@ TEST_FUNCTION(Should_Retry_NO_MAX_RETRY_TIME_success)
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_024: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is less than `retry_control->current_wait_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_RETRY_LATER]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_025: [Otherwise, if (`current_time` - `retry_control->last_retry_time`) is greater or equal to `retry_control->current_wait_time_in_secs`, `retry_action` shall be set to RETRY_ACTION_RETRY_NOW]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_026: [If no errors occur, the evaluation function shall return 0]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `calculate_next_wait_time` shall return ((pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`) * (1 + (`retry_control->max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_032: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF_WITH_JITTER, `retry_control_calculate_wait_time` shall return ((pow(2, `retry_count` - 1) * `initial_wait_time_in_secs`) * (1 + (`max_jitter_percent` / 100) * (rand() / RAND_MAX)))]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_040: [If `name` is "max_jitter_percent", value shall be saved on `retry_control->max_jitter_percent`]
 TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_WITH_JITTER_success)
 {
@@ -913,7 +970,7 @@ TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_WITH_JITTER_success)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `calculate_next_wait_time` shall return (pow(2, `retry_control->retry_count` - 1) * `retry_control->initial_wait_time_in_secs`)]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_031: [If `policy` is IOTHUB_CLIENT_RETRY_EXPONENTIAL_BACKOFF, `retry_control_calculate_wait_time` shall return (pow(2, `retry_count` - 1) * `initial_wait_time_in_secs`)]
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_038: [If `name` is "initial_wait_time_in_secs", `value` shall be saved on `retry_control->initial_wait_time_in_secs`]
 TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_success)
 {
@@ -935,7 +992,7 @@ TEST_FUNCTION(Should_Retry_EXPONENTIAL_BACKOFF_success)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_INTERVAL, `calculate_next_wait_time` shall return `retry_control->initial_wait_time_in_secs`]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_029: [If `policy` is IOTHUB_CLIENT_RETRY_INTERVAL, `retry_control_calculate_wait_time` shall return `initial_wait_time_in_secs`]
 TEST_FUNCTION(Should_Retry_INTERVAL_success)
 {
 	// arrange
@@ -953,7 +1010,7 @@ TEST_FUNCTION(Should_Retry_INTERVAL_success)
 }
 
 // Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_006: [Otherwise `retry_control->initial_wait_time_in_secs` shall be set to 5]
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (`retry_control->retry_count`))]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_030: [If `policy` is IOTHUB_CLIENT_RETRY_LINEAR_BACKOFF, `retry_control_calculate_wait_time` shall return (`initial_wait_time_in_secs` * `retry_count`)]
 TEST_FUNCTION(Should_Retry_LINEAR_BACKOFF_success)
 {
 	// arrange
@@ -970,7 +1027,7 @@ TEST_FUNCTION(Should_Retry_LINEAR_BACKOFF_success)
 	retry_control_destroy(handle);
 }
 
-// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `retry_control->policy_name` is IOTHUB_CLIENT_RETRY_RANDOM, `calculate_next_wait_time` shall return (`retry_control->initial_wait_time_in_secs` * (rand() / RAND_MAX))]
+// Tests_SRS_IOTHUB_CLIENT_RETRY_CONTROL_09_033: [If `policy` is IOTHUB_CLIENT_RETRY_RANDOM, `retry_control_calculate_wait_time` shall return (`initial_wait_time_in_secs` * (rand() / RAND_MAX))]
 // This test must be replaced. Create an auxiliary module for get_rand() in c-shared-utilities and test using that
 /*
 TEST_FUNCTION(Should_Retry_RANDOM_success)
@@ -172,6 +172,12 @@ static const char* TEST_DEVICE_METHOD_RESPONSE = "{device:method, response:true}
 
 const unsigned char TEST_REPORTED_STATE[] = { 0x01, 0x02, 0x03 };
 const size_t TEST_REPORTED_SIZE = sizeof(TEST_REPORTED_STATE) / sizeof(TEST_REPORTED_STATE[0]);
+static const char* TEST_REPORTED_JSON = "{\"a\":1,\"b\":{\"c\":1}}";
+static const char* TEST_REPORTED_JSON_PATCH = "{\"b\":{\"d\":2}}";
+static const char* TEST_TWIN_COMPLETE_JSON = "{\"desired\":{\"a\":1,\"$version\":2},\"reported\":{\"$version\":1}}";
+static const char* TEST_TWIN_PARTIAL_JSON = "{\"a\":null,\"b\":2,\"$version\":3}";
+static const char* TEST_TWIN_PARTIAL_STALE_JSON = "{\"a\":5,\"$version\":2}";
+static const char* TEST_TWIN_COMPLETE_PATCHED_JSON = "{\"desired\":{\"b\":2,\"$version\":3},\"reported\":{\"$version\":1}}";
 
 static const TRANSPORT_PROVIDER* provideFAKE(void);
 
@@ -587,6 +593,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
 
     REGISTER_GLOBAL_MOCK_HOOK(STRING_new, my_STRING_new);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_new, NULL);
@@ -3874,6 +3881,124 @@ TEST_FUNCTION(IoTHubClient_LL_DoWork_SendReportedState_continue_processing_succe
     IoTHubClient_LL_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_09_011: [ "twin_reported_coalescing_ms" - reported states sent within value milliseconds of each other shall be merged into a single PATCH. Value is a pointer to a tickcounter_ms_t, 0 disables it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_twin_reported_coalescing_ms_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    tickcounter_ms_t window = 5000;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_TWIN_REPORTED_COALESCING_MS, &window);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_014: [ If "twin_reported_coalescing_ms" is set and an IOTHUB_DEVICE_TWIN is still waiting to be processed, IoTHubClient_LL_SendReportedState shall JSON-merge reportedState into the last one and return IOTHUB_CLIENT_OK. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SendReportedState_coalesces_queued_report_succeeds)
+{
+    //arrange
+    CONSTBUFFER queued_data = { (const unsigned char*)TEST_REPORTED_JSON, strlen(TEST_REPORTED_JSON) };
+    tickcounter_ms_t window = 5000;
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_TWIN_REPORTED_COALESCING_MS, &window);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, (const unsigned char*)TEST_REPORTED_JSON, strlen(TEST_REPORTED_JSON), iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+        .SetReturn(&queued_data);
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(CONSTBUFFER_Create(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG));
+
+    //act
+    result = IoTHubClient_LL_SendReportedState(h, (const unsigned char*)TEST_REPORTED_JSON_PATCH, strlen(TEST_REPORTED_JSON_PATCH), iothub_reported_state_callback, (void*)0x1234);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_012: [ If "twin_reported_coalescing_ms" is set, IoTHubClient_LL_DoWork shall not process an IOTHUB_DEVICE_TWIN until that many milliseconds have passed since it was queued. ]*/
+TEST_FUNCTION(IoTHubClient_LL_DoWork_holds_reported_state_within_coalescing_window)
+{
+    //arrange
+    tickcounter_ms_t window = 5000;
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_TWIN_REPORTED_COALESCING_MS, &window);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, (const unsigned char*)TEST_REPORTED_JSON, strlen(TEST_REPORTED_JSON), iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG)) /*_DoWork will ask "what's the time"*/
+        .IgnoreAllArguments();
+    EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(tickcounter_get_current_ms(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreAllArguments();
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_DoWork(IGNORED_PTR_ARG, h))
+        .IgnoreArgument(1);
+
+    //act
+    IoTHubClient_LL_DoWork(h);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_013: [ IoTHubClient_LL_ReportedStateComplete shall invoke the callback of every report that was coalesced into the IOTHUB_DEVICE_TWIN, in the order they were sent. ]*/
+TEST_FUNCTION(IoTHubClient_LL_ReportedStateComplete_coalesced_reports_succeed)
+{
+    //arrange
+    CONSTBUFFER queued_data = { (const unsigned char*)TEST_REPORTED_JSON, strlen(TEST_REPORTED_JSON) };
+    tickcounter_ms_t window = 1;
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_TWIN_REPORTED_COALESCING_MS, &window);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SendReportedState(h, (const unsigned char*)TEST_REPORTED_JSON, strlen(TEST_REPORTED_JSON), iothub_reported_state_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    EXPECTED_CALL(CONSTBUFFER_GetContent(IGNORED_PTR_ARG))
+        .SetReturn(&queued_data);
+    result = IoTHubClient_LL_SendReportedState(h, (const unsigned char*)TEST_REPORTED_JSON_PATCH, strlen(TEST_REPORTED_JSON_PATCH), iothub_reported_state_callback, (void*)0x1234);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+
+    IoTHubClient_LL_DoWork(h);
+
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(iothub_reported_state_callback(TEST_DEVICE_STATUS_CODE, NULL));
+    STRICT_EXPECTED_CALL(iothub_reported_state_callback(TEST_DEVICE_STATUS_CODE, (void*)0x1234));
+    EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_ReportedStateComplete(h, 2, TEST_DEVICE_STATUS_CODE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
 /*Tests_SRS_IOTHUBCLIENT_LL_12_017: [ `IoTHubClient_LL_SetDeviceMethodCallback` shall fail and return `IOTHUB_CLIENT_INVALID_ARG` if parameter `iotHubClientHandle` is `NULL`. ]*/
 TEST_FUNCTION(IoTHubClient_LL_SetDeviceMethodCallback_with_NULL_iotHubClientHandle_fails)
 {
@@ -4300,6 +4425,234 @@ TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_update_partial_before_com
     IoTHubClient_LL_Destroy(h);
 }
 
+/*Tests_SRS_IOTHUBCLIENT_LL_09_017: [ "twin_desired_cache" - Value is a pointer to a bool. When set to false IoTHubClient_LL_SetOption shall release the desired properties copy. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_twin_desired_cache_succeeds)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    bool enabled = true;
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_TWIN_DESIRED_CACHE, &enabled);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_018: [ "c2d_receive_paused" - Value is a pointer to a bool. When set to true while a message callback is set, IoTHubClient_LL_SetOption shall call the underlying layer's _Unsubscribe function and keep the message callback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_c2d_receive_paused_unsubscribes)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    bool paused = true;
+    (void)IoTHubClient_LL_SetMessageCallback(h, test_message_callback_async, (void*)1);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Unsubscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &paused);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &paused);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_019: [ When "c2d_receive_paused" is set back to false while a message callback is set, IoTHubClient_LL_SetOption shall call the underlying layer's _Subscribe function. If it fails, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR and C2D messages shall remain paused. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_c2d_receive_paused_false_resubscribes)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    bool paused = true;
+    bool resumed = false;
+    (void)IoTHubClient_LL_SetMessageCallback(h, test_message_callback_async, (void*)1);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &paused);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &resumed);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_019: [ When "c2d_receive_paused" is set back to false while a message callback is set, IoTHubClient_LL_SetOption shall call the underlying layer's _Subscribe function. If it fails, IoTHubClient_LL_SetOption shall return IOTHUB_CLIENT_ERROR and C2D messages shall remain paused. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetOption_c2d_receive_paused_false_Subscribe_fails)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    bool paused = true;
+    bool resumed = false;
+    (void)IoTHubClient_LL_SetMessageCallback(h, test_message_callback_async, (void*)1);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &paused);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1)
+        .SetReturn(1);
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &resumed);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &resumed);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_020: [ While "c2d_receive_paused" is true, IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall only save or clear the callback, without calling the underlying layer's _Subscribe or _Unsubscribe functions. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_while_c2d_receive_paused_does_not_subscribe)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    bool paused = true;
+    bool resumed = false;
+    (void)IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &paused);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(FAKE_IoTHubTransport_Subscribe(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback_Ex(h, messageCallbackEx, (void*)1);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &resumed);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_020: [ While "c2d_receive_paused" is true, IoTHubClient_LL_SetMessageCallback and IoTHubClient_LL_SetMessageCallback_Ex shall only save or clear the callback, without calling the underlying layer's _Subscribe or _Unsubscribe functions. ]*/
+TEST_FUNCTION(IoTHubClient_LL_SetMessageCallback_NULL_while_c2d_receive_paused_does_not_unsubscribe)
+{
+    //arrange
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    bool paused = true;
+    (void)IoTHubClient_LL_SetMessageCallback(h, test_message_callback_async, (void*)1);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_C2D_RECEIVE_PAUSED, &paused);
+    umock_c_reset_all_calls();
+
+    //act
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetMessageCallback(h, NULL, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_016: [ If "twin_desired_cache" is enabled and the desired $version of the update is not newer than the one of the copy, IoTHubClient_LL_RetrievePropertyComplete shall not call deviceTwinCallback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_twin_desired_cache_same_version_not_delivered)
+{
+    //arrange
+    bool enabled = true;
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_TWIN_DESIRED_CACHE, &enabled);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)TEST_TWIN_COMPLETE_JSON, strlen(TEST_TWIN_COMPLETE_JSON));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)TEST_TWIN_COMPLETE_JSON, strlen(TEST_TWIN_COMPLETE_JSON));
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_016: [ If "twin_desired_cache" is enabled and the desired $version of the update is not newer than the one of the copy, IoTHubClient_LL_RetrievePropertyComplete shall not call deviceTwinCallback. ]*/
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_twin_desired_cache_stale_partial_not_delivered)
+{
+    //arrange
+    bool enabled = true;
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_TWIN_DESIRED_CACHE, &enabled);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)TEST_TWIN_COMPLETE_JSON, strlen(TEST_TWIN_COMPLETE_JSON));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_PARTIAL, (const unsigned char*)TEST_TWIN_PARTIAL_STALE_JSON, strlen(TEST_TWIN_PARTIAL_STALE_JSON));
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
+/*Tests_SRS_IOTHUBCLIENT_LL_09_015: [ If "twin_desired_cache" is enabled, IoTHubClient_LL_RetrievePropertyComplete shall keep a copy of the desired properties and apply every DEVICE_TWIN_UPDATE_PARTIAL to it. ]*/
+TEST_FUNCTION(IoTHubClient_LL_RetrievePropertyComplete_twin_desired_cache_applies_partial)
+{
+    //arrange
+    bool enabled = true;
+    IOTHUB_CLIENT_LL_HANDLE h = IoTHubClient_LL_Create(&TEST_CONFIG);
+    (void)IoTHubClient_LL_SetOption(h, OPTION_TWIN_DESIRED_CACHE, &enabled);
+    IOTHUB_CLIENT_RESULT result = IoTHubClient_LL_SetDeviceTwinCallback(h, iothub_device_twin_callback, NULL);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)TEST_TWIN_COMPLETE_JSON, strlen(TEST_TWIN_COMPLETE_JSON));
+    umock_c_reset_all_calls();
+
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(iothub_device_twin_callback(DEVICE_TWIN_UPDATE_PARTIAL, IGNORED_PTR_ARG, IGNORED_NUM_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_userContextCallback()
+        .IgnoreArgument_payLoad()
+        .IgnoreArgument_size();
+    EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_PARTIAL, (const unsigned char*)TEST_TWIN_PARTIAL_JSON, strlen(TEST_TWIN_PARTIAL_JSON));
+    IoTHubClient_LL_RetrievePropertyComplete(h, DEVICE_TWIN_UPDATE_COMPLETE, (const unsigned char*)TEST_TWIN_COMPLETE_PATCHED_JSON, strlen(TEST_TWIN_COMPLETE_PATCHED_JSON));
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubClient_LL_Destroy(h);
+}
+
 /*Tests_SRS_IOTHUBCLIENT_LL_10_006: [ If deviceTwinCallback is NULL, then IoTHubClient_LL_SetDeviceTwinCallback shall call the underlying layer's _Unsubscribe function and return IOTHUB_CLIENT_OK.] */
 TEST_FUNCTION(IoTHubClient_LL_SetDeviceTwinCallback_unsubscribe_succeed)
 {
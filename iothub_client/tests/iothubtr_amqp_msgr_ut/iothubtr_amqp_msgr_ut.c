@@ -296,8 +296,10 @@ static MQ_MESSAGE_HANDLE TEST_message_queue_add_message[TEST_MESSAGE_QUEUE_ADD_B
 static MESSAGE_PROCESSING_COMPLETED_CALLBACK TEST_message_queue_add_on_message_processing_completed_callback[TEST_MESSAGE_QUEUE_ADD_BUFFERS_SIZE];
 static void* TEST_message_queue_add_user_context[TEST_MESSAGE_QUEUE_ADD_BUFFERS_SIZE];
 static int TEST_message_queue_add_return;
-static int TEST_message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback, void* user_context)
+static int TEST_message_queue_add(MESSAGE_QUEUE_HANDLE message_queue, MQ_MESSAGE_HANDLE message, MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback, void* user_context, MQ_ITEM_HANDLE* item)
 {
+	(void)item;
+
 	TEST_message_queue_add_message_queue[TEST_message_queue_add_count] = message_queue;
 	TEST_message_queue_add_message[TEST_message_queue_add_count] = message;
 	TEST_message_queue_add_on_message_processing_completed_callback[TEST_message_queue_add_count] = on_message_processing_completed_callback;
@@ -615,11 +617,23 @@ static void TEST_on_message_processing_completed_callback(MQ_MESSAGE_HANDLE mess
 	TEST_on_message_processing_completed_callback_message_context = message_context;
 }
 
+static MQ_ITEM_HANDLE TEST_on_process_message_completed_callback_item;
+static MESSAGE_QUEUE_RESULT TEST_on_process_message_completed_callback_result;
+static int TEST_on_process_message_completed_callback_count;
+static void TEST_on_process_message_completed_callback(MESSAGE_QUEUE_HANDLE message_queue, MQ_ITEM_HANDLE item, MESSAGE_QUEUE_RESULT result, USER_DEFINED_REASON reason)
+{
+	(void)message_queue;
+	(void)reason;
+	TEST_on_process_message_completed_callback_item = item;
+	TEST_on_process_message_completed_callback_result = result;
+	TEST_on_process_message_completed_callback_count++;
+}
+
 static void set_expected_calls_for_amqp_messenger_send_async()
 {
 	STRICT_EXPECTED_CALL(message_clone(IGNORED_NUM_ARG));
 	EXPECTED_CALL(malloc(IGNORED_NUM_ARG)); // create_message_send_context
-	STRICT_EXPECTED_CALL(message_queue_add(TEST_MESSAGE_QUEUE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(message_queue_add(TEST_MESSAGE_QUEUE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 }
 
 static AMQP_MESSENGER_SEND_RESULT TEST_on_event_send_complete_result;
@@ -1264,7 +1278,7 @@ TEST_FUNCTION(amqp_messenger_create_config_NULL_iothub_host_fqdn)
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_003: [amqp_messenger_create() shall allocate memory for the messenger instance structure (aka `instance`)]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_005: [amqp_messenger_create() shall save a copy of `messenger_config` into `instance`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_007: [`instance->send_queue` shall be set using message_queue_create(), passing `on_process_message_callback`]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_007: [`instance->send_queue` shall be set using message_queue_create(), passing `on_process_message_callback` and an exponential backoff with jitter for retries]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_009: [If no failures occurr, amqp_messenger_create() shall return a handle to `instance`]
 TEST_FUNCTION(amqp_messenger_create_success)
 {
@@ -1674,6 +1688,57 @@ TEST_FUNCTION(amqp_messenger_do_work_send_events_success)
 	amqp_messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_022: [If `result` is MESSAGE_QUEUE_TIMEOUT, `send_ctx->on_send_complete_callback` shall be invoked with AMQP_MESSENGER_SEND_RESULT_ERROR and AMQP_MESSENGER_REASON_TIMEOUT]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_122: [If a failure occurred, `context->on_process_message_completed_callback` shall be invoked with result MESSAGE_QUEUE_ERROR]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_140: [If `send_ctx` is still in flight (i.e., `on_send_complete_callback` has not been invoked for it yet), it shall be marked as abandoned instead of destroyed]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_141: [If `context` was abandoned by `instance->send_queue` while in flight, it shall be destroyed]
+TEST_FUNCTION(amqp_messenger_send_complete_after_in_flight_message_timed_out)
+{
+	// arrange
+	AMQP_MESSENGER_CONFIG* config = get_messenger_config();
+	AMQP_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+	set_expected_calls_for_amqp_messenger_send_async();
+	ASSERT_ARE_EQUAL(int, 0, amqp_messenger_send_async(handle, TEST_MESSAGE_HANDLE, TEST_on_event_send_complete, TEST_IOTHUB_CLIENT_HANDLE));
+
+	MQ_MESSAGE_HANDLE mq_message = TEST_message_queue_add_message[0];
+	MESSAGE_PROCESSING_COMPLETED_CALLBACK on_message_processing_completed_callback = TEST_message_queue_add_on_message_processing_completed_callback[0];
+	void* send_ctx = TEST_message_queue_add_user_context[0];
+
+	TEST_on_process_message_completed_callback_count = 0;
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(messagesender_send(TEST_MESSAGE_SENDER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.IgnoreArgument(2).IgnoreArgument(3).IgnoreArgument(4);
+	EXPECTED_CALL(message_destroy(IGNORED_PTR_ARG));
+	TEST_on_process_message_callback(TEST_MESSAGE_QUEUE_HANDLE, mq_message, TEST_on_process_message_completed_callback, send_ctx);
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NOT_NULL(saved_messagesender_send_on_message_send_complete);
+
+	// The message times out while uAMQP still holds `send_ctx`; it shall not be freed yet.
+	umock_c_reset_all_calls();
+	on_message_processing_completed_callback(mq_message, MESSAGE_QUEUE_TIMEOUT, NULL, send_ctx);
+	TEST_remove_message_queue_first_item();
+
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, AMQP_MESSENGER_SEND_RESULT_ERROR, TEST_on_event_send_complete_result);
+	ASSERT_ARE_EQUAL(int, AMQP_MESSENGER_REASON_TIMEOUT, TEST_on_event_send_complete_reason);
+
+	umock_c_reset_all_calls();
+	EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+	// act
+	saved_messagesender_send_on_message_send_complete(saved_messagesender_send_callback_context, MESSAGE_SEND_ERROR);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(int, 1, TEST_on_process_message_completed_callback_count);
+	ASSERT_ARE_EQUAL(int, MESSAGE_QUEUE_ERROR, TEST_on_process_message_completed_callback_result);
+
+	// cleanup
+	amqp_messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_092: [The AMQP link address shall be defined as "amqps://<`iothub_host_fqdn`>/devices/<`device_id`>/<`instance-config->receive_link.target_suffix`>"]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_093: [The AMQP link name shall be defined as "link-rcv-<`device_id`>-<locally generated UUID>"]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_094: [The AMQP link source shall be defined as <link address>]  
@@ -43,6 +43,7 @@ void real_free(void* ptr)
 #include "azure_c_shared_utility/singlylinkedlist.h"
 #include "azure_c_shared_utility/uniqueid.h"
 #include "azure_c_shared_utility/optionhandler.h"
+#include "azure_c_shared_utility/tickcounter.h"
 #include "azure_uamqp_c/session.h"
 #include "azure_uamqp_c/link.h"
 #include "azure_uamqp_c/messaging.h"
@@ -144,6 +145,7 @@ static SINGLYLINKEDLIST_HANDLE TEST_IN_PROGRESS_LIST;
 #define TEST_IN_PROGRESS_LIST2                            (SINGLYLINKEDLIST_HANDLE)0x4484
 #define TEST_OPTIONHANDLER_HANDLE                         (OPTIONHANDLER_HANDLE)0x4485
 #define TEST_CALLBACK_LIST1                               (SINGLYLINKEDLIST_HANDLE)0x4486
+#define TEST_TICK_COUNTER_HANDLE                          (TICK_COUNTER_HANDLE)0x4487
 #define INDEFINITE_TIME                                   ((time_t)-1)
 
 static delivery_number TEST_DELIVERY_NUMBER;
@@ -310,11 +312,13 @@ static MESSAGE_RECEIVER_HANDLE TEST_messagereceiver_create(LINK_HANDLE link, ON_
 static IOTHUB_MESSAGE_HANDLE saved_on_new_message_received_callback_message;
 static void* saved_on_new_message_received_callback_context;
 static TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* saved_on_new_message_received_callback_disposition_info;
+static const char* saved_on_new_message_received_callback_disposition_info_source;
 static TELEMETRY_MESSENGER_DISPOSITION_RESULT TEST_on_new_message_received_callback_result;
 static TELEMETRY_MESSENGER_DISPOSITION_RESULT TEST_on_new_message_received_callback(IOTHUB_MESSAGE_HANDLE message, TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* disposition_info, void* context)
 {
     saved_on_new_message_received_callback_message = message;
     saved_on_new_message_received_callback_disposition_info = disposition_info;
+    saved_on_new_message_received_callback_disposition_info_source = disposition_info->source;
     saved_on_new_message_received_callback_context = context;
     return TEST_on_new_message_received_callback_result;
 }
@@ -1515,24 +1519,14 @@ static int TEST_messagereceiver_get_link_name(MESSAGE_RECEIVER_HANDLE message_re
     return TEST_messagereceiver_get_link_name_result;
 }
 
-static void set_expected_calls_for_create_message_disposition_info()
+static void set_expected_calls_for_get_message_disposition_info()
 {
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)));
     STRICT_EXPECTED_CALL(messagereceiver_get_received_message_id(TEST_MESSAGE_RECEIVER_HANDLE, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
         .CopyOutArgumentBuffer(2, &TEST_DELIVERY_NUMBER, sizeof(delivery_number));
     
     STRICT_EXPECTED_CALL(messagereceiver_get_link_name(TEST_MESSAGE_RECEIVER_HANDLE, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
-    static char* link_name = TEST_MESSAGE_RECEIVER_LINK_NAME_CHAR_PTR;
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer_destination(&link_name, sizeof(char*));
-}
-
-static void set_expected_calls_for_destroy_message_disposition_info()
-{
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
 static void set_expected_calls_for_on_message_received_internal_callback(TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result)
@@ -1540,9 +1534,7 @@ static void set_expected_calls_for_on_message_received_internal_callback(TELEMET
     TEST_on_new_message_received_callback_result = disposition_result;
     STRICT_EXPECTED_CALL(message_create_IoTHubMessage_from_uamqp_message(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
     
-    set_expected_calls_for_create_message_disposition_info();
-
-    set_expected_calls_for_destroy_message_disposition_info();
+    set_expected_calls_for_get_message_disposition_info();
 
     if (disposition_result == TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED)
     {
@@ -1796,6 +1788,12 @@ TEST_SUITE_INITIALIZE(TestClassInitialize)
     REGISTER_GLOBAL_MOCK_RETURN(message_add_body_amqp_data, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(message_add_body_amqp_data, 1);
 
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_create, TEST_TICK_COUNTER_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_create, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(tickcounter_get_current_ms, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(tickcounter_get_current_ms, 1);
+
     TEST_IOTHUB_MESSAGE_LIST_HANDLE = (IOTHUB_MESSAGE_LIST*)real_malloc(sizeof(IOTHUB_MESSAGE_LIST));
     ASSERT_IS_NOT_NULL(TEST_IOTHUB_MESSAGE_LIST_HANDLE);
     TEST_IOTHUB_MESSAGE_LIST_HANDLE->messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
@@ -2830,6 +2828,7 @@ TEST_FUNCTION(telemetry_messenger_unsubscribe_for_messages_not_subscribed)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_121: [An IOTHUB_MESSAGE_HANDLE shall be obtained from MESSAGE_HANDLE using message_create_IoTHubMessage_from_uamqp_message()]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_123: [`instance->on_message_received_callback` shall be invoked passing the IOTHUB_MESSAGE_HANDLE]  
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_125: [If `instance->on_message_received_callback` returns TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED, on_message_received_internal_callback shall return the result of messaging_delivery_accepted()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be populated with the source link name and message delivery ID, without copying the link name]
 TEST_FUNCTION(messenger_on_message_received_internal_callback_ACCEPTED)
 {
     // arrange
@@ -2847,14 +2846,13 @@ TEST_FUNCTION(messenger_on_message_received_internal_callback_ACCEPTED)
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_EQUAL(void_ptr, result, TEST_MESSAGE_DISPOSITION_ACCEPTED_AMQP_VALUE);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)TEST_messagereceiver_get_link_name_link_name, (void*)saved_on_new_message_received_callback_disposition_info_source);
 
     // cleanup
     telemetry_messenger_destroy(handle);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_126: [If `instance->on_message_received_callback` returns TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED, on_message_received_internal_callback shall return the result of messaging_delivery_released()]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_186: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created containing the source link name and message delivery ID]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_188: [The memory allocated for the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be released]  
 TEST_FUNCTION(messenger_on_message_received_internal_callback_RELEASED)
 {
     // arrange
@@ -2927,8 +2925,8 @@ TEST_FUNCTION(messenger_on_message_received_internal_callback_message_create_IoT
     telemetry_messenger_destroy(handle);
 }
 
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_187: [If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance fails to be created, on_message_received_internal_callback shall return messaging_delivery_released()]  
-TEST_FUNCTION(messenger_on_message_received_internal_callback_create_TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO_fails)
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_187: [If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance fails to be populated, on_message_received_internal_callback shall return messaging_delivery_released()]
+TEST_FUNCTION(messenger_on_message_received_internal_callback_get_TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO_fails)
 {
     // arrange
     TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
@@ -2937,7 +2935,9 @@ TEST_FUNCTION(messenger_on_message_received_internal_callback_create_TELEMETRY_M
     umock_c_reset_all_calls();
     TEST_on_new_message_received_callback_result = TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED;
     STRICT_EXPECTED_CALL(message_create_IoTHubMessage_from_uamqp_message(TEST_MESSAGE_HANDLE, IGNORED_PTR_ARG)).IgnoreArgument(2);
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO))).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(messagereceiver_get_received_message_id(TEST_MESSAGE_RECEIVER_HANDLE, IGNORED_PTR_ARG))
+        .IgnoreArgument(2)
+        .SetReturn(1);
     STRICT_EXPECTED_CALL(messaging_delivery_released());
 
     // act
@@ -3220,6 +3220,146 @@ TEST_FUNCTION(telemetry_messenger_set_option_EVENT_SEND_TIMEOUT_SECS)
     telemetry_messenger_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_197: [If name matches MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, `value` shall be saved on `instance->event_batch_target_size` and the cached maximum batch size reset]
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_BATCH_TARGET_SIZE)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 16384;
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = telemetry_messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_198: [If name matches MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, `value` shall be saved on `instance->event_batch_max_linger_msecs`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_199: [If `value` is not zero and `instance->tick_counter` is NULL, it shall be created using tickcounter_create()]
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_BATCH_MAX_LINGER_MSECS)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 50;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create());
+
+    // act
+    int result = telemetry_messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, &value);
+    int result2 = telemetry_messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_200: [If tickcounter_create() fails, telemetry_messenger_set_option shall fail and return a non-zero value]
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_BATCH_MAX_LINGER_MSECS_tickcounter_create_fails)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 50;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(tickcounter_create()).SetReturn(NULL);
+
+    // act
+    int result = telemetry_messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, &value);
+
+    // assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_201: [If name matches MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, `value` shall be saved on `instance->event_batch_max_in_flight`]
+TEST_FUNCTION(telemetry_messenger_set_option_EVENT_BATCH_MAX_IN_FLIGHT)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t value = 2;
+
+    umock_c_reset_all_calls();
+
+    // act
+    int result = telemetry_messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_193: [If `instance->event_batch_max_in_flight` batches are already in flight, no more messages shall be taken from `instance->wait_to_send_list`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_204: [A batch shall no longer be counted as in flight once its send completes or times out]
+TEST_FUNCTION(telemetry_messenger_do_work_max_batches_in_flight_released_on_send_complete)
+{
+    // arrange
+    TELEMETRY_MESSENGER_CONFIG* config = get_messenger_config();
+    TELEMETRY_MESSENGER_HANDLE handle = create_and_start_messenger2(config, false);
+
+    size_t max_in_flight = 1;
+    ASSERT_ARE_EQUAL(int, 0, telemetry_messenger_set_option(handle, MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, &max_in_flight));
+
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+
+    time_t current_time = time(NULL);
+    MESSENGER_DO_WORK_EXP_CALL_PROFILE *mdwp = get_msgr_do_work_exp_call_profile(TELEMETRY_MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+    crank_telemetry_messenger_do_work(handle, mdwp);
+
+    ASSERT_IS_NOT_NULL(saved_messagesender_send_on_message_send_complete);
+    ON_MESSAGE_SEND_COMPLETE on_message_send_complete = saved_messagesender_send_on_message_send_complete;
+    void* on_message_send_complete_context = saved_messagesender_send_callback_context;
+
+    ASSERT_ARE_EQUAL(int, 1, send_events(handle, 1));
+    saved_messagesender_send_message = NULL;
+
+    umock_c_reset_all_calls();
+    telemetry_messenger_do_work(handle);
+
+    // the first batch is still in flight, so the second event is left waiting
+    ASSERT_IS_NULL(saved_messagesender_send_message);
+    ASSERT_ARE_EQUAL(int, 1, saved_wait_to_send_list_count);
+
+    umock_c_reset_all_calls();
+    on_message_send_complete(on_message_send_complete_context, MESSAGE_SEND_OK);
+
+    mdwp = get_msgr_do_work_exp_call_profile(TELEMETRY_MESSENGER_STATE_STARTED, false, false, 1, 0, current_time, DEFAULT_EVENT_SEND_TIMEOUT_SECS);
+
+    // act
+    crank_telemetry_messenger_do_work(handle, mdwp);
+
+    // assert
+    ASSERT_IS_NOT_NULL(saved_messagesender_send_message);
+    ASSERT_ARE_EQUAL(int, 0, saved_wait_to_send_list_count);
+
+    // cleanup
+    telemetry_messenger_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_169: [If name matches MESSENGER_OPTION_SAVED_OPTIONS, `value` shall be applied using OptionHandler_FeedOptions]
 TEST_FUNCTION(telemetry_messenger_set_option_SAVED_OPTIONS)
 {
@@ -3469,6 +3609,12 @@ static void set_expected_calls_for_telemetry_messenger_retrieve_options()
 
     STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_EVENT_SEND_TIMEOUT_SECS, IGNORED_PTR_ARG))
         .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(OptionHandler_AddOption(TEST_OPTIONHANDLER_HANDLE, MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_MESSENGER_09_173: [If `messenger_handle` is NULL, telemetry_messenger_retrieve_options shall fail and return NULL]
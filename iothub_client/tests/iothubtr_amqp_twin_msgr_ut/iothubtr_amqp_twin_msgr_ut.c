@@ -48,6 +48,7 @@ void real_free(void* ptr)
 #include "azure_uamqp_c/messaging.h"
 #include "iothub_client_private.h"
 #include "iothubtransport_amqp_messenger.h"
+#include "hash_index.h"
 
 #undef ENABLE_MOCKS
 
@@ -114,6 +115,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_SYMBOL_AMQP_VALUE                               (AMQP_VALUE)0x4490
 #define TEST_MSG_ANNOTATIONS_AMQP_VALUE                      (AMQP_VALUE)0x4491
 #define TEST_PROPERTIES_HANDLE                               (PROPERTIES_HANDLE)0x4492
+#define TEST_OPERATIONS_INDEX                                (HASH_INDEX_HANDLE)0x4493
 
 #define INDEFINITE_TIME                                      ((time_t)-1)
 #define DEFAULT_TWIN_SEND_LINK_SOURCE_NAME                   "twin"
@@ -427,6 +429,7 @@ static void set_expected_calls_for_twin_messenger_create(TWIN_MESSENGER_CONFIG*
 		.CopyOutArgumentBuffer(1, &config->iothub_host_fqdn, sizeof(config->iothub_host_fqdn));
 	STRICT_EXPECTED_CALL(singlylinkedlist_create());
 	STRICT_EXPECTED_CALL(singlylinkedlist_create());
+	STRICT_EXPECTED_CALL(hash_index_create(0));
 
 	set_create_link_attach_properties_expected_calls(config);
 
@@ -485,7 +488,7 @@ static void set_process_timeouts_expected_calls(time_t current_time, size_t numb
 	for (i = 0; i < number_of_expired_pending_operations; i++)
 	{
 		STRICT_EXPECTED_CALL(get_difftime(current_time, IGNORED_NUM_ARG)).SetReturn(10000000); // Simulate it's expired for sure.
-		STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)); // correlation id
+		STRICT_EXPECTED_CALL(hash_index_remove(TEST_OPERATIONS_INDEX, IGNORED_PTR_ARG));
 		STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
 	}
 
@@ -500,7 +503,6 @@ static void set_process_timeouts_expected_calls(time_t current_time, size_t numb
 static void set_create_twin_operation_context_expected_calls()
 {
 	STRICT_EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
-	set_generate_unique_id_expected_calls();
 }
 
 static void set_add_map_item_expected_calls(const char* name, const char* value)
@@ -607,6 +609,7 @@ static void set_twin_messenger_do_work_expected_calls(DOWORK_TEST_PROFILE* dwtp)
 			set_create_twin_operation_context_expected_calls();
 
 			STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+			STRICT_EXPECTED_CALL(hash_index_add_without_copy(TEST_OPERATIONS_INDEX, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
 			set_send_twin_operation_request_expected_calls(dwtp->current_time);
 
@@ -743,6 +746,7 @@ static void register_global_mock_aliases()
 	REGISTER_UMOCK_ALIAS_TYPE(LIST_ACTION_FUNCTION, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(LIST_CONDITION_FUNCTION, void*);
 	REGISTER_UMOCK_ALIAS_TYPE(CONSTBUFFER_HANDLE, void*);
+	REGISTER_UMOCK_ALIAS_TYPE(HASH_INDEX_HANDLE, void*);
 }
 
 static void register_global_mock_returns()
@@ -804,6 +808,15 @@ static void register_global_mock_returns()
 	REGISTER_GLOBAL_MOCK_RETURN(singlylinkedlist_add, TEST_LIST_ITEM_HANDLE);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
 
+	// hash_index
+	REGISTER_GLOBAL_MOCK_RETURN(hash_index_create, TEST_OPERATIONS_INDEX);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(hash_index_create, NULL);
+
+	REGISTER_GLOBAL_MOCK_RETURN(hash_index_add_without_copy, 0);
+	REGISTER_GLOBAL_MOCK_FAIL_RETURN(hash_index_add_without_copy, 1);
+
+	REGISTER_GLOBAL_MOCK_RETURN(hash_index_remove, 0);
+
 	// STRING
 	REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, TEST_IOTHUB_HOST_FQDN);
 	REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_c_str, NULL);
@@ -961,6 +974,7 @@ TEST_FUNCTION(twin_msgr_create_NULL_device_id)
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_015: [`amqp_msgr_config` shall have "twin/" as send link target suffix and receive link source suffix]
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_016: [`amqp_msgr_config` shall have send and receive link attach properties set as "com.microsoft:client-version" = `twin_msgr->client_version`, "com.microsoft:channel-correlation-id" = `twin:<UUID>`, "com.microsoft:api-version" = "2016-11-14"]
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_017: [`amqp_msgr_config` shall be set with `on_amqp_messenger_state_changed_callback` and `on_amqp_messenger_subscription_changed_callback` callbacks]
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_113: [`twin_msgr->operations_index` shall be set using hash_index_create()]
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_019: [`twin_msgr->amqp_msgr` shall subscribe for AMQP messages by calling amqp_messenger_subscribe_for_messages() passing `on_amqp_message_received`]  
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_021: [If no failures occurr, twin_messenger_create() shall return a handle to `twin_msgr`] 
 TEST_FUNCTION(twin_msgr_create_success)
@@ -995,6 +1009,7 @@ TEST_FUNCTION(twin_msgr_create_success)
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_006: [If any `messenger_config` info fails to be copied, twin_messenger_create() shall fail and return NULL]  
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_008: [If singlylinkedlist_create() fails, twin_messenger_create() shall fail and return NULL]  
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_010: [If singlylinkedlist_create() fails, twin_messenger_create() shall fail and return NULL]  
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_114: [If hash_index_create() fails, twin_messenger_create() shall fail and return NULL]
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_018: [If amqp_messenger_create() fails, twin_messenger_create() shall fail and return NULL]  
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_020: [If amqp_messenger_subscribe_for_messages() fails, twin_messenger_create() shall fail and return NULL] 
 TEST_FUNCTION(twin_msgr_create_failure_checks)
@@ -1012,7 +1027,7 @@ TEST_FUNCTION(twin_msgr_create_failure_checks)
 	size_t i;
 	for (i = 0; i < umock_c_negative_tests_call_count(); i++)
 	{
-		if (i == 10 || i == 14 || i == 17)
+		if (i == 11 || i == 15 || i == 18)
 		{
 			// These expected calls do not cause the API to fail.
 			continue;
@@ -1540,6 +1555,8 @@ TEST_FUNCTION(twin_msgr_do_work_not_started_with_EXPIRED_pending_patches_success
 
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_080: [twin_messenger_do_work() shall remove and destroy any timed out items from `twin_msgr->pending_patches` and `twin_msgr->operations`]  
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_081: [If a timed-out item is a reported property PATCH, `on_report_state_complete_callback` shall be invoked with RESULT_ERROR and REASON_TIMEOUT]  
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_109: [Each TWIN operation queued into `twin_msgr->operations` shall be indexed by its correlation-id using hash_index_add_without_copy(), so the index refers to the correlation-id buffer of the operation context instead of copying it]
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_111: [Timed-out items of `twin_msgr->operations` shall be removed from `twin_msgr->operations_index` using hash_index_remove()]
 TEST_FUNCTION(twin_msgr_do_work_started_with_EXPIRED_in_progress_patches_success)
 {
 	// arrange
@@ -1583,6 +1600,41 @@ TEST_FUNCTION(twin_msgr_do_work_started_with_EXPIRED_in_progress_patches_success
 	twin_messenger_destroy(handle);
 }
 
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_061: [If any other failure occurs sending the PATCH request, `on_report_state_complete_callback` shall be invoked with RESULT_ERROR and REASON_INTERNAL_ERROR]
+// Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_110: [If hash_index_add_without_copy() fails, the TWIN operation shall be removed from `twin_msgr->operations` and the request shall fail]
+TEST_FUNCTION(twin_msgr_do_work_hash_index_add_without_copy_fails)
+{
+	// arrange
+	TWIN_MESSENGER_CONFIG* config = get_twin_messenger_config();
+	TWIN_MESSENGER_HANDLE handle = create_and_start_twin_messenger(config);
+
+	send_one_report_patch(handle, g_initial_time);
+
+	umock_c_reset_all_calls();
+	STRICT_EXPECTED_CALL(singlylinkedlist_remove_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	set_create_twin_operation_context_expected_calls();
+	STRICT_EXPECTED_CALL(singlylinkedlist_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(hash_index_add_without_copy(TEST_OPERATIONS_INDEX, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+		.SetReturn(1);
+	STRICT_EXPECTED_CALL(singlylinkedlist_remove(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(CONSTBUFFER_Destroy(IGNORED_PTR_ARG));
+	STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+	set_process_timeouts_expected_calls(g_initial_time, 0, 0, 0, 0);
+	STRICT_EXPECTED_CALL(amqp_messenger_do_work(TEST_AMQP_MESSENGER_HANDLE));
+
+	// act
+	twin_messenger_do_work(handle);
+
+	// assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_ARE_EQUAL(size_t, 1, TEST_on_report_state_complete_callback_result_ERROR_count);
+	ASSERT_ARE_EQUAL(size_t, 1, TEST_on_report_state_complete_callback_reason_INTERNAL_ERROR_count);
+
+	// cleanup
+	twin_messenger_destroy(handle);
+}
+
 // Tests_IOTHUBTRANSPORT_AMQP_TWIN_MESSENGER_09_082: [If any failure occurs while verifying/removing timed-out items `twin_msgr->state` shall be set to TWIN_MESSENGER_STATE_ERROR and user informed]  
 
 
@@ -154,6 +154,8 @@ static int TEST_cbs_put_token_async(CBS_HANDLE cbs, const char* type, const char
     return TEST_cbs_put_token_async_return;
 }
 
+static char* saved_IoTHubClient_Auth_Get_SasToken_result;
+
 char* TEST_IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const char* scope, size_t expire_time)
 {
     (void)handle;
@@ -163,6 +165,7 @@ char* TEST_IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, co
     size_t len = strlen(TEST_USER_DEFINED_SAS_TOKEN);
     result = (char*)real_malloc(len+1);
     strcpy(result, TEST_USER_DEFINED_SAS_TOKEN);
+    saved_IoTHubClient_Auth_Get_SasToken_result = result;
     return result;
 }
 
@@ -341,11 +344,13 @@ static void set_expected_calls_for_authentication_create(AUTHENTICATION_CONFIG*
     EXPECTED_CALL(malloc(IGNORED_NUM_ARG));
     STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_DeviceId(TEST_AUTHORIZATION_MODULE_HANDLE));
     STRICT_EXPECTED_CALL(STRING_construct(TEST_IOTHUB_HOST_FQDN)).SetReturn(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE)).SetReturn(TEST_IOTHUB_HOST_FQDN);
 }
 
 static void set_expected_calls_for_authentication_destroy(AUTHENTICATION_HANDLE handle)
 {
     STRICT_EXPECTED_CALL(STRING_delete(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
     STRICT_EXPECTED_CALL(free(handle));
 }
 
@@ -390,9 +395,7 @@ static void set_expected_calls_for_create_and_put_sas_token(AUTHENTICATION_HANDL
         .SetReturn(current_time);
     STRICT_EXPECTED_CALL(get_difftime(current_time, (time_t)0))
         .SetReturn(difftime(current_time, (time_t)0));
-    STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
     set_expected_calls_for_put_SAS_token_to_cbs(handle, current_time, TEST_GENERATED_SAS_TOKEN_STRING_HANDLE);
-    STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
 }
 
 static void set_expected_calls_for_authentication_do_work(AUTHENTICATION_CONFIG* config, AUTHENTICATION_HANDLE handle, time_t current_time, AUTHENTICATION_DO_WORK_EXPECTED_STATE* exp_context)
@@ -414,10 +417,8 @@ static void set_expected_calls_for_authentication_do_work(AUTHENTICATION_CONFIG*
     }
     else if (exp_context->current_state == AUTHENTICATION_STATE_STARTING)
     {
-        STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE));
         set_expected_calls_for_put_SAS_token_to_cbs(handle, current_time, exp_context->sas_token_to_use);
         STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
-        STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICES_PATH_STRING_HANDLE));
     }
     else if (exp_context->current_state == AUTHENTICATION_STATE_STARTED)
     {
@@ -427,6 +428,15 @@ static void set_expected_calls_for_authentication_do_work(AUTHENTICATION_CONFIG*
     }
 }
 
+static void set_expected_calls_for_sas_token_pregeneration(time_t current_time)
+{
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_MODULE_HANDLE)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(current_time);
+    STRICT_EXPECTED_CALL(get_difftime(current_time, (time_t)0)).SetReturn(difftime(current_time, (time_t)0));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken(TEST_AUTHORIZATION_MODULE_HANDLE, TEST_DEVICES_PATH, IGNORED_NUM_ARG));
+}
+
 static void crank_authentication_do_work(AUTHENTICATION_CONFIG* config, AUTHENTICATION_HANDLE handle, time_t current_time, AUTHENTICATION_DO_WORK_EXPECTED_STATE* exp_context)
 {
     umock_c_reset_all_calls();
@@ -472,6 +482,8 @@ static void reset_parameters()
     saved_cbs_put_token_token = NULL;
     saved_cbs_put_token_on_operation_complete = NULL;
     saved_cbs_put_token_context = NULL;
+
+    saved_IoTHubClient_Auth_Get_SasToken_result = NULL;
 }
 
 BEGIN_TEST_SUITE(iothubtransport_amqp_cbs_auth_ut)
@@ -575,6 +587,7 @@ TEST_FUNCTION(authentication_create_NULL_on_state_changed_callback)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_012: [If provided, authentication_create() shall save a copy of `config->device_primary_key` into the `instance->device_primary_key`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_014: [If provided, authentication_create() shall save a copy of `config->device_secondary_key` into `instance->device_secondary_key`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_016: [If provided, authentication_create() shall save a copy of `config->iothub_host_fqdn` into `instance->iothub_host_fqdn`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_129: [authentication_create() shall save into `instance->devices_path` a STRING_HANDLE created from the following parts: iothub_host_fqdn + "/devices/" + device_id]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_024: [If no failure occurs, authentication_create() shall return a reference to the AUTHENTICATION_INSTANCE handle]
 TEST_FUNCTION(authentication_create_DEVICE_KEYS_succeeds)
 {
@@ -878,7 +891,7 @@ TEST_FUNCTION(authentication_do_work_SAS_TOKEN_AUTHENTICATION_STATE_STARTING_suc
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_042: [Otherwise, authentication_do_work() shall use device keys for CBS authentication]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_049: [authentication_do_work() shall create a SAS token using `IoTHubClient_Auth_Get_SasToken`, unless it has failed previously]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_052: [The SAS token expiration time shall be calculated adding `instance->sas_token_lifetime_secs` to the current number of seconds since epoch time UTC]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_053: [A STRING_HANDLE, referred to as `devices_path`, shall be created from the following parts: iothub_host_fqdn + "/devices/" + device_id]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_053: [The SAS token shall be created for `instance->devices_path`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_057: [authentication_do_work() shall set `instance->is_cbs_put_token_in_progress` to TRUE]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_058: [The SAS token shall be sent to CBS using cbs_put_token_async(), using `servicebus.windows.net:sastoken` as token type, `devices_path` as audience and passing on_cbs_put_token_complete_callback]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_059: [If cbs_put_token_async() succeeds, authentication_do_work() shall set `instance->current_sas_token_put_time` with current time]
@@ -1006,12 +1019,12 @@ TEST_FUNCTION(authentication_do_work_SAS_TOKEN_AUTHENTICATION_STATE_STARTING_fai
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 0 || i == 1 || i == 4 || i == 6 || i == 7)
+        if (i == 0 || i == 3 || i == 5 || i == 6)
         {
             // These expected calls do not cause the API to fail.
             continue;
         }
-        else if (i == 5)
+        else if (i == 4)
         {
             TEST_cbs_put_token_async_return = 1;
         }
@@ -1075,7 +1088,6 @@ TEST_FUNCTION(authentication_do_work_SAS_TOKEN_on_cbs_put_token_callback_error)
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_022: [authentication_create() shall set `instance->sas_token_lifetime_secs` with the default value of one hour]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_054: [If `devices_path` failed to be created, authentication_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_056: [If SASToken_Create() fails, authentication_do_work() shall fail and return]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_060: [If cbs_put_token_async() fails, `instance->is_cbs_put_token_in_progress` shall be set to FALSE]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_061: [If cbs_put_token_async() fails, `instance->state` shall be updated to AUTHENTICATION_STATE_ERROR and `instance->on_state_changed_callback` invoked]
@@ -1102,12 +1114,12 @@ TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_AUTHENTICATION_STATE_STARTING_f
     size_t i;
     for (i = 0; i < umock_c_negative_tests_call_count(); i++)
     {
-        if (i == 0 || i == 1 || i == 3 || i == 4 || i == 7 || i == 8 || i == 10 || i == 11 || i == 12)
+        if (i == 0 || i == 2 || i == 3 || i == 6 || i == 7 || i == 9 || i == 10 || i == 11)
         {
             // These expected calls do not cause the API to fail.
             continue;
         }
-        else if (i == 9)
+        else if (i == 8)
         {
             TEST_cbs_put_token_async_return = 1;
         }
@@ -1178,7 +1190,7 @@ TEST_FUNCTION(authentication_do_work_SAS_TOKEN_next_calls_no_op)
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_039: [If `instance->state` is AUTHENTICATION_STATE_STARTED and device keys were used, authentication_do_work() shall only verify the SAS token refresh time]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_023: [authentication_create() shall set `instance->sas_token_refresh_time_secs` with the default value of 30 minutes]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs` minus the refresh jitter]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_066: [If SAS token does not need to be refreshed, authentication_do_work() shall return]
 TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh_check)
 {
@@ -1215,14 +1227,212 @@ TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh_check)
     authentication_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_065: [The SAS token shall be refreshed if the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs` minus the refresh jitter]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_131: [If cbs_put_token_async() succeeds, authentication_do_work() shall randomly pick the refresh jitter of the new SAS token, between 0 and 10% of `instance->sas_token_refresh_time_secs`]
+TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh_jitter_is_bounded)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    time_t current_time = time(NULL);
+    time_t next_time = add_seconds(current_time, 89);
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != next_time, "failed to computer 'next_time'");
+
+    size_t refresh_time_secs = 100;
+    int result = authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, &refresh_time_secs);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "authentication_set_option(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS) failed!");
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(next_time);
+    STRICT_EXPECTED_CALL(get_difftime(next_time, current_time)).SetReturn(89);
+    set_expected_calls_for_sas_token_pregeneration(next_time);
+
+    saved_cbs_put_token_context = NULL;
+
+    // act
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, AUTHENTICATION_STATE_STARTED, saved_on_state_changed_callback_new_state);
+    ASSERT_IS_NULL(saved_cbs_put_token_context);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_132: [If cbs_put_token_async() succeeds, authentication_do_work() shall randomly pick the pre-generation lead of the next SAS token, between 15% and 25% of `instance->sas_token_refresh_time_secs`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_133: [If the SAS token does not need to be refreshed yet, but the current time minus `instance->current_sas_token_put_time` equals or exceeds `instance->sas_token_refresh_time_secs` minus the pre-generation lead, authentication_do_work() shall create the next SAS token and keep it for `instance->devices_path`, unless one was already created]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_134: [If the SAS token needs to be refreshed and one was pre-generated, authentication_do_work() shall put the pre-generated SAS token to CBS instead of creating a new one]
+TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh_puts_pregenerated_token)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    time_t current_time = time(NULL);
+    time_t pregeneration_time = add_seconds(current_time, 85);
+    time_t refresh_time = add_seconds(current_time, 100);
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != pregeneration_time && INDEFINITE_TIME != refresh_time, "failed to computer 'next_time'");
+
+    size_t refresh_time_secs = 100;
+    int result = authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, &refresh_time_secs);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "authentication_set_option(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS) failed!");
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(pregeneration_time);
+    STRICT_EXPECTED_CALL(get_difftime(pregeneration_time, current_time)).SetReturn(85);
+    set_expected_calls_for_sas_token_pregeneration(pregeneration_time);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(pregeneration_time);
+    STRICT_EXPECTED_CALL(get_difftime(pregeneration_time, current_time)).SetReturn(85);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(refresh_time);
+    STRICT_EXPECTED_CALL(get_difftime(refresh_time, current_time)).SetReturn(100);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
+    STRICT_EXPECTED_CALL(cbs_put_token_async(TEST_CBS_HANDLE, SAS_TOKEN_TYPE, TEST_DEVICES_PATH, IGNORED_PTR_ARG, IGNORED_PTR_ARG, handle));
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(refresh_time);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    saved_IoTHubClient_Auth_Get_SasToken_result = NULL;
+
+    // act
+    authentication_do_work(handle);
+    char* pregenerated_sas_token = saved_IoTHubClient_Auth_Get_SasToken_result;
+    authentication_do_work(handle);
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(pregenerated_sas_token);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)pregenerated_sas_token, (void*)saved_cbs_put_token_token);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_135: [If the next SAS token fails to be pre-generated, authentication_do_work() shall create it when the refresh is due]
+TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_pregeneration_fails)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    time_t current_time = time(NULL);
+    time_t pregeneration_time = add_seconds(current_time, 85);
+    time_t refresh_time = add_seconds(current_time, 100);
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != pregeneration_time && INDEFINITE_TIME != refresh_time, "failed to computer 'next_time'");
+
+    size_t refresh_time_secs = 100;
+    int result = authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, &refresh_time_secs);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "authentication_set_option(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS) failed!");
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(pregeneration_time);
+    STRICT_EXPECTED_CALL(get_difftime(pregeneration_time, current_time)).SetReturn(85);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_MODULE_HANDLE)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(pregeneration_time);
+    STRICT_EXPECTED_CALL(get_difftime(pregeneration_time, (time_t)0)).SetReturn(difftime(pregeneration_time, (time_t)0));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICES_PATH_STRING_HANDLE)).SetReturn(TEST_DEVICES_PATH);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken(TEST_AUTHORIZATION_MODULE_HANDLE, TEST_DEVICES_PATH, IGNORED_NUM_ARG)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(refresh_time);
+    STRICT_EXPECTED_CALL(get_difftime(refresh_time, current_time)).SetReturn(100);
+    set_expected_calls_for_put_SAS_token_to_cbs(handle, refresh_time, TEST_GENERATED_SAS_TOKEN_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
+
+    saved_cbs_put_token_context = NULL;
+
+    // act
+    authentication_do_work(handle);
+    authentication_do_work(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(void_ptr, (void*)handle, saved_cbs_put_token_context);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_136: [authentication_stop() shall free the pre-generated SAS token, if any]
+TEST_FUNCTION(authentication_stop_frees_pregenerated_sas_token)
+{
+    // arrange
+    AUTHENTICATION_CONFIG* config = get_auth_config(USE_DEVICE_KEYS);
+    AUTHENTICATION_HANDLE handle = create_and_start_authentication(config);
+
+    time_t current_time = time(NULL);
+    time_t pregeneration_time = add_seconds(current_time, 85);
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != pregeneration_time, "failed to computer 'next_time'");
+
+    size_t refresh_time_secs = 100;
+    int result = authentication_set_option(handle, AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS, &refresh_time_secs);
+    ASSERT_ARE_EQUAL_WITH_MSG(int, 0, result, "authentication_set_option(AUTHENTICATION_OPTION_SAS_TOKEN_REFRESH_TIME_SECS) failed!");
+
+    AUTHENTICATION_DO_WORK_EXPECTED_STATE *exp_state = get_do_work_expected_state_struct();
+    exp_state->current_state = AUTHENTICATION_STATE_STARTING;
+    exp_state->sas_token_to_use = TEST_PRIMARY_DEVICE_KEY_STRING_HANDLE;
+
+    crank_authentication_do_work(config, handle, current_time, exp_state);
+    saved_cbs_put_token_on_operation_complete(saved_cbs_put_token_context, CBS_OPERATION_RESULT_OK, 0, "all good");
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(IGNORED_PTR_ARG)).SetReturn(IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(pregeneration_time);
+    STRICT_EXPECTED_CALL(get_difftime(pregeneration_time, current_time)).SetReturn(85);
+    set_expected_calls_for_sas_token_pregeneration(pregeneration_time);
+    authentication_do_work(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NOT_NULL(saved_IoTHubClient_Auth_Get_SasToken_result);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(free(saved_IoTHubClient_Auth_Get_SasToken_result));
+
+    // act
+    result = authentication_stop(handle);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    authentication_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_067: [authentication_do_work() shall create a SAS token using `instance->device_primary_key`, unless it has failed previously]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_070: [The SAS token expiration time shall be calculated adding `instance->sas_token_lifetime_secs` to the current number of seconds since epoch time UTC]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_071: [A STRING_HANDLE, referred to as `devices_path`, shall be created from the following parts: iothub_host_fqdn + "/devices/" + device_id]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_071: [The SAS token shall be created for `instance->devices_path`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_117: [An empty STRING_HANDLE, referred to as `sasTokenKeyName`, shall be created using STRING_new()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_073: [The SAS token shall be created using SASToken_Create(), passing the selected device key, device_path, sasTokenKeyName and expiration time as arguments]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_076: [The SAS token shall be sent to CBS using cbs_put_token_async(), using `servicebus.windows.net:sastoken` as token type, `devices_path` as audience and passing on_cbs_put_token_complete_callback]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_077: [If cbs_put_token_async() succeeds, authentication_do_work() shall set `instance->current_sas_token_put_time` with the current time]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_081: [authentication_do_work() shall free the memory it allocated for `devices_path`, `sasTokenKeyName` and SAS token]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_AUTH_09_081: [authentication_do_work() shall free the memory it allocated for the SAS token]
 // Tests_SRSIOTHUBTRANSPORT_AMQP_AUTH_09_125: [If name matches AUTHENTICATION_OPTION_SAS_TOKEN_LIFETIME_SECS, `value` shall be saved on `instance->sas_token_lifetime_secs`]
 TEST_FUNCTION(authentication_do_work_DEVICE_KEYS_sas_token_refresh)
 {
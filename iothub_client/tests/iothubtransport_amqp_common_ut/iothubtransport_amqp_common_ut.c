@@ -112,6 +112,7 @@ extern "C"
 #include "iothub_client_private.h"
 #include "iothub_client_version.h"
 #include "iothub_client_retry_control.h"
+#include "hash_index.h"
 #include "iothubtransportamqp_methods.h"
 #include "iothubtransport_amqp_connection.h"
 #include "iothubtransport_amqp_device.h"
@@ -206,11 +207,10 @@ extern "C"
         return item_found == 1 ? 0 : 1;
     }
 
-    static LIST_ITEM_HANDLE TEST_singlylinkedlist_find(SINGLYLINKEDLIST_HANDLE list, LIST_MATCH_FUNCTION match_function, const void* match_context)
+    static void* TEST_hash_index_find(HASH_INDEX_HANDLE index, const char* key)
     {
-        (void)list;
-        (void)match_function;
-        return (LIST_ITEM_HANDLE)match_context;
+        (void)index;
+        return (void*)key;
     }
 
     static const void* TEST_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle)
@@ -393,6 +393,7 @@ static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
 #define TEST_IOTHUB_HOST_FQDN_CLONE_STRING_HANDLE  (STRING_HANDLE)0x4265
 #define TEST_PROTOCOL_PROVIDER                     (IOTHUB_CLIENT_TRANSPORT_PROVIDER)0x4266
 #define TEST_REGISTERED_DEVICES_LIST               (SINGLYLINKEDLIST_HANDLE)0x4267
+#define TEST_REGISTERED_DEVICES_INDEX              (HASH_INDEX_HANDLE)0x4277
 #define TEST_DEVICE_ID_STRING_HANDLE               (STRING_HANDLE)0x4268
 #define TEST_DEVICE_HANDLE                         (DEVICE_HANDLE)0x4269
 #define TEST_LIST_ITEM_HANDLE                      (LIST_ITEM_HANDLE)0x4270
@@ -440,6 +441,8 @@ static void set_expected_calls_for_Create(IOTHUBTRANSPORT_CONFIG* transport_conf
 
     STRICT_EXPECTED_CALL(singlylinkedlist_create())
         .SetReturn(TEST_REGISTERED_DEVICES_LIST);
+    STRICT_EXPECTED_CALL(hash_index_create(0))
+        .SetReturn(TEST_REGISTERED_DEVICES_INDEX);
 }
 
 static void set_expected_calls_for_GetSendStatus(DEVICE_SEND_STATUS send_status)
@@ -459,10 +462,9 @@ static void set_expected_calls_for_is_device_registered_ex(IOTHUB_DEVICE_CONFIG*
 {
     (void)device_config;
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+    STRICT_EXPECTED_CALL(hash_index_find(TEST_REGISTERED_DEVICES_INDEX, IGNORED_PTR_ARG))
         .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)registered_device);
+        .SetReturn((void*)registered_device);
 }
 
 static MESSAGE_DISPOSITION_CONTEXT* TRANSPORT_CONTEXT_DATA_create2(IOTHUB_DEVICE_HANDLE device_handle)
@@ -475,21 +477,6 @@ static MESSAGE_DISPOSITION_CONTEXT* TRANSPORT_CONTEXT_DATA_create2(IOTHUB_DEVICE
     return result;
 }
 
-static void set_expected_calls_for_create_device_message_disposition_info()
-{
-    STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)));
-
-    static char* source = TEST_MESSAGE_SOURCE_CHAR_PTR;
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer_destination(&source, sizeof(char*));
-}
-
-static void set_expected_calls_for_destroy_device_message_disposition_info()
-{
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-}
-
 static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSITION_RESULT iothc_disposition_result)
 {
     DEVICE_MESSAGE_DISPOSITION_RESULT device_disposition_result;
@@ -511,7 +498,6 @@ static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSIT
         device_disposition_result = DEVICE_MESSAGE_DISPOSITION_RESULT_NONE;
     }
 
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, device_disposition_result))
         .IgnoreArgument(2);
 
@@ -520,8 +506,6 @@ static void set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_DISPOSIT
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)).IgnoreArgument_ptr();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)).IgnoreArgument_ptr();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG)).IgnoreArgument_ptr();
-
-    set_expected_calls_for_destroy_device_message_disposition_info();
 }
 
 // @param registered_device
@@ -548,6 +532,7 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
     STRICT_EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, TEST_PRODUCT_INFO_CHAR_PTR));
     STRICT_EXPECTED_CALL(STRING_construct(device_config->deviceId))
         .SetReturn(TEST_DEVICE_ID_STRING_HANDLE);
+    STRICT_EXPECTED_CALL(retry_control_create(DEFAULT_RETRY_POLICY, DEFAULT_MAX_RETRY_TIME_IN_SECS));
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_IOTHUB_HOST_FQDN_STRING_HANDLE))
         .SetReturn(TEST_IOTHUB_HOST_FQDN_CHAR_PTR);
     EXPECTED_CALL(device_create(IGNORED_PTR_ARG));
@@ -562,6 +547,12 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
     // replicate_device_options_to
     STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_SEND_TIMEOUT_SECS, IGNORED_PTR_ARG))
         .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
+    STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
 
     if (is_using_cbs)
     {
@@ -575,6 +566,8 @@ static void set_expected_calls_for_Register(IOTHUB_DEVICE_CONFIG* device_config,
 
     STRICT_EXPECTED_CALL(singlylinkedlist_add(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
+    STRICT_EXPECTED_CALL(hash_index_add(TEST_REGISTERED_DEVICES_INDEX, device_config->deviceId, IGNORED_PTR_ARG))
+        .IgnoreArgument(3);
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
@@ -583,20 +576,21 @@ static void set_expected_calls_for_Unregister(IOTHUB_DEVICE_HANDLE iothub_device
     STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3)
-        .SetReturn((LIST_ITEM_HANDLE)iothub_device_handle);
+    STRICT_EXPECTED_CALL(hash_index_find(TEST_REGISTERED_DEVICES_INDEX, TEST_DEVICE_ID_CHAR_PTR))
+        .SetReturn((void*)iothub_device_handle);
 
     STRICT_EXPECTED_CALL(singlylinkedlist_remove(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG))
         .IgnoreArgument(2);
 
+    STRICT_EXPECTED_CALL(hash_index_remove(TEST_REGISTERED_DEVICES_INDEX, TEST_DEVICE_ID_CHAR_PTR));
+
 #ifdef WIP_C2D_METHODS_AMQP /* This feature is WIP, do not use yet */
     STRICT_EXPECTED_CALL(iothubtransportamqp_methods_destroy(TEST_IOTHUBTRANSPORTAMQP_METHODS));
 #endif	
 
     STRICT_EXPECTED_CALL(device_destroy(TEST_DEVICE_HANDLE));
     STRICT_EXPECTED_CALL(STRING_delete(TEST_DEVICE_ID_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
     EXPECTED_CALL(free(IGNORED_PTR_ARG));
 }
 
@@ -759,6 +753,7 @@ static void set_expected_calls_for_Destroy(int number_of_registered_devices, IOT
     }
     
     STRICT_EXPECTED_CALL(singlylinkedlist_destroy(TEST_REGISTERED_DEVICES_LIST));
+    STRICT_EXPECTED_CALL(hash_index_destroy(TEST_REGISTERED_DEVICES_INDEX));
     STRICT_EXPECTED_CALL(amqp_connection_destroy(TEST_AMQP_CONNECTION_HANDLE));
     STRICT_EXPECTED_CALL(xio_destroy(TEST_UNDERLYING_IO_TRANSPORT));
     STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
@@ -851,6 +846,8 @@ static bool TEST_amqp_connection_create_saved_create_cbs_connection;
 static ON_AMQP_CONNECTION_STATE_CHANGED TEST_amqp_connection_create_saved_on_state_changed_callback;
 static const void* TEST_amqp_connection_create_saved_on_state_changed_context;
 static size_t TEST_amqp_connection_create_saved_c2d_keep_alive_freq_secs;
+static size_t TEST_amqp_connection_create_saved_session_incoming_window;
+static size_t TEST_amqp_connection_create_saved_session_outgoing_window;
 static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create_return;
 static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create(AMQP_CONNECTION_CONFIG* config)
 {
@@ -859,6 +856,8 @@ static AMQP_CONNECTION_HANDLE TEST_amqp_connection_create(AMQP_CONNECTION_CONFIG
     TEST_amqp_connection_create_saved_on_state_changed_callback = config->on_state_changed_callback;
     TEST_amqp_connection_create_saved_on_state_changed_context = config->on_state_changed_context;
     TEST_amqp_connection_create_saved_c2d_keep_alive_freq_secs = config->c2d_keep_alive_freq_secs;
+    TEST_amqp_connection_create_saved_session_incoming_window = config->session_incoming_window;
+    TEST_amqp_connection_create_saved_session_outgoing_window = config->session_outgoing_window;
 
     return TEST_amqp_connection_create_return;
 }
@@ -891,11 +890,114 @@ static double TEST_get_difftime(time_t t1, time_t t0)
 static ON_DEVICE_STATE_CHANGED TEST_device_create_saved_on_state_changed_callback;
 static void* TEST_device_create_saved_on_state_changed_context;
 static DEVICE_HANDLE TEST_device_create_return;
+
+// Stand-in for the CBS node of the hub. When enabled, every device created gets its own handle, device_start_async()
+// puts the device token (moving the device to DEVICE_STATE_STARTING, as the device module does) and each
+// amqp_connection_do_work() delivers the reply to the oldest put-token pending, moving that device to DEVICE_STATE_STARTED.
+#define TEST_CBS_ENDPOINT_MAX_DEVICES 20
+
+typedef struct TEST_CBS_ENDPOINT_DEVICE_TAG
+{
+    ON_DEVICE_STATE_CHANGED on_state_changed_callback;
+    void* on_state_changed_context;
+    DEVICE_STATE state;
+    size_t number_of_starts;
+} TEST_CBS_ENDPOINT_DEVICE;
+
+static bool TEST_cbs_endpoint_enabled;
+static TEST_CBS_ENDPOINT_DEVICE TEST_cbs_endpoint_devices[TEST_CBS_ENDPOINT_MAX_DEVICES];
+static size_t TEST_cbs_endpoint_device_count;
+static TEST_CBS_ENDPOINT_DEVICE* TEST_cbs_endpoint_pending_put_tokens[TEST_CBS_ENDPOINT_MAX_DEVICES];
+static size_t TEST_cbs_endpoint_pending_put_token_count;
+static size_t TEST_cbs_endpoint_max_starting_devices;
+
+static void TEST_cbs_endpoint_set_device_state(TEST_CBS_ENDPOINT_DEVICE* device, DEVICE_STATE new_state)
+{
+    DEVICE_STATE previous_state = device->state;
+    device->state = new_state;
+    device->on_state_changed_callback(device->on_state_changed_context, previous_state, new_state);
+}
+
+static size_t TEST_cbs_endpoint_get_starting_device_count()
+{
+    size_t result = 0;
+    size_t i;
+
+    for (i = 0; i < TEST_cbs_endpoint_device_count; i++)
+    {
+        if (TEST_cbs_endpoint_devices[i].state == DEVICE_STATE_STARTING)
+        {
+            result++;
+        }
+    }
+
+    return result;
+}
+
 static DEVICE_HANDLE TEST_device_create(DEVICE_CONFIG* config)
 {
+    DEVICE_HANDLE result;
+
     TEST_device_create_saved_on_state_changed_callback = config->on_state_changed_callback;
     TEST_device_create_saved_on_state_changed_context = config->on_state_changed_context;
-    return TEST_device_create_return;
+
+    if (TEST_cbs_endpoint_enabled && TEST_cbs_endpoint_device_count < TEST_CBS_ENDPOINT_MAX_DEVICES)
+    {
+        TEST_CBS_ENDPOINT_DEVICE* device = &TEST_cbs_endpoint_devices[TEST_cbs_endpoint_device_count++];
+        device->on_state_changed_callback = config->on_state_changed_callback;
+        device->on_state_changed_context = config->on_state_changed_context;
+        device->state = DEVICE_STATE_STOPPED;
+        device->number_of_starts = 0;
+        result = (DEVICE_HANDLE)device;
+    }
+    else
+    {
+        result = TEST_device_create_return;
+    }
+
+    return result;
+}
+
+static int TEST_device_start_async(DEVICE_HANDLE handle, SESSION_HANDLE session_handle, CBS_HANDLE cbs_handle)
+{
+    (void)session_handle;
+
+    if (TEST_cbs_endpoint_enabled && cbs_handle != NULL)
+    {
+        TEST_CBS_ENDPOINT_DEVICE* device = (TEST_CBS_ENDPOINT_DEVICE*)handle;
+        size_t starting_device_count;
+
+        device->number_of_starts++;
+        TEST_cbs_endpoint_pending_put_tokens[TEST_cbs_endpoint_pending_put_token_count++] = device;
+        TEST_cbs_endpoint_set_device_state(device, DEVICE_STATE_STARTING);
+
+        starting_device_count = TEST_cbs_endpoint_get_starting_device_count();
+        if (starting_device_count > TEST_cbs_endpoint_max_starting_devices)
+        {
+            TEST_cbs_endpoint_max_starting_devices = starting_device_count;
+        }
+    }
+
+    return 0;
+}
+
+static void TEST_amqp_connection_do_work(AMQP_CONNECTION_HANDLE conn_handle)
+{
+    (void)conn_handle;
+
+    if (TEST_cbs_endpoint_enabled && TEST_cbs_endpoint_pending_put_token_count > 0)
+    {
+        TEST_CBS_ENDPOINT_DEVICE* device = TEST_cbs_endpoint_pending_put_tokens[0];
+        size_t i;
+
+        TEST_cbs_endpoint_pending_put_token_count--;
+        for (i = 0; i < TEST_cbs_endpoint_pending_put_token_count; i++)
+        {
+            TEST_cbs_endpoint_pending_put_tokens[i] = TEST_cbs_endpoint_pending_put_tokens[i + 1];
+        }
+
+        TEST_cbs_endpoint_set_device_state(device, DEVICE_STATE_STARTED);
+    }
 }
 
 static bool g_MessageCallback_return;
@@ -914,6 +1016,15 @@ bool TEST_IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, MESSAG
     return g_MessageCallback_return;
 }
 
+static const char* TEST_device_send_message_disposition_saved_source;
+static int TEST_device_send_message_disposition(DEVICE_HANDLE device_handle, DEVICE_MESSAGE_DISPOSITION_INFO* disposition_info, DEVICE_MESSAGE_DISPOSITION_RESULT disposition_result)
+{
+    (void)device_handle;
+    (void)disposition_result;
+    TEST_device_send_message_disposition_saved_source = disposition_info->source;
+    return 0;
+}
+
 // ---------- Test Helpers ---------- //
 const TRANSPORT_PROVIDER* TEST_get_iothub_client_transport_provider(void)
 {
@@ -1025,6 +1136,7 @@ static void crank_transport_ready_after_create(void* handle, PDLIST_ENTRY wts, i
 
     STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
     STRICT_EXPECTED_CALL(retry_control_reset(TEST_RETRY_CONTROL_HANDLE));
+    STRICT_EXPECTED_CALL(retry_control_reset(TEST_RETRY_CONTROL_HANDLE));
     STRICT_EXPECTED_CALL(IoTHubClient_LL_ConnectionStatusCallBack(TEST_IOTHUB_CLIENT_LL_HANDLE, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK));
 
     TEST_device_create_saved_on_state_changed_callback(TEST_device_create_saved_on_state_changed_context,
@@ -1109,6 +1221,7 @@ static void register_umock_alias_types()
     REGISTER_UMOCK_ALIAS_TYPE(RETRY_CONTROL_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SESSION_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HASH_INDEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(time_t, int);
@@ -1136,7 +1249,7 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, TEST_singlylinkedlist_remove);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, TEST_singlylinkedlist_get_head_item);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_next_item, TEST_singlylinkedlist_get_next_item);
-    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_find, TEST_singlylinkedlist_find);
+    REGISTER_GLOBAL_MOCK_HOOK(hash_index_find, TEST_hash_index_find);
     REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, TEST_singlylinkedlist_item_get_value);
 
     REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, my_DList_RemoveEntryList);
@@ -1151,11 +1264,14 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(get_difftime, TEST_get_difftime);
 
     REGISTER_GLOBAL_MOCK_HOOK(device_create, TEST_device_create);
+    REGISTER_GLOBAL_MOCK_HOOK(device_start_async, TEST_device_start_async);
+    REGISTER_GLOBAL_MOCK_HOOK(amqp_connection_do_work, TEST_amqp_connection_do_work);
     REGISTER_GLOBAL_MOCK_HOOK(device_subscribe_message, TEST_device_subscribe_message);
 
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_MessageCallback, TEST_IoTHubClient_LL_MessageCallback);
     REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetOption, TEST_IoTHubClient_LL_GetOption);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, TEST_mallocAndStrcpy_s);
+    REGISTER_GLOBAL_MOCK_HOOK(device_send_message_disposition, TEST_device_send_message_disposition);
 }
 
 static void register_global_mock_returns()
@@ -1181,6 +1297,12 @@ static void register_global_mock_returns()
 
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
 
+    REGISTER_GLOBAL_MOCK_RETURN(hash_index_create, TEST_REGISTERED_DEVICES_INDEX);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(hash_index_create, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(hash_index_add, 0);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(hash_index_add, 1);
+    REGISTER_GLOBAL_MOCK_RETURN(hash_index_remove, 0);
+
     REGISTER_GLOBAL_MOCK_RETURN(device_start_async, 0);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(device_start_async, 1);
 
@@ -1232,6 +1354,11 @@ static void initialize_static_variables()
     TEST_device_create_saved_on_state_changed_context = NULL;
     TEST_device_create_return = TEST_DEVICE_HANDLE;
 
+    TEST_cbs_endpoint_enabled = false;
+    TEST_cbs_endpoint_device_count = 0;
+    TEST_cbs_endpoint_pending_put_token_count = 0;
+    TEST_cbs_endpoint_max_starting_devices = 0;
+
     saved_registered_devices_list_count = 0;
 
     TEST_device_subscribe_message_saved_callback = NULL;
@@ -1248,6 +1375,8 @@ static void initialize_test_variables()
     ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
 
     real_DList_InitializeListHead(&TEST_waitingToSend);
+
+    TEST_device_send_message_disposition_saved_source = NULL;
 }
 
 
@@ -1979,6 +2108,7 @@ TEST_FUNCTION(GetHostName_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_005: [If `config->upperConfig->protocolGatewayHostName` is NULL, `instance->iothub_target_fqdn` shall be set as `config->upperConfig->iotHubName` + "." + `config->upperConfig->iotHubSuffix`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_006: [If `config->upperConfig->protocolGatewayHostName` is not NULL, `instance->iothub_target_fqdn` shall be set with a copy of it]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_008: [`instance->registered_devices` shall be set using singlylinkedlist_create()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_156: [`instance->registered_devices_index` shall be set using hash_index_create()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_010: [`get_io_transport` shall be saved on `instance->underlying_io_transport_provider`]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_012: [If IoTHubTransport_AMQP_Common_Create succeeds it shall return a pointer to `instance`.]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_124: [`instance->connection_retry_control` shall be set using retry_control_create(), passing defaults EXPONENTIAL_BACKOFF_WITH_JITTER and 0]
@@ -2006,6 +2136,7 @@ TEST_FUNCTION(Create_success)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_004: [If malloc() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_007: [If `instance->iothub_target_fqdn` fails to be set, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_009: [If singlylinkedlist_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_157: [If hash_index_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_011: [If IoTHubTransport_AMQP_Common_Create fails it shall free any memory it allocated]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_125: [If retry_control_create() fails, IoTHubTransport_AMQP_Common_Create shall fail and return NULL]
 TEST_FUNCTION(Create_failure_checks)
@@ -2182,9 +2313,8 @@ TEST_FUNCTION(Register_device_already_registered)
 
     IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config->deviceId))
-        .IgnoreArgument(2)
-        .SetReturn(TEST_LIST_ITEM_HANDLE);
+    STRICT_EXPECTED_CALL(hash_index_find(TEST_REGISTERED_DEVICES_INDEX, device_config->deviceId))
+        .SetReturn((void*)TEST_LIST_ITEM_HANDLE);
 
     // act
     IOTHUB_DEVICE_HANDLE device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
@@ -2213,8 +2343,7 @@ TEST_FUNCTION(Register_CBS_transport_X509_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
+    STRICT_EXPECTED_CALL(hash_index_find(TEST_REGISTERED_DEVICES_INDEX, device_config2->deviceId))
         .SetReturn(NULL);
 
     // act
@@ -2245,8 +2374,7 @@ TEST_FUNCTION(Register_X509_transport_CBS_credentials)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(singlylinkedlist_find(TEST_REGISTERED_DEVICES_LIST, IGNORED_PTR_ARG, device_config2->deviceId))
-        .IgnoreArgument(2)
+    STRICT_EXPECTED_CALL(hash_index_find(TEST_REGISTERED_DEVICES_INDEX, device_config2->deviceId))
         .SetReturn(NULL);
 
     // act
@@ -2266,6 +2394,7 @@ TEST_FUNCTION(Register_X509_transport_CBS_credentials)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_073: [If device_create() fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_011: [ If `iothubtransportamqp_methods_create` fails, `IoTHubTransport_AMQP_Common_Register` shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_075: [If it fails to add `amqp_device_instance`, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_170: [If retry_control_create() fails, IoTHubTransport_AMQP_Common_Register shall fail and return NULL]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_077: [If IoTHubTransport_AMQP_Common_Register fails, it shall free all memory it allocated]
 TEST_FUNCTION(Register_failure_checks)
 {
@@ -2284,7 +2413,7 @@ TEST_FUNCTION(Register_failure_checks)
     size_t i, n = umock_c_negative_tests_call_count();
     for (i = 0; i < n; i++)
     {
-        if (i == 0 || i == 2 || i == 3 || i == 4 || i >= 6)
+        if (i == 0 || i == 2 || i == 3 || i == 4 || i >= 7)
         {
             // These expected calls do not cause the API to fail.
             continue;
@@ -2309,6 +2438,32 @@ TEST_FUNCTION(Register_failure_checks)
     destroy_transport(handle, NULL, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_159: [If hash_index_add() fails, IoTHubTransport_AMQP_Common_Register shall remove `amqp_device_instance` from `instance->registered_devices`, fail and return NULL]
+TEST_FUNCTION(Register_hash_index_add_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(hash_index_find(TEST_REGISTERED_DEVICES_INDEX, device_config->deviceId))
+        .SetReturn(NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(hash_index_add, 1);
+
+    // act
+    IOTHUB_DEVICE_HANDLE device_handle = IoTHubTransport_AMQP_Common_Register(handle, device_config, TEST_IOTHUB_CLIENT_LL_HANDLE, &TEST_waitingToSend);
+
+    // assert
+    ASSERT_IS_NULL(device_handle);
+    ASSERT_ARE_EQUAL(int, 0, saved_registered_devices_list_count);
+
+    // cleanup
+    REGISTER_GLOBAL_MOCK_RETURN(hash_index_add, 0);
+    destroy_transport(handle, NULL, NULL);
+}
+
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_066: [IoTHubTransport_AMQP_Common_Register shall allocate an instance of AMQP_TRANSPORT_DEVICE_STATE to store the state of the new registered device.]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_068: [IoTHubTransport_AMQP_Common_Register shall save the handle references to the IoTHubClient, transport, waitingToSend list on `amqp_device_instance`.]
@@ -2317,6 +2472,7 @@ TEST_FUNCTION(Register_failure_checks)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_072: [The configuration for device_create shall be set according to the authentication preferred by IOTHUB_DEVICE_CONFIG]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_010: [ `IoTHubTransport_AMQP_Common_Register` shall create a new iothubtransportamqp_methods instance by calling `iothubtransportamqp_methods_create` while passing to it the the fully qualified domain name and the device Id]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_074: [IoTHubTransport_AMQP_Common_Register shall add the `amqp_device_instance` to `instance->registered_devices`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_158: [IoTHubTransport_AMQP_Common_Register shall index the new `instance->registered_devices` item by device id using hash_index_add()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_076: [If the device is the first being registered on the transport, IoTHubTransport_AMQP_Common_Register shall save its authentication mode as the transport preferred authentication mode]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_078: [IoTHubTransport_AMQP_Common_Register shall return a handle to `amqp_device_instance` as a IOTHUB_DEVICE_HANDLE]
 TEST_FUNCTION(Register_succeeds)
@@ -2766,6 +2922,50 @@ TEST_FUNCTION(SetOption_device_specific_failure_check)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_102: [If `option` is a device-specific option, it shall be saved and applied to each registered device using device_set_option()]
+TEST_FUNCTION(SetOption_event_batch_options_succeed)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    size_t target_size = 65536;
+    size_t max_linger = 50;
+    size_t max_in_flight = 4;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG)).SetReturn(device_handle);
+    STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE, &target_size));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG)).SetReturn(device_handle);
+    STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, &max_linger));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG)).SetReturn(device_handle);
+    STRICT_EXPECTED_CALL(device_set_option(TEST_DEVICE_HANDLE, DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, &max_in_flight));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+    // act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_EVENT_BATCH_TARGET_SIZE, &target_size);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_EVENT_BATCH_MAX_LINGER_MS, &max_linger);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_EVENT_BATCH_MAX_IN_FLIGHT, &max_in_flight);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result3);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_02_007: [ If `option` is `x509certificate` and the transport preferred authentication method is not x509 then IoTHubTransport_AMQP_Common_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]
 TEST_FUNCTION(SetOption_CBS_transport_option_x509certificate)
 {
@@ -3765,6 +3965,7 @@ TEST_FUNCTION(Unregister_device_not_registered)
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_080: [if `deviceHandle` has a NULL reference to its transport instance, IoTHubTransport_AMQP_Common_Unregister shall return.] (NT)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_082: [`device_instance` shall be removed from `instance->registered_devices`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_160: [IoTHubTransport_AMQP_Common_Unregister shall remove the device id from `instance->registered_devices_index` using hash_index_remove()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_01_012: [IoTHubTransport_AMQP_Common_Unregister shall destroy the C2D methods handler by calling iothubtransportamqp_methods_destroy]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_083: [IoTHubTransport_AMQP_Common_Unregister shall free all the memory allocated for the `device_instance`]
 TEST_FUNCTION(Unregister_succeeds)
@@ -3893,6 +4094,7 @@ TEST_FUNCTION(on_message_received_fails)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_063: [If `registered_device->time_of_last_state_change` shall be set using get_time()]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_120: [If `new_state` is DEVICE_STATE_STARTED, IoTHubClient_LL_ConnectionStatusCallBack shall be invoked with IOTHUB_CLIENT_CONNECTION_AUTHENTICATED and IOTHUB_CLIENT_CONNECTION_OK]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_127: [If `new_state` is DEVICE_STATE_STARTED, retry_control_reset() shall be invoked passing `instance->connection_retry_control`]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_166: [If `new_state` is DEVICE_STATE_STARTED, retry_control_reset() shall be invoked passing `registered_device->retry_control`]
 TEST_FUNCTION(DoWork_success)
 {
     // arrange
@@ -3924,6 +4126,7 @@ TEST_FUNCTION(DoWork_success)
 
     STRICT_EXPECTED_CALL(get_time(NULL)).SetReturn(TEST_current_time);
     STRICT_EXPECTED_CALL(retry_control_reset(TEST_RETRY_CONTROL_HANDLE));
+    STRICT_EXPECTED_CALL(retry_control_reset(TEST_RETRY_CONTROL_HANDLE));
     STRICT_EXPECTED_CALL(IoTHubClient_LL_ConnectionStatusCallBack(TEST_IOTHUB_CLIENT_LL_HANDLE, IOTHUB_CLIENT_CONNECTION_AUTHENTICATED, IOTHUB_CLIENT_CONNECTION_OK));
 
     TEST_device_create_saved_on_state_changed_callback(TEST_device_create_saved_on_state_changed_context,
@@ -4119,6 +4322,407 @@ TEST_FUNCTION(DoWork_configures_AMQP_connection_using_c2d_keep_alive_freq_secs)
     destroy_transport(handle, device_handle, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_154: [`instance->session_incoming_window` and `instance->session_outgoing_window` shall be set into AMQP_CONNECTION_CONFIG]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_155: [If `option` is `amqp_session_incoming_window` or `amqp_session_outgoing_window`, `value` shall be saved and used when the AMQP connection is next established]
+TEST_FUNCTION(DoWork_configures_AMQP_connection_using_session_windows)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    const char* certificate = TEST_X509_CERTIFICATE;
+    const char* private_key = TEST_X509_PRIVATE_KEY;
+    size_t incoming_window = 5000;
+    size_t outgoing_window = 2000;
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_X509_CERT, certificate);
+    (void)IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_X509_PRIVATE_KEY, private_key);
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_INCOMING_WINDOW, &incoming_window);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_SESSION_OUTGOING_WINDOW, &outgoing_window);
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config_for_x509(TEST_DEVICE_ID_CHAR_PTR);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, false);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, true, false, false, 1, TEST_current_time, false);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result1);
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, incoming_window, TEST_amqp_connection_create_saved_session_incoming_window);
+    ASSERT_ARE_EQUAL(size_t, outgoing_window, TEST_amqp_connection_create_saved_session_outgoing_window);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_161: [If `instance->max_concurrent_authentications` is not zero and as many registered devices are in DEVICE_STATE_STARTING, the device shall not be started on this DoWork]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_162: [If `option` is `amqp_max_concurrent_authentications`, `value` shall be saved into `instance->max_concurrent_authentications`]
+TEST_FUNCTION(DoWork_limits_concurrent_authentications)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    size_t max_concurrent_authentications = 1;
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_MAX_CONCURRENT_AUTHENTICATIONS, &max_concurrent_authentications);
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ON_DEVICE_STATE_CHANGED device1_on_state_changed_callback = TEST_device_create_saved_on_state_changed_callback;
+    void* device1_on_state_changed_context = TEST_device_create_saved_on_state_changed_context;
+
+    device_config = create_device_config(TEST_DEVICE_ID_2_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle2 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NOT_NULL(device_handle2);
+
+    crank_transport(handle, &TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 2, TEST_current_time, false);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    // The first device takes the only place available.
+    device1_on_state_changed_callback(device1_on_state_changed_context, DEVICE_STATE_STOPPED, DEVICE_STATE_STARTING);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTING, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Once the first device is started, the second one can start.
+    device1_on_state_changed_callback(device1_on_state_changed_context, DEVICE_STATE_STARTING, DEVICE_STATE_STARTED);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, device_handle2);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_021: [If DoWork fails for the registered device for more than MAX_NUMBER_OF_DEVICE_FAILURES, the device shall be considered failed]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_165: [Otherwise, each failed device shall be stopped using device_stop() and have its failure counters reset, without affecting the other registered devices or the connection]
+TEST_FUNCTION(DoWork_failed_device_is_reset_without_connection_retry)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ON_DEVICE_STATE_CHANGED device1_on_state_changed_callback = TEST_device_create_saved_on_state_changed_callback;
+    void* device1_on_state_changed_context = TEST_device_create_saved_on_state_changed_context;
+
+    device_config = create_device_config(TEST_DEVICE_ID_2_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle2 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NOT_NULL(device_handle2);
+
+    crank_transport(handle, &TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 2, TEST_current_time, false);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    device1_on_state_changed_callback(device1_on_state_changed_context, DEVICE_STATE_STOPPED, DEVICE_STATE_ERROR_AUTH);
+    TEST_device_create_saved_on_state_changed_callback(TEST_device_create_saved_on_state_changed_context, DEVICE_STATE_STOPPED, DEVICE_STATE_STARTED);
+
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        umock_c_reset_all_calls();
+        IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    }
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+    // reset_failed_devices
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+    set_expected_calls_for_prepare_device_for_connection_retry(DEVICE_STATE_ERROR_AUTH);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // The connection is kept; both devices keep being processed on the next DoWork.
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+    STRICT_EXPECTED_CALL(device_stop(TEST_DEVICE_HANDLE));
+    STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, device_handle2);
+}
+
+static void fail_and_stop_device(TRANSPORT_LL_HANDLE handle, ON_DEVICE_STATE_CHANGED on_state_changed_callback, void* on_state_changed_context)
+{
+    on_state_changed_callback(on_state_changed_context, DEVICE_STATE_STOPPED, DEVICE_STATE_ERROR_AUTH);
+
+    // The device fails MAX_NUMBER_OF_DEVICE_FAILURES times in a row, then is reset by the transport.
+    int i;
+    for (i = 0; i < 5; i++)
+    {
+        umock_c_reset_all_calls();
+        IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    }
+
+    on_state_changed_callback(on_state_changed_context, DEVICE_STATE_ERROR_AUTH, DEVICE_STATE_STOPPED);
+}
+
+static void set_expected_calls_for_DoWork_with_failed_device(RETRY_ACTION* retry_action)
+{
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+
+    if (retry_action != NULL)
+    {
+        STRICT_EXPECTED_CALL(retry_control_should_retry(TEST_RETRY_CONTROL_HANDLE, IGNORED_PTR_ARG))
+            .CopyOutArgumentBuffer_retry_action(retry_action, sizeof(RETRY_ACTION));
+    }
+
+    if (retry_action != NULL && *retry_action == RETRY_ACTION_RETRY_NOW)
+    {
+        set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, true, TEST_current_time, false);
+    }
+    else
+    {
+        if (retry_action != NULL && *retry_action == RETRY_ACTION_STOP_RETRYING)
+        {
+            STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+                .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+            STRICT_EXPECTED_CALL(IoTHubClient_LL_ConnectionStatusCallBack(TEST_IOTHUB_CLIENT_LL_HANDLE, IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED, IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED));
+        }
+
+        STRICT_EXPECTED_CALL(device_do_work(TEST_DEVICE_HANDLE));
+    }
+
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    set_expected_calls_for_Device_DoWork(&TEST_waitingToSend, 0, DEVICE_STATE_STARTED, true, TEST_current_time, false);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(amqp_connection_do_work(TEST_AMQP_CONNECTION_HANDLE));
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_167: [If the device was stopped by the transport after failing, it shall be started only if retry_control_should_retry() on `registered_device->retry_control` returns RETRY_ACTION_RETRY_NOW, or if it fails]
+TEST_FUNCTION(DoWork_failed_device_restart_backs_off)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ON_DEVICE_STATE_CHANGED device1_on_state_changed_callback = TEST_device_create_saved_on_state_changed_callback;
+    void* device1_on_state_changed_context = TEST_device_create_saved_on_state_changed_context;
+
+    device_config = create_device_config(TEST_DEVICE_ID_2_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle2 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NOT_NULL(device_handle2);
+
+    crank_transport(handle, &TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 2, TEST_current_time, false);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+    TEST_device_create_saved_on_state_changed_callback(TEST_device_create_saved_on_state_changed_context, DEVICE_STATE_STOPPED, DEVICE_STATE_STARTED);
+
+    fail_and_stop_device(handle, device1_on_state_changed_callback, device1_on_state_changed_context);
+
+    RETRY_ACTION retry_later = RETRY_ACTION_RETRY_LATER;
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork_with_failed_device(&retry_later);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // Once the wait time has elapsed the device is started again.
+    RETRY_ACTION retry_now = RETRY_ACTION_RETRY_NOW;
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork_with_failed_device(&retry_now);
+
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, device_handle2);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_168: [If retry_control_should_retry() returns RETRY_ACTION_STOP_RETRYING, IoTHubClient_LL_ConnectionStatusCallBack shall be invoked once for the device with IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED and IOTHUB_CLIENT_CONNECTION_RETRY_EXPIRED, and the device shall not be restarted]
+TEST_FUNCTION(DoWork_failed_device_restart_retry_expired)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle1 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ON_DEVICE_STATE_CHANGED device1_on_state_changed_callback = TEST_device_create_saved_on_state_changed_callback;
+    void* device1_on_state_changed_context = TEST_device_create_saved_on_state_changed_context;
+
+    device_config = create_device_config(TEST_DEVICE_ID_2_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle2 = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle1);
+    ASSERT_IS_NOT_NULL(device_handle2);
+
+    crank_transport(handle, &TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, 2, TEST_current_time, false);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+    TEST_device_create_saved_on_state_changed_callback(TEST_device_create_saved_on_state_changed_context, DEVICE_STATE_STOPPED, DEVICE_STATE_STARTED);
+
+    fail_and_stop_device(handle, device1_on_state_changed_callback, device1_on_state_changed_context);
+
+    RETRY_ACTION stop_retrying = RETRY_ACTION_STOP_RETRYING;
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork_with_failed_device(&stop_retrying);
+
+    // act
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // The expiry is reported only once, and the device is not restarted.
+    umock_c_reset_all_calls();
+    set_expected_calls_for_DoWork_with_failed_device(NULL);
+
+    IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    // cleanup
+    destroy_transport(handle, device_handle1, device_handle2);
+}
+
+#define TEST_NUMBER_OF_AUTHENTICATING_DEVICES 10
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_161: [If `instance->max_concurrent_authentications` is not zero and as many registered devices are in DEVICE_STATE_STARTING, the device shall not be started on this DoWork]
+TEST_FUNCTION(DoWork_with_max_concurrent_authentications_starts_all_devices_through_the_CBS_endpoint)
+{
+    // arrange
+    size_t max_concurrent_authentications = 3;
+    IOTHUB_DEVICE_HANDLE device_handles[TEST_NUMBER_OF_AUTHENTICATING_DEVICES];
+    size_t number_of_started_devices = 0;
+    size_t number_of_do_works;
+    size_t i;
+
+    initialize_test_variables();
+    TEST_cbs_endpoint_enabled = true;
+    TRANSPORT_LL_HANDLE handle = create_transport();
+    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SetOption(handle, OPTION_AMQP_MAX_CONCURRENT_AUTHENTICATIONS, &max_concurrent_authentications);
+
+    for (i = 0; i < TEST_NUMBER_OF_AUTHENTICATING_DEVICES; i++)
+    {
+        char device_id[32];
+        (void)sprintf(device_id, "%s%lu", TEST_DEVICE_ID_CHAR_PTR, (unsigned long)i);
+        device_handles[i] = register_device(handle, create_device_config(device_id, true), &TEST_waitingToSend, true);
+        ASSERT_IS_NOT_NULL(device_handles[i]);
+    }
+
+    crank_transport(handle, &TEST_waitingToSend, 0, DEVICE_STATE_STOPPED, false, true, false, false, TEST_NUMBER_OF_AUTHENTICATING_DEVICES, TEST_current_time, false);
+    TEST_amqp_connection_create_saved_on_state_changed_callback(
+        TEST_amqp_connection_create_saved_on_state_changed_context,
+        AMQP_CONNECTION_STATE_CLOSED, AMQP_CONNECTION_STATE_OPENED);
+
+    // act
+    for (number_of_do_works = 0; number_of_started_devices < TEST_NUMBER_OF_AUTHENTICATING_DEVICES && number_of_do_works < 10 * TEST_NUMBER_OF_AUTHENTICATING_DEVICES; number_of_do_works++)
+    {
+        umock_c_reset_all_calls();
+        IoTHubTransport_AMQP_Common_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+        number_of_started_devices = 0;
+        for (i = 0; i < TEST_cbs_endpoint_device_count; i++)
+        {
+            if (TEST_cbs_endpoint_devices[i].state == DEVICE_STATE_STARTED)
+            {
+                number_of_started_devices++;
+            }
+        }
+    }
+
+    // assert
+    ASSERT_ARE_EQUAL(int, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, TEST_NUMBER_OF_AUTHENTICATING_DEVICES, TEST_cbs_endpoint_device_count);
+    ASSERT_ARE_EQUAL(size_t, TEST_NUMBER_OF_AUTHENTICATING_DEVICES, number_of_started_devices);
+    ASSERT_ARE_EQUAL(size_t, max_concurrent_authentications, TEST_cbs_endpoint_max_starting_devices);
+    for (i = 0; i < TEST_NUMBER_OF_AUTHENTICATING_DEVICES; i++)
+    {
+        ASSERT_ARE_EQUAL(size_t, 1, TEST_cbs_endpoint_devices[i].number_of_starts);
+    }
+
+    // cleanup
+    for (i = 0; i < TEST_NUMBER_OF_AUTHENTICATING_DEVICES; i++)
+    {
+        umock_c_reset_all_calls();
+        set_expected_calls_for_Unregister(device_handles[i]);
+        IoTHubTransport_AMQP_Common_Unregister(device_handles[i]);
+    }
+    destroy_transport(handle, NULL, NULL);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_121: [If `new_state` is DEVICE_STATE_STOPPED, IoTHubClient_LL_ConnectionStatusCallBack shall be invoked with IOTHUB_CLIENT_CONNECTION_UNAUTHENTICATED and IOTHUB_CLIENT_CONNECTION_OK]
 TEST_FUNCTION(ConnectionStatusCallBack_UNAUTH_OK)
 {
@@ -4309,8 +4913,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_NULL_CONTEXT_fa
 }
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_10_004: [IoTHubTransport_AMQP_Common_SendMessageDisposition shall convert the given IOTHUBMESSAGE_DISPOSITION_RESULT to the equivalent DEVICE_MESSAGE_DISPOSITION_RESULT and send it via device_send_message_disposition.]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_112: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `link_name` and `message_id` contained in `message_data`]  
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_114: [`IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall destroy the DEVICE_MESSAGE_DISPOSITION_INFO instance]  
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_112: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be populated with the `link_name` and `message_id` contained in `message_data`, without copying `link_name`]  
 TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ACCEPTED_succeeds)
 {
     // arrange
@@ -4325,6 +4928,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ACCEPTED_succee
     memset(data, 0, sizeof(MESSAGE_CALLBACK_INFO));
     data->messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
     data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
+    const char* link_name = data->transportContext->link_name;
 
     umock_c_reset_all_calls();
     set_expected_calls_for_SendMessageDisposition(IOTHUBMESSAGE_ACCEPTED);
@@ -4335,6 +4939,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ACCEPTED_succee
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)link_name, (void*)TEST_device_send_message_disposition_saved_source);
 
     // cleanup
     destroy_transport(handle, device_handle, NULL);
@@ -4357,49 +4962,11 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ACCEPTED_fails)
     data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED))
         .IgnoreArgument(2)
         .SetReturn(1);
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_destroy_device_message_disposition_info();
-    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
-
-    // act
-    IOTHUB_CLIENT_RESULT result = IoTHubTransport_AMQP_Common_SendMessageDisposition(data, IOTHUBMESSAGE_ACCEPTED);
-
-    // assert
-    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
-    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
-
-    // cleanup
-    destroy_transport(handle, device_handle, NULL);
-}
-
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_113: [If the DEVICE_MESSAGE_DISPOSITION_INFO fails to be created, `IoTHubTransport_AMQP_Common_SendMessageDisposition()` shall fail and return IOTHUB_CLIENT_ERROR]
-TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_DEVICE_MESSAGE_DISPOSITION_INFO_create_fails)
-{
-    // arrange
-    initialize_test_variables();
-    TRANSPORT_LL_HANDLE handle = create_transport();
-
-    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, false);
-    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
-    ASSERT_IS_NOT_NULL(device_handle);
-
-    MESSAGE_CALLBACK_INFO* data = (MESSAGE_CALLBACK_INFO*)malloc(sizeof(MESSAGE_CALLBACK_INFO));
-    memset(data, 0, sizeof(MESSAGE_CALLBACK_INFO));
-    data->messageHandle = TEST_IOTHUB_MESSAGE_HANDLE;
-    data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
-
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)))
-        .SetReturn(NULL);
-    EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
-        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
@@ -4462,13 +5029,11 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_ABANDONED_fails
     data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED))
         .IgnoreArgument(2)
         .SetReturn(1);
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_destroy_device_message_disposition_info();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
@@ -4531,13 +5096,11 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SendMessageDisposition_REJECTED_fails)
     data->transportContext = TRANSPORT_CONTEXT_DATA_create2(device_handle);
 
     umock_c_reset_all_calls();
-    set_expected_calls_for_create_device_message_disposition_info();
     STRICT_EXPECTED_CALL(device_send_message_disposition(TEST_DEVICE_HANDLE, IGNORED_PTR_ARG, DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED))
         .IgnoreArgument(2)
         .SetReturn(1);
     EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG))
         .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
-    set_expected_calls_for_destroy_device_message_disposition_info();
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(free(IGNORED_PTR_ARG));
@@ -4617,6 +5180,7 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetRetryPolicy_success)
     umock_c_reset_all_calls();
     STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600));
     STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
 
     // act
     int result = IoTHubTransport_AMQP_Common_SetRetryPolicy(handle, IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600);
@@ -4629,4 +5193,68 @@ TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetRetryPolicy_success)
     destroy_transport(handle, NULL, NULL);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_171: [`registered_device->retry_control` of each registered device shall be replaced using retry_control_create(), passing `retryPolicy` and `retryTimeoutLimitInSeconds`.]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetRetryPolicy_registered_devices_success)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600));
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600));
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+    // act
+    int result = IoTHubTransport_AMQP_Common_SetRetryPolicy(handle, IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_COMMON_09_172: [If retry_control_create() fails for a registered device, the device shall keep its previous retry control and `IoTHubTransport_AMQP_Common_SetRetryPolicy` shall return non-zero.]
+TEST_FUNCTION(IoTHubTransport_AMQP_Common_SetRetryPolicy_registered_device_retry_control_create_fails)
+{
+    // arrange
+    initialize_test_variables();
+    TRANSPORT_LL_HANDLE handle = create_transport();
+
+    IOTHUB_DEVICE_CONFIG* device_config = create_device_config(TEST_DEVICE_ID_CHAR_PTR, true);
+    IOTHUB_DEVICE_HANDLE device_handle = register_device(handle, device_config, &TEST_waitingToSend, true);
+    ASSERT_IS_NOT_NULL(device_handle);
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600));
+    STRICT_EXPECTED_CALL(retry_control_destroy(TEST_RETRY_CONTROL_HANDLE));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(TEST_REGISTERED_DEVICES_LIST));
+    EXPECTED_CALL(singlylinkedlist_item_get_value(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(retry_control_create(IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_DEVICE_ID_STRING_HANDLE))
+        .SetReturn(TEST_DEVICE_ID_CHAR_PTR);
+    EXPECTED_CALL(singlylinkedlist_get_next_item(IGNORED_PTR_ARG));
+
+    // act
+    int result = IoTHubTransport_AMQP_Common_SetRetryPolicy(handle, IOTHUB_CLIENT_RETRY_IMMEDIATE, 1600);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+
+    // cleanup
+    destroy_transport(handle, device_handle, NULL);
+}
+
 END_TEST_SUITE(iothubtransport_amqp_common_ut)
@@ -162,6 +162,8 @@ static AMQP_CONNECTION_CONFIG* get_amqp_connection_config()
 	global_amqp_connection_config.create_cbs_connection = true;
 	global_amqp_connection_config.is_trace_on = true;
     global_amqp_connection_config.c2d_keep_alive_freq_secs = 123;
+    global_amqp_connection_config.session_incoming_window = 0;
+    global_amqp_connection_config.session_outgoing_window = 0;
 
 	return &global_amqp_connection_config;
 }
@@ -214,8 +216,10 @@ static void set_exp_calls_for_amqp_connection_create(AMQP_CONNECTION_CONFIG* amq
 
 	// Session
 	STRICT_EXPECTED_CALL(session_create(TEST_CONNECTION_HANDLE, NULL, NULL));
-	STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_SESSION_HANDLE, (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE));
-	STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_SESSION_HANDLE, (uint32_t)DEFAULT_OUTGOING_WINDOW_SIZE));
+	STRICT_EXPECTED_CALL(session_set_incoming_window(TEST_SESSION_HANDLE,
+		amqp_connection_config->session_incoming_window == 0 ? (uint32_t)DEFAULT_INCOMING_WINDOW_SIZE : (uint32_t)amqp_connection_config->session_incoming_window));
+	STRICT_EXPECTED_CALL(session_set_outgoing_window(TEST_SESSION_HANDLE,
+		amqp_connection_config->session_outgoing_window == 0 ? (uint32_t)DEFAULT_OUTGOING_WINDOW_SIZE : (uint32_t)amqp_connection_config->session_outgoing_window));
 
 	// CBS
 	if (amqp_connection_config->create_cbs_connection)
@@ -432,8 +436,8 @@ TEST_FUNCTION(amqp_connection_create_NULL_underlying_io_transport)
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_023: [The connection tracing shall be set using connection_set_trace(), passing `instance->is_trace_on`]
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_024: [`instance->session_handle` shall be created using session_create(), passing `instance->connection_handle`]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_026: [The `instance->session_handle` incoming window size shall be set as UINT_MAX using session_set_incoming_window()]
-// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_027: [The `instance->session_handle` outgoing window size shall be set as 100 using session_set_outgoing_window()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_026: [The `instance->session_handle` incoming window size shall be set as `instance->session_incoming_window` using session_set_incoming_window()]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_027: [The `instance->session_handle` outgoing window size shall be set as `instance->session_outgoing_window` using session_set_outgoing_window()]
 
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_028: [Only if `config->create_cbs_connection` is true, amqp_connection_create() shall create and open the CBS_HANDLE]
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_029: [`instance->cbs_handle` shall be created using cbs_create()`]
@@ -459,6 +463,29 @@ TEST_FUNCTION(amqp_connection_create_SASL_and_CBS_success)
 	amqp_connection_destroy(handle);
 }
 
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_075: [`config->session_incoming_window` shall be saved on `instance->session_incoming_window`, or UINT_MAX if zero]
+// Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_076: [`config->session_outgoing_window` shall be saved on `instance->session_outgoing_window`, or 100 if zero]
+TEST_FUNCTION(amqp_connection_create_custom_session_windows_success)
+{
+    // arrange
+	AMQP_CONNECTION_CONFIG* config = get_amqp_connection_config();
+	config->session_incoming_window = 5000;
+	config->session_outgoing_window = 2000;
+
+	umock_c_reset_all_calls();
+	set_exp_calls_for_amqp_connection_create(config);
+
+    // act
+	AMQP_CONNECTION_HANDLE handle = amqp_connection_create(config);
+
+    // assert
+	ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+	ASSERT_IS_NOT_NULL(handle);
+
+    // cleanup
+	amqp_connection_destroy(handle);
+}
+
 // Tests_SRS_IOTHUBTRANSPORT_AMQP_CONNECTION_09_028: [Only if `config->create_cbs_connection` is true, amqp_connection_create() shall create and open the CBS_HANDLE]
 TEST_FUNCTION(amqp_connection_create_SASL_only_success)
 {
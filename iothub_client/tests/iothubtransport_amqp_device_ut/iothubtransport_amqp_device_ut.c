@@ -180,6 +180,17 @@ static int TEST_telemetry_messenger_subscribe_for_messages(TELEMETRY_MESSENGER_H
     return TEST_telemetry_messenger_subscribe_for_messages_return;
 }
 
+static const char* TEST_telemetry_messenger_send_message_disposition_saved_source;
+static int TEST_telemetry_messenger_send_message_disposition_return;
+static int TEST_telemetry_messenger_send_message_disposition(TELEMETRY_MESSENGER_HANDLE messenger_handle, TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO* disposition_info, TELEMETRY_MESSENGER_DISPOSITION_RESULT disposition_result)
+{
+    (void)messenger_handle;
+    (void)disposition_result;
+    TEST_telemetry_messenger_send_message_disposition_saved_source = disposition_info->source;
+
+    return TEST_telemetry_messenger_send_message_disposition_return;
+}
+
 static double TEST_get_difftime(time_t end_time, time_t start_time)
 {
     return difftime(end_time, start_time);
@@ -246,12 +257,16 @@ static void TEST_on_state_changed_callback(void* context, DEVICE_STATE previous_
 
 static IOTHUB_MESSAGE_HANDLE TEST_on_message_received_saved_message;
 static DEVICE_MESSAGE_DISPOSITION_INFO* TEST_on_message_received_saved_disposition_info;
+static const char* TEST_on_message_received_saved_disposition_info_source;
+static unsigned long TEST_on_message_received_saved_disposition_info_message_id;
 static void* TEST_on_message_received_saved_context;
 static DEVICE_MESSAGE_DISPOSITION_RESULT TEST_on_message_received_return;
 static DEVICE_MESSAGE_DISPOSITION_RESULT TEST_on_message_received(IOTHUB_MESSAGE_HANDLE message, DEVICE_MESSAGE_DISPOSITION_INFO* disposition_info, void* context)
 {
     TEST_on_message_received_saved_message = message;
     TEST_on_message_received_saved_disposition_info = disposition_info;
+    TEST_on_message_received_saved_disposition_info_source = disposition_info->source;
+    TEST_on_message_received_saved_disposition_info_message_id = disposition_info->message_id;
     TEST_on_message_received_saved_context = context;
 
     return TEST_on_message_received_return;
@@ -298,6 +313,8 @@ static void initialize_test_variables()
 
     TEST_on_message_received_saved_message = NULL;
     TEST_on_message_received_saved_disposition_info = NULL;
+    TEST_on_message_received_saved_disposition_info_source = NULL;
+    TEST_on_message_received_saved_disposition_info_message_id = 0;
     TEST_on_message_received_saved_context = NULL;
     TEST_on_message_received_return = DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED;
 
@@ -306,6 +323,9 @@ static void initialize_test_variables()
     TEST_telemetry_messenger_subscribe_for_messages_saved_context = NULL;
     TEST_telemetry_messenger_subscribe_for_messages_return = 0;
 
+    TEST_telemetry_messenger_send_message_disposition_saved_source = NULL;
+    TEST_telemetry_messenger_send_message_disposition_return = 0;
+
     TEST_authentication_create_saved_on_authentication_changed_callback = NULL;
     TEST_authentication_create_saved_on_authentication_changed_context = NULL;
     TEST_authentication_create_saved_on_error_callback = NULL;
@@ -369,6 +389,7 @@ static void register_global_mock_hooks()
     REGISTER_GLOBAL_MOCK_HOOK(free, TEST_free);
     REGISTER_GLOBAL_MOCK_HOOK(mallocAndStrcpy_s, TEST_mallocAndStrcpy_s);
     REGISTER_GLOBAL_MOCK_HOOK(telemetry_messenger_subscribe_for_messages, TEST_telemetry_messenger_subscribe_for_messages);
+    REGISTER_GLOBAL_MOCK_HOOK(telemetry_messenger_send_message_disposition, TEST_telemetry_messenger_send_message_disposition);
     REGISTER_GLOBAL_MOCK_HOOK(get_difftime, TEST_get_difftime);
     REGISTER_GLOBAL_MOCK_HOOK(authentication_create, TEST_authentication_create);
 	REGISTER_GLOBAL_MOCK_HOOK(telemetry_messenger_create, TEST_telemetry_messenger_create);
@@ -1790,6 +1811,38 @@ TEST_FUNCTION(device_set_option_MSGR_succeeds)
     device_destroy(handle);
 }
 
+// Tests_SRS_DEVICE_09_086: [If `name` refers to messenger module, it shall be passed along with `value` to telemetry_messenger_set_option]
+// Tests_SRS_DEVICE_09_152: [`name` shall be translated to the corresponding MESSENGER_OPTION_* name before being passed to telemetry_messenger_set_option]
+TEST_FUNCTION(device_set_option_MSGR_event_batch_options_succeed)
+{
+    // arrange
+    ASSERT_IS_TRUE_WITH_MSG(INDEFINITE_TIME != TEST_current_time, "Failed setting TEST_current_time");
+
+    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
+    DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
+
+    size_t value = 400;
+
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, MESSENGER_OPTION_EVENT_BATCH_TARGET_SIZE, &value));
+    STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, MESSENGER_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, &value));
+    STRICT_EXPECTED_CALL(telemetry_messenger_set_option(TEST_TELEMETRY_MESSENGER_HANDLE, MESSENGER_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, &value));
+
+    // act
+    int result1 = device_set_option(handle, DEVICE_OPTION_EVENT_BATCH_TARGET_SIZE, &value);
+    int result2 = device_set_option(handle, DEVICE_OPTION_EVENT_BATCH_MAX_LINGER_MSECS, &value);
+    int result3 = device_set_option(handle, DEVICE_OPTION_EVENT_BATCH_MAX_IN_FLIGHT, &value);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result1);
+    ASSERT_ARE_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(int, 0, result3);
+
+    // cleanup
+    device_destroy(handle);
+}
+
 // Tests_SRS_DEVICE_09_088: [If `name` is DEVICE_OPTION_SAVED_AUTH_OPTIONS but CBS authentication is not being used, device_set_option shall return a non-zero result]
 TEST_FUNCTION(device_set_option_X509_saved_auth_options)
 {
@@ -2571,8 +2624,7 @@ TEST_FUNCTION(on_messenger_message_received_callback_NULL_context)
 // Tests_SRS_DEVICE_09_072: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED]
 // Tests_SRS_DEVICE_09_073: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_REJECTED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_REJECTED]
 // Tests_SRS_DEVICE_09_074: [If the user callback returns DEVICE_MESSAGE_DISPOSITION_RESULT_RELEASED, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-// Tests_SRS_DEVICE_09_119: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be created containing a copy of `disposition_info->source` and `disposition_info->message_id`]
-// Tests_SRS_DEVICE_09_121: [on_messenger_message_received_callback shall release the memory allocated for DEVICE_MESSAGE_DISPOSITION_INFO]
+// Tests_SRS_DEVICE_09_119: [A DEVICE_MESSAGE_DISPOSITION_INFO instance shall be populated with `disposition_info->source` and `disposition_info->message_id`, without copying `source`]
 TEST_FUNCTION(on_messenger_message_received_callback_succeess)
 {
     // arrange
@@ -2613,10 +2665,6 @@ TEST_FUNCTION(on_messenger_message_received_callback_succeess)
         disposition_info.message_id = TEST_MESSAGE_ID;
 
         umock_c_reset_all_calls();
-        STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)));
-        EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
-        EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
         TELEMETRY_MESSENGER_DISPOSITION_RESULT result = TEST_telemetry_messenger_subscribe_for_messages_saved_on_message_received_callback(
             TEST_IOTHUB_MESSAGE_HANDLE,
@@ -2626,75 +2674,16 @@ TEST_FUNCTION(on_messenger_message_received_callback_succeess)
         // assert
         ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
         ASSERT_ARE_EQUAL(int, messenger_results[i], result);
+        ASSERT_ARE_EQUAL(void_ptr, (void*)disposition_info.source, (void*)TEST_on_message_received_saved_disposition_info_source);
+        ASSERT_ARE_EQUAL(int, (int)TEST_MESSAGE_ID, (int)TEST_on_message_received_saved_disposition_info_message_id);
     }
 
     // cleanup
     device_destroy(handle);
 }
 
-// Tests_SRS_DEVICE_09_120: [If the DEVICE_MESSAGE_DISPOSITION_INFO instance fails to be created, on_messenger_message_received_callback shall return TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED]
-TEST_FUNCTION(on_messenger_message_received_callback_failure_checks)
-{
-    // arrange
-    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
-
-    DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
-    DEVICE_HANDLE handle = create_and_start_and_crank_device(config, TEST_current_time);
-
-    umock_c_reset_all_calls();
-    TEST_telemetry_messenger_subscribe_for_messages_return = 0;
-    STRICT_EXPECTED_CALL(telemetry_messenger_subscribe_for_messages(TEST_TELEMETRY_MESSENGER_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .IgnoreArgument(2)
-        .IgnoreArgument(3);
-
-    (void)device_subscribe_message(handle, TEST_on_message_received, handle);
-    ASSERT_IS_NOT_NULL(TEST_telemetry_messenger_subscribe_for_messages_saved_on_message_received_callback);
-
-    TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO disposition_info;
-    disposition_info.source = TEST_MESSAGE_SOURCE_NAME_CHAR_PTR;
-    disposition_info.message_id = TEST_MESSAGE_ID;
-
-    umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(DEVICE_MESSAGE_DISPOSITION_INFO)));
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    umock_c_negative_tests_snapshot();
-
-    // act
-    size_t i;
-    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
-    {
-        if (i == 2 || i == 3)
-        {
-            // These expected calls do not cause the API to fail.
-            continue;
-        }
-
-        // arrange
-        char error_msg[64];
-
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(i);
-
-        TELEMETRY_MESSENGER_DISPOSITION_RESULT result = TEST_telemetry_messenger_subscribe_for_messages_saved_on_message_received_callback(
-            TEST_IOTHUB_MESSAGE_HANDLE,
-            &disposition_info,
-            TEST_telemetry_messenger_subscribe_for_messages_saved_context);
-
-        // assert
-        sprintf(error_msg, "On failed call %zu", i);
-        ASSERT_ARE_EQUAL_WITH_MSG(int, TELEMETRY_MESSENGER_DISPOSITION_RESULT_RELEASED, result, error_msg);
-    }
-
-    // cleanup
-    device_destroy(handle);
-    umock_c_negative_tests_deinit();
-}
-
-// Tests_SRS_DEVICE_09_113: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be created with a copy of the `source` and `message_id` contained in `disposition_info`]  
+// Tests_SRS_DEVICE_09_113: [A TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance shall be populated with the `source` and `message_id` contained in `disposition_info`, without copying `source`]  
 // Tests_SRS_DEVICE_09_115: [`telemetry_messenger_send_message_disposition()` shall be invoked passing the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance and the corresponding TELEMETRY_MESSENGER_DISPOSITION_RESULT]  
-// Tests_SRS_DEVICE_09_117: [device_send_message_disposition() shall destroy the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO instance]  
 // Tests_SRS_DEVICE_09_118: [If no failures occurr, device_send_message_disposition() shall return 0]  
 TEST_FUNCTION(device_send_message_disposition_succeess)
 {
@@ -2707,12 +2696,8 @@ TEST_FUNCTION(device_send_message_disposition_succeess)
     disposition_info.message_id = TEST_MESSAGE_ID;
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)));
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(telemetry_messenger_send_message_disposition(TEST_TELEMETRY_MESSENGER_HANDLE, IGNORED_PTR_ARG, TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED))
         .IgnoreArgument(2);
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
 
     // act
     int result = device_send_message_disposition(handle, &disposition_info, DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED);
@@ -2720,6 +2705,7 @@ TEST_FUNCTION(device_send_message_disposition_succeess)
     // assert
     ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
     ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(void_ptr, (void*)disposition_info.source, (void*)TEST_telemetry_messenger_send_message_disposition_saved_source);
 
     // cleanup
     device_destroy(handle);
@@ -2789,13 +2775,10 @@ TEST_FUNCTION(device_send_message_NULL_disposition_info_source)
     device_destroy(handle);
 }
 
-// Tests_SRS_DEVICE_09_114: [If the TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO fails to be created, device_send_message_disposition() shall fail and return __FAILURE__]  
 // Tests_SRS_DEVICE_09_116: [If `telemetry_messenger_send_message_disposition()` fails, device_send_message_disposition() shall fail and return __FAILURE__]  
-TEST_FUNCTION(device_send_message_disposition_failure_checks)
+TEST_FUNCTION(device_send_message_disposition_telemetry_messenger_send_message_disposition_fails)
 {
     // arrange
-    ASSERT_ARE_EQUAL(int, 0, umock_c_negative_tests_init());
-
     DEVICE_CONFIG* config = get_device_config(DEVICE_AUTH_MODE_CBS);
     DEVICE_HANDLE handle = create_and_start_device(config, TEST_current_time);
 
@@ -2804,40 +2787,19 @@ TEST_FUNCTION(device_send_message_disposition_failure_checks)
     disposition_info.message_id = TEST_MESSAGE_ID;
 
     umock_c_reset_all_calls();
-    STRICT_EXPECTED_CALL(malloc(sizeof(TELEMETRY_MESSENGER_MESSAGE_DISPOSITION_INFO)));
-    EXPECTED_CALL(mallocAndStrcpy_s(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    TEST_telemetry_messenger_send_message_disposition_return = 1;
     STRICT_EXPECTED_CALL(telemetry_messenger_send_message_disposition(TEST_TELEMETRY_MESSENGER_HANDLE, IGNORED_PTR_ARG, TELEMETRY_MESSENGER_DISPOSITION_RESULT_ACCEPTED))
         .IgnoreArgument(2);
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    EXPECTED_CALL(free(IGNORED_PTR_ARG));
-    umock_c_negative_tests_snapshot();
 
     // act
-    size_t i;
-    for (i = 0; i < umock_c_negative_tests_call_count(); i++)
-    {
-        if (i == 3 || i == 4)
-        {
-            continue;
-        }
-
-        // arrange
-        char error_msg[64];
-
-        umock_c_negative_tests_reset();
-        umock_c_negative_tests_fail_call(i);
-
-        int result = device_send_message_disposition(handle, &disposition_info, DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED);
-
-        // assert
-        sprintf(error_msg, "On failed call %zu", i);
-        ASSERT_ARE_NOT_EQUAL_WITH_MSG(int, 0, result, error_msg);
-    }
+    int result = device_send_message_disposition(handle, &disposition_info, DEVICE_MESSAGE_DISPOSITION_RESULT_ACCEPTED);
 
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
 
     // cleanup
     device_destroy(handle);
-    umock_c_negative_tests_deinit();
 }
 
 END_TEST_SUITE(iothubtransport_amqp_device_ut)
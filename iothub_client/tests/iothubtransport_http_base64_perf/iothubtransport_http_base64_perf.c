@@ -0,0 +1,178 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+/*compares the base64 encoder of HTTP event batches (a table of the 4096 base64 character pairs) with
+the 1 character per lookup loop it replaced and with Base64_Encode_Bytes, the codec of the shared utility*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "azure_c_shared_utility/base64.h"
+#include "azure_c_shared_utility/strings.h"
+#include "iothubtransport_http_common.h"
+
+/*every encoder gets through about this many bytes for each size, so each measurement lasts long enough for clock()*/
+#define BYTES_PER_MEASUREMENT ((size_t)256 * 1024 * 1024)
+
+/*from a single small event up to the largest HTTP batch the service accepts*/
+static const size_t sourceSizes[] = { 16, 256, 4 * 1024, 64 * 1024, 255 * 1024 };
+
+static const char base64Characters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*the HTTP transport encoder before the pair table, 4 lookups for every 3 bytes*/
+static size_t encodeBase64WithCharacterTable(char* destination, const unsigned char* source, size_t size)
+{
+    char* destinationBegin = destination;
+    size_t i;
+
+    for (i = 0; i + 2 < size; i += 3)
+    {
+        destination[0] = base64Characters[source[i] >> 2];
+        destination[1] = base64Characters[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        destination[2] = base64Characters[((source[i + 1] & 0x0F) << 2) | (source[i + 2] >> 6)];
+        destination[3] = base64Characters[source[i + 2] & 0x3F];
+        destination += 4;
+    }
+
+    if (i + 1 == size)
+    {
+        destination[0] = base64Characters[source[i] >> 2];
+        destination[1] = base64Characters[(source[i] & 0x03) << 4];
+        destination[2] = '=';
+        destination[3] = '=';
+        destination += 4;
+    }
+    else if (i + 2 == size)
+    {
+        destination[0] = base64Characters[source[i] >> 2];
+        destination[1] = base64Characters[((source[i] & 0x03) << 4) | (source[i + 1] >> 4)];
+        destination[2] = base64Characters[(source[i + 1] & 0x0F) << 2];
+        destination[3] = '=';
+        destination += 4;
+    }
+
+    return (size_t)(destination - destinationBegin);
+}
+
+/*Base64_Encode_Bytes allocates the encoding, as the transport had to before it encoded in place*/
+static size_t encodeBase64WithSharedUtility(char* destination, const unsigned char* source, size_t size)
+{
+    size_t result;
+    STRING_HANDLE encoding = Base64_Encode_Bytes(source, size);
+    if (encoding == NULL)
+    {
+        result = 0;
+    }
+    else
+    {
+        result = STRING_length(encoding);
+        (void)memcpy(destination, STRING_c_str(encoding), result);
+        STRING_delete(encoding);
+    }
+    return result;
+}
+
+typedef size_t(*ENCODE_BASE64)(char* destination, const unsigned char* source, size_t size);
+
+typedef struct ENCODER_TAG
+{
+    const char* name;
+    ENCODE_BASE64 encode;
+} ENCODER;
+
+static const ENCODER encoders[] =
+{
+    { "pair table", IoTHubTransport_HTTP_Common_EncodeBase64 },
+    { "character table", encodeBase64WithCharacterTable },
+    { "Base64_Encode_Bytes", encodeBase64WithSharedUtility }
+};
+
+#define ENCODER_COUNT (sizeof(encoders) / sizeof(encoders[0]))
+
+/*returns the nanoseconds 1 encoding of size bytes takes, or a negative value if the encoding is wrong*/
+static double measureEncoder(const ENCODER* encoder, char* destination, const char* expectedEncoding, const unsigned char* source, size_t size)
+{
+    double result;
+    size_t expectedLength = IOTHUB_BASE64_ENCODED_LENGTH(size);
+
+    if ((encoder->encode(destination, source, size) != expectedLength) ||
+        (memcmp(destination, expectedEncoding, expectedLength) != 0))
+    {
+        (void)printf("%s does not encode %lu bytes like the pair table\r\n", encoder->name, (unsigned long)size);
+        result = -1;
+    }
+    else
+    {
+        size_t iterations = BYTES_PER_MEASUREMENT / size;
+        size_t i;
+        clock_t start = clock();
+        for (i = 0; i < iterations; i++)
+        {
+            (void)encoder->encode(destination, source, size);
+        }
+        result = ((double)(clock() - start) / CLOCKS_PER_SEC) * 1e9 / iterations;
+    }
+    return result;
+}
+
+int main(void)
+{
+    int result = 0;
+    size_t largestSize = sourceSizes[sizeof(sourceSizes) / sizeof(sourceSizes[0]) - 1];
+    unsigned char* source = (unsigned char*)malloc(largestSize);
+    char* destination = (char*)malloc(IOTHUB_BASE64_ENCODED_LENGTH(largestSize));
+    char* expectedEncoding = (char*)malloc(IOTHUB_BASE64_ENCODED_LENGTH(largestSize));
+
+    if ((source == NULL) || (destination == NULL) || (expectedEncoding == NULL))
+    {
+        (void)printf("unable to malloc\r\n");
+        result = __LINE__;
+    }
+    else
+    {
+        size_t i;
+        size_t sizeIndex;
+
+        srand(0);
+        for (i = 0; i < largestSize; i++)
+        {
+            source[i] = (unsigned char)rand();
+        }
+
+        (void)printf("%10s", "bytes");
+        for (i = 0; i < ENCODER_COUNT; i++)
+        {
+            (void)printf("%22s", encoders[i].name);
+        }
+        (void)printf("   (ns per encoding, MB/s)\r\n");
+
+        for (sizeIndex = 0; (result == 0) && (sizeIndex < sizeof(sourceSizes) / sizeof(sourceSizes[0])); sizeIndex++)
+        {
+            size_t size = sourceSizes[sizeIndex];
+            (void)encoders[0].encode(expectedEncoding, source, size);
+
+            (void)printf("%10lu", (unsigned long)size);
+            for (i = 0; i < ENCODER_COUNT; i++)
+            {
+                double nanoseconds = measureEncoder(&encoders[i], destination, expectedEncoding, source, size);
+                if (nanoseconds < 0)
+                {
+                    result = __LINE__;
+                    break;
+                }
+                else
+                {
+                    (void)printf("%14.0f %7.0f", nanoseconds, (nanoseconds > 0) ? (size * 1e3 / nanoseconds) : 0);
+                }
+            }
+            (void)printf("\r\n");
+        }
+    }
+
+    free(source);
+    free(destination);
+    free(expectedEncoding);
+    return result;
+}
@@ -0,0 +1,637 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#endif
+
+#include <stdbool.h>
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/map.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_version.h"
+#include "iothub_client_private.h"
+#include "iothub_message.h"
+#undef ENABLE_MOCKS
+
+#include "iothubtransport_http_common.h"
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+
+// Data definitions
+
+#define TEST_IOTHUB_CLIENT_LL_HANDLE        (IOTHUB_CLIENT_LL_HANDLE)0x34333
+#define TEST_HTTP_HEADERS_HANDLE            (HTTP_HEADERS_HANDLE)0x5555
+#define TEST_IOTHUB_MESSAGE_HANDLE          (IOTHUB_MESSAGE_HANDLE)0x01e1
+#define TEST_MAP_HANDLE                     (MAP_HANDLE)0xe0
+#define TEST_PRODUCT_INFO_STRING_HANDLE     (STRING_HANDLE)0x6001
+#define TEST_PRODUCT_INFO                   "thisIsProductInfo"
+#define TEST_SDK_USER_AGENT                 CLIENT_DEVICE_TYPE_PREFIX CLIENT_DEVICE_BACKSLASH IOTHUB_SDK_VERSION
+
+static const char* TEST_RESPONSE_HEADERS[] =
+{
+    "iothub-app-myName: myValue",
+    "ETag: \"thisIsAnETag\"",
+    "iothub-messageid: myMessageId",
+    "iothub-correlationid: myCorrelationId",
+    "ContentType: myContentType",
+    "ContentEncoding: myContentEncoding"
+};
+#define TEST_RESPONSE_HEADERS_COUNT (sizeof(TEST_RESPONSE_HEADERS) / sizeof(TEST_RESPONSE_HEADERS[0]))
+
+static void* g_product_info;
+
+
+// Mock hooks
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_GetOption(IOTHUB_CLIENT_LL_HANDLE handle, const char* option, void** value)
+{
+    (void)handle;
+    (void)option;
+    *value = g_product_info;
+    return IOTHUB_CLIENT_OK;
+}
+
+static HTTP_HEADERS_RESULT my_HTTPHeaders_GetHeaderCount(HTTP_HEADERS_HANDLE handle, size_t* headerCount)
+{
+    (void)handle;
+    *headerCount = TEST_RESPONSE_HEADERS_COUNT;
+    return HTTP_HEADERS_OK;
+}
+
+static HTTP_HEADERS_RESULT my_HTTPHeaders_GetHeader(HTTP_HEADERS_HANDLE handle, size_t index, char** destination)
+{
+    (void)handle;
+    *destination = (char*)my_gballoc_malloc(strlen(TEST_RESPONSE_HEADERS[index]) + 1);
+    (void)strcpy(*destination, TEST_RESPONSE_HEADERS[index]);
+    return HTTP_HEADERS_OK;
+}
+
+
+// Helpers
+
+static void set_expected_calls_for_header(size_t index)
+{
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeader(TEST_HTTP_HEADERS_HANDLE, index, IGNORED_PTR_ARG));
+}
+
+static void assert_polling_interval_is_jittered(unsigned int result, unsigned int baseInterval)
+{
+    ASSERT_IS_TRUE(result >= baseInterval);
+    ASSERT_IS_TRUE(result <= baseInterval + baseInterval / 10);
+}
+
+
+BEGIN_TEST_SUITE(iothubtransport_http_common_ut)
+
+TEST_SUITE_INITIALIZE(TestClassInitialize)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_RESULT, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetOption, my_IoTHubClient_LL_GetOption);
+    REGISTER_GLOBAL_MOCK_RETURN(STRING_c_str, TEST_PRODUCT_INFO);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_GetHeaderCount, my_HTTPHeaders_GetHeaderCount);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_GetHeader, my_HTTPHeaders_GetHeader);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_HANDLE);
+    REGISTER_GLOBAL_MOCK_RETURN(Map_AddOrUpdate, MAP_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_SetMessageId, IOTHUB_MESSAGE_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_SetCorrelationId, IOTHUB_MESSAGE_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_SetContentTypeSystemProperty, IOTHUB_MESSAGE_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_SetContentEncodingSystemProperty, IOTHUB_MESSAGE_OK);
+}
+
+TEST_SUITE_CLEANUP(TestClassCleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(TestMethodInitialize)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+
+    umock_c_reset_all_calls();
+    g_product_info = NULL;
+}
+
+TEST_FUNCTION_CLEANUP(TestMethodCleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_001: [ If maximumPollingTime is not greater than minimumPollingTime, IoTHubTransport_HTTP_Common_GetNextPollingInterval shall set baseInterval to minimumPollingTime and return it, without jitter. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetNextPollingInterval_without_back_off_returns_minimumPollingTime)
+{
+    // arrange
+    unsigned int baseInterval = 0;
+    unsigned int results[3];
+    size_t i;
+
+    // act
+    for (i = 0; i < 3; i++)
+    {
+        results[i] = IoTHubTransport_HTTP_Common_GetNextPollingInterval(100, 0, &baseInterval);
+    }
+
+    // assert
+    for (i = 0; i < 3; i++)
+    {
+        ASSERT_ARE_EQUAL(int, 100, (int)results[i]);
+    }
+    ASSERT_ARE_EQUAL(int, 100, (int)baseInterval);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_001: [ If maximumPollingTime is not greater than minimumPollingTime, IoTHubTransport_HTTP_Common_GetNextPollingInterval shall set baseInterval to minimumPollingTime and return it, without jitter. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetNextPollingInterval_with_maximum_equal_to_minimum_returns_minimumPollingTime)
+{
+    // arrange
+    unsigned int baseInterval = 400;
+
+    // act
+    unsigned int result = IoTHubTransport_HTTP_Common_GetNextPollingInterval(100, 100, &baseInterval);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 100, (int)result);
+    ASSERT_ARE_EQUAL(int, 100, (int)baseInterval);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_002: [ Otherwise IoTHubTransport_HTTP_Common_GetNextPollingInterval shall double baseInterval, starting at minimumPollingTime and capped at maximumPollingTime. ]
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_003: [ IoTHubTransport_HTTP_Common_GetNextPollingInterval shall return baseInterval plus up to 10% of it chosen at random, but not more than maximumPollingTime. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetNextPollingInterval_first_interval_is_minimumPollingTime_plus_jitter)
+{
+    // arrange
+    unsigned int baseInterval = 0;
+
+    // act
+    unsigned int result = IoTHubTransport_HTTP_Common_GetNextPollingInterval(100, 1000, &baseInterval);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 100, (int)baseInterval);
+    assert_polling_interval_is_jittered(result, 100);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_002: [ Otherwise IoTHubTransport_HTTP_Common_GetNextPollingInterval shall double baseInterval, starting at minimumPollingTime and capped at maximumPollingTime. ]
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_003: [ IoTHubTransport_HTTP_Common_GetNextPollingInterval shall return baseInterval plus up to 10% of it chosen at random, but not more than maximumPollingTime. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetNextPollingInterval_doubles_the_base_interval_not_the_jitter)
+{
+    // arrange
+    unsigned int baseInterval = 100;
+    unsigned int expectedBaseInterval;
+
+    for (expectedBaseInterval = 200; expectedBaseInterval <= 800; expectedBaseInterval *= 2)
+    {
+        // act
+        unsigned int result = IoTHubTransport_HTTP_Common_GetNextPollingInterval(100, 1000, &baseInterval);
+
+        // assert
+        ASSERT_ARE_EQUAL(int, (int)expectedBaseInterval, (int)baseInterval);
+        assert_polling_interval_is_jittered(result, expectedBaseInterval);
+    }
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_002: [ Otherwise IoTHubTransport_HTTP_Common_GetNextPollingInterval shall double baseInterval, starting at minimumPollingTime and capped at maximumPollingTime. ]
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_003: [ IoTHubTransport_HTTP_Common_GetNextPollingInterval shall return baseInterval plus up to 10% of it chosen at random, but not more than maximumPollingTime. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetNextPollingInterval_does_not_exceed_maximumPollingTime)
+{
+    // arrange
+    unsigned int baseInterval = 100;
+    unsigned int results[2];
+
+    // act
+    results[0] = IoTHubTransport_HTTP_Common_GetNextPollingInterval(100, 150, &baseInterval);
+    results[1] = IoTHubTransport_HTTP_Common_GetNextPollingInterval(100, 150, &baseInterval);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 150, (int)baseInterval);
+    ASSERT_ARE_EQUAL(int, 150, (int)results[0]);
+    ASSERT_ARE_EQUAL(int, 150, (int)results[1]);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_014: [ IoTHubTransport_HTTP_Common_GetPollingPhaseOffset shall return pollingInterval times the fractional part of deviceIndex times the golden ratio conjugate, which is 0 for deviceIndex 0. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetPollingPhaseOffset_first_device_has_no_offset)
+{
+    // arrange
+
+    // act
+    unsigned int result = IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(100, 0);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 0, (int)result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_014: [ IoTHubTransport_HTTP_Common_GetPollingPhaseOffset shall return pollingInterval times the fractional part of deviceIndex times the golden ratio conjugate, which is 0 for deviceIndex 0. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetPollingPhaseOffset_spreads_the_next_devices_over_the_interval)
+{
+    // arrange
+    unsigned int results[4];
+
+    // act
+    results[0] = IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(100, 1);
+    results[1] = IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(100, 2);
+    results[2] = IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(100, 3);
+    results[3] = IoTHubTransport_HTTP_Common_GetPollingPhaseOffset(100, 4);
+
+    // assert
+    ASSERT_ARE_EQUAL(int, 61, (int)results[0]);
+    ASSERT_ARE_EQUAL(int, 23, (int)results[1]);
+    ASSERT_ARE_EQUAL(int, 85, (int)results[2]);
+    ASSERT_ARE_EQUAL(int, 47, (int)results[3]);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_015: [ IoTHubTransport_HTTP_Common_EncodeBase64 shall write the base64 encoding of the size bytes of source, padded with '=', to destination, without a null terminator. ]
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_016: [ Every 3 bytes of source shall be encoded with 2 lookups of 2 characters each. ]
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_017: [ IoTHubTransport_HTTP_Common_EncodeBase64 shall return the number of characters written, IOTHUB_BASE64_ENCODED_LENGTH(size). ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_EncodeBase64_encodes_the_RFC_4648_test_vectors)
+{
+    // arrange
+    static const char* expectedEncodings[] = { "", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy" };
+    const unsigned char* source = (const unsigned char*)"foobar";
+    size_t size;
+
+    for (size = 0; size < sizeof(expectedEncodings) / sizeof(expectedEncodings[0]); size++)
+    {
+        char destination[9];
+        size_t result;
+        (void)memset(destination, '#', sizeof(destination));
+
+        // act
+        result = IoTHubTransport_HTTP_Common_EncodeBase64(destination, source, size);
+
+        // assert
+        ASSERT_ARE_EQUAL(size_t, IOTHUB_BASE64_ENCODED_LENGTH(size), result);
+        ASSERT_ARE_EQUAL(int, 0, memcmp(expectedEncodings[size], destination, result));
+        ASSERT_ARE_EQUAL(char, '#', destination[result]);
+    }
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_016: [ Every 3 bytes of source shall be encoded with 2 lookups of 2 characters each. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_EncodeBase64_encodes_the_first_and_last_pairs)
+{
+    // arrange
+    static const unsigned char source[] = { 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFB, 0xF0, 0x3E };
+    char destination[12];
+
+    // act
+    size_t result = IoTHubTransport_HTTP_Common_EncodeBase64(destination, source, sizeof(source));
+
+    // assert
+    ASSERT_ARE_EQUAL(size_t, 12, result);
+    ASSERT_ARE_EQUAL(int, 0, memcmp("AAAA////+/A+", destination, result));
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_004: [ If the buffer is too small for "iothub-app-" followed by key, IoTHubTransport_HTTP_Common_GetPropertyHeaderName shall realloc it and write "iothub-app-" at its beginning. ]
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_006: [ IoTHubTransport_HTTP_Common_GetPropertyHeaderName shall copy key after "iothub-app-" and return the buffer. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetPropertyHeaderName_grows_the_buffer)
+{
+    // arrange
+    char* propertyHeaderName = NULL;
+    size_t propertyHeaderNameSize = 0;
+    const char* result;
+
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, sizeof(IOTHUB_APP_PREFIX "myName")));
+
+    // act
+    result = IoTHubTransport_HTTP_Common_GetPropertyHeaderName(&propertyHeaderName, &propertyHeaderNameSize, "myName");
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, IOTHUB_APP_PREFIX "myName", result);
+    ASSERT_ARE_EQUAL(void_ptr, propertyHeaderName, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(IOTHUB_APP_PREFIX "myName"), propertyHeaderNameSize);
+
+    // cleanup
+    my_gballoc_free(propertyHeaderName);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_006: [ IoTHubTransport_HTTP_Common_GetPropertyHeaderName shall copy key after "iothub-app-" and return the buffer. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetPropertyHeaderName_reuses_a_large_enough_buffer)
+{
+    // arrange
+    char* propertyHeaderName = NULL;
+    size_t propertyHeaderNameSize = 0;
+    const char* result;
+
+    (void)IoTHubTransport_HTTP_Common_GetPropertyHeaderName(&propertyHeaderName, &propertyHeaderNameSize, "aLongerName");
+    umock_c_reset_all_calls();
+
+    // act
+    result = IoTHubTransport_HTTP_Common_GetPropertyHeaderName(&propertyHeaderName, &propertyHeaderNameSize, "short");
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(char_ptr, IOTHUB_APP_PREFIX "short", result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(IOTHUB_APP_PREFIX "aLongerName"), propertyHeaderNameSize);
+
+    // cleanup
+    my_gballoc_free(propertyHeaderName);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_005: [ If realloc fails, IoTHubTransport_HTTP_Common_GetPropertyHeaderName shall return NULL and leave the buffer untouched. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_GetPropertyHeaderName_realloc_fails_returns_NULL)
+{
+    // arrange
+    char* propertyHeaderName = NULL;
+    size_t propertyHeaderNameSize = 0;
+    const char* result;
+
+    (void)IoTHubTransport_HTTP_Common_GetPropertyHeaderName(&propertyHeaderName, &propertyHeaderNameSize, "short");
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(gballoc_realloc(propertyHeaderName, sizeof(IOTHUB_APP_PREFIX "aLongerName")))
+        .SetReturn(NULL);
+
+    // act
+    result = IoTHubTransport_HTTP_Common_GetPropertyHeaderName(&propertyHeaderName, &propertyHeaderNameSize, "aLongerName");
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, IOTHUB_APP_PREFIX "short", propertyHeaderName);
+    ASSERT_ARE_EQUAL(size_t, sizeof(IOTHUB_APP_PREFIX "short"), propertyHeaderNameSize);
+
+    // cleanup
+    my_gballoc_free(propertyHeaderName);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_007: [ If the product info option of the client cannot be read or is not set, the "User-Agent" header shall be the SDK name and version. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo_without_product_info_adds_the_SDK_version)
+{
+    // arrange
+    HTTP_HEADERS_RESULT result;
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(TEST_IOTHUB_CLIENT_LL_HANDLE, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "User-Agent", TEST_SDK_USER_AGENT));
+
+    // act
+    result = IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, HTTP_HEADERS_OK, result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_007: [ If the product info option of the client cannot be read or is not set, the "User-Agent" header shall be the SDK name and version. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo_GetOption_fails_adds_the_SDK_version)
+{
+    // arrange
+    HTTP_HEADERS_RESULT result;
+    g_product_info = TEST_PRODUCT_INFO_STRING_HANDLE;
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(TEST_IOTHUB_CLIENT_LL_HANDLE, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_CLIENT_ERROR);
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "User-Agent", TEST_SDK_USER_AGENT));
+
+    // act
+    result = IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, HTTP_HEADERS_OK, result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_008: [ Otherwise the "User-Agent" header shall be the product info. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo_with_product_info_adds_it)
+{
+    // arrange
+    HTTP_HEADERS_RESULT result;
+    g_product_info = TEST_PRODUCT_INFO_STRING_HANDLE;
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(TEST_IOTHUB_CLIENT_LL_HANDLE, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(TEST_PRODUCT_INFO_STRING_HANDLE));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(TEST_HTTP_HEADERS_HANDLE, "User-Agent", TEST_PRODUCT_INFO))
+        .SetReturn(HTTP_HEADERS_ERROR);
+
+    // act
+    result = IoTHubTransport_HTTP_Common_AddUserAgentHeaderInfo(TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, HTTP_HEADERS_ERROR, result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_011: [ Every header of the form iothub-app-name: somecontent shall be added to the message properties as {name, somecontent}. ]
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_012: [ The values of the "iothub-messageid", "iothub-correlationid", "ContentType" and "ContentEncoding" headers shall be set as the message id, correlation id, content type and content encoding of the message. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_SetMessageProperties_succeeds)
+{
+    // arrange
+    bool result;
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(TEST_HTTP_HEADERS_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+    set_expected_calls_for_header(0);
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "myName", "myValue"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_for_header(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_for_header(2);
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetMessageId(TEST_IOTHUB_MESSAGE_HANDLE, "myMessageId"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_for_header(3);
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetCorrelationId(TEST_IOTHUB_MESSAGE_HANDLE, "myCorrelationId"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_for_header(4);
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetContentTypeSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE, "myContentType"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_for_header(5);
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetContentEncodingSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE, "myContentEncoding"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = IoTHubTransport_HTTP_Common_SetMessageProperties(TEST_IOTHUB_MESSAGE_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_TRUE(result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_009: [ If the count of headers cannot be read, IoTHubTransport_HTTP_Common_SetMessageProperties shall fail and return false. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_SetMessageProperties_GetHeaderCount_fails)
+{
+    // arrange
+    bool result;
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(TEST_HTTP_HEADERS_HANDLE, IGNORED_PTR_ARG))
+        .SetReturn(HTTP_HEADERS_ERROR);
+
+    // act
+    result = IoTHubTransport_HTTP_Common_SetMessageProperties(TEST_IOTHUB_MESSAGE_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_010: [ If any header cannot be read or copied, IoTHubTransport_HTTP_Common_SetMessageProperties shall stop and return false. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_SetMessageProperties_GetHeader_fails)
+{
+    // arrange
+    bool result;
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(TEST_HTTP_HEADERS_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+    set_expected_calls_for_header(0);
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "myName", "myValue"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeader(TEST_HTTP_HEADERS_HANDLE, 1, IGNORED_PTR_ARG))
+        .SetReturn(HTTP_HEADERS_ERROR);
+
+    // act
+    result = IoTHubTransport_HTTP_Common_SetMessageProperties(TEST_IOTHUB_MESSAGE_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_010: [ If any header cannot be read or copied, IoTHubTransport_HTTP_Common_SetMessageProperties shall stop and return false. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_SetMessageProperties_Map_AddOrUpdate_fails)
+{
+    // arrange
+    bool result;
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(TEST_HTTP_HEADERS_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+    set_expected_calls_for_header(0);
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "myName", "myValue"))
+        .SetReturn(MAP_ERROR);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = IoTHubTransport_HTTP_Common_SetMessageProperties(TEST_IOTHUB_MESSAGE_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_010: [ If any header cannot be read or copied, IoTHubTransport_HTTP_Common_SetMessageProperties shall stop and return false. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_SetMessageProperties_SetMessageId_fails)
+{
+    // arrange
+    bool result;
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_GetHeaderCount(TEST_HTTP_HEADERS_HANDLE, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+    set_expected_calls_for_header(0);
+    STRICT_EXPECTED_CALL(Map_AddOrUpdate(TEST_MAP_HANDLE, "myName", "myValue"));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_for_header(1);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+    set_expected_calls_for_header(2);
+    STRICT_EXPECTED_CALL(IoTHubMessage_SetMessageId(TEST_IOTHUB_MESSAGE_HANDLE, "myMessageId"))
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    // act
+    result = IoTHubTransport_HTTP_Common_SetMessageProperties(TEST_IOTHUB_MESSAGE_HANDLE, TEST_HTTP_HEADERS_HANDLE);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_IS_FALSE(result);
+}
+
+// Tests_SRS_IOTHUBTRANSPORT_HTTP_COMMON_09_013: [ IoTHubTransport_HTTP_Common_ReversePutListBackIn shall move the entries of source, in order, to the head of destination and leave source empty. ]
+TEST_FUNCTION(IoTHubTransport_HTTP_Common_ReversePutListBackIn_succeeds)
+{
+    // arrange
+    DLIST_ENTRY source;
+    DLIST_ENTRY destinationHead;
+    DLIST_ENTRY destinationFirst;
+    destinationHead.Flink = &destinationFirst;
+
+    STRICT_EXPECTED_CALL(DList_AppendTailList(&destinationFirst, &source));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(&source));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(&source));
+
+    // act
+    IoTHubTransport_HTTP_Common_ReversePutListBackIn(&source, &destinationHead);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+END_TEST_SUITE(iothubtransport_http_common_ut)
@@ -1478,5 +1478,206 @@ TEST_FUNCTION(IoTHubTransport_worker_thread_runs_lock_fails)
     IoTHubTransport_Destroy(transportHandle);
 }
 
-END_TEST_SUITE(iothubtransport_ut)
+/*Tests_SRS_IOTHUBTRANSPORT_09_002: [ IoTHubTransport_CreatePool shall allocate memory for the pool data and for transportCount transport handles. ]*/
+/*Tests_SRS_IOTHUBTRANSPORT_09_004: [ IoTHubTransport_CreatePool shall create transportCount transports using IoTHubTransport_Create, each with its own lower layer transport, lock and worker thread. ]*/
+/*Tests_SRS_IOTHUBTRANSPORT_09_006: [ IoTHubTransport_CreatePool shall return a non-NULL handle on success. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_success_returns_non_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    size_t i;
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(2 * sizeof(TRANSPORT_HANDLE)));
+    for (i = 0; i < 2; i++)
+    {
+        STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Create(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Lock_Init());
+        STRICT_EXPECTED_CALL(mocks, Lock_Init()).SetReturn(TEST_CLIENTS_LOCK_HANDLE); // clients lock
+        STRICT_EXPECTED_CALL(mocks, VECTOR_create(sizeof(IOTHUB_CLIENT_HANDLE)));
+    }
+
+    ///act
+    auto result = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_DestroyPool(result);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_09_001: [ If protocol, iotHubName or iotHubSuffix are NULL, or transportCount is zero, IoTHubTransport_CreatePool shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_invalid_args_return_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    auto result1 = IoTHubTransport_CreatePool(NULL, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+    auto result2 = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, NULL, TEST_CONFIG.iotHubSuffix, 2);
+    auto result3 = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, NULL, 2);
+    auto result4 = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 0);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_09_003: [ If memory allocation fails, IoTHubTransport_CreatePool shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_alloc_fails_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_malloc(IGNORED_NUM_ARG))
+        .IgnoreArgument(1)
+        .SetFailReturn((void_ptr)NULL);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+
+    ///act
+    auto result = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
 
+    ///assert
+    ASSERT_IS_NULL(result);
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_09_005: [ If any transport fails to be created, IoTHubTransport_CreatePool shall destroy the transports already created, free all memory and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_CreatePool_second_transport_fails_returns_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    whenShallmalloc_fail = 4; /* pool, array, first transport, second transport */
+
+    ///act
+    auto result = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_09_007: [ IoTHubTransport_DestroyPool shall do nothing if poolHandle is NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_DestroyPool_null_handle_does_nothing)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+
+    ///act
+    IoTHubTransport_DestroyPool(NULL);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_09_008: [ IoTHubTransport_DestroyPool shall destroy each transport using IoTHubTransport_Destroy and free all resources. ]*/
+TEST_FUNCTION(IoTHubTransport_DestroyPool_success)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    size_t i;
+    auto poolHandle = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+    mocks.ResetAllCalls();
+
+    for (i = 0; i < 2; i++)
+    {
+        STRICT_EXPECTED_CALL(mocks, Lock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Unlock(TEST_LOCK_HANDLE));
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, FAKE_IoTHubTransport_Destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, VECTOR_destroy(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, Lock_Deinit(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+        STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+            .IgnoreArgument(1);
+    }
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(IGNORED_PTR_ARG))
+        .IgnoreArgument(1);
+    STRICT_EXPECTED_CALL(mocks, gballoc_free(poolHandle));
+
+    ///act
+    IoTHubTransport_DestroyPool(poolHandle);
+
+    ///assert
+    mocks.AssertActualAndExpectedCalls();
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_09_009: [ If poolHandle or deviceId are NULL, IoTHubTransport_GetPoolTransport shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransport_GetPoolTransport_invalid_args_return_null)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    auto poolHandle = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 2);
+    mocks.ResetAllCalls();
+
+    ///act
+    auto result1 = IoTHubTransport_GetPoolTransport(NULL, TEST_DEVICE_ID);
+    auto result2 = IoTHubTransport_GetPoolTransport(poolHandle, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_DestroyPool(poolHandle);
+}
+
+/*Tests_SRS_IOTHUBTRANSPORT_09_010: [ IoTHubTransport_GetPoolTransport shall return the transport selected by a hash of deviceId modulo the number of transports in the pool. ]*/
+TEST_FUNCTION(IoTHubTransport_GetPoolTransport_spreads_devices_and_is_stable)
+{
+    CIotHubTransportMocks mocks;
+    ///arrange
+    char deviceId[32];
+    size_t i;
+    size_t distinctCount = 0;
+    TRANSPORT_HANDLE distinctTransports[4];
+    auto poolHandle = IoTHubTransport_CreatePool(TEST_CONFIG.protocol, TEST_CONFIG.iotHubName, TEST_CONFIG.iotHubSuffix, 4);
+    mocks.ResetAllCalls();
+
+    ///act
+    for (i = 0; i < 400; i++)
+    {
+        size_t j;
+        TRANSPORT_HANDLE transport;
+        (void)sprintf(deviceId, "gateway-device-%u", (unsigned int)i);
+        transport = IoTHubTransport_GetPoolTransport(poolHandle, deviceId);
+        ASSERT_IS_NOT_NULL(transport);
+        ASSERT_ARE_EQUAL(void_ptr, transport, IoTHubTransport_GetPoolTransport(poolHandle, deviceId));
+
+        for (j = 0; j < distinctCount; j++)
+        {
+            if (distinctTransports[j] == transport)
+            {
+                break;
+            }
+        }
+
+        if (j == distinctCount)
+        {
+            ASSERT_IS_TRUE(distinctCount < 4);
+            distinctTransports[distinctCount++] = transport;
+        }
+    }
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, distinctCount);
+    mocks.AssertActualAndExpectedCalls();
+
+    ///cleanup
+    IoTHubTransport_DestroyPool(poolHandle);
+}
+
+END_TEST_SUITE(iothubtransport_ut)
@@ -0,0 +1,2260 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#ifdef __cplusplus
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#else
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "testrunnerswitcher.h"
+#include "umock_c.h"
+#include "umocktypes_charptr.h"
+#include "umock_c_negative_tests.h"
+#include "umocktypes_stdint.h"
+#include "umocktypes_bool.h"
+
+static void* my_gballoc_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void my_gballoc_free(void* ptr)
+{
+    free(ptr);
+}
+
+#define ENABLE_MOCKS
+#include "azure_c_shared_utility/gballoc.h"
+#include "azure_c_shared_utility/optimize_size.h"
+#include "azure_c_shared_utility/urlencode.h"
+#include "azure_c_shared_utility/doublylinkedlist.h"
+#include "azure_c_shared_utility/singlylinkedlist.h"
+#include "azure_c_shared_utility/httpheaders.h"
+#include "azure_c_shared_utility/strings.h"
+#include "azure_c_shared_utility/vector.h"
+#include "azure_c_shared_utility/vector_types_internal.h"
+#include "azure_c_shared_utility/agenttime.h"
+#include "azure_c_shared_utility/platform.h"
+#include "azure_c_shared_utility/tlsio.h"
+
+#include "azure_hub_modules/uhttp.h"
+
+#include "iothub_client_options.h"
+#include "iothub_client_version.h"
+#include "iothub_client_private.h"
+#include "iothub_client_authorization.h"
+#undef ENABLE_MOCKS
+
+#include "iothubtransporthttp_async.h"
+
+#include "real_strings.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    extern VECTOR_HANDLE real_VECTOR_create(size_t elementSize);
+    extern void real_VECTOR_destroy(VECTOR_HANDLE handle);
+    extern int real_VECTOR_push_back(VECTOR_HANDLE handle, const void* elements, size_t numElements);
+    extern void real_VECTOR_erase(VECTOR_HANDLE handle, void* elements, size_t numElements);
+    extern void* real_VECTOR_element(VECTOR_HANDLE handle, size_t index);
+    extern void* real_VECTOR_find_if(VECTOR_HANDLE handle, PREDICATE_FUNCTION pred, const void* value);
+    extern size_t real_VECTOR_size(VECTOR_HANDLE handle);
+
+    extern void real_DList_InitializeListHead(PDLIST_ENTRY listHead);
+    extern int real_DList_IsListEmpty(const PDLIST_ENTRY listHead);
+    extern void real_DList_InsertTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    extern void real_DList_InsertHeadList(PDLIST_ENTRY listHead, PDLIST_ENTRY listEntry);
+    extern void real_DList_AppendTailList(PDLIST_ENTRY listHead, PDLIST_ENTRY ListToAppend);
+    extern int real_DList_RemoveEntryList(PDLIST_ENTRY listEntry);
+    extern PDLIST_ENTRY real_DList_RemoveHeadList(PDLIST_ENTRY listHead);
+
+    extern SINGLYLINKEDLIST_HANDLE real_singlylinkedlist_create(void);
+    extern void real_singlylinkedlist_destroy(SINGLYLINKEDLIST_HANDLE list);
+    extern LIST_ITEM_HANDLE real_singlylinkedlist_add(SINGLYLINKEDLIST_HANDLE list, const void* item);
+    extern int real_singlylinkedlist_remove(SINGLYLINKEDLIST_HANDLE list, LIST_ITEM_HANDLE item_handle);
+    extern LIST_ITEM_HANDLE real_singlylinkedlist_get_head_item(SINGLYLINKEDLIST_HANDLE list);
+    extern const void* real_singlylinkedlist_item_get_value(LIST_ITEM_HANDLE item_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_RESULT_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_STATUS_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_STATUS_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_RESULT_VALUES);
+
+TEST_DEFINE_ENUM_TYPE(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_TYPE_VALUES);
+IMPLEMENT_UMOCK_C_ENUM_TYPE(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_TYPE_VALUES);
+
+#define TEST_DEVICE_ID "thisIsDeviceID"
+#define TEST_DEVICE_ID2 "aSecondDeviceID"
+#define TEST_DEVICE_KEY "thisIsDeviceKey"
+#define TEST_DEVICE_KEY2 "aSecondDeviceKey"
+#define TEST_IOTHUB_NAME "thisIsIotBuhName"
+#define TEST_IOTHUB_SUFFIX "thisIsIotHubSuffix"
+#define TEST_IOTHUB_GWHOSTNAME "thisIsGWHostname"
+#define TEST_SAS_TOKEN "thisIsSasToken"
+#define TEST_ETAG_VALUE_UNQUOTED "thisIsSomeETAGValueSomeGUIDMaybe"
+#define TEST_ETAG_VALUE "\"" TEST_ETAG_VALUE_UNQUOTED "\""
+#define TEST_IOTHUB_CLIENT_LL_HANDLE (IOTHUB_CLIENT_LL_HANDLE)0x34333
+#define TEST_IOTHUB_CLIENT_LL_HANDLE2 (IOTHUB_CLIENT_LL_HANDLE)0x34344
+#define TEST_AUTHORIZATION_HANDLE (IOTHUB_AUTHORIZATION_HANDLE)0x4444
+#define TEST_AUTHORIZATION_HANDLE2 (IOTHUB_AUTHORIZATION_HANDLE)0x4445
+#define TEST_INTERFACE_DESC (const IO_INTERFACE_DESCRIPTION*)0x11111115
+#define TEST_IOTHUB_MESSAGE_HANDLE_1 ((IOTHUB_MESSAGE_HANDLE)0x01d1)
+#define TEST_RECEIVED_MESSAGE_HANDLE ((IOTHUB_MESSAGE_HANDLE)0x01e1)
+#define TEST_MAP_EMPTY (MAP_HANDLE)0xe0
+#define TEST_RESPONSE_HEADERS (HTTP_HEADERS_HANDLE)0x5555
+#define TEST_GET_TIME_VALUE 384968
+
+#define TEST_EVENT_PATH "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION
+#define TEST_MESSAGE_PATH "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION
+#define TEST_ABANDON_PATH "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED "/abandon" API_VERSION
+#define TEST_COMPLETE_PATH "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP_ETAG TEST_ETAG_VALUE_UNQUOTED API_VERSION
+#define TEST_REJECT_PATH TEST_COMPLETE_PATH "&reject"
+#define TEST_HOSTNAME TEST_IOTHUB_NAME "." TEST_IOTHUB_SUFFIX
+#define TEST_SAS_TOKEN_SCOPE TEST_HOSTNAME "/devices/" TEST_DEVICE_ID
+
+static unsigned char contains3[1] = { '3' };
+
+static const IOTHUB_DEVICE_CONFIG TEST_DEVICE_1 =
+{
+    TEST_DEVICE_ID,
+    TEST_DEVICE_KEY,
+    NULL,
+    TEST_AUTHORIZATION_HANDLE
+};
+
+static const IOTHUB_DEVICE_CONFIG TEST_DEVICE_2 =
+{
+    TEST_DEVICE_ID2,
+    TEST_DEVICE_KEY2,
+    NULL,
+    TEST_AUTHORIZATION_HANDLE2
+};
+
+static const IOTHUB_DEVICE_CONFIG TEST_DEVICE_NULL_AUTHORIZATION =
+{
+    TEST_DEVICE_ID,
+    TEST_DEVICE_KEY,
+    NULL,
+    NULL
+};
+
+static const IOTHUB_CLIENT_CONFIG TEST_CONFIG_IOTHUBCLIENT_CONFIG =
+{
+    HTTP_Async_Protocol,                            /* IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;   */
+    TEST_DEVICE_ID,                                 /* const char* deviceId;                        */
+    TEST_DEVICE_KEY,                                /* const char* deviceKey;                       */
+    NULL,                                           /* const char* deviceSasToken;                  */
+    TEST_IOTHUB_NAME,                               /* const char* iotHubName;                      */
+    TEST_IOTHUB_SUFFIX,                             /* const char* iotHubSuffix;                    */
+    NULL                                            /* const char* protocolGatewayHostName;         */
+};
+
+static const IOTHUB_CLIENT_CONFIG TEST_CONFIG_IOTHUBCLIENT_GW_CONFIG =
+{
+    HTTP_Async_Protocol,                            /* IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;   */
+    TEST_DEVICE_ID,                                 /* const char* deviceId;                        */
+    TEST_DEVICE_KEY,                                /* const char* deviceKey;                       */
+    NULL,                                           /* const char* deviceSasToken;                  */
+    TEST_IOTHUB_NAME,                               /* const char* iotHubName;                      */
+    TEST_IOTHUB_SUFFIX,                             /* const char* iotHubSuffix;                    */
+    TEST_IOTHUB_GWHOSTNAME                          /* const char* protocolGatewayHostName;         */
+};
+
+static const IOTHUB_CLIENT_CONFIG TEST_CONFIG_IOTHUBCLIENT_CONFIG_NULL_IOTHUB_NAME =
+{
+    HTTP_Async_Protocol,                            /* IOTHUB_CLIENT_TRANSPORT_PROVIDER protocol;   */
+    TEST_DEVICE_ID,                                 /* const char* deviceId;                        */
+    TEST_DEVICE_KEY,                                /* const char* deviceKey;                       */
+    NULL,                                           /* const char* deviceSasToken;                  */
+    NULL,                                           /* const char* iotHubName;                      */
+    TEST_IOTHUB_SUFFIX,                             /* const char* iotHubSuffix;                    */
+    NULL                                            /* const char* protocolGatewayHostName;         */
+};
+
+static DLIST_ENTRY waitingToSend;
+static DLIST_ENTRY waitingToSend2;
+
+static IOTHUBTRANSPORT_CONFIG TEST_CONFIG =
+{
+    &TEST_CONFIG_IOTHUBCLIENT_CONFIG,
+    &waitingToSend
+};
+
+static IOTHUBTRANSPORT_CONFIG TEST_GW_CONFIG =
+{
+    &TEST_CONFIG_IOTHUBCLIENT_GW_CONFIG,
+    &waitingToSend
+};
+
+static IOTHUBTRANSPORT_CONFIG TEST_CONFIG_NULL_CONFIG =
+{
+    NULL,
+    &waitingToSend
+};
+
+static IOTHUBTRANSPORT_CONFIG TEST_CONFIG_NULL_IOTHUB_NAME =
+{
+    &TEST_CONFIG_IOTHUBCLIENT_CONFIG_NULL_IOTHUB_NAME,
+    &waitingToSend
+};
+
+static IOTHUB_MESSAGE_LIST message1 =
+{
+    TEST_IOTHUB_MESSAGE_HANDLE_1,                   /*IOTHUB_MESSAGE_HANDLE messageHandle;                    */
+    NULL,                                           /*IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK callback;     */
+    NULL,                                           /*void* context;                                          */
+    { NULL, NULL }                                  /*DLIST_ENTRY entry;                                      */
+};
+
+static pfIoTHubTransport_SendMessageDisposition         IoTHubTransportHttpAsync_SendMessageDisposition;
+static pfIoTHubTransport_Subscribe_DeviceTwin           IoTHubTransportHttpAsync_Subscribe_DeviceTwin;
+static pfIoTHubTransport_Subscribe_DeviceMethod         IoTHubTransportHttpAsync_Subscribe_DeviceMethod;
+static pfIoTHubTransport_ProcessItem                    IoTHubTransportHttpAsync_ProcessItem;
+static pfIoTHubTransport_GetHostname                    IoTHubTransportHttpAsync_GetHostname;
+static pfIoTHubTransport_SetOption                      IoTHubTransportHttpAsync_SetOption;
+static pfIoTHubTransport_Create                         IoTHubTransportHttpAsync_Create;
+static pfIoTHubTransport_Destroy                        IoTHubTransportHttpAsync_Destroy;
+static pfIotHubTransport_Register                       IoTHubTransportHttpAsync_Register;
+static pfIotHubTransport_Unregister                     IoTHubTransportHttpAsync_Unregister;
+static pfIoTHubTransport_Subscribe                      IoTHubTransportHttpAsync_Subscribe;
+static pfIoTHubTransport_Unsubscribe                    IoTHubTransportHttpAsync_Unsubscribe;
+static pfIoTHubTransport_DoWork                         IoTHubTransportHttpAsync_DoWork;
+static pfIoTHubTransport_GetSendStatus                  IoTHubTransportHttpAsync_GetSendStatus;
+
+static TEST_MUTEX_HANDLE g_testByTest;
+static TEST_MUTEX_HANDLE g_dllByDll;
+
+DEFINE_ENUM_STRINGS(UMOCK_C_ERROR_CODE, UMOCK_C_ERROR_CODE_VALUES)
+
+static void on_umock_c_error(UMOCK_C_ERROR_CODE error_code)
+{
+    char temp_str[256];
+    (void)snprintf(temp_str, sizeof(temp_str), "umock_c reported error :%s", ENUM_TO_STRING(UMOCK_C_ERROR_CODE, error_code));
+    ASSERT_FAIL(temp_str);
+}
+
+/*the uhttp callbacks, captured so the tests can play the part of the connection*/
+static ON_HTTP_OPEN_COMPLETE_CALLBACK g_on_http_open;
+static void* g_http_open_ctx;
+static ON_HTTP_ERROR_CALLBACK g_on_http_error;
+static void* g_http_error_ctx;
+static ON_HTTP_REQUEST_CALLBACK g_on_http_request;
+static void* g_http_request_ctx;
+static size_t g_uhttp_client_create_count;
+static size_t g_uhttp_client_destroy_count;
+static size_t g_execute_request_count;
+static HTTP_CLIENT_REQUEST_TYPE g_last_request_type;
+static char g_last_relative_path[256];
+
+static time_t g_current_time;
+
+static IOTHUB_CLIENT_CONFIRMATION_RESULT g_send_complete_result;
+static size_t g_send_complete_count;
+
+static MESSAGE_CALLBACK_INFO* g_message_callback_info;
+static bool g_message_callback_return_value;
+
+static size_t g_get_sas_token_count;
+static char g_sas_token_scope[256];
+static size_t g_sas_token_expiry;
+
+static STRING_HANDLE my_URL_EncodeString(const char* textEncode)
+{
+    return real_STRING_construct(textEncode);
+}
+
+static time_t my_get_time(time_t* p)
+{
+    (void)p;
+    return g_current_time;
+}
+
+static double my_get_difftime(time_t stopTime, time_t startTime)
+{
+    return (double)(stopTime - startTime);
+}
+
+static HTTP_HEADERS_HANDLE my_HTTPHeaders_Alloc(void)
+{
+    return (HTTP_HEADERS_HANDLE)my_gballoc_malloc(1);
+}
+
+static HTTP_HEADERS_HANDLE my_HTTPHeaders_Clone(HTTP_HEADERS_HANDLE handle)
+{
+    (void)handle;
+    return (HTTP_HEADERS_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_HTTPHeaders_Free(HTTP_HEADERS_HANDLE httpHeadersHandle)
+{
+    my_gballoc_free(httpHeadersHandle);
+}
+
+static HTTP_HEADERS_RESULT my_HTTPHeaders_GetHeaderCount(HTTP_HEADERS_HANDLE handle, size_t* headerCount)
+{
+    (void)handle;
+    *headerCount = 0;
+    return HTTP_HEADERS_OK;
+}
+
+static IOTHUB_CLIENT_RESULT my_IoTHubClient_LL_GetOption(IOTHUB_CLIENT_LL_HANDLE handle, const char* option, void** value)
+{
+    (void)handle;
+    (void)option;
+    *value = NULL;
+    return IOTHUB_CLIENT_OK;
+}
+
+static void my_IoTHubClient_LL_SendComplete(IOTHUB_CLIENT_LL_HANDLE handle, PDLIST_ENTRY completed, IOTHUB_CLIENT_CONFIRMATION_RESULT result)
+{
+    (void)handle;
+    g_send_complete_result = result;
+    g_send_complete_count++;
+    real_DList_InitializeListHead(completed);
+}
+
+static bool my_IoTHubClient_LL_MessageCallback(IOTHUB_CLIENT_LL_HANDLE handle, MESSAGE_CALLBACK_INFO* messageData)
+{
+    (void)handle;
+    g_message_callback_info = messageData;
+    return g_message_callback_return_value;
+}
+
+static char* my_IoTHubClient_Auth_Get_SasToken(IOTHUB_AUTHORIZATION_HANDLE handle, const char* scope, size_t expire_time)
+{
+    char* result;
+    (void)handle;
+    g_get_sas_token_count++;
+    (void)snprintf(g_sas_token_scope, sizeof(g_sas_token_scope), "%s", (scope == NULL) ? "" : scope);
+    g_sas_token_expiry = expire_time;
+    result = (char*)my_gballoc_malloc(sizeof(TEST_SAS_TOKEN));
+    (void)strcpy(result, TEST_SAS_TOKEN);
+    return result;
+}
+
+static IOTHUB_MESSAGE_RESULT my_IoTHubMessage_GetByteArray(IOTHUB_MESSAGE_HANDLE iotHubMessageHandle, const unsigned char** buffer, size_t* size)
+{
+    (void)iotHubMessageHandle;
+    *buffer = contains3;
+    *size = 1;
+    return IOTHUB_MESSAGE_OK;
+}
+
+static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys, const char*const** values, size_t* count)
+{
+    (void)handle;
+    *keys = NULL;
+    *values = NULL;
+    *count = 0;
+    return MAP_OK;
+}
+
+static HTTP_CLIENT_HANDLE my_uhttp_client_create(const IO_INTERFACE_DESCRIPTION* io_interface_desc, const void* xio_param, ON_HTTP_ERROR_CALLBACK on_http_error, void* callback_ctx)
+{
+    (void)io_interface_desc;
+    (void)xio_param;
+    g_on_http_error = on_http_error;
+    g_http_error_ctx = callback_ctx;
+    g_uhttp_client_create_count++;
+    return (HTTP_CLIENT_HANDLE)my_gballoc_malloc(1);
+}
+
+static void my_uhttp_client_destroy(HTTP_CLIENT_HANDLE handle)
+{
+    g_uhttp_client_destroy_count++;
+    my_gballoc_free(handle);
+}
+
+static HTTP_CLIENT_RESULT my_uhttp_client_open(HTTP_CLIENT_HANDLE handle, const char* host, int port_num, ON_HTTP_OPEN_COMPLETE_CALLBACK on_connect, void* callback_ctx)
+{
+    (void)handle;
+    (void)host;
+    (void)port_num;
+    g_on_http_open = on_connect;
+    g_http_open_ctx = callback_ctx;
+    return HTTP_CLIENT_OK;
+}
+
+static HTTP_CLIENT_RESULT my_uhttp_client_execute_request(HTTP_CLIENT_HANDLE handle, HTTP_CLIENT_REQUEST_TYPE request_type, const char* relative_path,
+    HTTP_HEADERS_HANDLE http_header_handle, const unsigned char* content, size_t content_length, ON_HTTP_REQUEST_CALLBACK on_request_callback, void* callback_ctx)
+{
+    (void)handle;
+    (void)http_header_handle;
+    (void)content;
+    (void)content_length;
+    g_on_http_request = on_request_callback;
+    g_http_request_ctx = callback_ctx;
+    g_last_request_type = request_type;
+    (void)snprintf(g_last_relative_path, sizeof(g_last_relative_path), "%s", relative_path);
+    g_execute_request_count++;
+    return HTTP_CLIENT_OK;
+}
+
+BEGIN_TEST_SUITE(iothubtransporthttp_async_ut)
+
+TEST_SUITE_INITIALIZE(suite_init)
+{
+    int result;
+
+    TEST_INITIALIZE_MEMORY_DEBUG(g_dllByDll);
+    g_testByTest = TEST_MUTEX_CREATE();
+    ASSERT_IS_NOT_NULL(g_testByTest);
+
+    (void)umock_c_init(on_umock_c_error);
+
+    result = umocktypes_charptr_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    result = umocktypes_bool_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    result = umocktypes_stdint_register_types();
+    ASSERT_ARE_EQUAL(int, 0, result);
+
+    REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PREDICATE_FUNCTION, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_LL_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(const PDLIST_ENTRY, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_AUTHORIZATION_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(SINGLYLINKEDLIST_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(LIST_ITEM_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_ERROR_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_OPEN_COMPLETE_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_REQUEST_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(ON_HTTP_CLOSED_CALLBACK, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(time_t, long);
+
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CREDENTIAL_TYPE, int);
+    REGISTER_UMOCK_ALIAS_TYPE(SAS_TOKEN_STATUS, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CLIENT_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(HTTP_CALLBACK_REASON, int);
+
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
+
+    REGISTER_STRING_GLOBAL_MOCK_HOOK;
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_clone, NULL);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct, NULL);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_construct_n, NULL);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat, __FAILURE__);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(STRING_concat_with_STRING, __FAILURE__);
+
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_create, real_VECTOR_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_destroy, real_VECTOR_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_push_back, real_VECTOR_push_back);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_push_back, __FAILURE__);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_erase, real_VECTOR_erase);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_element, real_VECTOR_element);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_find_if, real_VECTOR_find_if);
+    REGISTER_GLOBAL_MOCK_HOOK(VECTOR_size, real_VECTOR_size);
+
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InitializeListHead, real_DList_InitializeListHead);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_IsListEmpty, real_DList_IsListEmpty);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertTailList, real_DList_InsertTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_InsertHeadList, real_DList_InsertHeadList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_AppendTailList, real_DList_AppendTailList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveEntryList, real_DList_RemoveEntryList);
+    REGISTER_GLOBAL_MOCK_HOOK(DList_RemoveHeadList, real_DList_RemoveHeadList);
+
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_create, real_singlylinkedlist_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_destroy, real_singlylinkedlist_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_add, real_singlylinkedlist_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(singlylinkedlist_add, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_remove, real_singlylinkedlist_remove);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_get_head_item, real_singlylinkedlist_get_head_item);
+    REGISTER_GLOBAL_MOCK_HOOK(singlylinkedlist_item_get_value, real_singlylinkedlist_item_get_value);
+
+    REGISTER_GLOBAL_MOCK_HOOK(URL_EncodeString, my_URL_EncodeString);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_EncodeString, NULL);
+
+    REGISTER_GLOBAL_MOCK_HOOK(get_time, my_get_time);
+    REGISTER_GLOBAL_MOCK_HOOK(get_difftime, my_get_difftime);
+
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Alloc, my_HTTPHeaders_Alloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Alloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Clone, my_HTTPHeaders_Clone);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_Clone, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_Free, my_HTTPHeaders_Free);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_AddHeaderNameValuePair, HTTP_HEADERS_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(HTTPHeaders_ReplaceHeaderNameValuePair, HTTP_HEADERS_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(HTTPHeaders_FindHeaderValue, TEST_ETAG_VALUE);
+    REGISTER_GLOBAL_MOCK_HOOK(HTTPHeaders_GetHeaderCount, my_HTTPHeaders_GetHeaderCount);
+
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_GetOption, my_IoTHubClient_LL_GetOption);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_SendComplete, my_IoTHubClient_LL_SendComplete);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_LL_MessageCallback, my_IoTHubClient_LL_MessageCallback);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_Auth_Get_Credential_Type, IOTHUB_CREDENTIAL_TYPE_DEVICE_KEY);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubClient_Auth_Get_SasToken, my_IoTHubClient_Auth_Get_SasToken);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubClient_Auth_Get_SasToken, NULL);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubClient_Auth_Is_SasToken_Valid, SAS_TOKEN_STATUS_VALID);
+
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_GetContentType, IOTHUBMESSAGE_BYTEARRAY);
+    REGISTER_GLOBAL_MOCK_HOOK(IoTHubMessage_GetByteArray, my_IoTHubMessage_GetByteArray);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_GetByteArray, IOTHUB_MESSAGE_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_Properties, TEST_MAP_EMPTY);
+    REGISTER_GLOBAL_MOCK_HOOK(Map_GetInternals, my_Map_GetInternals);
+    REGISTER_GLOBAL_MOCK_RETURN(IoTHubMessage_CreateFromByteArray, TEST_RECEIVED_MESSAGE_HANDLE);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(IoTHubMessage_CreateFromByteArray, NULL);
+
+    REGISTER_GLOBAL_MOCK_RETURN(platform_get_default_tlsio, TEST_INTERFACE_DESC);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(platform_get_default_tlsio, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_create, my_uhttp_client_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_destroy, my_uhttp_client_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_open, my_uhttp_client_open);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_open, HTTP_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_HOOK(uhttp_client_execute_request, my_uhttp_client_execute_request);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_execute_request, HTTP_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(uhttp_client_set_trace, HTTP_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_RETURN(uhttp_client_set_trusted_cert, HTTP_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_set_trusted_cert, HTTP_CLIENT_ERROR);
+    REGISTER_GLOBAL_MOCK_RETURN(uhttp_client_set_X509_cert, HTTP_CLIENT_OK);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(uhttp_client_set_X509_cert, HTTP_CLIENT_ERROR);
+
+    IoTHubTransportHttpAsync_SendMessageDisposition = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_SendMessageDisposition;
+    IoTHubTransportHttpAsync_Subscribe_DeviceTwin = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Subscribe_DeviceTwin;
+    IoTHubTransportHttpAsync_Subscribe_DeviceMethod = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Subscribe_DeviceMethod;
+    IoTHubTransportHttpAsync_ProcessItem = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_ProcessItem;
+    IoTHubTransportHttpAsync_GetHostname = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_GetHostname;
+    IoTHubTransportHttpAsync_SetOption = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_SetOption;
+    IoTHubTransportHttpAsync_Create = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Create;
+    IoTHubTransportHttpAsync_Destroy = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Destroy;
+    IoTHubTransportHttpAsync_Register = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Register;
+    IoTHubTransportHttpAsync_Unregister = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Unregister;
+    IoTHubTransportHttpAsync_Subscribe = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Subscribe;
+    IoTHubTransportHttpAsync_Unsubscribe = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_Unsubscribe;
+    IoTHubTransportHttpAsync_DoWork = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_DoWork;
+    IoTHubTransportHttpAsync_GetSendStatus = ((TRANSPORT_PROVIDER*)HTTP_Async_Protocol())->IoTHubTransport_GetSendStatus;
+}
+
+TEST_SUITE_CLEANUP(suite_cleanup)
+{
+    umock_c_deinit();
+
+    TEST_MUTEX_DESTROY(g_testByTest);
+    TEST_DEINITIALIZE_MEMORY_DEBUG(g_dllByDll);
+}
+
+TEST_FUNCTION_INITIALIZE(method_init)
+{
+    if (TEST_MUTEX_ACQUIRE(g_testByTest))
+    {
+        ASSERT_FAIL("Could not acquire test serialization mutex.");
+    }
+    umock_c_reset_all_calls();
+
+    real_DList_InitializeListHead(&waitingToSend);
+    real_DList_InitializeListHead(&waitingToSend2);
+
+    g_on_http_open = NULL;
+    g_http_open_ctx = NULL;
+    g_on_http_error = NULL;
+    g_http_error_ctx = NULL;
+    g_on_http_request = NULL;
+    g_http_request_ctx = NULL;
+    g_uhttp_client_create_count = 0;
+    g_uhttp_client_destroy_count = 0;
+    g_execute_request_count = 0;
+    g_last_request_type = HTTP_CLIENT_REQUEST_OPTIONS;
+    g_last_relative_path[0] = '\0';
+
+    g_current_time = TEST_GET_TIME_VALUE;
+
+    g_send_complete_result = IOTHUB_CLIENT_CONFIRMATION_ERROR;
+    g_send_complete_count = 0;
+
+    g_message_callback_info = NULL;
+    g_message_callback_return_value = true;
+
+    g_get_sas_token_count = 0;
+    g_sas_token_scope[0] = '\0';
+    g_sas_token_expiry = 0;
+}
+
+TEST_FUNCTION_CLEANUP(method_cleanup)
+{
+    TEST_MUTEX_RELEASE(g_testByTest);
+}
+
+static IOTHUB_DEVICE_HANDLE createAndRegister(TRANSPORT_LL_HANDLE* handle)
+{
+    IOTHUB_DEVICE_HANDLE result;
+    *handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+    ASSERT_IS_NOT_NULL(*handle);
+    result = IoTHubTransportHttpAsync_Register(*handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    ASSERT_IS_NOT_NULL(result);
+    return result;
+}
+
+/*runs DoWork until the connection of the device is open*/
+static void openDeviceConnection(TRANSPORT_LL_HANDLE handle)
+{
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_IS_NOT_NULL(g_on_http_open);
+    g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OK);
+}
+
+static int should_skip_index(size_t current_index, const size_t skip_array[], size_t length)
+{
+    int result = 0;
+    for (size_t index = 0; index < length; index++)
+    {
+        if (current_index == skip_array[index])
+        {
+            result = __LINE__;
+            break;
+        }
+    }
+    return result;
+}
+
+static void setPollingTimes(TRANSPORT_LL_HANDLE handle, unsigned int minimumPollingTime, unsigned int maximumPollingTime)
+{
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransportHttpAsync_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransportHttpAsync_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime));
+}
+
+/*receives a message on the open connection of a subscribed device, so a disposition can be sent for it*/
+static void receiveMessage(TRANSPORT_LL_HANDLE handle)
+{
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_GET, g_last_request_type);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+    ASSERT_IS_NOT_NULL(g_message_callback_info);
+}
+
+/*answers the GET in progress with statusCode and checks that the next GET is not issued at minimumInterval seconds, but is issued after maximumInterval seconds*/
+static void completeGETAndExpectNextGETBetween(TRANSPORT_LL_HANDLE handle, unsigned int statusCode, unsigned int minimumInterval, unsigned int maximumInterval)
+{
+    time_t lastPollTime = g_current_time;
+    size_t executeRequestCount = g_execute_request_count;
+
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, statusCode, TEST_RESPONSE_HEADERS);
+
+    g_current_time = lastPollTime + minimumInterval;
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, executeRequestCount, g_execute_request_count);
+
+    g_current_time = lastPollTime + maximumInterval + 1;
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, executeRequestCount + 1, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_GET, g_last_request_type);
+}
+
+static void setupCreateExpectedCalls(void)
+{
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_IOTHUB_NAME));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "."));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_IOTHUB_SUFFIX));
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG));
+}
+
+static void setupCreateDevicePathExpectedCalls(const char* prefix, const char* suffix)
+{
+    STRICT_EXPECTED_CALL(URL_EncodeString(TEST_DEVICE_ID));
+    STRICT_EXPECTED_CALL(STRING_construct(prefix));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "/devices/"));
+    STRICT_EXPECTED_CALL(STRING_concat_with_STRING(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, suffix));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+}
+
+static void setupCreateRequestHeadersExpectedCalls(bool isEventHeaders)
+{
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(TEST_IOTHUB_CLIENT_LL_HANDLE, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Connection", "Keep-Alive"));
+    STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", " "));
+    if (isEventHeaders)
+    {
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-to", "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT));
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Accept", "application/json"));
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/octet-stream"));
+    }
+}
+
+static void setupRegisterExpectedCalls(void)
+{
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_HANDLE));
+    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, TEST_DEVICE_ID));
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_DEVICE_ID));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    setupCreateDevicePathExpectedCalls(TEST_HOSTNAME, "");
+    setupCreateDevicePathExpectedCalls("", EVENT_ENDPOINT API_VERSION);
+    setupCreateDevicePathExpectedCalls("", MESSAGE_ENDPOINT_HTTP API_VERSION);
+    setupCreateDevicePathExpectedCalls("", MESSAGE_ENDPOINT_HTTP_ETAG);
+    setupCreateRequestHeadersExpectedCalls(false);
+    STRICT_EXPECTED_CALL(singlylinkedlist_create());
+    setupCreateDevicePathExpectedCalls("", EVENT_ENDPOINT);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    setupCreateRequestHeadersExpectedCalls(true);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+}
+
+/*the calls of the DoWork that sends message1 on an open connection, getting the first SAS token of the device*/
+static void setupDoWorkSendEventExpectedCalls(void)
+{
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, 0));
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(get_time(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_HANDLE));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken(TEST_AUTHORIZATION_HANDLE, TEST_SAS_TOKEN_SCOPE, TEST_GET_TIME_VALUE + 3600));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_SAS_TOKEN));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_SAS_TOKEN));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Clone(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(uhttp_client_execute_request(IGNORED_PTR_ARG, HTTP_CLIENT_REQUEST_POST, TEST_EVENT_PATH, IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(&waitingToSend));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    STRICT_EXPECTED_CALL(uhttp_client_dowork(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(get_difftime(IGNORED_NUM_ARG, IGNORED_NUM_ARG));
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_064: [ HTTP_Async_Protocol shall return a pointer to a TRANSPORT_PROVIDER holding the IoTHubTransportHttpAsync functions. ]*/
+TEST_FUNCTION(HTTP_Async_Protocol_succeeds)
+{
+    ///arrange
+
+    ///act
+    const TRANSPORT_PROVIDER* provider = HTTP_Async_Protocol();
+
+    ///assert
+    ASSERT_IS_NOT_NULL(provider);
+    ASSERT_IS_NOT_NULL((void*)provider->IoTHubTransport_Create);
+    ASSERT_IS_NOT_NULL((void*)provider->IoTHubTransport_DoWork);
+    ASSERT_IS_NOT_NULL((void*)provider->IoTHubTransport_SendMessageDisposition);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_001: [ If config, config->upperConfig, or its fields protocol, iotHubName or iotHubSuffix are NULL, then IoTHubTransportHttpAsync_Create shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Create_with_NULL_config_fails)
+{
+    ///arrange
+
+    ///act
+    TRANSPORT_LL_HANDLE result1 = IoTHubTransportHttpAsync_Create(NULL);
+    TRANSPORT_LL_HANDLE result2 = IoTHubTransportHttpAsync_Create(&TEST_CONFIG_NULL_CONFIG);
+    TRANSPORT_LL_HANDLE result3 = IoTHubTransportHttpAsync_Create(&TEST_CONFIG_NULL_IOTHUB_NAME);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_002: [ Otherwise IoTHubTransportHttpAsync_Create shall create the hostname iotHubName + "." + iotHubSuffix. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_006: [ Otherwise, IoTHubTransportHttpAsync_Create shall succeed and return a non-NULL value. No connection is opened until a device has work to do. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_063: [ If handle is NULL then IoTHubTransportHttpAsync_GetHostname shall fail and return NULL, otherwise it shall return a clone of the hostname. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Create_succeeds)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    STRING_HANDLE hostName;
+
+    ///act
+    handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(handle);
+    ASSERT_ARE_EQUAL(size_t, 0, g_uhttp_client_create_count);
+    hostName = IoTHubTransportHttpAsync_GetHostname(handle);
+    ASSERT_IS_NOT_NULL(hostName);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_IOTHUB_NAME "." TEST_IOTHUB_SUFFIX, real_STRING_c_str(hostName));
+
+    ///cleanup
+    real_STRING_delete(hostName);
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_003: [ If config->upperConfig->protocolGatewayHostName is not NULL, IoTHubTransportHttpAsync_Create shall use it as hostname. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Create_with_gateway_hostname_succeeds)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    STRING_HANDLE hostName;
+
+    ///act
+    handle = IoTHubTransportHttpAsync_Create(&TEST_GW_CONFIG);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(handle);
+    hostName = IoTHubTransportHttpAsync_GetHostname(handle);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_IOTHUB_GWHOSTNAME, real_STRING_c_str(hostName));
+
+    ///cleanup
+    real_STRING_delete(hostName);
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_005: [ If any of the transport resources fails to be created, then IoTHubTransportHttpAsync_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Create_VECTOR_create_fails)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(STRING_construct(TEST_IOTHUB_NAME));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, "."));
+    STRICT_EXPECTED_CALL(STRING_concat(IGNORED_PTR_ARG, TEST_IOTHUB_SUFFIX));
+    STRICT_EXPECTED_CALL(VECTOR_create(IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+
+    ///assert
+    ASSERT_IS_NULL(handle);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_005: [ If any of the transport resources fails to be created, then IoTHubTransportHttpAsync_Create shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Create_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    ///arrange
+    setupCreateExpectedCalls();
+
+    umock_c_negative_tests_snapshot();
+
+    ///act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubTransportHttpAsync_Create failure in test %zu/%zu", index, count);
+
+        TRANSPORT_LL_HANDLE result = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+
+        ///assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_008: [ If handle or device is NULL, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_009: [ If the deviceId or the authorization_module of the device, waitingToSend or iotHubClientHandle are NULL, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Register_with_NULL_arguments_fails)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+
+    ///act
+    IOTHUB_DEVICE_HANDLE result1 = IoTHubTransportHttpAsync_Register(NULL, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    IOTHUB_DEVICE_HANDLE result2 = IoTHubTransportHttpAsync_Register(handle, NULL, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    IOTHUB_DEVICE_HANDLE result3 = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_NULL_AUTHORIZATION, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    IOTHUB_DEVICE_HANDLE result4 = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, NULL, &waitingToSend);
+    IOTHUB_DEVICE_HANDLE result5 = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, NULL);
+
+    ///assert
+    ASSERT_IS_NULL(result1);
+    ASSERT_IS_NULL(result2);
+    ASSERT_IS_NULL(result3);
+    ASSERT_IS_NULL(result4);
+    ASSERT_IS_NULL(result5);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_010: [ If the credential type of the device is IOTHUB_CREDENTIAL_TYPE_X509_ECC, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Register_x509_ECC_fails)
+{
+    ///arrange
+    IOTHUB_DEVICE_HANDLE result;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_HANDLE))
+        .SetReturn(IOTHUB_CREDENTIAL_TYPE_X509_ECC);
+
+    ///act
+    result = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_014: [ IoTHubTransportHttpAsync_Register shall create the event path "/devices/" + URL_ENCODED(deviceId) + "/messages/events" + APIVERSION, the message path "/devices/" + URL_ENCODED(deviceId) + "/messages/devicebound" + APIVERSION, the abandon path "/devices/" + URL_ENCODED(deviceId) + "/messages/devicebound/" and the SAS token scope hostname + "/devices/" + URL_ENCODED(deviceId). ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_015: [ IoTHubTransportHttpAsync_Register shall create the event HTTP request headers ("User-Agent", "Connection": "Keep-Alive", "Authorization", "iothub-to": "/devices/" + URL_ENCODED(deviceId) + "/messages/events", "Accept": "application/json" and "Content-Type": "application/octet-stream") and the message HTTP request headers ("User-Agent", "Connection": "Keep-Alive" and "Authorization"). ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_016: [ IoTHubTransportHttpAsync_Register shall add the device to the devices list by calling VECTOR_push_back. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Register_succeeds)
+{
+    ///arrange
+    IOTHUB_DEVICE_HANDLE result;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+    setupRegisterExpectedCalls();
+
+    ///act
+    result = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(result);
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_013: [ If any of the device resources fails to be created, then IoTHubTransportHttpAsync_Register shall fail and return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Register_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    ///arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+    umock_c_reset_all_calls();
+    setupRegisterExpectedCalls();
+
+    umock_c_negative_tests_snapshot();
+
+    size_t calls_cannot_fail[] = { 0, 1, 3, 5, 11, 17, 23, 29, 31, 41, 42, 44, 51 };
+
+    ///act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+        {
+            continue;
+        }
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubTransportHttpAsync_Register failure in test %zu/%zu", index, count);
+
+        IOTHUB_DEVICE_HANDLE result = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+
+        ///assert
+        ASSERT_IS_NULL_WITH_MSG(result, tmp_msg);
+    }
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_011: [ If a device with the same deviceId is already registered, then IoTHubTransportHttpAsync_Register shall return NULL. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Register_same_device_twice_fails)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE result;
+    (void)createAndRegister(&handle);
+
+    ///act
+    result = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+
+    ///assert
+    ASSERT_IS_NULL(result);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_012: [ The event and message HTTP request headers shall have an "Authorization" header, unless the credential type is IOTHUB_CREDENTIAL_TYPE_X509 or IOTHUB_CREDENTIAL_TYPE_UNKNOWN (x509 certificates set through options). ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_016: [ IoTHubTransportHttpAsync_Register shall add the device to the devices list by calling VECTOR_push_back. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Register_two_devices_succeeds)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE device1;
+    IOTHUB_DEVICE_HANDLE device2;
+    umock_c_reset_all_calls();
+
+    ///act
+    device1 = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    device2 = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, &waitingToSend2);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(device1);
+    ASSERT_IS_NOT_NULL(device2);
+    ASSERT_ARE_NOT_EQUAL(void_ptr, device1, device2);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Unregister(device2);
+    IoTHubTransportHttpAsync_Unregister(device1);
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_017: [ If deviceHandle is NULL, then IoTHubTransportHttpAsync_Unregister shall do nothing. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Unregister_with_NULL_handle_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubTransportHttpAsync_Unregister(NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_018: [ IoTHubTransportHttpAsync_Unregister shall close the connection of the device, put the event being sent back in waitingToSend, free all the resources of the device and remove it from the devices list. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Unregister_closes_connection_and_restores_event)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    IOTHUB_DEVICE_HANDLE registeredAgain;
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) != 0);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, device));
+    STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
+    STRICT_EXPECTED_CALL(uhttp_client_close(IGNORED_PTR_ARG, NULL, NULL));
+    STRICT_EXPECTED_CALL(uhttp_client_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_AppendTailList(&waitingToSend, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveEntryList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InitializeListHead(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_get_head_item(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(singlylinkedlist_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    ///act
+    IoTHubTransportHttpAsync_Unregister(device);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_destroy_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) == 0);
+    ASSERT_ARE_EQUAL(void_ptr, &(message1.entry), waitingToSend.Flink);
+    registeredAgain = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    ASSERT_IS_NOT_NULL(registeredAgain);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_019: [ If handle is NULL or the device is not registered, then IoTHubTransportHttpAsync_Subscribe shall fail and return a non-zero value. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_Subscribe_with_NULL_handle_fails)
+{
+    ///arrange
+
+    ///act
+    int result = IoTHubTransportHttpAsync_Subscribe(NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_054: [ If handle is NULL, then IoTHubTransportHttpAsync_DoWork shall do nothing. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_with_NULL_handle_does_nothing)
+{
+    ///arrange
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(NULL, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_006: [ Otherwise, IoTHubTransportHttpAsync_Create shall succeed and return a non-NULL value. No connection is opened until a device has work to do. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_without_work_does_not_connect)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_uhttp_client_create_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_026: [ DoWork shall open the connection of a device that has work to do by calling uhttp_client_create with the default TLS IO, setting the "TrustedCerts", x509 certificate and private key and "logtrace" options received by SetOption, and calling uhttp_client_open on port 443 of the hostname. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_051: [ DoWork shall call uhttp_client_dowork for every device with a connection; it shall not wait for any request to complete. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_with_event_opens_connection)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_create_count);
+    ASSERT_IS_NOT_NULL(g_on_http_open);
+    ASSERT_ARE_EQUAL(size_t, 0, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_027: [ Once the connection is open, requests can be started for the device. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_032: [ The event shall be sent by calling uhttp_client_execute_request with HTTP_CLIENT_REQUEST_POST, the event path, the cloned headers and the message content. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_033: [ Once the request is queued, the event shall be moved from waitingToSend to the events in progress of the device. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_posts_event_once_open)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_POST, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_EVENT_PATH, g_last_relative_path);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) != 0);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_030: [ The event shall be sent with a clone of the event HTTP request headers, to which every message property is added as "iothub-app-name":"value", and the message id, correlation id, content type and content encoding as "iothub-messageid", "iothub-correlationid", "iothub-contenttype" and "iothub-contentencoding". ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_032: [ The event shall be sent by calling uhttp_client_execute_request with HTTP_CLIENT_REQUEST_POST, the event path, the cloned headers and the message content. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_posts_event_succeeds)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+    setupDoWorkSendEventExpectedCalls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_025: [ If no SAS token can be obtained, no request shall be started. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_029: [ If the content of the event cannot be obtained, or the event exceeds 255KB - 1 bytes (payload + 384 bytes, plus every property name and value + 16 bytes), it shall be removed from waitingToSend and IoTHubClient_LL_SendComplete shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_031: [ If building the request fails, the event shall stay in waitingToSend and be retried on a later DoWork. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_posts_event_fails)
+{
+    int negativeTestsInitResult = umock_c_negative_tests_init();
+    ASSERT_ARE_EQUAL(int, 0, negativeTestsInitResult);
+
+    ///arrange
+    setupDoWorkSendEventExpectedCalls();
+
+    umock_c_negative_tests_snapshot();
+
+    size_t calls_cannot_fail[] = { 0, 1, 2, 3, 4, 5, 6, 10, 11, 12, 13, 15, 16, 18, 19, 20, 21, 22, 24, 25, 26, 27, 28 };
+
+    ///act
+    size_t count = umock_c_negative_tests_call_count();
+    for (size_t index = 0; index < count; index++)
+    {
+        if (should_skip_index(index, calls_cannot_fail, sizeof(calls_cannot_fail) / sizeof(calls_cannot_fail[0])) != 0)
+        {
+            continue;
+        }
+
+        TRANSPORT_LL_HANDLE handle;
+        umock_c_reset_all_calls();
+        real_DList_InitializeListHead(&waitingToSend);
+        (void)createAndRegister(&handle);
+        real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+        openDeviceConnection(handle);
+        g_send_complete_count = 0;
+
+        umock_c_negative_tests_reset();
+        umock_c_negative_tests_fail_call(index);
+
+        char tmp_msg[64];
+        sprintf(tmp_msg, "IoTHubTransportHttpAsync_DoWork failure in test %zu/%zu", index, count);
+
+        IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+        ///assert
+        /*the event is either still waiting to be sent, or completed with an error, but it is not in progress*/
+        ASSERT_IS_TRUE_WITH_MSG((real_DList_IsListEmpty(&waitingToSend) == 0) ||
+            ((g_send_complete_count == 1) && (g_send_complete_result == IOTHUB_CLIENT_CONFIRMATION_ERROR)), tmp_msg);
+
+        ///cleanup
+        IoTHubTransportHttpAsync_Destroy(handle);
+    }
+
+    ///cleanup
+    umock_c_negative_tests_deinit();
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_022: [ Before a request is started, the "Authorization" headers of the device shall get a new SAS token if they have none yet, or if the one they hold was obtained 2880 seconds ago or more. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_023: [ Otherwise the SAS token shall be created by IoTHubClient_Auth_Get_SasToken for the SAS token scope, expiring in 3600 seconds. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_first_request_gets_SAS_token)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_get_sas_token_count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_SAS_TOKEN_SCOPE, g_sas_token_scope);
+    ASSERT_ARE_EQUAL(size_t, TEST_GET_TIME_VALUE + 3600, g_sas_token_expiry);
+    ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_022: [ Before a request is started, the "Authorization" headers of the device shall get a new SAS token if they have none yet, or if the one they hold was obtained 2880 seconds ago or more. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_refreshes_SAS_token_after_2880_seconds)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 204, TEST_RESPONSE_HEADERS);
+
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    g_current_time += 2879;
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(size_t, 1, g_get_sas_token_count);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 204, TEST_RESPONSE_HEADERS);
+
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    g_current_time += 1;
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 3, g_execute_request_count);
+    ASSERT_ARE_EQUAL(size_t, 2, g_get_sas_token_count);
+    ASSERT_ARE_EQUAL(size_t, TEST_GET_TIME_VALUE + 2880 + 3600, g_sas_token_expiry);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_024: [ If the device uses a SAS token provided by the application, that token shall be used as long as IoTHubClient_Auth_Is_SasToken_Valid reports it valid. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_uses_valid_application_SAS_token)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_HANDLE))
+        .SetReturn(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Is_SasToken_Valid(TEST_AUTHORIZATION_HANDLE));
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_get_sas_token_count);
+    ASSERT_ARE_EQUAL(char_ptr, "", g_sas_token_scope);
+    ASSERT_ARE_EQUAL(size_t, 0, g_sas_token_expiry);
+    ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_024: [ If the device uses a SAS token provided by the application, that token shall be used as long as IoTHubClient_Auth_Is_SasToken_Valid reports it valid. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_025: [ If no SAS token can be obtained, no request shall be started. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_with_invalid_application_SAS_token_starts_no_request)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_Credential_Type(TEST_AUTHORIZATION_HANDLE))
+        .SetReturn(IOTHUB_CREDENTIAL_TYPE_SAS_TOKEN);
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Is_SasToken_Valid(TEST_AUTHORIZATION_HANDLE))
+        .SetReturn(SAS_TOKEN_STATUS_INVALID);
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_get_sas_token_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_execute_request_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) == 0);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_025: [ If no SAS token can be obtained, no request shall be started. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_without_SAS_token_starts_no_request)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubClient_Auth_Get_SasToken(TEST_AUTHORIZATION_HANDLE, IGNORED_PTR_ARG, IGNORED_NUM_ARG))
+        .SetReturn(NULL);
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_execute_request_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) == 0);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_047: [ If the POST of an event completes with a status code < 300, IoTHubClient_LL_SendComplete shall be called with the events in progress and IOTHUB_CLIENT_CONFIRMATION_OK. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_event_completed_with_204_calls_SendComplete)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    IOTHUB_CLIENT_STATUS status;
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 204, TEST_RESPONSE_HEADERS);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_send_complete_count);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_OK, g_send_complete_result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransportHttpAsync_GetSendStatus(device, &status));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_048: [ Otherwise the events in progress shall be put back at the front of waitingToSend, to be retried. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_event_completed_with_500_is_retried)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 500, TEST_RESPONSE_HEADERS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 0, g_send_complete_count);
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_EVENT_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_029: [ If the content of the event cannot be obtained, or the event exceeds 255KB - 1 bytes (payload + 384 bytes, plus every property name and value + 16 bytes), it shall be removed from waitingToSend and IoTHubClient_LL_SendComplete shall be called with IOTHUB_CLIENT_CONFIRMATION_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_event_without_content_fails_the_event)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn(IOTHUB_MESSAGE_ERROR);
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_send_complete_count);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_CONFIRMATION_RESULT, IOTHUB_CLIENT_CONFIRMATION_ERROR, g_send_complete_result);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) != 0);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_046: [ If a request completes with a reason other than HTTP_CALLBACK_REASON_OK, the connection of the device shall be closed on the same DoWork. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_053: [ When the connection of a device is closed, the event in progress shall be put back at the front of waitingToSend. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_connection_error_closes_and_restores_event)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    IOTHUB_CLIENT_STATUS status;
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_error(g_http_error_ctx, HTTP_CALLBACK_REASON_ERROR);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_destroy_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) == 0);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, IoTHubTransportHttpAsync_GetSendStatus(device, &status));
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_050: [ After a connection fails, a new one shall not be opened for the device before 5 seconds have passed. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_reconnects_after_delay)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_open(g_http_open_ctx, HTTP_CALLBACK_REASON_OPEN_FAILED);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_destroy_count);
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_create_count);
+    g_current_time += 5;
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_uhttp_client_create_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_052: [ If a connection is not open, or a request is not completed, within 60 seconds, the connection of the device shall be closed. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_request_timeout_closes_connection)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    g_current_time += 61;
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_destroy_count);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) == 0);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_020: [ Otherwise, IoTHubTransportHttpAsync_Subscribe shall set the device so that subsequent calls to DoWork issue GET requests for messages, and return 0. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_034: [ Messages shall be requested by calling uhttp_client_execute_request with HTTP_CLIENT_REQUEST_GET, the message path and the message HTTP request headers. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_subscribed_issues_GET)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    ASSERT_ARE_EQUAL(int, 0, IoTHubTransportHttpAsync_Subscribe(device));
+    openDeviceConnection(handle);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_GET, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_MESSAGE_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_037: [ A GET shall not be issued earlier than the polling interval after the previous one, except for the first GET, when the previous GET received a message, or when time is not available. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_DoWork_GET_with_204_waits_for_polling_interval)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 204, TEST_RESPONSE_HEADERS);
+    umock_c_reset_all_calls();
+
+    ///act
+    g_current_time += 1;
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 1, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_038: [ The polling interval shall be "MinimumPollingTime" (default 25 minutes), without jitter, when "MaximumPollingTime" is not greater than it, or after a GET that did not answer with status code 204. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_without_MaximumPollingTime_polls_after_MinimumPollingTime)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    setPollingTimes(handle, 100, 0);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 100);
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 3, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_038: [ The polling interval shall be "MinimumPollingTime" (default 25 minutes), without jitter, when "MaximumPollingTime" is not greater than it, or after a GET that did not answer with status code 204. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GET_answered_with_error_status_polls_after_MinimumPollingTime)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    setPollingTimes(handle, 100, 1000);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 110);
+    completeGETAndExpectNextGETBetween(handle, 204, 200, 220);
+    umock_c_reset_all_calls();
+
+    ///act
+    completeGETAndExpectNextGETBetween(handle, 500, 100, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_066: [ After a GET that is not answered with 204, the back off shall start over, so the next GET answered without a message waits "MinimumPollingTime". ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GET_answered_with_204_after_a_message_polls_after_MinimumPollingTime)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    setPollingTimes(handle, 100, 1000);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 110);
+    completeGETAndExpectNextGETBetween(handle, 500, 100, 100);
+    umock_c_reset_all_calls();
+
+    ///act
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 110);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_065: [ The first polling interval of a device shall be delayed by IoTHubTransport_HTTP_Common_GetPollingPhaseOffset of that interval and of the order in which the device was registered, whether or not "MaximumPollingTime" is set. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_without_MaximumPollingTime_offsets_the_first_interval_of_the_second_registered_device)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    IoTHubTransportHttpAsync_Unregister(device);
+    device = IoTHubTransportHttpAsync_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, &waitingToSend);
+    ASSERT_IS_NOT_NULL(device);
+    setPollingTimes(handle, 100, 0);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    completeGETAndExpectNextGETBetween(handle, 204, 161, 161);
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 100);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 3, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_040: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", the polling interval shall double after every GET answered without a message, starting at "MinimumPollingTime" and capped at "MaximumPollingTime". Up to 10% of the doubled interval, chosen at random, shall be added to it, without exceeding "MaximumPollingTime". ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_with_MaximumPollingTime_polling_interval_doubles_with_jitter)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    setPollingTimes(handle, 100, 1000);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 110);
+    completeGETAndExpectNextGETBetween(handle, 204, 200, 220);
+    completeGETAndExpectNextGETBetween(handle, 204, 400, 440);
+    completeGETAndExpectNextGETBetween(handle, 204, 800, 880);
+    completeGETAndExpectNextGETBetween(handle, 204, 1000, 1000);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 6, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_040: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", the polling interval shall double after every GET answered without a message, starting at "MinimumPollingTime" and capped at "MaximumPollingTime". Up to 10% of the doubled interval, chosen at random, shall be added to it, without exceeding "MaximumPollingTime". ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_polling_interval_does_not_exceed_MaximumPollingTime)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    setPollingTimes(handle, 100, 150);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    completeGETAndExpectNextGETBetween(handle, 204, 100, 110);
+    completeGETAndExpectNextGETBetween(handle, 204, 150, 150);
+    completeGETAndExpectNextGETBetween(handle, 204, 150, 150);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 4, g_execute_request_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_039: [ If the GET fails, the next GET shall not wait for the polling interval. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_failed_GET_does_not_wait_for_polling_interval)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    setPollingTimes(handle, 100, 0);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_ERROR, NULL, 0, 0, NULL);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_destroy_count);
+    g_current_time += 5;
+    umock_c_reset_all_calls();
+
+    ///act
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_GET, g_last_request_type);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_041: [ If the GET is answered with status code 200, the next GET shall not wait for the polling interval, since more messages might be waiting. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_042: [ If the GET is answered with status code 200, the message shall be assembled from the content, its "iothub-app-" headers shall become properties and "iothub-messageid", "iothub-correlationid", "ContentType" and "ContentEncoding" shall become the message id, correlation id, content type and content encoding. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_045: [ The message shall be given to IoTHubClient_LL_MessageCallback; if it returns false, the message shall be queued to be abandoned. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GET_with_200_calls_MessageCallback)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+
+    ///assert
+    ASSERT_IS_NOT_NULL(g_message_callback_info);
+    ASSERT_ARE_EQUAL(void_ptr, TEST_RECEIVED_MESSAGE_HANDLE, g_message_callback_info->messageHandle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_GET, g_last_request_type);
+
+    ///cleanup
+    (void)IoTHubTransportHttpAsync_SendMessageDisposition(g_message_callback_info, IOTHUBMESSAGE_ACCEPTED);
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_043: [ If the "ETag" header is missing or is not a quoted string, the message shall be ignored. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GET_with_200_without_ETag_ignores_message)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(TEST_RESPONSE_HEADERS, "ETag"))
+        .SetReturn(NULL);
+
+    ///act
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+
+    ///assert
+    ASSERT_IS_NULL(g_message_callback_info);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_GET, g_last_request_type);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_043: [ If the "ETag" header is missing or is not a quoted string, the message shall be ignored. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GET_with_200_and_unquoted_ETag_ignores_message)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(TEST_RESPONSE_HEADERS, "ETag"))
+        .SetReturn(TEST_ETAG_VALUE_UNQUOTED);
+
+    ///act
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+
+    ///assert
+    ASSERT_IS_NULL(g_message_callback_info);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_GET, g_last_request_type);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_044: [ If assembling the message or its transport context fails, the message shall be queued to be abandoned. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GET_with_200_message_that_cannot_be_created_is_abandoned)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_CreateFromByteArray(IGNORED_PTR_ARG, 1))
+        .SetReturn(NULL);
+
+    ///act
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+
+    ///assert
+    ASSERT_IS_NULL(g_message_callback_info);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_POST, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ABANDON_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_045: [ The message shall be given to IoTHubClient_LL_MessageCallback; if it returns false, the message shall be queued to be abandoned. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_035: [ A message disposition shall be sent by calling uhttp_client_execute_request with: ... ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_MessageCallback_returning_false_abandons_message)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_message_callback_return_value = false;
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+    umock_c_reset_all_calls();
+
+    ///act
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_POST, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ABANDON_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_057: [ IoTHubTransportHttpAsync_SendMessageDisposition shall queue the disposition, to be sent to the service by a later DoWork, and return IOTHUB_CLIENT_OK. ]*/
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_028: [ When the connection of a device is open and no request is in progress, DoWork shall start, in this order of preference, the oldest pending message disposition, the oldest event in waitingToSend, or a GET for messages if polling is allowed. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_SendMessageDisposition_ACCEPTED_sends_DELETE_first)
+{
+    ///arrange
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    umock_c_reset_all_calls();
+
+    ///act
+    result = IoTHubTransportHttpAsync_SendMessageDisposition(g_message_callback_info, IOTHUBMESSAGE_ACCEPTED);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_DELETE, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_COMPLETE_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_035: [ A message disposition shall be sent by calling uhttp_client_execute_request with: ... ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_SendMessageDisposition_REJECTED_sends_DELETE_with_reject)
+{
+    ///arrange
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    receiveMessage(handle);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = IoTHubTransportHttpAsync_SendMessageDisposition(g_message_callback_info, IOTHUBMESSAGE_REJECTED);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_DELETE, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_REJECT_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_035: [ A message disposition shall be sent by calling uhttp_client_execute_request with: ... ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_SendMessageDisposition_ABANDONED_sends_POST_abandon)
+{
+    ///arrange
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    receiveMessage(handle);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = IoTHubTransportHttpAsync_SendMessageDisposition(g_message_callback_info, IOTHUBMESSAGE_ABANDONED);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_POST, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_ABANDON_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_049: [ Once the request of a message disposition completes with HTTP_CALLBACK_REASON_OK, the disposition shall be removed from the pending dispositions of the device; it is successful if the status code is 204, other status codes shall only be logged. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_disposition_answered_with_error_status_is_not_sent_again)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    receiveMessage(handle);
+    (void)IoTHubTransportHttpAsync_SendMessageDisposition(g_message_callback_info, IOTHUBMESSAGE_ACCEPTED);
+    IoTHubTransportHttpAsync_Unsubscribe(device);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 412, TEST_RESPONSE_HEADERS);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_uhttp_client_destroy_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_036: [ The disposition shall stay first in the pending dispositions of the device while its request is in progress, so that it is sent again on the next connection if the request does not complete with HTTP_CALLBACK_REASON_OK. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_disposition_is_sent_again_after_connection_error)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+    (void)IoTHubTransportHttpAsync_SendMessageDisposition(g_message_callback_info, IOTHUBMESSAGE_ACCEPTED);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    g_on_http_error(g_http_error_ctx, HTTP_CALLBACK_REASON_ERROR);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_current_time += 5;
+    umock_c_reset_all_calls();
+
+    ///act
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_uhttp_client_create_count);
+    ASSERT_ARE_EQUAL(size_t, 3, g_execute_request_count);
+    ASSERT_ARE_EQUAL(HTTP_CLIENT_REQUEST_TYPE, HTTP_CLIENT_REQUEST_DELETE, g_last_request_type);
+    ASSERT_ARE_EQUAL(char_ptr, TEST_COMPLETE_PATH, g_last_relative_path);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_049: [ Once the request of a message disposition completes with HTTP_CALLBACK_REASON_OK, the disposition shall be removed from the pending dispositions of the device; it is successful if the status code is 204, other status codes shall only be logged. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_disposition_completed_is_not_sent_again)
+{
+    ///arrange
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    (void)IoTHubTransportHttpAsync_Subscribe(device);
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, contains3, 1, 200, TEST_RESPONSE_HEADERS);
+    (void)IoTHubTransportHttpAsync_SendMessageDisposition(g_message_callback_info, IOTHUBMESSAGE_ACCEPTED);
+    IoTHubTransportHttpAsync_Unsubscribe(device);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    ///act
+    g_on_http_request(g_http_request_ctx, HTTP_CALLBACK_REASON_OK, NULL, 0, 204, TEST_RESPONSE_HEADERS);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(size_t, 2, g_execute_request_count);
+    ASSERT_ARE_EQUAL(size_t, 0, g_uhttp_client_destroy_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_056: [ If message_data, its messageHandle or its transportContext are NULL, IoTHubTransportHttpAsync_SendMessageDisposition shall fail and return IOTHUB_CLIENT_ERROR. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_SendMessageDisposition_with_NULL_message_data_fails)
+{
+    ///arrange
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttpAsync_SendMessageDisposition(NULL, IOTHUBMESSAGE_ACCEPTED);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_ERROR, result);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_058: [ IoTHubTransportHttpAsync_GetSendStatus shall return IOTHUB_CLIENT_INVALID_ARG if called with a NULL parameter or a device that is not registered. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GetSendStatus_with_NULL_arguments_fails)
+{
+    ///arrange
+    IOTHUB_CLIENT_STATUS status;
+
+    ///act
+    IOTHUB_CLIENT_RESULT result = IoTHubTransportHttpAsync_GetSendStatus(NULL, &status);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_059: [ IoTHubTransportHttpAsync_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if events are waiting to be sent or being sent, IOTHUB_CLIENT_SEND_STATUS_IDLE otherwise. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GetSendStatus_without_events_returns_IDLE)
+{
+    ///arrange
+    IOTHUB_CLIENT_STATUS status;
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = IoTHubTransportHttpAsync_GetSendStatus(device, &status);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_IDLE, status);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_059: [ IoTHubTransportHttpAsync_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if events are waiting to be sent or being sent, IOTHUB_CLIENT_SEND_STATUS_IDLE otherwise. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GetSendStatus_with_event_waiting_returns_BUSY)
+{
+    ///arrange
+    IOTHUB_CLIENT_STATUS status;
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    umock_c_reset_all_calls();
+
+    ///act
+    result = IoTHubTransportHttpAsync_GetSendStatus(device, &status);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_059: [ IoTHubTransportHttpAsync_GetSendStatus shall return IOTHUB_CLIENT_OK and status IOTHUB_CLIENT_SEND_STATUS_BUSY if events are waiting to be sent or being sent, IOTHUB_CLIENT_SEND_STATUS_IDLE otherwise. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_GetSendStatus_with_event_in_progress_returns_BUSY)
+{
+    ///arrange
+    IOTHUB_CLIENT_STATUS status;
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_LL_HANDLE handle;
+    IOTHUB_DEVICE_HANDLE device = createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    openDeviceConnection(handle);
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    ASSERT_IS_TRUE(real_DList_IsListEmpty(&waitingToSend) != 0);
+    umock_c_reset_all_calls();
+
+    ///act
+    result = IoTHubTransportHttpAsync_GetSendStatus(device, &status);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_STATUS, IOTHUB_CLIENT_SEND_STATUS_BUSY, status);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_060: [ If handle, option or value are NULL then IoTHubTransportHttpAsync_SetOption shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_SetOption_with_NULL_arguments_fails)
+{
+    ///arrange
+    unsigned int pollingTime = 10;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransportHttpAsync_SetOption(NULL, OPTION_MIN_POLLING_TIME, &pollingTime);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransportHttpAsync_SetOption(handle, NULL, &pollingTime);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubTransportHttpAsync_SetOption(handle, OPTION_MIN_POLLING_TIME, NULL);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result3);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_061: [ "MinimumPollingTime", "MaximumPollingTime", "TrustedCerts", "x509certificate", "x509privatekey" and "logtrace" shall be stored; certificates and "logtrace" apply to the connections opened afterwards. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_SetOption_TrustedCerts_applies_to_new_connections)
+{
+    ///arrange
+    IOTHUB_CLIENT_RESULT result;
+    TRANSPORT_LL_HANDLE handle;
+    (void)createAndRegister(&handle);
+    real_DList_InsertTailList(&waitingToSend, &(message1.entry));
+    umock_c_reset_all_calls();
+
+    /*failing the certificate makes the connection attempt visible in g_uhttp_client_destroy_count*/
+    STRICT_EXPECTED_CALL(uhttp_client_set_trusted_cert(IGNORED_PTR_ARG, "certificates"))
+        .SetReturn(HTTP_CLIENT_ERROR);
+
+    ///act
+    result = IoTHubTransportHttpAsync_SetOption(handle, "TrustedCerts", "certificates");
+    IoTHubTransportHttpAsync_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result);
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_create_count);
+    ASSERT_ARE_EQUAL(size_t, 1, g_uhttp_client_destroy_count);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+/*Tests_SRS_TRANSPORTHTTPASYNC_09_062: [ "Batching" shall only accept false; every other option shall return IOTHUB_CLIENT_INVALID_ARG. ]*/
+TEST_FUNCTION(IoTHubTransportHttpAsync_SetOption_Batching_true_fails)
+{
+    ///arrange
+    bool batchingOn = true;
+    bool batchingOff = false;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttpAsync_Create(&TEST_CONFIG);
+
+    ///act
+    IOTHUB_CLIENT_RESULT result1 = IoTHubTransportHttpAsync_SetOption(handle, OPTION_BATCHING, &batchingOn);
+    IOTHUB_CLIENT_RESULT result2 = IoTHubTransportHttpAsync_SetOption(handle, OPTION_BATCHING, &batchingOff);
+    IOTHUB_CLIENT_RESULT result3 = IoTHubTransportHttpAsync_SetOption(handle, "unknown", &batchingOff);
+
+    ///assert
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result1);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_OK, result2);
+    ASSERT_ARE_EQUAL(IOTHUB_CLIENT_RESULT, IOTHUB_CLIENT_INVALID_ARG, result3);
+
+    ///cleanup
+    IoTHubTransportHttpAsync_Destroy(handle);
+}
+
+TEST_FUNCTION(IoTHubTransportHttpAsync_Subscribe_DeviceTwin_is_not_supported)
+{
+    ///arrange
+
+    ///act
+    int result1 = IoTHubTransportHttpAsync_Subscribe_DeviceTwin((IOTHUB_DEVICE_HANDLE)0x1);
+    int result2 = IoTHubTransportHttpAsync_Subscribe_DeviceMethod((IOTHUB_DEVICE_HANDLE)0x1);
+    IOTHUB_PROCESS_ITEM_RESULT result3 = IoTHubTransportHttpAsync_ProcessItem((TRANSPORT_LL_HANDLE)0x1, IOTHUB_TYPE_DEVICE_TWIN, NULL);
+
+    ///assert
+    ASSERT_ARE_NOT_EQUAL(int, 0, result1);
+    ASSERT_ARE_NOT_EQUAL(int, 0, result2);
+    ASSERT_ARE_EQUAL(int, (int)IOTHUB_PROCESS_ERROR, (int)result3);
+}
+
+END_TEST_SUITE(iothubtransporthttp_async_ut)
@@ -5,10 +5,12 @@
 #include <cstdlib>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #else
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #endif
 
 #include <stdbool.h>
@@ -25,6 +27,11 @@ static void* my_gballoc_malloc(size_t size)
     return malloc(size);
 }
 
+static void* my_gballoc_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
 static void my_gballoc_free(void* ptr)
 {
     free(ptr);
@@ -48,6 +55,7 @@ static void my_gballoc_free(void* ptr)
 #include "iothub_client_options.h"
 #include "iothub_client_version.h"
 #include "iothub_client_private.h"
+#include "hash_index.h"
 #undef ENABLE_MOCKS
 
 #include "iothubtransporthttp.h"
@@ -839,6 +847,78 @@ static MAP_RESULT my_Map_GetInternals(MAP_HANDLE handle, const char*const** keys
     return MAP_OK;
 }
 
+#define TEST_HASH_INDEX_MAX_ITEMS 8
+
+typedef struct TEST_HASH_INDEX_TAG
+{
+    char keys[TEST_HASH_INDEX_MAX_ITEMS][64];
+    void* values[TEST_HASH_INDEX_MAX_ITEMS];
+} TEST_HASH_INDEX;
+
+static HASH_INDEX_HANDLE my_hash_index_create(size_t initial_bucket_count)
+{
+    (void)initial_bucket_count;
+    TEST_HASH_INDEX* index = (TEST_HASH_INDEX*)malloc(sizeof(TEST_HASH_INDEX));
+    memset(index, 0, sizeof(TEST_HASH_INDEX));
+    return (HASH_INDEX_HANDLE)index;
+}
+
+static void my_hash_index_destroy(HASH_INDEX_HANDLE index)
+{
+    free(index);
+}
+
+static void* my_hash_index_find(HASH_INDEX_HANDLE index, const char* key)
+{
+    TEST_HASH_INDEX* test_index = (TEST_HASH_INDEX*)index;
+    void* result = NULL;
+    for (size_t i = 0; i < TEST_HASH_INDEX_MAX_ITEMS; i++)
+    {
+        if (test_index->values[i] != NULL && strcmp(test_index->keys[i], key) == 0)
+        {
+            result = test_index->values[i];
+            break;
+        }
+    }
+    return result;
+}
+
+static int my_hash_index_add(HASH_INDEX_HANDLE index, const char* key, void* value)
+{
+    TEST_HASH_INDEX* test_index = (TEST_HASH_INDEX*)index;
+    int result = __LINE__;
+    if (my_hash_index_find(index, key) == NULL)
+    {
+        for (size_t i = 0; i < TEST_HASH_INDEX_MAX_ITEMS; i++)
+        {
+            if (test_index->values[i] == NULL)
+            {
+                (void)strcpy(test_index->keys[i], key);
+                test_index->values[i] = value;
+                result = 0;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
+static int my_hash_index_remove(HASH_INDEX_HANDLE index, const char* key)
+{
+    TEST_HASH_INDEX* test_index = (TEST_HASH_INDEX*)index;
+    int result = __LINE__;
+    for (size_t i = 0; i < TEST_HASH_INDEX_MAX_ITEMS; i++)
+    {
+        if (test_index->values[i] != NULL && strcmp(test_index->keys[i], key) == 0)
+        {
+            test_index->values[i] = NULL;
+            result = 0;
+            break;
+        }
+    }
+    return result;
+}
+
 static void setupCreateHappyPathAlloc(bool deallocateCreated)
 {
     STRICT_EXPECTED_CALL(gballoc_malloc(IGNORED_NUM_ARG));
@@ -887,12 +967,22 @@ static void setupCreateHappyPathPerDeviceList(bool deallocateCreated)
     }
 }
 
+static void setupCreateHappyPathPerDeviceIndex(bool deallocateCreated)
+{
+    STRICT_EXPECTED_CALL(hash_index_create(0));
+    if (deallocateCreated == true)
+    {
+        STRICT_EXPECTED_CALL(hash_index_destroy(IGNORED_PTR_ARG));
+    }
+}
+
 static void setupCreateHappyPath(bool deallocateCreated)
 {
     setupCreateHappyPathAlloc(deallocateCreated);
     setupCreateHappyPathHostname(deallocateCreated);
     setupCreateHappyPathApiExHandle(deallocateCreated);
     setupCreateHappyPathPerDeviceList(deallocateCreated);
+    setupCreateHappyPathPerDeviceIndex(deallocateCreated);
 }
 
 static void setupUnregisterOneDevice()
@@ -974,7 +1064,7 @@ static void setupRegisterHappyPathmessageHTTPrelativePath(bool deallocateCreated
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 }
 
-static void setupRegisterHappyPatheventHTTPrequestHeaders(bool deallocateCreated, bool is_x509_used)
+static void setupRegisterHappyPatheventHTTPrequestHeadersWithAuthorization(bool deallocateCreated, bool is_x509_used, const char* authorization)
 {
     STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
     STRICT_EXPECTED_CALL(STRING_construct("/devices/"));
@@ -985,7 +1075,7 @@ static void setupRegisterHappyPatheventHTTPrequestHeaders(bool deallocateCreated
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "iothub-to", "/devices/"  TEST_DEVICE_ID  EVENT_ENDPOINT));
     if (is_x509_used == false)
     {
-        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN));
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", authorization));
     }
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Accept", "application/json"));
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Connection", "Keep-Alive"));
@@ -1000,7 +1090,12 @@ static void setupRegisterHappyPatheventHTTPrequestHeaders(bool deallocateCreated
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 }
 
-static void setupRegisterHappyPathmessageHTTPrequestHeaders(bool deallocateCreated, bool is_x509_used)
+static void setupRegisterHappyPatheventHTTPrequestHeaders(bool deallocateCreated, bool is_x509_used)
+{
+    setupRegisterHappyPatheventHTTPrequestHeadersWithAuthorization(deallocateCreated, is_x509_used, TEST_BLANK_SAS_TOKEN);
+}
+
+static void setupRegisterHappyPathmessageHTTPrequestHeadersWithAuthorization(bool deallocateCreated, bool is_x509_used, const char* authorization)
 {
     STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
     STRICT_EXPECTED_CALL(IoTHubClient_LL_GetOption(IGNORED_PTR_ARG, OPTION_PRODUCT_INFO, IGNORED_PTR_ARG));
@@ -1008,7 +1103,7 @@ static void setupRegisterHappyPathmessageHTTPrequestHeaders(bool deallocateCreat
     STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "User-Agent", TEST_STRING_DATA));
     if (is_x509_used == false)
     {
-        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", TEST_BLANK_SAS_TOKEN));
+        STRICT_EXPECTED_CALL(HTTPHeaders_AddHeaderNameValuePair(IGNORED_PTR_ARG, "Authorization", authorization));
     }
     if (deallocateCreated == true)
     {
@@ -1016,6 +1111,11 @@ static void setupRegisterHappyPathmessageHTTPrequestHeaders(bool deallocateCreat
     }
 }
 
+static void setupRegisterHappyPathmessageHTTPrequestHeaders(bool deallocateCreated, bool is_x509_used)
+{
+    setupRegisterHappyPathmessageHTTPrequestHeadersWithAuthorization(deallocateCreated, is_x509_used, TEST_BLANK_SAS_TOKEN);
+}
+
 static void setupRegisterHappyPathabandonHTTPrelativePathBegin(bool deallocateCreated)
 {
     STRICT_EXPECTED_CALL(STRING_construct("/devices/"));
@@ -1057,19 +1157,20 @@ static void setupRegisterHappyPatheventConfirmations()
 
 static void setupRegisterHappyPathDeviceListAdd()
 {
+    STRICT_EXPECTED_CALL(hash_index_add(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_push_back(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
 }
 
 static void setupRegisterHappyPathWithSasToken(bool deallocateCreated)
 {
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     setupRegisterHappyPathAllocHandle(deallocateCreated);
     setupRegisterHappyPathcreate_deviceId(deallocateCreated);
     setupRegisterHappyPathcreate_deviceSasToken(deallocateCreated);
     setupRegisterHappyPatheventHTTPrelativePath(deallocateCreated);
     setupRegisterHappyPathmessageHTTPrelativePath(deallocateCreated);
-    setupRegisterHappyPatheventHTTPrequestHeaders(deallocateCreated, false);
-    setupRegisterHappyPathmessageHTTPrequestHeaders(deallocateCreated, false);
+    setupRegisterHappyPatheventHTTPrequestHeadersWithAuthorization(deallocateCreated, false, TEST_DEVICE_TOKEN);
+    setupRegisterHappyPathmessageHTTPrequestHeadersWithAuthorization(deallocateCreated, false, TEST_DEVICE_TOKEN);
     setupRegisterHappyPathabandonHTTPrelativePathBegin(deallocateCreated);
     setupRegisterHappyPathDeviceListAdd();
     setupRegisterHappyPatheventConfirmations();
@@ -1077,7 +1178,7 @@ static void setupRegisterHappyPathWithSasToken(bool deallocateCreated)
 
 static void setupRegisterHappyPath(bool deallocateCreated, bool is_x509_used)
 {
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
     setupRegisterHappyPathAllocHandle(deallocateCreated);
     setupRegisterHappyPathcreate_deviceId(deallocateCreated);
     setupRegisterHappyPathcreate_deviceKey(deallocateCreated, is_x509_used);
@@ -1102,6 +1203,46 @@ static void setupDoWorkLoopForNextDevice(size_t next)
     STRICT_EXPECTED_CALL(VECTOR_element(IGNORED_PTR_ARG, next));
 }
 
+static void setupDoMessagesForFailedGet(HTTPAPIEX_RESULT executeResult)
+{
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc()); /*because responseHeadearsHandle: a new instance of HTTP headers*/
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .SetReturn(executeResult);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+}
+
+/*runs a DoWork at pollTime, the GET (when allowed) is answered with 204 by my_HTTPAPIEX_SAS_ExecuteRequest*/
+static void doWorkAtPollTime(TRANSPORT_LL_HANDLE handle, time_t lastPollTime, time_t pollTime)
+{
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(pollTime);
+    STRICT_EXPECTED_CALL(get_difftime(pollTime, lastPollTime))
+        .SetReturn((double)(pollTime - lastPollTime));
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+}
+
+/*the GET is issued at pollTime and fails*/
+static void setupDoMessagesForFailedGetAtPollTime(time_t lastPollTime, time_t pollTime)
+{
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(pollTime);
+    STRICT_EXPECTED_CALL(get_difftime(pollTime, lastPollTime))
+        .SetReturn((double)(pollTime - lastPollTime));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+}
+
 BEGIN_TEST_SUITE(iothubtransporthttp_ut)
 
 TEST_SUITE_INITIALIZE(suite_init)
@@ -1127,6 +1268,7 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_UMOCK_ALIAS_TYPE(MAP_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(STRING_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(VECTOR_HANDLE, void*);
+    REGISTER_UMOCK_ALIAS_TYPE(HASH_INDEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTPAPIEX_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(PREDICATE_FUNCTION, void*);
     REGISTER_UMOCK_ALIAS_TYPE(HTTP_HEADERS_HANDLE, void*);
@@ -1139,12 +1281,15 @@ TEST_SUITE_INITIALIZE(suite_init)
 
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_CLIENT_CONFIRMATION_RESULT, int);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_RESULT, int);
+    REGISTER_UMOCK_ALIAS_TYPE(IOTHUBMESSAGE_CONTENT_TYPE, int);
     /*REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);
     REGISTER_UMOCK_ALIAS_TYPE(IOTHUB_MESSAGE_HANDLE, void*);*/
 
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_malloc, my_gballoc_malloc);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_malloc, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(gballoc_realloc, my_gballoc_realloc);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(gballoc_realloc, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(gballoc_free, my_gballoc_free);
 
     REGISTER_GLOBAL_MOCK_HOOK(BUFFER_new, real_BUFFER_new);
@@ -1192,6 +1337,14 @@ TEST_SUITE_INITIALIZE(suite_init)
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(VECTOR_find_if, NULL);
     REGISTER_GLOBAL_MOCK_HOOK(VECTOR_size, real_VECTOR_size);
 
+    REGISTER_GLOBAL_MOCK_HOOK(hash_index_create, my_hash_index_create);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(hash_index_create, NULL);
+    REGISTER_GLOBAL_MOCK_HOOK(hash_index_destroy, my_hash_index_destroy);
+    REGISTER_GLOBAL_MOCK_HOOK(hash_index_add, my_hash_index_add);
+    REGISTER_GLOBAL_MOCK_FAIL_RETURN(hash_index_add, __LINE__);
+    REGISTER_GLOBAL_MOCK_HOOK(hash_index_find, my_hash_index_find);
+    REGISTER_GLOBAL_MOCK_HOOK(hash_index_remove, my_hash_index_remove);
+
     REGISTER_GLOBAL_MOCK_HOOK(URL_EncodeString, my_URL_EncodeString);
     REGISTER_GLOBAL_MOCK_FAIL_RETURN(URL_EncodeString, NULL);
 
@@ -1433,6 +1586,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_with_NULL_iothub_suffix_fails)
 //Tests_SRS_TRANSPORTMULTITHTTP_17_005: [If config->upperConfig->protocolGatewayHostName is NULL, `IoTHubTransportHttp_Create` shall create an immutable string (further called hostname) containing `config->transportConfig->iotHubName + config->transportConfig->iotHubSuffix`.] 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_007: [ IoTHubTransportHttp_Create shall create a HTTPAPIEX_HANDLE by a call to HTTPAPIEX_Create passing for hostName the hostname so far constructed by IoTHubTransportHttp_Create. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_009: [ IoTHubTransportHttp_Create shall call VECTOR_create to create a list of registered devices. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_005: [ IoTHubTransportHttp_Create shall call hash_index_create to create an index of the registered devices by device id. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_130: [ IoTHubTransportHttp_Create shall allocate memory for the handle. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_011: [ Otherwise, IoTHubTransportHttp_Create shall succeed and return a non-NULL value. ]
 TEST_FUNCTION(IoTHubTransportHttp_Create_happy_path)
@@ -1476,6 +1630,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_happy_path_with_gwhostname)
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_010: [ If creating the list fails, then IoTHubTransportHttp_Create shall fail and return NULL. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_006: [ If creating the index fails, then IoTHubTransportHttp_Create shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_008: [ If creating the HTTPAPIEX_HANDLE fails then IoTHubTransportHttp_Create shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_006: [ If creating the hostname fails then IoTHubTransportHttp_Create shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_006: [ If creating the hostname fails then IoTHubTransportHttp_Create shall fail and return NULL. ]
@@ -1490,6 +1645,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Create_fails)
     setupCreateHappyPathHostname(false);
     setupCreateHappyPathApiExHandle(false);
     setupCreateHappyPathPerDeviceList(false);
+    setupCreateHappyPathPerDeviceIndex(false);
 
     umock_c_negative_tests_snapshot();
 
@@ -1542,6 +1698,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Destroy_succeeds_NoRegistered_devices)
     STRICT_EXPECTED_CALL(HTTPAPIEX_Destroy(IGNORED_PTR_ARG));                                             //HTTPAPIEX_HANDLE httpApiExHandle;
     STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(handle));
 
     //act
@@ -1566,6 +1723,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Destroy_succeeds_One_Registered_device)
     STRICT_EXPECTED_CALL(gballoc_free(devHandle));
 
     STRICT_EXPECTED_CALL(VECTOR_destroy(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_destroy(IGNORED_PTR_ARG));
     STRICT_EXPECTED_CALL(gballoc_free(handle));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
 
@@ -1596,6 +1754,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Destroy_succeeds_One_Registered_device)
 //Tests_SRS_TRANSPORTMULTITHTTP_17_040: [ IoTHubTransportHttp_Register shall put event HTTP relative path, message HTTP relative path, event HTTP request headers, message HTTP request headers, abandonHTTPrelativePathBegin, HTTPAPIEX_SAS_HANDLE, and the device handle into a device structure. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_128: [ IoTHubTransportHttp_Register shall mark this device as unsubscribed. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_041: [ IoTHubTransportHttp_Register shall call VECTOR_push_back to store the new device information. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_002: [ IoTHubTransportHttp_Register shall index the new device by deviceId by calling hash_index_add. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_043: [ Upon success, IoTHubTransportHttp_Register shall store the transport handle, iotHubClientHandle, and the waitingToSend queue in the device handle return a non-NULL value. ]
 TEST_FUNCTION(IoTHubTransportHttp_Register_HappyPath_with_deviceKey_success_fun_time)
 {
@@ -1626,6 +1785,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_HappyPath_with_deviceKey_success_fun_
 //"Connection" : "Keep-Alive" ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_132: [ IoTHubTransportHttp_Register shall create a set of HTTP headers (further called "message HTTP request headers") consisting of the following fixed field names and values:
 //"Authorization": "" ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_014: [ If a deviceSasToken exists, the "Authorization" header of the event HTTP request headers and of the message HTTP request headers shall be set to it, instead of "". ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_024: [ IoTHubTransportHttp_Register shall create a STRING containing: "/devices/" + URL_ENCODED(device id) +"/messages/deviceBound/" called abandonHTTPrelativePathBegin. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_026: [ IoTHubTransportHttp_Register shall invoke URL_EncodeString with an argument of device id. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_028: [ IoTHubTransportHttp_Register shall invoke STRING_clone using the previously created hostname. ]
@@ -1666,9 +1826,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_2nd_device_HappyPath_success_fun_time
     IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
     umock_c_reset_all_calls();
 
-    // find in vector..
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    // find in index..
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, TEST_DEVICE_1.deviceId));
     setupRegisterHappyPathAllocHandle(false);
     setupRegisterHappyPathcreate_deviceId(false);
     setupRegisterHappyPathcreate_deviceKey(false, false);
@@ -1698,6 +1857,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_2nd_device_HappyPath_success_fun_time
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_001: [ IoTHubTransportHttp_Register shall look deviceId up in the devices index by calling hash_index_find. ]
 TEST_FUNCTION(IoTHubTransportHttp_Register_sameDevice_twice_returns_null)
 {
     //arrange
@@ -1706,10 +1866,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_sameDevice_twice_returns_null)
     (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    // find in vector.. 2 and 1a
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
-    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    // find in index.. 1a
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, TEST_DEVICE_1.deviceId));
 
     //act 
     IOTHUB_DEVICE_HANDLE devHandle1b = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
@@ -1723,6 +1881,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_sameDevice_twice_returns_null)
 }
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_042: [ If the VECTOR_push_back fails then IoTHubTransportHttp_Register shall fail and return NULL. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_003: [ If hash_index_add fails then IoTHubTransportHttp_Register shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_037: [ If the HTTPAPIEX_SAS_Create fails then IoTHubTransportHttp_Register shall fail and return NULL. ]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_029: [ If the clone fails then IoTHubTransportHttp_Register shall fail and return NULL. ] 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_141: [ If the STRING_concat fails, then it shall fail and return NULL. ]
@@ -1742,7 +1901,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_HappyPath_with_deviceKey_fail)
 
     umock_c_negative_tests_snapshot();
 
-    size_t calls_cannot_fail[] = { 0, 8, 13, 19, 24, 25, 27, 28, 30, 31, 38, 46, 47, 48, 50, 51 };
+    size_t calls_cannot_fail[] = { 0, 8, 13, 19, 24, 25, 27, 28, 30, 31, 38, 46, 47, 48, 51, 52 };
 
     //act
     size_t count = umock_c_negative_tests_call_count();
@@ -2831,13 +2990,14 @@ TEST_FUNCTION(IoTHubTransportHttp_Register_create_deviceId_fails)
 #endif
 
 //Tests_SRS_TRANSPORTMULTITHTTP_17_137: [ IoTHubTransportHttp_Register shall search the devices list for any device matching name deviceId. If deviceId is found it shall return NULL. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_001: [ IoTHubTransportHttp_Register shall look deviceId up in the devices index by calling hash_index_find. ]
 TEST_FUNCTION(IoTHubTransportHttp_Register_deviceFoundInList_fails)
 {
     //arrange
     TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG)).SetReturn((void_ptr)0x1);
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, TEST_DEVICE_1.deviceId)).SetReturn((void_ptr)0x1);
 
     //act
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
@@ -2969,6 +3129,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_null_does_nothing)
 //Tests_SRS_TRANSPORTMULTITHTTP_17_045: [IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list by calling VECTOR_find_if.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_047 : [IoTHubTransportHttp_Unregister shall free all the resources used in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_048 : [IoTHubTransportHttp_Unregister shall call VECTOR_erase to remove device from devices list.]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_004: [ IoTHubTransportHttp_Unregister shall remove the device from the devices index by calling hash_index_remove. ]
 TEST_FUNCTION(IoTHubTransportHttp_Unregister_superHappyFunPath)
 {
     //arrange
@@ -2977,6 +3138,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_superHappyFunPath)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_remove(IGNORED_PTR_ARG, TEST_DEVICE_1.deviceId));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     setupUnregisterOneDevice();
     STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
@@ -2995,6 +3158,7 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_superHappyFunPath)
 //Tests_SRS_TRANSPORTMULTITHTTP_17_045: [IoTHubTransportHttp_Unregister shall locate deviceHandle in the transport device list by calling VECTOR_find_if.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_047 : [IoTHubTransportHttp_Unregister shall free all the resources used in the device structure.]
 //Tests_SRS_TRANSPORTMULTITHTTP_17_048 : [IoTHubTransportHttp_Unregister shall call VECTOR_erase to remove device from devices list.]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_004: [ IoTHubTransportHttp_Unregister shall remove the device from the devices index by calling hash_index_remove. ]
 TEST_FUNCTION(IoTHubTransportHttp_Unregister_2nd_device_superHappyFunPath)
 {
     //arrange
@@ -3004,6 +3168,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Unregister_2nd_device_superHappyFunPath)
     umock_c_reset_all_calls();
 
     STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle1));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_remove(IGNORED_PTR_ARG, TEST_DEVICE_1.deviceId));
     STRICT_EXPECTED_CALL(STRING_delete(IGNORED_PTR_ARG));
     setupUnregisterOneDevice();
     STRICT_EXPECTED_CALL(VECTOR_erase(IGNORED_PTR_ARG, IGNORED_PTR_ARG, 1));
@@ -3061,7 +3227,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_with_non_NULL_parameter_succeeds)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
     int result = IoTHubTransportHttp_Subscribe(devHandle);
@@ -3084,8 +3251,10 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_2devices_succeeds)
     IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle1));
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle2));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
     int result1 = IoTHubTransportHttp_Subscribe(devHandle1);
@@ -3108,7 +3277,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Subscribe_with_list_find_fails)
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .SetReturn((void_ptr)NULL);
 
     //act
@@ -3144,7 +3314,8 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_non_NULL_parameter_succeeds)
     IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
     IoTHubTransportHttp_Unsubscribe(devHandle);
@@ -3166,8 +3337,10 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_2devices_succeeds)
     IOTHUB_DEVICE_HANDLE devHandle2 = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle));
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle2));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG));
 
     //act
     IoTHubTransportHttp_Unsubscribe(devHandle);
@@ -3189,8 +3362,9 @@ TEST_FUNCTION(IoTHubTransportHttp_Unsubscribe_with_device_not_found_does_nothing
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
-        .SetFailReturn((void_ptr)NULL);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .SetReturn((void_ptr)NULL);
 
     //act
     IoTHubTransportHttp_Unsubscribe(devHandle);
@@ -3474,6 +3648,576 @@ TEST_FUNCTION(IoTHubTransportHttp_DoWork_happy_path_with_2_registered_devices_em
     IoTHubTransportHttp_Destroy(handle);
 }
 
+//Tests_SRS_TRANSPORTMULTITHTTP_09_007: [ If an HTTP request fails with HTTPAPIEX_RECOVERYFAILED, IoTHubTransportHttp_DoWork shall not execute HTTP requests for the remaining devices. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_skips_2nd_device_when_HTTPAPIEX_SAS_ExecuteRequest_fails_recovery)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
+
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    setupDoMessagesForFailedGet(HTTPAPIEX_RECOVERYFAILED);
+
+    /*no work for the second device because the connection could not be recovered*/
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_008: [ IoTHubTransportHttp_DoWork shall start the loop at the device following the one being serviced when the connection was lost. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_2devices_starts_at_2nd_device_after_HTTPAPIEX_SAS_ExecuteRequest_fails_recovery)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_2, TEST_IOTHUB_CLIENT_LL_HANDLE2, TEST_CONFIG2.waitingToSend);
+
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupDoMessagesForFailedGet(HTTPAPIEX_RECOVERYFAILED);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(VECTOR_size(IGNORED_PTR_ARG));
+    setupDoWorkLoopForNextDevice(1);
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend2));
+    setupDoWorkLoopForNextDevice(0);
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend)); /*because DoWork for event*/
+    setupDoMessagesForFailedGet(HTTPAPIEX_ERROR);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_056: [ IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...] ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_058: [ If IoTHubMessage has properties, then they shall be serialized at the same level as "body" using the following pattern: "properties":{"iothub-app-name1":"value1","iothub-app-name2":"value2"} ]
+//Tests_SRS_TRANSPORTMULTITHTTP_17_070: [ If HTTPAPIEX_SAS_ExecuteRequest does not fail and http status code <300 then IoTHubTransportHttp_DoWork shall call IoTHubClient_LL_SendComplete. Parameter PDLIST_ENTRY completed shall point to a list containing all the items batched, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_OK. The batched items shall be removed from waitingToSend. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_2_batched_event_items_builds_1_JSON_payload)
+{
+    //arrange
+    static const char expectedPayload[] = "[{\"body\":\"MQ==\"},{\"body\":\"MTIzNDU2\",\"properties\":{\"iothub-app-" TEST_RED_KEY "\":\"" TEST_RED_VALUE "\"}}]";
+    bool batching = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message6.entry));
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_1, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_1));
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(NULL, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message1.entry)));
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_6, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_6));
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_1_PROPERTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_realloc(IGNORED_PTR_ARG, IGNORED_NUM_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message6.entry)));
+
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(BUFFER_build(IGNORED_PTR_ARG, IGNORED_PTR_ARG, sizeof(expectedPayload) - 1))
+        .ValidateArgumentBuffer(2, expectedPayload, sizeof(expectedPayload) - 1);
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_OK));
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(gballoc_free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+static char capturedPayload[256];
+static size_t capturedPayloadLength;
+static int my_BUFFER_build_capture(BUFFER_HANDLE handle, const unsigned char* source, size_t size)
+{
+    if (size <= sizeof(capturedPayload))
+    {
+        (void)memcpy(capturedPayload, source, size);
+        capturedPayloadLength = size;
+    }
+    return real_BUFFER_build(handle, source, size);
+}
+
+/*decodes the next "body" of capturedPayload, starting at *position; returns the number of bytes decoded*/
+static size_t decodeNextCapturedBody(size_t* position, unsigned char* decoded, size_t* encodedLength)
+{
+    static const char bodyBegin[] = "{\"body\":\"";
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t length = 0;
+    size_t begin;
+    size_t end;
+
+    begin = *position;
+    while (begin + sizeof(bodyBegin) - 1 < capturedPayloadLength && memcmp(capturedPayload + begin, bodyBegin, sizeof(bodyBegin) - 1) != 0)
+    {
+        begin++;
+    }
+    begin += sizeof(bodyBegin) - 1;
+
+    end = begin;
+    while (end < capturedPayloadLength && capturedPayload[end] != '"')
+    {
+        end++;
+    }
+
+    *encodedLength = end - begin;
+    *position = end;
+
+    for (; begin + 4 <= end; begin += 4)
+    {
+        uint32_t quad = 0;
+        size_t padding = 0;
+        size_t j;
+        for (j = 0; j < 4; j++)
+        {
+            quad <<= 6;
+            if (capturedPayload[begin + j] == '=')
+            {
+                padding++;
+            }
+            else
+            {
+                quad |= (uint32_t)(strchr(alphabet, capturedPayload[begin + j]) - alphabet);
+            }
+        }
+
+        decoded[length++] = (unsigned char)(quad >> 16);
+        if (padding < 2)
+        {
+            decoded[length++] = (unsigned char)(quad >> 8);
+        }
+        if (padding < 1)
+        {
+            decoded[length++] = (unsigned char)quad;
+        }
+    }
+
+    return length;
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_056: [ IoTHubTransportHttp_DoWork shall build the following string:[{"body":"base64 encoding of the message1 content"},{"body":"base64 encoding of the message2 content"}...] ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_batched_event_items_of_every_length_mod_3_round_trips_base64)
+{
+    //arrange
+    static const unsigned char* const expectedBodies[] = { buffer1, buffer2, buffer3 };
+    static const size_t expectedSizes[] = { sizeof(buffer1), sizeof(buffer2), sizeof(buffer3) };
+    bool batching = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+    DList_InsertTailList(&(waitingToSend), &(message1.entry));
+    DList_InsertTailList(&(waitingToSend), &(message2.entry));
+    DList_InsertTailList(&(waitingToSend), &(message3.entry));
+    capturedPayloadLength = 0;
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_build, my_BUFFER_build_capture);
+    umock_c_reset_all_calls();
+
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_POST, "/devices/" TEST_DEVICE_ID EVENT_ENDPOINT API_VERSION, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, NULL, NULL))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &httpStatus200, sizeof(httpStatus200));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_NOT_EQUAL(size_t, 0, capturedPayloadLength);
+    {
+        size_t position = 0;
+        size_t i;
+        for (i = 0; i < sizeof(expectedSizes) / sizeof(expectedSizes[0]); i++)
+        {
+            unsigned char decoded[sizeof(capturedPayload)];
+            size_t encodedLength;
+            size_t decodedLength = decodeNextCapturedBody(&position, decoded, &encodedLength);
+
+            ASSERT_ARE_EQUAL(size_t, 4 * ((expectedSizes[i] + 2) / 3), encodedLength);
+            ASSERT_ARE_EQUAL(size_t, expectedSizes[i], decodedLength);
+            ASSERT_ARE_EQUAL(int, 0, memcmp(expectedBodies[i], decoded, decodedLength));
+        }
+    }
+
+    //cleanup
+    REGISTER_GLOBAL_MOCK_HOOK(BUFFER_build, real_BUFFER_build);
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_17_065: [ If the oldest message in waitingToSend causes the message size to exceed the message size limit then it shall be removed from waitingToSend, and IoTHubClient_LL_SendComplete shall be called. Parameter PDLIST_ENTRY completed shall point to a list containing only the oldest item, and parameter IOTHUB_CLIENT_CONFIRMATION_RESULT result shall be set to IOTHUB_CLIENT_CONFIRMATION_BATCHSTATE_FAILED. ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_009: [ The size of each message shall be checked against the message size limit before its content is encoded into the payload. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_1_batched_event_item_bigger_than_256K_is_not_encoded)
+{
+    //arrange
+    bool batching = true;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    (void)IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_BATCHING, &batching);
+    DList_InsertTailList(&(waitingToSend), &(message4.entry));
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(HTTPHeaders_ReplaceHeaderNameValuePair(IGNORED_PTR_ARG, "Content-Type", "application/vnd.microsoft.iothub.json"));
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE_4));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE_4, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE_4));
+    STRICT_EXPECTED_CALL(Map_GetInternals(TEST_MAP_EMPTY, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_RemoveHeadList(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(DList_InsertTailList(IGNORED_PTR_ARG, &(message4.entry)));
+    STRICT_EXPECTED_CALL(gballoc_free(NULL));
+
+    STRICT_EXPECTED_CALL(IoTHubClient_LL_SendComplete(TEST_IOTHUB_CLIENT_LL_HANDLE, IGNORED_PTR_ARG, IOTHUB_CLIENT_CONFIRMATION_ERROR));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_011: [ If status code is 200, the next GET shall not wait for the polling interval, since more messages might be waiting. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_after_a_service_message_polls_again_without_waiting)
+{
+    //arrange
+    unsigned int statusCode200 = 200;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupDoMessagesForFailedGet(HTTPAPIEX_ERROR);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_014: [ If a deviceSasToken exists, the "Authorization" header of the event HTTP request headers and of the message HTTP request headers shall be set to it, instead of "". ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_deviceSasToken_GET_does_not_patch_the_Authorization_header)
+{
+    //arrange
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_3, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG)); /*because relativePath is a STRING_HANDLE*/
+    STRICT_EXPECTED_CALL(HTTPAPIEX_ExecuteRequest(IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .SetReturn(HTTPAPIEX_ERROR);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_010: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", the polling interval shall double after every GET answered without a message, starting at "MinimumPollingTime" and capped at "MaximumPollingTime". ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_013: [ "MaximumPollingTime" ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_MaximumPollingTime_backs_off_after_2_polls_without_messages)
+{
+    //arrange
+    unsigned int minimumPollingTime = 20;
+    unsigned int maximumPollingTime = 80;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime);
+    umock_c_reset_all_calls();
+
+    /*the first GET is always allowed, the second one happens 3s past the minimum polling time, both get 204*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 23);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 23, TEST_GET_TIME_VALUE))
+        .SetReturn(23);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 23 + 23);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 23 + 23, TEST_GET_TIME_VALUE + 23))
+        .SetReturn(23);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_015: [ If "MaximumPollingTime" is not greater than "MinimumPollingTime", the polling interval shall be "MinimumPollingTime", without back off or jitter. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_without_MaximumPollingTime_polls_right_after_MinimumPollingTime)
+{
+    //arrange
+    unsigned int minimumPollingTime = 100;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    umock_c_reset_all_calls();
+
+    /*2 GETs answered with 204, jitter would have delayed the second one past 101s*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    doWorkAtPollTime(handle, TEST_GET_TIME_VALUE, TEST_GET_TIME_VALUE + 101);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupDoMessagesForFailedGetAtPollTime(TEST_GET_TIME_VALUE + 101, TEST_GET_TIME_VALUE + 101 + 101);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_010: [ If "MaximumPollingTime" is greater than "MinimumPollingTime", the polling interval shall double after every GET answered without a message, starting at "MinimumPollingTime" and capped at "MaximumPollingTime". ]
+//Tests_SRS_TRANSPORTMULTITHTTP_09_012: [ Up to 10% of the doubled interval, chosen at random, shall be added to it; the jitter shall not be doubled by later GETs and the result shall not exceed "MaximumPollingTime". ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_MaximumPollingTime_does_not_double_the_jitter)
+{
+    //arrange
+    unsigned int minimumPollingTime = 100;
+    unsigned int maximumPollingTime = 1000;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime);
+    umock_c_reset_all_calls();
+
+    /*GETs answered with 204 once each interval (100s, 200s) plus its largest jitter has passed, the next interval is 400s + at most 40s*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    doWorkAtPollTime(handle, TEST_GET_TIME_VALUE, TEST_GET_TIME_VALUE + 111);
+    doWorkAtPollTime(handle, TEST_GET_TIME_VALUE + 111, TEST_GET_TIME_VALUE + 111 + 221);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupDoMessagesForFailedGetAtPollTime(TEST_GET_TIME_VALUE + 111 + 221, TEST_GET_TIME_VALUE + 111 + 221 + 441);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_012: [ Up to 10% of the doubled interval, chosen at random, shall be added to it; the jitter shall not be doubled by later GETs and the result shall not exceed "MaximumPollingTime". ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_MaximumPollingTime_does_not_wait_longer_than_MaximumPollingTime)
+{
+    //arrange
+    unsigned int minimumPollingTime = 100;
+    unsigned int maximumPollingTime = 150;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime);
+    umock_c_reset_all_calls();
+
+    /*2 GETs answered with 204, the interval that follows is capped at 150s, jitter included*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    doWorkAtPollTime(handle, TEST_GET_TIME_VALUE, TEST_GET_TIME_VALUE + 111);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupDoMessagesForFailedGetAtPollTime(TEST_GET_TIME_VALUE + 111, TEST_GET_TIME_VALUE + 111 + 151);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_016: [ The first polling interval of a device shall be delayed by IoTHubTransport_HTTP_Common_GetPollingPhaseOffset of that interval and of the order in which the device was registered, whether or not "MaximumPollingTime" is set. ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_without_MaximumPollingTime_offsets_the_first_interval_of_the_second_registered_device)
+{
+    //arrange
+    unsigned int minimumPollingTime = 100;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    IoTHubTransportHttp_Unregister(devHandle);
+    devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    umock_c_reset_all_calls();
+
+    /*the GET is answered with 204, the second device registered waits 100s plus an offset of 61s*/
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 161);
+    STRICT_EXPECTED_CALL(get_difftime(TEST_GET_TIME_VALUE + 161, TEST_GET_TIME_VALUE))
+        .SetReturn(161);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
+//Tests_SRS_TRANSPORTMULTITHTTP_09_017: [ After a GET that is not answered with 204, the back off shall start over, so the next GET answered without a message waits "MinimumPollingTime". ]
+TEST_FUNCTION(IoTHubTransportHttp_DoWork_with_MaximumPollingTime_after_a_service_message_waits_MinimumPollingTime)
+{
+    //arrange
+    unsigned int statusCode200 = 200;
+    unsigned int minimumPollingTime = 20;
+    unsigned int maximumPollingTime = 80;
+    TRANSPORT_LL_HANDLE handle = IoTHubTransportHttp_Create(&TEST_CONFIG);
+    IOTHUB_DEVICE_HANDLE devHandle = IoTHubTransportHttp_Register(handle, &TEST_DEVICE_1, TEST_IOTHUB_CLIENT_LL_HANDLE, TEST_CONFIG.waitingToSend);
+    (void)IoTHubTransportHttp_Subscribe(devHandle);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MIN_POLLING_TIME, &minimumPollingTime);
+    (void)IoTHubTransportHttp_SetOption(handle, OPTION_MAX_POLLING_TIME, &maximumPollingTime);
+    umock_c_reset_all_calls();
+
+    /*the first GET receives a message, the one right after it gets 204*/
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE);
+    STRICT_EXPECTED_CALL(HTTPHeaders_Alloc());
+    STRICT_EXPECTED_CALL(BUFFER_new());
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPAPIEX_SAS_ExecuteRequest(IGNORED_PTR_ARG, IGNORED_PTR_ARG, HTTPAPI_REQUEST_GET, "/devices/" TEST_DEVICE_ID MESSAGE_ENDPOINT_HTTP API_VERSION, IGNORED_PTR_ARG, NULL, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .IgnoreArgument_requestType()
+        .CopyOutArgumentBuffer(7, &statusCode200, sizeof(statusCode200));
+    STRICT_EXPECTED_CALL(HTTPHeaders_FindHeaderValue(IGNORED_PTR_ARG, "ETag"))
+        .SetReturn(NULL);
+    STRICT_EXPECTED_CALL(BUFFER_delete(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(HTTPHeaders_Free(IGNORED_PTR_ARG));
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    STRICT_EXPECTED_CALL(get_time(NULL))
+        .SetReturn(TEST_GET_TIME_VALUE + 1);
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+    umock_c_reset_all_calls();
+
+    /*20s plus at most 2s of jitter, not the doubled 40s*/
+    setupDoWorkLoopOnceForOneDevice();
+    STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
+    setupDoMessagesForFailedGetAtPollTime(TEST_GET_TIME_VALUE + 1, TEST_GET_TIME_VALUE + 1 + 23);
+
+    //act
+    IoTHubTransportHttp_DoWork(handle, TEST_IOTHUB_CLIENT_LL_HANDLE);
+
+    //assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+
+    //cleanup
+    IoTHubTransportHttp_Destroy(handle);
+}
+
 //Tests_SRS_TRANSPORTMULTITHTTP_17_084: [ Otherwise, IoTHubTransportHttp_DoWork shall call HTTPAPIEX_SAS_ExecuteRequest passing the following parameters
 //requestType: GET
 //	relativePath : the message HTTP relative path
@@ -9854,7 +10598,8 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_empty_waitingToSend_and_empty_ev
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
 
@@ -9891,7 +10636,8 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_waitingToSend_not_empty_success)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2);
     STRICT_EXPECTED_CALL(DList_IsListEmpty(&waitingToSend));
@@ -9927,10 +10673,11 @@ TEST_FUNCTION(IoTHubTransportHttp_GetSendStatus_deviceData_is_not_found_fails)
 
     umock_c_reset_all_calls();
 
-    STRICT_EXPECTED_CALL(VECTOR_find_if(IGNORED_PTR_ARG, IGNORED_PTR_ARG, devHandle))
+    STRICT_EXPECTED_CALL(STRING_c_str(IGNORED_PTR_ARG));
+    STRICT_EXPECTED_CALL(hash_index_find(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .IgnoreArgument(1)
         .IgnoreArgument(2)
-        .SetFailReturn((void_ptr)NULL);
+        .SetReturn((void_ptr)NULL);
 
     IOTHUB_CLIENT_STATUS status;
 
@@ -105,16 +105,9 @@ int test_amqpvalue_get_string(AMQP_VALUE value, const char** string_value)
 
 static void set_exp_calls_for_create_encoded_message_properties(bool has_message_id, bool has_correlation_id, const char* content_type, const char* content_encoding)
 {
-    size_t encoding_size = 5;
-
-    STRICT_EXPECTED_CALL(properties_create());
-
     if (has_message_id)
     {
         STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_IOTHUB_MESSAGE_HANDLE));
-        STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_STRING));
-        STRICT_EXPECTED_CALL(properties_set_message_id(TEST_PROPERTIES_HANDLE, TEST_AMQP_VALUE));
-        STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
     }
     else
     {
@@ -124,9 +117,6 @@ static void set_exp_calls_for_create_encoded_message_properties(bool has_message
     if (has_correlation_id)
     {
         STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_IOTHUB_MESSAGE_HANDLE));
-        STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_CORRELATION_ID));
-        STRICT_EXPECTED_CALL(properties_set_correlation_id(TEST_PROPERTIES_HANDLE, TEST_AMQP_VALUE));
-        STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
     }
     else
     {
@@ -135,60 +125,21 @@ static void set_exp_calls_for_create_encoded_message_properties(bool has_message
 
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE))
         .SetReturn(content_type);
-
-    if (content_type != NULL)
-    {
-        STRICT_EXPECTED_CALL(properties_set_content_type(IGNORED_PTR_ARG, content_type));
-    }
-    
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE))
         .SetReturn(content_encoding);
-
-    if (content_encoding != NULL)
-    {
-        STRICT_EXPECTED_CALL(properties_set_content_encoding(IGNORED_PTR_ARG, content_encoding));
-    }
-
-    STRICT_EXPECTED_CALL(amqpvalue_create_properties(TEST_PROPERTIES_HANDLE));
-    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
-    STRICT_EXPECTED_CALL(properties_destroy(TEST_PROPERTIES_HANDLE));
 }
 
 static void set_exp_calls_for_create_encoded_application_properties(size_t number_of_app_properties)
 {
-    size_t encoding_size = 5;
-
     STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
     STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
         .CopyOutArgumentBuffer(2, &TEST_MAP_KEYS, sizeof(TEST_MAP_KEYS))
         .CopyOutArgumentBuffer(3, &TEST_MAP_VALUES, sizeof(TEST_MAP_VALUES))
         .CopyOutArgumentBuffer(4, &number_of_app_properties, sizeof(number_of_app_properties));
-
-    if (number_of_app_properties > 0)
-    {
-        STRICT_EXPECTED_CALL(amqpvalue_create_map());
-
-        for (size_t i = 0; i < number_of_app_properties; i++)
-        {
-            STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_MAP_KEYS[i]));
-            STRICT_EXPECTED_CALL(amqpvalue_create_string(TEST_MAP_VALUES[i]));
-            STRICT_EXPECTED_CALL(amqpvalue_set_map_value(TEST_AMQP_VALUE, TEST_AMQP_VALUE, TEST_AMQP_VALUE));
-            STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
-            STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
-        }
-
-        STRICT_EXPECTED_CALL(amqpvalue_create_application_properties(TEST_AMQP_VALUE));
-        STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-            .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
-        STRICT_EXPECTED_CALL(amqpvalue_destroy(IGNORED_PTR_ARG));
-    }
 }
 
 static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg_content_type)
 {
-    size_t encoding_size = 5;
-
     STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(msg_content_type);
 
     if (msg_content_type == IOTHUBMESSAGE_BYTEARRAY)
@@ -199,12 +150,6 @@ static void set_exp_calls_for_create_encoded_data(IOTHUBMESSAGE_CONTENT_TYPE msg
     {
         STRICT_EXPECTED_CALL(IoTHubMessage_GetString(TEST_IOTHUB_MESSAGE_HANDLE));
     }
-
-    data d;
-    memset(&d, 0, sizeof(d));
-    STRICT_EXPECTED_CALL(amqpvalue_create_data(d)).IgnoreArgument(1);
-    STRICT_EXPECTED_CALL(amqpvalue_get_encoded_size(IGNORED_PTR_ARG, IGNORED_PTR_ARG))
-        .CopyOutArgumentBuffer(2, &encoding_size, sizeof(encoding_size));
 }
 
 static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(size_t number_of_app_properties, IOTHUBMESSAGE_CONTENT_TYPE msg_content_type, bool has_message_id, bool has_correlation_id, const char* content_type, const char* content_encoding)
@@ -212,22 +157,6 @@ static void set_exp_calls_for_message_create_uamqp_encoding_from_iothub_message(
     set_exp_calls_for_create_encoded_message_properties(has_message_id, has_correlation_id, content_type, content_encoding);
     set_exp_calls_for_create_encoded_application_properties(number_of_app_properties);
     set_exp_calls_for_create_encoded_data(msg_content_type);
-
-    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    if (number_of_app_properties > 0)
-    {
-        STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-    }
-
-    STRICT_EXPECTED_CALL(amqpvalue_encode(TEST_AMQP_VALUE, IGNORED_PTR_ARG, IGNORED_PTR_ARG));
-
-    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
-    if (number_of_app_properties > 0)
-    {
-        STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
-    }
-    STRICT_EXPECTED_CALL(amqpvalue_destroy(TEST_AMQP_VALUE));
 }
 
 static void set_exp_calls_for_message_create_IoTHubMessage_from_uamqp_message(size_t number_of_properties, bool has_message_id, bool has_correlation_id, bool has_properties)
@@ -683,6 +612,60 @@ TEST_FUNCTION(message_create_from_iothub_message_no_content_encoding_success)
     }
 }
 
+// Tests_SRS_UAMQP_MESSAGING_31_119: [Encode the message properties, application properties and data sections into the blob.]
+// Tests_SRS_UAMQP_MESSAGING_09_047: [The encoded size of every section shall be computed upfront so the whole message is encoded into a single allocation, without creating intermediate AMQP_VALUE instances.]
+TEST_FUNCTION(message_create_uamqp_encoding_from_iothub_message_encodes_sections)
+{
+    // arrange
+    static const unsigned char test_data[] = { 0x01, 0x02 };
+    static const unsigned char expected_encoding[] =
+    {
+        0x00, 0x53, 0x73, 0xC0, 0x11, 0x08,                 // properties: list8 of 8 fields
+        0xA1, 0x02, 'i', 'd',                               // message-id
+        0x40, 0x40, 0x40, 0x40, 0x40, 0x40,                 // user-id to correlation-id
+        0xA3, 0x04, 'u', 't', 'f', '8',                     // content-encoding
+        0x00, 0x53, 0x74, 0xC1, 0x07, 0x02,                 // application-properties: map8 of 1 pair
+        0xA1, 0x01, 'k', 0xA1, 0x01, 'v',
+        0x00, 0x53, 0x75, 0xA0, 0x02, 0x01, 0x02            // data: vbin8
+    };
+    const unsigned char* test_data_ptr = test_data;
+    size_t test_data_length = sizeof(test_data);
+    const char* keys[] = { "k" };
+    const char* values[] = { "v" };
+    const char* const* keys_ptr = keys;
+    const char* const* values_ptr = values;
+    size_t number_of_app_properties = 1;
+
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetMessageId(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn("id");
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetCorrelationId(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentTypeSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(NULL);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentEncodingSystemProperty(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn("utf8");
+    STRICT_EXPECTED_CALL(IoTHubMessage_Properties(TEST_IOTHUB_MESSAGE_HANDLE));
+    STRICT_EXPECTED_CALL(Map_GetInternals(IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &keys_ptr, sizeof(keys_ptr))
+        .CopyOutArgumentBuffer(3, &values_ptr, sizeof(values_ptr))
+        .CopyOutArgumentBuffer(4, &number_of_app_properties, sizeof(number_of_app_properties));
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetContentType(TEST_IOTHUB_MESSAGE_HANDLE)).SetReturn(IOTHUBMESSAGE_BYTEARRAY);
+    STRICT_EXPECTED_CALL(IoTHubMessage_GetByteArray(TEST_IOTHUB_MESSAGE_HANDLE, IGNORED_PTR_ARG, IGNORED_PTR_ARG))
+        .CopyOutArgumentBuffer(2, &test_data_ptr, sizeof(test_data_ptr))
+        .CopyOutArgumentBuffer(3, &test_data_length, sizeof(test_data_length));
+
+    BINARY_DATA binary_data;
+    memset(&binary_data, 0, sizeof(binary_data));
+
+    // act
+    int result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
+
+    // assert
+    ASSERT_ARE_EQUAL(char_ptr, umock_c_get_expected_calls(), umock_c_get_actual_calls());
+    ASSERT_ARE_EQUAL(int, 0, result);
+    ASSERT_ARE_EQUAL(size_t, sizeof(expected_encoding), binary_data.length);
+    ASSERT_ARE_EQUAL(int, 0, memcmp(expected_encoding, binary_data.bytes, sizeof(expected_encoding)));
+
+    // cleanup
+    real_free((void*)binary_data.bytes);
+}
+
 // Tests_SRS_UAMQP_MESSAGING_31_120: [Create a blob that contains AMQP encoding of IOTHUB_MESSAGE_HANDLE.  Errors stop processing on this message.]
 // Tests_SRS_UAMQP_MESSAGING_31_121: [Any errors during `message_create_uamqp_encoding_from_iothub_message` stop processing on this message.]
 TEST_FUNCTION(message_create_from_iothub_message_BYTEARRAY_return_errors_fails)
@@ -705,30 +688,16 @@ TEST_FUNCTION(message_create_from_iothub_message_BYTEARRAY_return_errors_fails)
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(i);
 
-        if ((i == 4) || // amqpvalue_destroy
-             (i == 8) || // amqpvalue_destroy
-             (i == 15) || // properties_destroy
-             (i == 22) || // amqpvalue_destroy
-             (i == 23) || // amqpvalue_destroy
-             (i == 26) || // amqpvalue_destroy
-             (i == 34) || // amqpvalue_destroy
-             (i == 35) || // amqpvalue_destroy
-             (i == 36) // amqpvalue_destroy
-           )
-        {
-            continue; // these lines have functions that do not return anything (void).
-        }
-
         BINARY_DATA binary_data;
         memset(&binary_data, 0, sizeof(binary_data));
 
         result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
 
         // assert
-        if ((i == 1) || // GetMessageId is optional
-            (i == 5) || //GetCorrelationId is optional
-            (i == 9) || // ContentType is optional 
-            (i == 11)   // ContentEncoding is optional
+        if ((i == 0) || // GetMessageId is optional
+            (i == 1) || // GetCorrelationId is optional
+            (i == 2) || // ContentType is optional
+            (i == 3)    // ContentEncoding is optional
            )
         {
             ASSERT_ARE_EQUAL(int, result, 0);
@@ -772,31 +741,17 @@ TEST_FUNCTION(message_create_from_iothub_message_STRING_return_errors_fails)
         umock_c_negative_tests_reset();
         umock_c_negative_tests_fail_call(i);
 
-        if ((i == 4) || // amqpvalue_destroy
-             (i == 8) || // amqpvalue_destroy
-             (i == 15) || // properties_destroy
-             (i == 22) || // amqpvalue_destroy
-             (i == 23) || // amqpvalue_destroy
-             (i == 26) || // amqpvalue_destroy
-             (i == 34) || // amqpvalue_destroy
-             (i == 35) || // amqpvalue_destroy
-             (i == 36) // amqpvalue_destroy
-           )
-        {
-            continue; // these lines have functions that do not return anything (void).
-        }
-
         BINARY_DATA binary_data;
         memset(&binary_data, 0, sizeof(binary_data));
 
         result = message_create_uamqp_encoding_from_iothub_message(TEST_IOTHUB_MESSAGE_HANDLE, &binary_data);
 
         // assert
-        if ((i == 1) || // GetMessageId is optional
-            (i == 5) || //GetCorrelationId is optional
-            (i == 9) || // ContentType is optional 
-            (i == 11)   // ContentEncoding is optional
-             )
+        if ((i == 0) || // GetMessageId is optional
+            (i == 1) || // GetCorrelationId is optional
+            (i == 2) || // ContentType is optional
+            (i == 3)    // ContentEncoding is optional
+           )
         {
             ASSERT_ARE_EQUAL(int, result, 0);
         }